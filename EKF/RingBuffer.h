@@ -37,11 +37,39 @@
  * Template RingBuffer.
  */
 
+#pragma once
+
 #include <inttypes.h>
 #include <cstdio>
 #include <cstring>
 
+// sample storage selected at compile time: in-class arrays when a fixed capacity
+// is given, nothing when the buffer length is decided at run time
+template <typename data_type, uint8_t capacity>
+struct RingBufferStorage {
+	data_type *data() { return _samples; }
+	uint64_t *times() { return _times; }
+	data_type _samples[capacity];
+	uint64_t _times[capacity];
+};
+
 template <typename data_type>
+struct RingBufferStorage<data_type, 0> {
+	data_type *data() { return nullptr; }
+	uint64_t *times() { return nullptr; }
+};
+
+// The sample timestamps are mirrored into a dense lane next to the sample structs, so
+// the time indexed retrieval only streams the timestamps it compares rather than
+// dragging the full samples through the cache.
+//
+// The second template parameter selects the storage mode. The default of zero keeps
+// the historical behaviour where allocate() sizes the buffer on the heap (or init()
+// places it in caller owned storage). A non-zero fixed_capacity embeds the sample
+// array in the buffer object itself, so targets which know their maximum buffer
+// length at compile time get zero heap usage, no allocation failure path and a
+// faster cold start.
+template <typename data_type, uint8_t fixed_capacity = 0>
 class RingBuffer
 {
 public:
@@ -53,7 +81,7 @@ public:
 			push(d);
 		}
 	}
-	~RingBuffer() { delete[] _buffer; }
+	~RingBuffer() { unallocate(); }
 
 	// no copy, assignment, move, move assignment
 	RingBuffer(const RingBuffer &) = delete;
@@ -63,35 +91,110 @@ public:
 
 	bool allocate(uint8_t size)
 	{
-		if (_buffer != nullptr) {
-			delete[] _buffer;
+		unallocate();
+
+		if (fixed_capacity > 0) {
+			// fixed capacity mode: the samples live in the in-class arrays, so there is
+			// no heap usage, but lengths beyond the capacity the buffer was compiled
+			// with cannot be satisfied
+			if (size > fixed_capacity) {
+				return false;
+			}
+
+			_buffer = _storage.data();
+			_times = _storage.times();
+
+		} else {
+			_buffer = new data_type[size];
+			_times = new uint64_t[size];
+
+			if (_buffer == nullptr || _times == nullptr) {
+				delete[] _buffer;
+				delete[] _times;
+				_buffer = nullptr;
+				_times = nullptr;
+				return false;
+			}
+
+			_owns_buffer = true;
 		}
 
-		_buffer = new data_type[size];
+		reset(size);
+
+		return true;
+	}
 
-		if (_buffer == nullptr) {
+	// use caller owned storage for the samples and the timestamp lane, e.g. carved from
+	// a pre-allocated arena. The caller must guarantee that the storage outlives the buffer
+	bool init(data_type *storage, uint64_t *times, uint8_t size)
+	{
+		if (storage == nullptr || times == nullptr || size == 0) {
 			return false;
 		}
 
-		_size = size;
+		unallocate();
 
-		_head = 0;
-		_tail = 0;
+		_buffer = storage;
+		_times = times;
+		_owns_buffer = false;
 
-		// set the time elements to zero so that bad data is not retrieved from the buffers
-		for (uint8_t index = 0; index < _size; index++) {
-			_buffer[index] = {};
+		reset(size);
+
+		return true;
+	}
+
+	// move the buffer contents into caller owned replacement storage of the given size,
+	// keeping the newest samples when the new storage is smaller
+	bool migrate(data_type *storage, uint64_t *times, uint8_t size)
+	{
+		if (storage == nullptr || times == nullptr || size == 0) {
+			return false;
 		}
 
-		_first_write = true;
+		// number of valid samples currently held
+		uint8_t count = _first_write ? 1 : (uint8_t)((_head + _size - _tail) % _size + 1);
+
+		if (count > size) {
+			count = size;
+		}
+
+		// copy across in time order, oldest first
+		for (uint8_t index = 0; index < count; index++) {
+			storage[index] = _buffer[(uint8_t)((_head + _size - count + 1 + index) % _size)];
+			times[index] = storage[index].time_us;
+		}
+
+		// clear the unused tail of the new storage so that bad data is not retrieved
+		for (uint8_t index = count; index < size; index++) {
+			storage[index] = {};
+			times[index] = 0;
+		}
+
+		if (_owns_buffer) {
+			delete[] _buffer;
+			delete[] _times;
+		}
+
+		_buffer = storage;
+		_times = times;
+		_owns_buffer = false;
+		_size = size;
+		_tail = 0;
+		_head = count - 1;
 
 		return true;
 	}
 
 	void unallocate()
 	{
-		delete[] _buffer;
+		if (_owns_buffer) {
+			delete[] _buffer;
+			delete[] _times;
+		}
+
 		_buffer = nullptr;
+		_times = nullptr;
+		_size = 0;
 	}
 
 	void push(const data_type &sample)
@@ -99,15 +202,16 @@ public:
 		uint8_t head_new = _head;
 
 		if (!_first_write) {
-			head_new = (_head + 1) % _size;
+			head_new = wrap_next(_head);
 		}
 
 		_buffer[head_new] = sample;
+		_times[head_new] = sample.time_us;
 		_head = head_new;
 
 		// move tail if we overwrite it
 		if (_head == _tail && !_first_write) {
-			_tail = (_tail + 1) % _size;
+			_tail = wrap_next(_tail);
 
 		} else {
 			_first_write = false;
@@ -123,49 +227,160 @@ public:
 
 	uint8_t get_oldest_index() const { return _tail; }
 
+	// number of valid samples currently held
+	uint8_t entries() const { return _first_write ? 0 : (uint8_t)((_head + _size - _tail) % _size + 1); }
+
+	// access the stored samples in time order, index 0 is the oldest sample
+	// and must be less than entries()
+	const data_type &peek_ordered(uint8_t index) const { return _buffer[(uint8_t)((_tail + index) % _size)]; }
+
+	// drop all stored samples, the allocation is retained
+	void clear() { reset(_size); }
+
 	bool pop_first_older_than(const uint64_t &timestamp, data_type *sample)
 	{
-		// start looking from newest observation data
-		for (uint8_t i = 0; i < _size; i++) {
-			int index = (_head - i);
-			index = index < 0 ? _size + index : index;
+		uint8_t index;
 
-			if (timestamp >= _buffer[index].time_us && timestamp - _buffer[index].time_us < (uint64_t)1e5) {
+		if (!find_newest_older_than(timestamp, index)) {
+			return false;
+		}
 
-				*sample = _buffer[index];
+		*sample = _buffer[index];
+		consume(index);
 
-				// Now we can set the tail to the item which comes after the one we removed
-				// since we don't want to have any older data in the buffer
-				if (index == _head) {
-					_tail = _head;
-					_first_write = true;
+		return true;
+	}
 
-				} else {
-					_tail = (index + 1) % _size;
-				}
+	// variant of pop_first_older_than() which blends the returned sample with the
+	// following stored sample so the result lands exactly on the requested timestamp,
+	// allowing the same alignment accuracy from a shorter buffer
+	// requires an interpolateSample() overload for the sample type
+	// when no newer sample is stored the behaviour matches pop_first_older_than()
+	bool pop_interpolated(const uint64_t &timestamp, data_type *sample)
+	{
+		uint8_t index;
 
-				_buffer[index].time_us = 0;
+		if (!find_newest_older_than(timestamp, index)) {
+			return false;
+		}
+
+		const data_type &newer = _buffer[wrap_next(index)];
+
+		if ((index != _head) && (newer.time_us > _buffer[index].time_us)) {
+			*sample = interpolateSample(_buffer[index], newer, timestamp);
+
+		} else {
+			*sample = _buffer[index];
+		}
+
+		consume(index);
+
+		return true;
+	}
+
+	int get_total_size() { return sizeof(*this) + (sizeof(data_type) + sizeof(uint64_t)) * _size; }
+
+	// number of bytes of sample and timestamp storage currently reserved
+	size_t get_storage_size() const { return (sizeof(data_type) + sizeof(uint64_t)) * _size; }
+
+	// true when the storage was heap allocated by the buffer itself rather than
+	// placed in caller owned storage or the in-class array
+	bool owns_storage() const { return _owns_buffer && (_buffer != nullptr); }
 
-				return true;
+private:
+	// find the newest sample which is older than or as old as the timestamp
+	// returns false when no sample within the acceptance window exists
+	// the search runs over the dense timestamp lane so it streams 8 byte entries
+	// instead of striding through the full sample structs
+	bool find_newest_older_than(const uint64_t &timestamp, uint8_t &found) const
+	{
+		if (_times[_tail] > timestamp) {
+			// the oldest sample is newer than the timestamp
+			return false;
+		}
+
+		// samples are pushed in time order so binary search the offsets from the tail
+		// for the newest sample which is older than or as old as the timestamp
+		uint8_t lo = 0;
+		uint8_t hi = (_head >= _tail) ? (_head - _tail) : (_size - _tail + _head);
+
+		while (lo < hi) {
+			const uint8_t mid = (lo + hi + 1) / 2;
+			uint8_t index = _tail + mid;
+
+			if (index >= _size) {
+				index -= _size;
 			}
 
-			if (index == _tail) {
-				// we have reached the tail and haven't got a match
-				return false;
+			if (_times[index] <= timestamp) {
+				lo = mid;
+
+			} else {
+				hi = mid - 1;
 			}
 		}
 
-		return false;
+		uint8_t index = _tail + lo;
+
+		if (index >= _size) {
+			index -= _size;
+		}
+
+		if (timestamp - _times[index] >= (uint64_t)1e5) {
+			return false;
+		}
+
+		found = index;
+
+		return true;
 	}
 
-	int get_total_size() { return sizeof(*this) + sizeof(data_type) * _size; }
+	// drop the consumed sample and everything older from the buffer
+	void consume(uint8_t index)
+	{
+		// Now we can set the tail to the item which comes after the one we removed
+		// since we don't want to have any older data in the buffer
+		if (index == _head) {
+			_tail = _head;
+			_first_write = true;
+
+		} else {
+			_tail = wrap_next(index);
+		}
+
+		_buffer[index].time_us = 0;
+		_times[index] = 0;
+	}
+
+	void reset(uint8_t size)
+	{
+		_size = size;
+
+		_head = 0;
+		_tail = 0;
+
+		// set the time elements to zero so that bad data is not retrieved from the buffers
+		for (uint8_t index = 0; index < _size; index++) {
+			_buffer[index] = {};
+			_times[index] = 0;
+		}
+
+		_first_write = true;
+	}
+
+	// advance a buffer index by one position with wrap around
+	// cheaper than a modulo operation because the buffer length is not constrained to a power of two
+	uint8_t wrap_next(uint8_t index) const { return (index >= _size - 1) ? 0 : index + 1; }
 
-private:
 	data_type *_buffer{nullptr};
+	uint64_t *_times{nullptr};
+
+	RingBufferStorage<data_type, fixed_capacity> _storage;
 
 	uint8_t _head{0};
 	uint8_t _tail{0};
 	uint8_t _size{0};
 
 	bool _first_write{true};
+	bool _owns_buffer{false};
 };
@@ -0,0 +1,112 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file Seqlock.h
+ * Template sequence lock protecting a single data block.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+
+// One writer thread may call write() while any number of reader threads call read()
+// without any locking. The writer bumps the sequence counter to an odd value before
+// touching the data and to the next even value after, so a reader that copies the
+// block while a write is in flight sees an odd or changed counter and retries the
+// copy. The writer never blocks or retries, which keeps the publication cost on the
+// filter thread constant.
+template <typename data_type>
+class Seqlock
+{
+public:
+	Seqlock() = default;
+
+	// no copy, assignment, move, move assignment
+	Seqlock(const Seqlock &) = delete;
+	Seqlock &operator=(const Seqlock &) = delete;
+	Seqlock(Seqlock &&) = delete;
+	Seqlock &operator=(Seqlock &&) = delete;
+
+	// writer side only
+	void write(const data_type &data)
+	{
+		const uint32_t seq = _seq.load(std::memory_order_relaxed);
+
+		// odd value marks the write in progress; the release fence keeps the data
+		// stores from becoming visible before it
+		_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		_data = data;
+
+		_seq.store(seq + 2, std::memory_order_release);
+	}
+
+	// reader side only
+	// returns false when nothing has been published yet, otherwise loops until a
+	// consistent copy has been taken
+	bool read(data_type *data) const
+	{
+		for (;;) {
+			const uint32_t seq_before = _seq.load(std::memory_order_acquire);
+
+			if (seq_before == 0) {
+				// never written
+				return false;
+			}
+
+			if (seq_before & 1u) {
+				// write in progress
+				continue;
+			}
+
+			*data = _data;
+
+			// the acquire fence keeps the data loads from being delayed past the
+			// sequence re-check
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (_seq.load(std::memory_order_relaxed) == seq_before) {
+				return true;
+			}
+		}
+	}
+
+private:
+	data_type _data{};
+
+	std::atomic<uint32_t> _seq{0};	///< even when idle, odd while a write is in progress
+};
@@ -0,0 +1,128 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file SpscQueue.h
+ * Template lock free single producer single consumer queue.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+
+// One thread may call push() while another thread calls pop() without any locking.
+// The producer publishes a slot with a release store of the head index and the
+// consumer observes it with an acquire load, so the sample data is always visible
+// before the slot is, and neither side ever blocks the other.
+template <typename data_type>
+class SpscQueue
+{
+public:
+	SpscQueue() = default;
+	~SpscQueue() { delete[] _buffer; }
+
+	// no copy, assignment, move, move assignment
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+	SpscQueue(SpscQueue &&) = delete;
+	SpscQueue &operator=(SpscQueue &&) = delete;
+
+	bool allocate(uint16_t size)
+	{
+		if (size == 0) {
+			return false;
+		}
+
+		delete[] _buffer;
+
+		// one slot is kept empty to distinguish a full queue from an empty one
+		_size = size + 1;
+		_buffer = new data_type[_size];
+
+		if (_buffer == nullptr) {
+			return false;
+		}
+
+		_head.store(0, std::memory_order_relaxed);
+		_tail.store(0, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	// producer side only
+	// returns false without blocking when the queue is full and the sample is dropped
+	bool push(const data_type &sample)
+	{
+		const uint16_t head = _head.load(std::memory_order_relaxed);
+		const uint16_t head_next = wrap_next(head);
+
+		if (head_next == _tail.load(std::memory_order_acquire)) {
+			// full
+			return false;
+		}
+
+		_buffer[head] = sample;
+		_head.store(head_next, std::memory_order_release);
+
+		return true;
+	}
+
+	// consumer side only
+	// returns false without blocking when the queue is empty
+	bool pop(data_type *sample)
+	{
+		const uint16_t tail = _tail.load(std::memory_order_relaxed);
+
+		if (tail == _head.load(std::memory_order_acquire)) {
+			// empty
+			return false;
+		}
+
+		*sample = _buffer[tail];
+		_tail.store(wrap_next(tail), std::memory_order_release);
+
+		return true;
+	}
+
+private:
+	// advance a queue index by one position with wrap around
+	uint16_t wrap_next(uint16_t index) const { return (index >= _size - 1) ? 0 : index + 1; }
+
+	data_type *_buffer{nullptr};
+	uint16_t _size{0};
+
+	std::atomic<uint16_t> _head{0};	///< index of the next slot written by the producer
+	std::atomic<uint16_t> _tail{0};	///< index of the next slot read by the consumer
+};
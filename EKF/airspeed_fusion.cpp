@@ -43,9 +43,17 @@
 #include "../ecl.h"
 #include "ekf.h"
 #include <mathlib/mathlib.h>
+#include <mathlib/kalman_kernels.h>
 
+namespace kf = ecl::kalman;
+
+#ifndef EKF_NO_AIRSPEED_FUSION
 void Ekf::fuseAirspeed()
 {
+#ifdef EKF_NO_WIND_STATES
+	// the wind velocity states are not part of this build
+	return;
+#else
 	// Initialize variables
 	float vn; // Velocity in north direction
 	float ve; // Velocity in east direction
@@ -53,7 +61,7 @@ void Ekf::fuseAirspeed()
 	float vwn; // Wind speed in north direction
 	float vwe; // Wind speed in east direction
 	float v_tas_pred; // Predicted measurement
-	float R_TAS = sq(math::constrain(_params.eas_noise, 0.5f, 5.0f) * math::constrain(_airspeed_sample_delayed.eas2tas, 0.9f,
+	float R_TAS = sq(_derived_params.eas_noise_limited * math::constrain(_airspeed_sample_delayed.eas2tas, 0.9f,
 			 10.0f)); // Variance for true airspeed measurement - (m/sec)^2
 	float SH_TAS[3] = {}; // Varialbe used to optimise calculations of measurement jacobian
 	float H_TAS[24] = {}; // Observation Jacobian
@@ -67,8 +75,12 @@ void Ekf::fuseAirspeed()
 	vwn = _state.wind_vel(0);
 	vwe = _state.wind_vel(1);
 
+	// refresh the shared wind relative kinematics (no-op if already current)
+	updateWindRelKinematics();
+	const Vector3f &rel_wind = _wind_rel_kin.rel_wind_earth;
+
 	// Calculate the predicted airspeed
-	v_tas_pred = sqrtf((ve - vwe) * (ve - vwe) + (vn - vwn) * (vn - vwn) + vd * vd);
+	v_tas_pred = sqrtf(rel_wind(1) * rel_wind(1) + rel_wind(0) * rel_wind(0) + rel_wind(2) * rel_wind(2));
 
 	// Perform fusion of True Airspeed measurement
 	if (v_tas_pred > 1.0f) {
@@ -159,10 +171,10 @@ void Ekf::fuseAirspeed()
 		_airspeed_innov_var = 1.0f / SK_TAS[0];
 
 		// Compute the ratio of innovation to gate size
-		_tas_test_ratio = sq(_airspeed_innov) / (sq(fmaxf(_params.tas_innov_gate, 1.0f)) * _airspeed_innov_var);
+		_innov_monitor.ratio.tas = sq(_airspeed_innov) / (_derived_params.tas_innov_gate_sq * _airspeed_innov_var);
 
 		// If the innovation consistency check fails then don't fuse the sample and indicate bad airspeed health
-		if (_tas_test_ratio > 1.0f) {
+		if (_innov_monitor.ratio.tas > 1.0f) {
 			_innov_check_fail_status.flags.reject_airspeed = true;
 			return;
 
@@ -174,57 +186,21 @@ void Ekf::fuseAirspeed()
 		_time_last_arsp_fuse = _time_last_imu;
 
 		// apply covariance correction via P_new = (I -K*H)*P
-		// first calculate expression for KHP
-		// then calculate P - KHP
-		float KHP[_k_num_states][_k_num_states];
-		float KH[5];
-
-		for (unsigned row = 0; row < _k_num_states; row++) {
-
-			KH[0] = Kfusion[row] * H_TAS[4];
-			KH[1] = Kfusion[row] * H_TAS[5];
-			KH[2] = Kfusion[row] * H_TAS[6];
-			KH[3] = Kfusion[row] * H_TAS[22];
-			KH[4] = Kfusion[row] * H_TAS[23];
-
-			for (unsigned column = 0; column < _k_num_states; column++) {
-				float tmp = KH[0] * P[4][column];
-				tmp += KH[1] * P[5][column];
-				tmp += KH[2] * P[6][column];
-				tmp += KH[3] * P[22][column];
-				tmp += KH[4] * P[23][column];
-				KHP[row][column] = tmp;
-			}
-		}
+		// form the H*P row once - for symmetric P the correction K*H*P is then the
+		// rank-1 outer product of the gain and this row
+		float HP[_k_max_num_states];
+		const uint8_t h_idx[5] = {4, 5, 6, 22, 23};
+		const float h_val[5] = {H_TAS[4], H_TAS[5], H_TAS[6], H_TAS[22], H_TAS[23]};
+		kf::sparseRowProduct(P, h_val, h_idx, 5, HP, _k_num_states);
 
 		// if the covariance correction will result in a negative variance, then
 		// the covariance marix is unhealthy and must be corrected
-		bool healthy = true;
-		_fault_status.flags.bad_airspeed = false;
+		const bool healthy = kf::rankOneDowndateHealthy(P, Kfusion, HP, _k_num_states);
+		_fault_status.flags.bad_airspeed = !healthy;
 
-		for (int i = 0; i < _k_num_states; i++) {
-			if (P[i][i] < KHP[i][i]) {
-				// zero rows and columns
-				zeroRows(P, i, i);
-				zeroCols(P, i, i);
-
-				//flag as unhealthy
-				healthy = false;
-
-				// update individual measurement health status
-				_fault_status.flags.bad_airspeed = true;
-
-			}
-		}
-
-		// only apply covariance and state corrrections if healthy
 		if (healthy) {
 			// apply the covariance corrections
-			for (unsigned row = 0; row < _k_num_states; row++) {
-				for (unsigned column = 0; column < _k_num_states; column++) {
-					P[row][column] = P[row][column] - KHP[row][column];
-				}
-			}
+			kf::rankOneDowndate(P, Kfusion, HP, _k_num_states);
 
 			// correct the covariance marix for gross errors
 			fixCovarianceErrors();
@@ -232,9 +208,20 @@ void Ekf::fuseAirspeed()
 			// apply the state corrections
 			fuse(Kfusion, _airspeed_innov);
 
+		} else {
+			// zero the rows and columns of any state whose variance would have
+			// been driven negative by the correction
+			for (int i = 0; i < _k_num_states; i++) {
+				if (P[i][i] < Kfusion[i] * HP[i]) {
+					zeroRows(P, i, i);
+					zeroCols(P, i, i);
+				}
+			}
 		}
 	}
+#endif // EKF_NO_WIND_STATES
 }
+#endif // EKF_NO_AIRSPEED_FUSION
 
 void Ekf::get_wind_velocity(float *wind)
 {
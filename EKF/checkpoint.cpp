@@ -0,0 +1,449 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file checkpoint.cpp
+ * Warm start checkpointing of the complete filter state.
+ */
+
+#include "checkpoint.h"
+#include "ekf.h"
+
+#include <ecl.h>
+
+namespace
+{
+constexpr uint32_t CHECKPOINT_MAGIC = 0x4B4C4345;	// "ECLK"
+constexpr uint32_t CHECKPOINT_VERSION = 2;	// v2: GPS quality check states moved into the GpsQualityChecks stage
+}
+
+void EstimatorInterface::checkpointInterfaceFields(checkpointCursor &c)
+{
+	// the allocation geometry (_imu_buffer_length, _obs_buffer_length,
+	// _min_obs_interval_us) and the buffer failure flags describe this
+	// instance and are owned by initialise_interface(), so they are not
+	// part of the image - the buffer contents below are checked against
+	// the live allocation on restore
+
+	// measured sensor arrival intervals driving the buffer length adaption
+	c(_gps_interval_us);
+	c(_mag_interval_us);
+	c(_baro_interval_us);
+	c(_range_interval_us);
+	c(_airspeed_interval_us);
+	c(_flow_interval_us);
+	c(_ev_interval_us);
+	c(_auxvel_interval_us);
+	c(_obs_window_us);
+	c(_time_last_buffer_adapt);
+
+	c(_dt_imu_avg);
+
+	// samples on the delayed time horizon
+	c(_imu_sample_delayed);
+	c(_mag_sample_delayed);
+	c(_baro_sample_delayed);
+	c(_gps_sample_delayed);
+	c(_range_sample_delayed);
+	c(_airspeed_sample_delayed);
+	c(_flow_sample_delayed);
+	c(_ev_sample_delayed);
+	c(_drag_sample_delayed);
+	c(_drag_down_sampled);
+	c(_auxvel_sample_delayed);
+	c(_gps_blend);
+	c(_auxvel_direct_sample);
+	c(_auxvel_direct_ready);
+	c(_drag_sample_count);
+	c(_drag_sample_time_dt);
+	c(_air_density);
+
+	// sensor limitations
+	c(_rng_valid_min_val);
+	c(_rng_valid_max_val);
+	c(_flow_max_rate);
+	c(_flow_min_distance);
+	c(_flow_max_distance);
+
+	// output predictor
+	c(_output_sample_delayed);
+	c(_output_new);
+	c(_output_vert_delayed);
+	c(_output_vert_new);
+	c(_imu_sample_new);
+	c(_R_to_earth_now);
+	c(_vel_imu_rel_body_ned);
+	c(_vel_deriv_ned);
+
+	c(_imu_updated);
+
+	// NED origin
+	c(_NED_origin_initialised);
+	c(_gps_speed_valid);
+	c(_gps_origin_eph);
+	c(_gps_origin_epv);
+	c(_pos_ref);
+
+	// innovation consistency check monitoring ratios
+	c(_innov_monitor);
+	c(_innov_check_fail_status);
+
+	c(_is_dead_reckoning);
+	c(_deadreckon_time_exceeded);
+	c(_is_wind_dead_reckoning);
+
+	// IMU vibration and movement monitoring
+	c(_delta_ang_prev);
+	c(_delta_vel_prev);
+	c(_vibe_metrics);
+	c(_vibe_accum);
+	c(_vibe_sample_count);
+	c(_gps_drift_metrics);
+	c(_vehicle_at_rest);
+	c(_time_last_move_detect_us);
+	c(_gps_drift_updated);
+
+	// data buffer contents
+	c(_imu_buffer);
+	c(_gps_buffer);
+	c(_mag_buffer);
+	c(_baro_buffer);
+	c(_range_buffer);
+	c(_airspeed_buffer);
+	c(_flow_buffer);
+	c(_ext_vision_buffer);
+	c(_output_buffer);
+	c(_output_vert_buffer);
+	c(_drag_buffer);
+	c(_auxvel_buffer);
+
+	c(_time_last_imu);
+	c(_time_last_gps);
+	c(_time_last_mag);
+	c(_time_last_baro);
+	c(_time_last_range);
+	c(_time_last_airspeed);
+	c(_time_last_ext_vision);
+	c(_ev_downsample);
+	c(_mag_downsample);
+	c(_baro_downsample);
+	c(_time_last_optflow);
+	c(_time_last_gnd_effect_on);
+	c(_time_last_auxvel);
+
+	c(_fault_status);
+
+	c(_mag_declination_gps);
+	c(_mag_declination_to_save_deg);
+
+	c(_control_status);
+	c(_control_status_prev);
+}
+
+void Ekf::checkpointFields(checkpointCursor &c)
+{
+	checkpointInterfaceFields(c);
+
+	c(_state_reset_status);
+	c(_dt_ekf_avg);
+	c(_dt_update);
+	c(_state);
+	c(_filter_initialised);
+	c(_update_phase);
+	c(_quiescent_frame_count);
+	c(_quiescent_delta_ang);
+	c(_quiescent_delta_vel);
+	c(_quiescent_delta_ang_dt);
+	c(_quiescent_delta_vel_dt);
+	c(_quiescent_frame_us);
+	c(_imu_sample_prediction);
+	c(_earth_rate_initialised);
+
+	// fusion requests pending at the fusion time horizon
+	c(_fuse_height);
+	c(_fuse_pos);
+	c(_fuse_hor_vel);
+	c(_fuse_vert_vel);
+	c(_fuse_hor_vel_aux);
+	c(_posObsNoiseNE);
+	c(_posInnovGateNE);
+	c(_velObsVarNE);
+	c(_hvelInnovGate);
+
+	// relative position odometry model
+	c(_fuse_hpos_as_odom);
+	c(_pos_meas_prev);
+	c(_hpos_pred_prev);
+	c(_hpos_prev_available);
+	c(_ev_rot_vec_filt);
+	c(_ev_rot_mat);
+	c(_ev_rot_last_time_us);
+
+	c(_gps_data_ready);
+	c(_mag_data_ready);
+	c(_baro_data_ready);
+	c(_range_data_ready);
+	c(_flow_data_ready);
+	c(_ev_data_ready);
+	c(_tas_data_ready);
+
+	c(_time_last_fake_gps);
+	c(_time_ins_deadreckon_start);
+	c(_using_synthetic_position);
+
+	c(_time_last_pos_fuse);
+	c(_time_last_delpos_fuse);
+	c(_time_last_vel_fuse);
+	c(_time_last_hgt_fuse);
+	c(_time_last_of_fuse);
+	c(_time_last_arsp_fuse);
+	c(_time_last_beta_fuse);
+	c(_time_last_rng_ready);
+	c(_last_known_posNE);
+	c(_imu_collection_time_adj);
+	c(_time_acc_bias_check);
+	c(_delta_time_baro_us);
+	c(_last_imu_bias_cov_reset_us);
+
+	c(_earth_rate_NED);
+	c(_R_to_earth);
+
+	// magnetometer fusion mode selection
+	c(_accel_lpf_NE);
+	c(_yaw_delta_ef);
+	c(_yaw_rate_lpf_ef);
+	c(_mag_bias_observable);
+	c(_yaw_angle_observable);
+	c(_time_yaw_started);
+	c(_num_bad_flight_yaw_events);
+	c(_mag_use_not_inhibit_us);
+	c(_mag_use_inhibit);
+	c(_mag_use_inhibit_prev);
+	c(_mag_inhibit_yaw_reset_req);
+	c(_last_static_yaw);
+	c(_vehicle_at_rest_prev);
+
+	c(P);
+
+	// innovations and innovation variances
+	c(_vel_pos_innov);
+	c(_vel_pos_innov_var);
+	c(_aux_vel_innov);
+	c(_mag_innov);
+	c(_mag_innov_var);
+	c(_airspeed_innov);
+	c(_airspeed_innov_var);
+	c(_beta_innov);
+	c(_beta_innov_var);
+	c(_drag_innov);
+	c(_drag_innov_var);
+	c(_heading_innov);
+	c(_heading_innov_var);
+
+	// optical flow processing
+	c(_flow_innov);
+	c(_flow_innov_var);
+	c(_flow_gyro_bias);
+	c(_imu_del_ang_of);
+	c(_delta_time_of);
+	c(_time_bad_motion_us);
+	c(_time_good_motion_us);
+	c(_inhibit_flow_use);
+	c(_flowRadXYcomp);
+
+	c(_mag_declination);
+
+	// output predictor states
+	c(_delta_angle_corr);
+	c(_imu_down_sampled);
+	c(_q_down_sampled);
+	c(_vel_err_integ);
+	c(_pos_err_integ);
+	c(_output_vel_correction);
+	c(_output_pos_correction);
+	c(_output_tracking_error);
+
+	// GPS quality checks - the stage object is trivially copyable so its
+	// internal drift filter states are stored whole
+	c(_gps_quality);
+	c(_last_gps_fail_us);
+	c(_last_gps_pass_us);
+	c(_gps_error_norm);
+	c(_gps_check_fail_status);
+
+	c(_last_gps_origin_time_us);
+	c(_gps_alt_ref);
+
+	// filter state initialisation
+	c(_hgt_counter);
+	c(_rng_filt_state);
+	c(_mag_counter);
+	c(_ev_counter);
+	c(_time_last_mag);
+	c(_mag_filt_state);
+	c(_delVel_sum);
+	c(_fast_align);
+	c(_hgt_sensor_offset);
+	c(_baro_hgt_offset);
+
+	// post takeoff functionality
+	c(_last_on_ground_posD);
+	c(_flt_mag_align_complete);
+	c(_flt_mag_align_converging);
+	c(_flt_mag_align_start_time);
+	c(_time_last_movement);
+	c(_saved_mag_variance);
+	c(_velpos_reset_request);
+
+	// accel bias learning inhibit
+	c(_accel_bias_inhibit);
+	c(_accel_vec_filt);
+	c(_accel_mag_filt);
+	c(_ang_rate_mag_filt);
+	c(_prev_dvel_bias_var);
+
+	// terrain height estimation
+	c(_terrain_vpos);
+	c(_terrain_var);
+	c(_terrain_profile_vpos);
+	c(_terrain_profile_len);
+	c(_hagl_innov);
+	c(_hagl_innov_var);
+	c(_time_last_hagl_fuse);
+	c(_terrain_initialised);
+	c(_sin_tilt_rng);
+	c(_cos_tilt_rng);
+	c(_R_rng_to_earth_2_2);
+	c(_range_data_continuous);
+	c(_dt_last_range_update_filt_us);
+	c(_hagl_valid);
+
+	// height sensor fault status
+	c(_baro_hgt_faulty);
+	c(_gps_hgt_faulty);
+	c(_rng_hgt_faulty);
+	c(_primary_hgt_source);
+
+	// imu fault status
+	c(_time_bad_vert_accel);
+	c(_time_good_vert_accel);
+	c(_bad_vert_accel_detected);
+
+	// range aid
+	c(_range_aid_mode_enabled);
+	c(_range_aid_mode_selected);
+	c(_rng_stuck_min_val);
+	c(_rng_stuck_max_val);
+
+	// the _quat_prod, _wind_rel_kin and _derived_outputs caches are
+	// deliberately not stored - they validate against the state they were
+	// computed from and refresh themselves on the first use after a restore
+}
+
+size_t Ekf::checkpoint_size()
+{
+	checkpointCursor cursor;
+	cursor.mode = checkpointCursor::SIZE;
+
+	checkpointFields(cursor);
+
+	return sizeof(checkpointHeader) + cursor.offset;
+}
+
+bool Ekf::save_checkpoint(uint8_t *buffer, size_t buffer_size)
+{
+	if (buffer == nullptr || buffer_size < sizeof(checkpointHeader)) {
+		return false;
+	}
+
+	checkpointCursor cursor;
+	cursor.mode = checkpointCursor::SAVE;
+	cursor.dst = buffer + sizeof(checkpointHeader);
+	cursor.capacity = buffer_size - sizeof(checkpointHeader);
+
+	checkpointFields(cursor);
+
+	if (!cursor.ok) {
+		return false;
+	}
+
+	checkpointHeader header;
+	header.magic = CHECKPOINT_MAGIC;
+	header.version = CHECKPOINT_VERSION;
+	header.length = (uint32_t)(sizeof(checkpointHeader) + cursor.offset);
+	memcpy(buffer, &header, sizeof(header));
+
+	return true;
+}
+
+bool Ekf::restore_checkpoint(const uint8_t *buffer, size_t buffer_size)
+{
+	if (buffer == nullptr || buffer_size < sizeof(checkpointHeader)) {
+		return false;
+	}
+
+	// the data buffers must exist before their contents can be restored
+	if (!_initialised) {
+		ECL_ERR("EKF restore rejected - call init() first");
+		return false;
+	}
+
+	checkpointHeader header;
+	memcpy(&header, buffer, sizeof(header));
+
+	if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION
+	    || header.length > buffer_size) {
+		ECL_ERR("EKF restore rejected - not a compatible checkpoint");
+		return false;
+	}
+
+	checkpointCursor cursor;
+	cursor.mode = checkpointCursor::RESTORE;
+	cursor.src = buffer + sizeof(checkpointHeader);
+	cursor.capacity = header.length - sizeof(checkpointHeader);
+
+	checkpointFields(cursor);
+
+	if (!cursor.ok || cursor.offset != cursor.capacity) {
+		// the image was produced by an instance with a different state or
+		// buffer configuration - the partial restore cannot be used
+		_filter_initialised = false;
+		ECL_ERR("EKF restore failed - filter must be re-initialised");
+		return false;
+	}
+
+	// the restored states replace the current ones, invalidate the cached derived outputs
+	_update_generation++;
+
+	return true;
+}
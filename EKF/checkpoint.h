@@ -0,0 +1,151 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file checkpoint.h
+ * Warm start checkpointing of the complete filter state.
+ *
+ * A checkpoint is a packed copy of everything the filter needs to resume
+ * exactly where it left off: the state vector, the covariance matrix, the
+ * control and fault status, the delayed time horizon samples, the output
+ * predictor and the contents of all data buffers. A supervisor can call
+ * Ekf::save_checkpoint() periodically and hand the image to a replacement
+ * instance via Ekf::restore_checkpoint(), which resumes producing converged
+ * output on the next update instead of re-running the full alignment, and a
+ * replay run can be resumed from mid-log without reprocessing from the start.
+ *
+ * Like the replay stream format, a checkpoint stores the native in-memory
+ * layout of the filter structures, so it must be restored on the same
+ * architecture and library version that saved it, into an instance
+ * initialised with the same parameters. The tuning parameters themselves are
+ * deliberately not part of the image - they belong to the owner of the
+ * instance.
+ *
+ * One field walk routine is shared by the size query, the save and the
+ * restore, so the serialized field list cannot get out of sync between the
+ * directions.
+ */
+
+#pragma once
+
+#include "RingBuffer.h"
+
+#include <cstring>
+
+// precedes the packed field data in a checkpoint image
+struct checkpointHeader {
+	uint32_t magic;			///< CHECKPOINT_MAGIC
+	uint32_t version;		///< CHECKPOINT_VERSION of the writer
+	uint32_t length;		///< total image size including this header (bytes)
+};
+
+// cursor passed down the field walk, the mode selects whether the walk
+// measures, writes or reads the image
+struct checkpointCursor {
+	enum Mode : uint8_t {
+		SIZE = 0,	///< accumulate the image size, no data access
+		SAVE,		///< copy the fields into the image
+		RESTORE		///< copy the image into the fields
+	};
+
+	Mode mode{SIZE};
+	uint8_t *dst{nullptr};		///< save destination
+	const uint8_t *src{nullptr};	///< restore source
+	size_t capacity{0};		///< bytes available at dst / src
+	size_t offset{0};		///< bytes consumed so far
+	bool ok{true};			///< false after any overrun or mismatch
+
+	void bytes(void *field, size_t n)
+	{
+		if (!ok) {
+			return;
+		}
+
+		if (mode != SIZE) {
+			if (offset + n > capacity) {
+				ok = false;
+				return;
+			}
+
+			if (mode == SAVE) {
+				memcpy(dst + offset, field, n);
+
+			} else {
+				memcpy(field, src + offset, n);
+			}
+		}
+
+		offset += n;
+	}
+
+	// a trivially copyable field stored by value
+	template <typename T>
+	void operator()(T &field)
+	{
+		bytes(&field, sizeof(T));
+	}
+
+	// a data buffer stored as its sample count followed by the samples in
+	// time order - on restore the count must fit the live buffer allocation
+	template <typename T, uint8_t C>
+	void operator()(RingBuffer<T, C> &buffer)
+	{
+		uint8_t count = buffer.entries();
+		bytes(&count, sizeof(count));
+
+		if (!ok) {
+			return;
+		}
+
+		if (mode == RESTORE) {
+			if (count > buffer.get_length()) {
+				ok = false;
+				return;
+			}
+
+			buffer.clear();
+
+			for (uint8_t index = 0; index < count; index++) {
+				T sample{};
+				bytes(&sample, sizeof(T));
+				buffer.push(sample);
+			}
+
+		} else {
+			for (uint8_t index = 0; index < count; index++) {
+				T sample = buffer.peek_ordered(index);
+				bytes(&sample, sizeof(T));
+			}
+		}
+	}
+};
@@ -40,8 +40,34 @@
  *
  */
 
+#pragma once
+
 #include <matrix/math.hpp>
 
+// The autogenerated covariance prediction and fusion equations address states by fixed
+// index, so optional states can only be removed from the end of the state vector at
+// compile time.
+// EKF_NO_WIND_STATES removes the wind velocity states (22,23), giving a 22 state filter.
+// EKF_NO_MAG_STATES additionally removes the earth and body frame magnetic field states
+// (16-21), giving a 16 state filter, and implies EKF_NO_WIND_STATES.
+#if defined(EKF_NO_MAG_STATES) && !defined(EKF_NO_WIND_STATES)
+#define EKF_NO_WIND_STATES
+#endif
+
+// The optical flow fusion scales the LOS rates by the height above terrain, so it
+// cannot operate without the terrain estimator.
+#if defined(EKF_NO_TERRAIN_ESTIMATOR) && !defined(EKF_NO_OPTFLOW_FUSION)
+#define EKF_NO_OPTFLOW_FUSION
+#endif
+
+#if defined(EKF_NO_MAG_STATES)
+#define EKF_NUM_STATES 16
+#elif defined(EKF_NO_WIND_STATES)
+#define EKF_NUM_STATES 22
+#else
+#define EKF_NUM_STATES 24
+#endif
+
 namespace estimator
 {
 
@@ -98,6 +124,25 @@ struct outputVert {
 	uint64_t    time_us;		///< timestamp of the measurement (uSec)
 };
 
+#ifdef EKF_INSTRUMENTATION
+// sections of the filter update that are individually timed when instrumentation is compiled in
+enum perfSection : uint8_t {
+	PERF_STATE_PREDICTION = 0,	///< predictState()
+	PERF_COVARIANCE_PREDICTION,	///< predictCovariance()
+	PERF_FUSION_CONTROL,		///< controlFusionModes() including the measurement fusions it performs
+	PERF_TERRAIN_ESTIMATOR,		///< runTerrainEstimator()
+	PERF_OUTPUT_PREDICTOR,		///< calculateOutputStates()
+	PERF_SECTION_COUNT
+};
+
+struct perfCounter {
+	uint64_t    count;		///< number of completed executions of the section
+	uint64_t    total_us;		///< accumulated execution time, mean is total_us / count (uSec)
+	uint32_t    min_us;		///< shortest recorded execution time (uSec)
+	uint32_t    max_us;		///< longest recorded execution time (uSec)
+};
+#endif
+
 struct imuSample {
 	Vector3f    delta_ang;		///< delta angle in body frame (integrated gyro measurements) (rad)
 	Vector3f    delta_vel;		///< delta velocity in body frame (integrated accelerometer measurements) (m/sec)
@@ -126,9 +171,14 @@ struct baroSample {
 	uint64_t    time_us{0};	///< timestamp of the measurement (uSec)
 };
 
+// maximum number of simultaneous ranging zones a multi-zone sensor can report
+static constexpr uint8_t RNG_MAX_ZONES = 8;
+
 struct rangeSample {
 	float       rng;	///< range (distance to ground) measurement (m)
 	uint64_t    time_us;	///< timestamp of the measurement (uSec)
+	float       rng_zone[RNG_MAX_ZONES];	///< per zone range measurements of a multi-zone sensor (m)
+	uint8_t     num_zones;	///< number of valid entries in rng_zone (0 for a single zone sensor)
 };
 
 struct airspeedSample {
@@ -139,9 +189,11 @@ struct airspeedSample {
 
 struct flowSample {
 	uint8_t  quality;	///< quality indicator between 0 and 255
+	bool     gyro_valid;	///< true when gyroXYZ contained finite sensor gyro data when the sample was ingested
 	Vector2f flowRadXY;	///< measured delta angle of the image about the X and Y body axes (rad), RH rotaton is positive
 	Vector3f gyroXYZ;	///< measured delta angle of the inertial frame about the body axes obtained from rate gyro measurements (rad), RH rotation is positive
 	float    dt;		///< amount of integration time (sec)
+	float    losVar;	///< LOS rate observation variance derived from the quality metric on ingestion ((rad/sec)**2)
 	uint64_t time_us;	///< timestamp of the integration period leading edge (uSec)
 };
 
@@ -164,6 +216,70 @@ struct auxVelSample {
 	uint64_t time_us;	///< timestamp of the measurement (uSec)
 };
 
+// Blend two time ordered samples at the specified time, used by
+// RingBuffer::pop_interpolated() to align retrieved observations with the fusion
+// time horizon so the same alignment accuracy can be achieved with a shorter buffer.
+// Measured quantities are interpolated linearly and accuracy estimates take the
+// worse of the two samples.
+
+inline float interpolateWeight(uint64_t older_us, uint64_t newer_us, uint64_t time_us)
+{
+	return (float)(time_us - older_us) / (float)(newer_us - older_us);
+}
+
+inline baroSample interpolateSample(const baroSample &older, const baroSample &newer, uint64_t time_us)
+{
+	const float weight = interpolateWeight(older.time_us, newer.time_us, time_us);
+
+	baroSample sample;
+	sample.hgt = older.hgt + weight * (newer.hgt - older.hgt);
+	sample.time_us = time_us;
+
+	return sample;
+}
+
+inline gpsSample interpolateSample(const gpsSample &older, const gpsSample &newer, uint64_t time_us)
+{
+	const float weight = interpolateWeight(older.time_us, newer.time_us, time_us);
+
+	gpsSample sample;
+	sample.pos = older.pos * (1.0f - weight) + newer.pos * weight;
+	sample.hgt = older.hgt + weight * (newer.hgt - older.hgt);
+	sample.vel = older.vel * (1.0f - weight) + newer.vel * weight;
+	sample.hacc = fmaxf(older.hacc, newer.hacc);
+	sample.vacc = fmaxf(older.vacc, newer.vacc);
+	sample.sacc = fmaxf(older.sacc, newer.sacc);
+	sample.time_us = time_us;
+
+	return sample;
+}
+
+inline extVisionSample interpolateSample(const extVisionSample &older, const extVisionSample &newer, uint64_t time_us)
+{
+	const float weight = interpolateWeight(older.time_us, newer.time_us, time_us);
+
+	extVisionSample sample;
+	sample.posNED = older.posNED * (1.0f - weight) + newer.posNED * weight;
+
+	// normalised linear blend of the quaternions, negating one if required so that
+	// the blend takes the shorter arc
+	Quatf q_newer = newer.quat;
+
+	if (older.quat(0) * q_newer(0) + older.quat(1) * q_newer(1)
+	    + older.quat(2) * q_newer(2) + older.quat(3) * q_newer(3) < 0.0f) {
+		q_newer = q_newer * -1.0f;
+	}
+
+	sample.quat = older.quat * (1.0f - weight) + q_newer * weight;
+	sample.quat.normalize();
+
+	sample.posErr = fmaxf(older.posErr, newer.posErr);
+	sample.angErr = fmaxf(older.angErr, newer.angErr);
+	sample.time_us = time_us;
+
+	return sample;
+}
+
 // Integer definitions for vdist_sensor_type
 #define VDIST_SENSOR_BARO  0	///< Use baro height
 #define VDIST_SENSOR_GPS   1	///< Use GPS height
@@ -183,6 +299,7 @@ struct auxVelSample {
 #define MASK_USE_EVYAW  (1<<4)		///< set to true to use exernal vision quaternion data for yaw
 #define MASK_USE_DRAG  (1<<5)		///< set to true to use the multi-rotor drag model to estimate wind
 #define MASK_ROTATE_EV  (1<<6)		///< set to true to if the EV observations are in a non NED reference frame and need to be rotated before being used
+#define MASK_USE_AUXVEL_DIRECT (1<<7)	///< set to true to fuse auxiliary velocity data directly into the output predictor states at the current time horizon instead of the delayed time horizon
 
 // Integer definitions for mag_fusion_type
 #define MAG_FUSE_TYPE_AUTO      0	///< The selection of either heading or 3D magnetometer fusion will be automatic
@@ -209,6 +326,7 @@ struct parameters {
 	int32_t fusion_mode{MASK_USE_GPS};		///< bitmasked integer that selects which aiding sources will be used
 	int32_t vdist_sensor_type{VDIST_SENSOR_BARO};	///< selects the primary source for height data
 	int32_t sensor_interval_min_ms{20};		///< minimum time of arrival difference between non IMU sensor updates. Sets the size of the observation buffers. (mSec)
+	int32_t fast_align{0};				///< set to 1 to align attitude from a short batch average of the first IMU, magnetometer and baro samples instead of waiting for the observation buffers to flush
 
 	// measurement time delays
 	float min_delay_ms{0.0f};		///< Maximmum time delay of any sensor used to increse buffer length to handle large timing jitter (mSec)
@@ -400,6 +518,23 @@ union innovation_fault_status_u {
 
 };
 
+// structure-of-arrays bank of innovation consistency test ratios. All monitored
+// quantities share one contiguous lane array so the status reporting can reduce
+// the bank in a single pass, and new monitored quantities have one place to go.
+// The named view gives the fusion code readable access to its own lanes
+union innovation_test_ratios_u {
+	struct {
+		float yaw;		///< yaw innovation consistency check ratio
+		float mag[3];		///< magnetometer XYZ innovation consistency check ratios
+		float vel_pos[6];	///< velocity and position innovation consistency check ratios
+		float tas;		///< true airspeed innovation consistency check ratio
+		float terr;		///< height above terrain innovation consistency check ratio
+		float beta;		///< synthetic sideslip innovation consistency check ratio
+		float drag[2];		///< drag specific force XY innovation consistency check ratios
+	} ratio;
+	float bank[15];		///< all ratios as contiguous lanes, ordered as the named view
+};
+
 // publish the status of various GPS quality checks
 union gps_check_fail_status_u {
 	struct {
@@ -464,4 +599,60 @@ union ekf_solution_status {
 	uint16_t value;
 };
 
+// packed summary of the filter outputs for publication to telemetry and logging
+// consumers, filled in a single pass by Ekf::get_snapshot()
+struct ekfSnapshot {
+	uint64_t time_us;		///< timestamp of the most recent IMU data used by the output predictor (uSec)
+	float quat_nominal[4];		///< quaternion defining the rotation from body to earth frame at the current time horizon
+	float velocity[3];		///< velocity of the body frame origin in NED earth frame (m/sec)
+	float position[3];		///< position of the body frame origin in NED earth frame (m)
+	float gyro_bias[3];		///< gyroscope bias estimate (rad/sec)
+	float accel_bias[3];		///< accelerometer bias estimate (m/sec**2)
+	float state_delayed[24];	///< state vector at the delayed time horizon
+	float covariances[24];		///< diagonal of the state covariance matrix
+	float vel_pos_innov[6];		///< velocity and position innovations, 0-2 vel 3-5 pos (m/sec, m)
+	float vel_pos_innov_var[6];	///< velocity and position innovation variances
+	float mag_innov[3];		///< earth magnetic field innovations (Gauss)
+	float mag_innov_var[3];		///< earth magnetic field innovation variances (Gauss**2)
+	float heading_innov;		///< heading innovation (rad)
+	float heading_innov_var;	///< heading innovation variance (rad**2)
+	float airspeed_innov;		///< airspeed innovation (m/sec)
+	float airspeed_innov_var;	///< airspeed innovation variance ((m/sec)**2)
+	float beta_innov;		///< synthetic sideslip innovation (rad)
+	float beta_innov_var;		///< synthetic sideslip innovation variance (rad**2)
+	float hagl_innov;		///< height above ground innovation (m)
+	float hagl_innov_var;		///< height above ground innovation variance (m**2)
+	float flow_innov[2];		///< optical flow LOS rate innovations (rad/sec)
+	float flow_innov_var[2];	///< optical flow LOS rate innovation variances ((rad/sec)**2)
+	float output_tracking_error[3];	///< output predictor angle, velocity and position tracking error magnitudes (rad, m/sec, m)
+	uint32_t control_mode;		///< filter_control_status_u bitmask value
+	uint16_t filter_fault_flags;	///< fault_status_u bitmask value
+	uint16_t innov_check_flags;	///< innovation_fault_status_u bitmask value
+	uint16_t solution_status;	///< ekf_solution_status bitmask value
+	uint16_t gps_check_fail_flags;	///< gps_check_fail_status_u bitmask value
+};
+
+// compact quantized covariance record for telemetry and logging - an order of
+// magnitude less logging bandwidth than exporting the variances as floats.
+// Variances are stored on a log10 scale, q = (log10(var) + 12) * 4096, covering
+// 1e-12 to 1e4 with 0.06 percent relative resolution; q = 0 marks a variance
+// that is not positive. Correlation coefficients are stored as int16 with
+// 1.0 = 32767. The exported off diagonal entries are selected with
+// Ekf::set_covariance_record_pairs().
+struct ekfCovarianceRecord {
+	static constexpr uint8_t MAX_CORRELATION_PAIRS = 12;
+
+	uint64_t time_us;				///< timestamp of the covariance data (uSec)
+	uint16_t variances[24];				///< quantized diagonal of the state covariance matrix
+	int16_t correlations[MAX_CORRELATION_PAIRS];	///< quantized correlation coefficients of the selected state pairs
+	uint8_t pairs[MAX_CORRELATION_PAIRS][2];	///< state index pairs the correlation entries refer to
+	uint8_t num_correlations;			///< number of valid correlation entries
+};
+
+// reconstruct a variance from its quantized record representation
+static inline float ekf_cov_record_variance(uint16_t q)
+{
+	return (q == 0) ? 0.0f : powf(10.0f, (float)q / 4096.0f - 12.0f);
+}
+
 }
@@ -43,11 +43,48 @@
 #include "ekf.h"
 #include <mathlib/mathlib.h>
 
+void Ekf::updateDerivedParams()
+{
+	if (_derived_params.valid && memcmp(&_derived_params.snapshot, &_params, sizeof(parameters)) == 0) {
+		return;
+	}
+
+	memcpy(&_derived_params.snapshot, &_params, sizeof(parameters));
+
+	_derived_params.vel_innov_gate = fmaxf(_params.vel_innov_gate, 1.0f);
+	_derived_params.posNE_innov_gate = fmaxf(_params.posNE_innov_gate, 1.0f);
+	_derived_params.ev_innov_gate = fmaxf(_params.ev_innov_gate, 1.0f);
+	_derived_params.baro_noise_sq = sq(_params.baro_noise);
+	_derived_params.baro_innov_gate_sq = sq(_params.baro_innov_gate);
+	_derived_params.range_aid_innov_gate_sq = sq(_params.range_aid_innov_gate);
+	_derived_params.vert_innov_test_lim_quad = sq(_params.vert_innov_test_lim) * sq(_params.vert_innov_test_lim);
+	_derived_params.pos_noaid_noise_floor = fmaxf(_params.pos_noaid_noise, _params.gps_pos_noise);
+
+	_derived_params.gps_vel_noise_floor = fmaxf(_params.gps_vel_noise, 0.01f);
+	_derived_params.gps_pos_noise_floor = fmaxf(_params.gps_pos_noise, 0.01f);
+	_derived_params.pos_noaid_noise_upper = fmaxf(_params.pos_noaid_noise, _derived_params.gps_pos_noise_floor);
+	_derived_params.baro_obs_var = sq(fmaxf(_params.baro_noise, 0.01f));
+	_derived_params.baro_innov_gate_fl = fmaxf(_params.baro_innov_gate, 1.0f);
+	_derived_params.range_noise_sq = sq(_params.range_noise);
+	_derived_params.range_innov_gate_fl = fmaxf(_params.range_innov_gate, 1.0f);
+	_derived_params.mag_obs_var = sq(fmaxf(_params.mag_noise, 0.0f));
+	_derived_params.mag_innov_gate_sq = sq(math::max(_params.mag_innov_gate, 1.0f));
+	_derived_params.mag_heading_obs_var = sq(fmaxf(_params.mag_heading_noise, 1.0e-2f));
+	_derived_params.heading_innov_gate_fl = math::max(_params.heading_innov_gate, 1.0f);
+	_derived_params.eas_noise_limited = math::constrain(_params.eas_noise, 0.5f, 5.0f);
+	_derived_params.tas_innov_gate_sq = sq(fmaxf(_params.tas_innov_gate, 1.0f));
+
+	_derived_params.valid = true;
+}
+
 void Ekf::controlFusionModes()
 {
 	// Store the status to enable change detection
 	_control_status_prev.value = _control_status.value;
 
+	// re-derive the parameter dependent configuration if the host changed a parameter
+	updateDerivedParams();
+
 	// Get the magnetic declination
 	calcMagDeclination();
 
@@ -91,11 +128,12 @@ void Ekf::controlFusionModes()
 	_gps_hgt_faulty = !((_time_last_imu - gps_init.time_us) < 2 * GPS_MAX_INTERVAL);
 
 	// check for arrival of new sensor data at the fusion time horizon
-	_gps_data_ready = _gps_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_gps_sample_delayed);
+	// gps, baro and external vision samples are interpolated onto the horizon
+	_gps_data_ready = _gps_buffer.pop_interpolated(_imu_sample_delayed.time_us, &_gps_sample_delayed);
 	_mag_data_ready = _mag_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_mag_sample_delayed);
 
 	_delta_time_baro_us = _baro_sample_delayed.time_us;
-	_baro_data_ready = _baro_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_baro_sample_delayed);
+	_baro_data_ready = _baro_buffer.pop_interpolated(_imu_sample_delayed.time_us, &_baro_sample_delayed);
 
 	// if we have a new baro sample save the delta time between this sample and the last sample which is
 	// used below for baro offset calculations
@@ -126,7 +164,7 @@ void Ekf::controlFusionModes()
 				   && (_R_to_earth(2, 2) > _params.range_cos_max_tilt);
 	}
 
-	_ev_data_ready = _ext_vision_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_ev_sample_delayed);
+	_ev_data_ready = _ext_vision_buffer.pop_interpolated(_imu_sample_delayed.time_us, &_ev_sample_delayed);
 	_tas_data_ready = _airspeed_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_airspeed_sample_delayed);
 
 	// check for height sensor timeouts and reset and change sensor if necessary
@@ -134,11 +172,19 @@ void Ekf::controlFusionModes()
 
 	// control use of observations for aiding
 	controlMagFusion();
+#ifndef EKF_NO_OPTFLOW_FUSION
 	controlOpticalFlowFusion();
+#endif // EKF_NO_OPTFLOW_FUSION
 	controlGpsFusion();
+#ifndef EKF_NO_AIRSPEED_FUSION
 	controlAirDataFusion();
+#endif // EKF_NO_AIRSPEED_FUSION
+#ifndef EKF_NO_SIDESLIP_FUSION
 	controlBetaFusion();
+#endif // EKF_NO_SIDESLIP_FUSION
+#ifndef EKF_NO_DRAG_FUSION
 	controlDragFusion();
+#endif // EKF_NO_DRAG_FUSION
 	controlHeightFusion();
 
 	// For efficiency, fusion of direct state observations for position and velocity is performed sequentially
@@ -324,7 +370,7 @@ void Ekf::controlExternalVisionFusion()
 			_posObsNoiseNE = fmaxf(_ev_sample_delayed.posErr, 0.01f);
 
 			// innovation gate size
-			_posInnovGateNE = fmaxf(_params.ev_innov_gate, 1.0f);
+			_posInnovGateNE = _derived_params.ev_innov_gate;
 		}
 
 		// Fuse available NED position data into the main filter
@@ -352,6 +398,7 @@ void Ekf::controlExternalVisionFusion()
 	}
 }
 
+#ifndef EKF_NO_OPTFLOW_FUSION
 void Ekf::controlOpticalFlowFusion()
 {
 	// Check if on ground motion is un-suitable for use of optical flow
@@ -505,6 +552,7 @@ void Ekf::controlOpticalFlowFusion()
 		_flow_data_ready = false;
 	}
 }
+#endif // EKF_NO_OPTFLOW_FUSION
 
 void Ekf::controlGpsFusion()
 {
@@ -643,8 +691,8 @@ void Ekf::controlGpsFusion()
 			_vel_pos_innov[4] = _state.pos(1) - _gps_sample_delayed.pos(1);
 
 			// set innovation gate size
-			_posInnovGateNE = fmaxf(_params.posNE_innov_gate, 1.0f);
-			_hvelInnovGate = fmaxf(_params.vel_innov_gate, 1.0f);
+			_posInnovGateNE = _derived_params.posNE_innov_gate;
+			_hvelInnovGate = _derived_params.vel_innov_gate;
 		}
 
 	} else if (_control_status.flags.gps && (_imu_sample_delayed.time_us - _gps_sample_delayed.time_us > (uint64_t)10e6)) {
@@ -664,7 +712,7 @@ void Ekf::controlHeightSensorTimeouts()
 
 	// Check for IMU accelerometer vibration induced clipping as evidenced by the vertical innovations being positive and not stale.
 	// Clipping causes the average accel reading to move towards zero which makes the INS think it is falling and produces positive vertical innovations
-	float var_product_lim = sq(_params.vert_innov_test_lim) * sq(_params.vert_innov_test_lim);
+	float var_product_lim = _derived_params.vert_innov_test_lim_quad;
 	bool bad_vert_accel = (_control_status.flags.baro_hgt && // we can only run this check if vertical position and velocity observations are indepedant
 			(sq(_vel_pos_innov[5] * _vel_pos_innov[2]) > var_product_lim * (_vel_pos_innov_var[5] * _vel_pos_innov_var[2])) && // vertical position and velocity sensors are in agreement that we have a significant error
 			(_vel_pos_innov[2] > 0.0f) && // positive innovation indicates that the inertial nav thinks it is falling
@@ -765,7 +813,7 @@ void Ekf::controlHeightSensorTimeouts()
 			const baroSample &baro_init = _baro_buffer.get_newest();
 			bool baro_data_fresh = ((_time_last_imu - baro_init.time_us) < 2 * BARO_MAX_INTERVAL);
 			float baro_innov = _state.pos(2) - (_hgt_sensor_offset - baro_init.hgt + _baro_hgt_offset);
-			bool baro_data_consistent = fabsf(baro_innov) < (sq(_params.baro_noise) + P[9][9]) * sq(_params.baro_innov_gate);
+			bool baro_data_consistent = fabsf(baro_innov) < (_derived_params.baro_noise_sq + P[9][9]) * _derived_params.baro_innov_gate_sq;
 
 			// if baro data is acceptable and GPS data is inaccurate, reset height to baro
 			bool reset_to_baro = baro_data_consistent && baro_data_fresh && !_baro_hgt_faulty && !gps_hgt_accurate;
@@ -1121,12 +1169,12 @@ void Ekf::rangeAidConditionsMet()
 
 		// use hysteresis to check for hagl
 		if (_range_aid_mode_enabled) {
-			can_use_range_finder &= ((_hagl_innov * _hagl_innov / (sq(_params.range_aid_innov_gate) * _hagl_innov_var)) < 1.0f);
+			can_use_range_finder &= ((_hagl_innov * _hagl_innov / (_derived_params.range_aid_innov_gate_sq * _hagl_innov_var)) < 1.0f);
 
 		} else {
 			// if we were not using range aid in the previous iteration then use a much lower (1/100) threshold to avoid
 			// switching to range finder too soon (wait for terrain to update).
-			can_use_range_finder &= ((_hagl_innov * _hagl_innov / (sq(_params.range_aid_innov_gate) * _hagl_innov_var)) < 0.01f);
+			can_use_range_finder &= ((_hagl_innov * _hagl_innov / (_derived_params.range_aid_innov_gate_sq * _hagl_innov_var)) < 0.01f);
 		}
 
 		_range_aid_mode_enabled = can_use_range_finder;
@@ -1208,6 +1256,7 @@ void Ekf::checkRangeDataValidity()
 	}
 }
 
+#ifndef EKF_NO_AIRSPEED_FUSION
 void Ekf::controlAirDataFusion()
 {
 	// control activation and initialisation/reset of wind states required for airspeed fusion
@@ -1233,6 +1282,7 @@ void Ekf::controlAirDataFusion()
 			_control_status.flags.fuse_aspd = true;
 		}
 
+#ifndef EKF_NO_WIND_STATES
 		// If starting wind state estimation, reset the wind states and covariances before fusing any data
 		if (!_control_status.flags.wind) {
 			// activate the wind states
@@ -1245,12 +1295,15 @@ void Ekf::controlAirDataFusion()
 			resetWindCovariance();
 
 		}
+#endif // EKF_NO_WIND_STATES
 
 		fuseAirspeed();
 
 	}
 }
+#endif // EKF_NO_AIRSPEED_FUSION
 
+#ifndef EKF_NO_SIDESLIP_FUSION
 void Ekf::controlBetaFusion()
 {
 	// control activation and initialisation/reset of wind states required for synthetic sideslip fusion fusion
@@ -1269,6 +1322,7 @@ void Ekf::controlBetaFusion()
 	bool beta_fusion_time_triggered = _time_last_imu - _time_last_beta_fuse > _params.beta_avg_ft_us;
 
 	if (beta_fusion_time_triggered && _control_status.flags.fuse_beta && _control_status.flags.in_air) {
+#ifndef EKF_NO_WIND_STATES
 		// If starting wind state estimation, reset the wind states and covariances before fusing any data
 		if (!_control_status.flags.wind) {
 			// activate the wind states
@@ -1280,23 +1334,29 @@ void Ekf::controlBetaFusion()
 			resetWindStates();
 			resetWindCovariance();
 		}
+#endif // EKF_NO_WIND_STATES
 
 		fuseSideslip();
 	}
 }
+#endif // EKF_NO_SIDESLIP_FUSION
 
+#ifndef EKF_NO_DRAG_FUSION
 void Ekf::controlDragFusion()
 {
 	if (_params.fusion_mode & MASK_USE_DRAG) {
 		if (_control_status.flags.in_air
 				&& !_mag_inhibit_yaw_reset_req) {
+#ifndef EKF_NO_WIND_STATES
 			if (!_control_status.flags.wind) {
 				// reset the wind states and covariances when starting drag accel fusion
 				_control_status.flags.wind = true;
 				resetWindStates();
 				resetWindCovariance();
 
-			} else if (_drag_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_drag_sample_delayed)) {
+			} else
+#endif // EKF_NO_WIND_STATES
+			if (_drag_buffer.pop_first_older_than(_imu_sample_delayed.time_us, &_drag_sample_delayed)) {
 				fuseDrag();
 
 			}
@@ -1307,6 +1367,7 @@ void Ekf::controlDragFusion()
 		}
 	}
 }
+#endif // EKF_NO_DRAG_FUSION
 
 void Ekf::controlMagFusion()
 {
@@ -1411,7 +1472,12 @@ void Ekf::controlMagFusion()
 				}
 
 				// only use one type of mag fusion at the same time
+#ifdef EKF_NO_MAG_STATES
+				// 3-axis fusion requires the magnetic field states which are not part of this build
+				_control_status.flags.mag_3D = false;
+#else
 				_control_status.flags.mag_3D = _flt_mag_align_complete;
+#endif
 				_control_status.flags.mag_hdg = !_control_status.flags.mag_3D;
 
 			} else {
@@ -1463,9 +1529,15 @@ void Ekf::controlMagFusion()
 				_control_status.flags.yaw_align = resetMagHeading(_mag_sample_delayed.mag) || _control_status.flags.yaw_align;
 			}
 
+#ifdef EKF_NO_MAG_STATES
+			// 3-axis fusion requires the magnetic field states which are not part of this build
+			_control_status.flags.mag_hdg = true;
+			_control_status.flags.mag_3D = false;
+#else
 			// always use 3-axis mag fusion
 			_control_status.flags.mag_hdg = false;
 			_control_status.flags.mag_3D = true;
+#endif
 
 		} else {
 			// do no magnetometer fusion at all
@@ -1555,7 +1627,7 @@ void Ekf::controlVelPosFusion()
 			_time_last_fake_gps = _time_last_imu;
 
 			if (_control_status.flags.in_air && _control_status.flags.tilt_align) {
-				_posObsNoiseNE = fmaxf(_params.pos_noaid_noise, _params.gps_pos_noise);
+				_posObsNoiseNE = _derived_params.pos_noaid_noise_floor;
 
 			} else {
 				_posObsNoiseNE = 0.5f;
@@ -126,7 +126,60 @@ void Ekf::get_vel_var(Vector3f &vel_var)
 	vel_var(2) = P[6][6];
 }
 
-void Ekf::predictCovariance()
+#ifdef EKF_VECTORIZED_PREDICTION
+// Predict the covariance for a contiguous block of columns from column 13 (delta velocity
+// bias) onwards. The auto generated expressions for all of these columns share the same
+// row coefficients, so each row can be evaluated with a loop that steps through contiguous
+// storage. The arithmetic is identical to the scalar reference retained below, but the
+// per-row loops are reliably auto-vectorised by the compiler.
+static void predictCovarianceColumns(const float (&P)[24][24], float (&nextP)[24][24],
+				     unsigned first, unsigned last, const float (&SF)[21],
+				     const float (&SPP)[11], float q0, float dt)
+{
+	for (unsigned c = first; c <= last; c++) {
+		nextP[0][c] = P[0][c] + P[1][c]*SF[9] + P[2][c]*SF[11] + P[3][c]*SF[10] + P[10][c]*SF[14] + P[11][c]*SF[15] + P[12][c]*SPP[10];
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[1][c] = P[1][c] + P[0][c]*SF[8] + P[2][c]*SF[7] + P[3][c]*SF[11] - P[12][c]*SF[15] + P[11][c]*SPP[10] - (P[10][c]*q0)/2;
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[2][c] = P[2][c] + P[0][c]*SF[6] + P[1][c]*SF[10] + P[3][c]*SF[8] + P[12][c]*SF[14] - P[10][c]*SPP[10] - (P[11][c]*q0)/2;
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[3][c] = P[3][c] + P[0][c]*SF[7] + P[1][c]*SF[6] + P[2][c]*SF[9] + P[10][c]*SF[15] - P[11][c]*SF[14] - (P[12][c]*q0)/2;
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[4][c] = P[4][c] + P[0][c]*SF[5] + P[1][c]*SF[3] - P[3][c]*SF[4] + P[2][c]*SPP[0] + P[13][c]*SPP[3] + P[14][c]*SPP[6] - P[15][c]*SPP[9];
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[5][c] = P[5][c] + P[0][c]*SF[4] + P[2][c]*SF[3] + P[3][c]*SF[5] - P[1][c]*SPP[0] - P[13][c]*SPP[8] + P[14][c]*SPP[2] + P[15][c]*SPP[5];
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[6][c] = P[6][c] + P[1][c]*SF[4] - P[2][c]*SF[5] + P[3][c]*SF[3] + P[0][c]*SPP[0] + P[13][c]*SPP[4] - P[14][c]*SPP[7] - P[15][c]*SPP[1];
+	}
+
+	for (unsigned c = first; c <= last; c++) {
+		nextP[7][c] = P[7][c] + P[4][c]*dt;
+		nextP[8][c] = P[8][c] + P[5][c]*dt;
+		nextP[9][c] = P[9][c] + P[6][c]*dt;
+	}
+
+	// rows from the gyro bias states onwards are unchanged by the state transition model
+	for (unsigned r = 10; r <= last; r++) {
+		for (unsigned c = (r > first) ? r : first; c <= last; c++) {
+			nextP[r][c] = P[r][c];
+		}
+	}
+}
+#endif
+
+void Ekf::predictCovariance(const imuSample &imu)
 {
 	// assign intermediate state variables
 	float q0 = _state.quat_nominal(0);
@@ -134,13 +187,17 @@ void Ekf::predictCovariance()
 	float q2 = _state.quat_nominal(2);
 	float q3 = _state.quat_nominal(3);
 
-	float dax = _imu_sample_delayed.delta_ang(0);
-	float day = _imu_sample_delayed.delta_ang(1);
-	float daz = _imu_sample_delayed.delta_ang(2);
+	// the quaternion product cache was primed by predictState() - this is a
+	// no-op unless the quaternion has been modified since
+	updateQuatProducts();
+
+	float dax = imu.delta_ang(0);
+	float day = imu.delta_ang(1);
+	float daz = imu.delta_ang(2);
 
-	float dvx = _imu_sample_delayed.delta_vel(0);
-	float dvy = _imu_sample_delayed.delta_vel(1);
-	float dvz = _imu_sample_delayed.delta_vel(2);
+	float dvx = imu.delta_vel(0);
+	float dvy = imu.delta_vel(1);
+	float dvz = imu.delta_vel(2);
 
 	float dax_b = _state.gyro_bias(0);
 	float day_b = _state.gyro_bias(1);
@@ -150,11 +207,11 @@ void Ekf::predictCovariance()
 	float dvy_b = _state.accel_bias(1);
 	float dvz_b = _state.accel_bias(2);
 
-	float dt = math::constrain(_imu_sample_delayed.delta_ang_dt, 0.5f * FILTER_UPDATE_PERIOD_S, 2.0f * FILTER_UPDATE_PERIOD_S);
+	float dt = math::constrain(imu.delta_ang_dt, 0.5f * FILTER_UPDATE_PERIOD_S, 2.0f * FILTER_UPDATE_PERIOD_S);
 	float dt_inv = 1.0f / dt;
 
 	// compute noise variance for stationary processes
-	float process_noise[_k_num_states] = {};
+	float process_noise[_k_max_num_states] = {};
 
 	// convert rate of change of rate gyro bias (rad/s**2) as specified by the parameter to an expected change in delta angle (rad) since the last update
 	float d_ang_bias_sig = dt * dt * math::constrain(_params.gyro_bias_p_noise, 0.0f, 1.0f);
@@ -165,11 +222,11 @@ void Ekf::predictCovariance()
 	// inhibit learning of imu acccel bias if the manoeuvre levels are too high to protect against the effect of sensor nonlinearities or bad accel data is detected
 	float alpha = math::constrain((dt / _params.acc_bias_learn_tc), 0.0f, 1.0f);
 	float beta = 1.0f - alpha;
-	_ang_rate_mag_filt = fmaxf(dt_inv * _imu_sample_delayed.delta_ang.norm(), beta * _ang_rate_mag_filt);
-	_accel_mag_filt = fmaxf(dt_inv * _imu_sample_delayed.delta_vel.norm(), beta * _accel_mag_filt);
-	_accel_vec_filt(0) = alpha * dt_inv * _imu_sample_delayed.delta_vel(0) + beta * _accel_vec_filt(0);
-	_accel_vec_filt(1) = alpha * dt_inv * _imu_sample_delayed.delta_vel(1) + beta * _accel_vec_filt(1);
-	_accel_vec_filt(2) = alpha * dt_inv * _imu_sample_delayed.delta_vel(2) + beta * _accel_vec_filt(2);
+	_ang_rate_mag_filt = fmaxf(dt_inv * imu.delta_ang.norm(), beta * _ang_rate_mag_filt);
+	_accel_mag_filt = fmaxf(dt_inv * imu.delta_vel.norm(), beta * _accel_mag_filt);
+	_accel_vec_filt(0) = alpha * dt_inv * imu.delta_vel(0) + beta * _accel_vec_filt(0);
+	_accel_vec_filt(1) = alpha * dt_inv * imu.delta_vel(1) + beta * _accel_vec_filt(1);
+	_accel_vec_filt(2) = alpha * dt_inv * imu.delta_vel(2) + beta * _accel_vec_filt(2);
 
 	if (_ang_rate_mag_filt > _params.acc_bias_learn_gyr_lim
 	    || _accel_mag_filt > _params.acc_bias_learn_acc_lim
@@ -285,25 +342,25 @@ void Ekf::predictCovariance()
 	SF[14] = q1/2;
 	SF[15] = q2/2;
 	SF[16] = q3/2;
-	SF[17] = sq(q3);
-	SF[18] = sq(q2);
-	SF[19] = sq(q1);
-	SF[20] = sq(q0);
+	SF[17] = _quat_prod.q3q3;
+	SF[18] = _quat_prod.q2q2;
+	SF[19] = _quat_prod.q1q1;
+	SF[20] = _quat_prod.q0q0;
 
 	float SG[8];
 	SG[0] = q0/2;
-	SG[1] = sq(q3);
-	SG[2] = sq(q2);
-	SG[3] = sq(q1);
-	SG[4] = sq(q0);
-	SG[5] = 2*q2*q3;
-	SG[6] = 2*q1*q3;
-	SG[7] = 2*q1*q2;
+	SG[1] = _quat_prod.q3q3;
+	SG[2] = _quat_prod.q2q2;
+	SG[3] = _quat_prod.q1q1;
+	SG[4] = _quat_prod.q0q0;
+	SG[5] = 2.0f*_quat_prod.q2q3;
+	SG[6] = 2.0f*_quat_prod.q1q3;
+	SG[7] = 2.0f*_quat_prod.q1q2;
 
 	float SQ[11];
-	SQ[0] = dvzVar*(SG[5] - 2*q0*q1)*(SG[1] - SG[2] - SG[3] + SG[4]) - dvyVar*(SG[5] + 2*q0*q1)*(SG[1] - SG[2] + SG[3] - SG[4]) + dvxVar*(SG[6] - 2*q0*q2)*(SG[7] + 2*q0*q3);
-	SQ[1] = dvzVar*(SG[6] + 2*q0*q2)*(SG[1] - SG[2] - SG[3] + SG[4]) - dvxVar*(SG[6] - 2*q0*q2)*(SG[1] + SG[2] - SG[3] - SG[4]) + dvyVar*(SG[5] + 2*q0*q1)*(SG[7] - 2*q0*q3);
-	SQ[2] = dvzVar*(SG[5] - 2*q0*q1)*(SG[6] + 2*q0*q2) - dvyVar*(SG[7] - 2*q0*q3)*(SG[1] - SG[2] + SG[3] - SG[4]) - dvxVar*(SG[7] + 2*q0*q3)*(SG[1] + SG[2] - SG[3] - SG[4]);
+	SQ[0] = dvzVar*(SG[5] - 2.0f*_quat_prod.q0q1)*(SG[1] - SG[2] - SG[3] + SG[4]) - dvyVar*(SG[5] + 2.0f*_quat_prod.q0q1)*(SG[1] - SG[2] + SG[3] - SG[4]) + dvxVar*(SG[6] - 2.0f*_quat_prod.q0q2)*(SG[7] + 2.0f*_quat_prod.q0q3);
+	SQ[1] = dvzVar*(SG[6] + 2.0f*_quat_prod.q0q2)*(SG[1] - SG[2] - SG[3] + SG[4]) - dvxVar*(SG[6] - 2.0f*_quat_prod.q0q2)*(SG[1] + SG[2] - SG[3] - SG[4]) + dvyVar*(SG[5] + 2.0f*_quat_prod.q0q1)*(SG[7] - 2.0f*_quat_prod.q0q3);
+	SQ[2] = dvzVar*(SG[5] - 2.0f*_quat_prod.q0q1)*(SG[6] + 2.0f*_quat_prod.q0q2) - dvyVar*(SG[7] - 2.0f*_quat_prod.q0q3)*(SG[1] - SG[2] + SG[3] - SG[4]) - dvxVar*(SG[7] + 2.0f*_quat_prod.q0q3)*(SG[1] + SG[2] - SG[3] - SG[4]);
 	SQ[3] = (dayVar*q1*SG[0])/2 - (dazVar*q1*SG[0])/2 - (daxVar*q2*q3)/4;
 	SQ[4] = (dazVar*q2*SG[0])/2 - (daxVar*q2*SG[0])/2 - (dayVar*q1*q3)/4;
 	SQ[5] = (daxVar*q3*SG[0])/2 - (dayVar*q3*SG[0])/2 - (dazVar*q1*q2)/4;
@@ -311,19 +368,19 @@ void Ekf::predictCovariance()
 	SQ[7] = (dazVar*q1*q3)/4 - (daxVar*q1*q3)/4 - (dayVar*q2*SG[0])/2;
 	SQ[8] = (dayVar*q2*q3)/4 - (daxVar*q1*SG[0])/2 - (dazVar*q2*q3)/4;
 	SQ[9] = sq(SG[0]);
-	SQ[10] = sq(q1);
+	SQ[10] = _quat_prod.q1q1;
 
 	float SPP[11] = {};
 	SPP[0] = SF[12] + SF[13] - 2*q2*SF[2];
 	SPP[1] = SF[17] - SF[18] - SF[19] + SF[20];
 	SPP[2] = SF[17] - SF[18] + SF[19] - SF[20];
 	SPP[3] = SF[17] + SF[18] - SF[19] - SF[20];
-	SPP[4] = 2*q0*q2 - 2*q1*q3;
-	SPP[5] = 2*q0*q1 - 2*q2*q3;
-	SPP[6] = 2*q0*q3 - 2*q1*q2;
-	SPP[7] = 2*q0*q1 + 2*q2*q3;
-	SPP[8] = 2*q0*q3 + 2*q1*q2;
-	SPP[9] = 2*q0*q2 + 2*q1*q3;
+	SPP[4] = 2.0f*_quat_prod.q0q2 - 2.0f*_quat_prod.q1q3;
+	SPP[5] = 2.0f*_quat_prod.q0q1 - 2.0f*_quat_prod.q2q3;
+	SPP[6] = 2.0f*_quat_prod.q0q3 - 2.0f*_quat_prod.q1q2;
+	SPP[7] = 2.0f*_quat_prod.q0q1 + 2.0f*_quat_prod.q2q3;
+	SPP[8] = 2.0f*_quat_prod.q0q3 + 2.0f*_quat_prod.q1q2;
+	SPP[9] = 2.0f*_quat_prod.q0q2 + 2.0f*_quat_prod.q1q3;
 	SPP[10] = SF[16];
 
 	// covariance update
@@ -430,6 +487,9 @@ void Ekf::predictCovariance()
 	// Don't calculate these covariance terms if IMU delta velocity bias estimation is inhibited
 	if (!(_params.fusion_mode & MASK_INHIBIT_ACC_BIAS) && !_accel_bias_inhibit) {
 
+#ifdef EKF_VECTORIZED_PREDICTION
+		predictCovarianceColumns(P, nextP, 13, 15, SF, SPP, q0, dt);
+#else
 		// calculate variances and upper diagonal covariances for IMU delta velocity bias states
 		nextP[0][13] = P[0][13] + P[1][13]*SF[9] + P[2][13]*SF[11] + P[3][13]*SF[10] + P[10][13]*SF[14] + P[11][13]*SF[15] + P[12][13]*SPP[10];
 		nextP[1][13] = P[1][13] + P[0][13]*SF[8] + P[2][13]*SF[7] + P[3][13]*SF[11] - P[12][13]*SF[15] + P[11][13]*SPP[10] - (P[10][13]*q0)/2;
@@ -476,6 +536,7 @@ void Ekf::predictCovariance()
 		nextP[13][15] = P[13][15];
 		nextP[14][15] = P[14][15];
 		nextP[15][15] = P[15][15];
+#endif
 
 		// add process noise that is not from the IMU
 		for (unsigned i = 13; i <= 15; i++) {
@@ -484,12 +545,14 @@ void Ekf::predictCovariance()
 
 	} else {
 		// Inhibit delta velocity bias learning by zeroing the covariance terms
-		zeroRows(nextP, 13, 15);
-		zeroCols(nextP, 13, 15);
+		zeroRowsCols(nextP, 13, 15);
 	}
 
 	// Don't do covariance prediction on magnetic field states unless we are using 3-axis fusion
 	if (_control_status.flags.mag_3D) {
+#ifdef EKF_VECTORIZED_PREDICTION
+		predictCovarianceColumns(P, nextP, 16, 21, SF, SPP, q0, dt);
+#else
 		// calculate variances and upper diagonal covariances for earth and body magnetic field states
 		nextP[0][16] = P[0][16] + P[1][16]*SF[9] + P[2][16]*SF[11] + P[3][16]*SF[10] + P[10][16]*SF[14] + P[11][16]*SF[15] + P[12][16]*SPP[10];
 		nextP[1][16] = P[1][16] + P[0][16]*SF[8] + P[2][16]*SF[7] + P[3][16]*SF[11] - P[12][16]*SF[15] + P[11][16]*SPP[10] - (P[10][16]*q0)/2;
@@ -608,6 +671,7 @@ void Ekf::predictCovariance()
 		nextP[19][21] = P[19][21];
 		nextP[20][21] = P[20][21];
 		nextP[21][21] = P[21][21];
+#endif
 
 		// add process noise that is not from the IMU
 		for (unsigned i = 16; i <= 21; i++) {
@@ -619,6 +683,9 @@ void Ekf::predictCovariance()
 	// Don't do covariance prediction on wind states unless we are using them
 	if (_control_status.flags.wind) {
 
+#ifdef EKF_VECTORIZED_PREDICTION
+		predictCovarianceColumns(P, nextP, 22, 23, SF, SPP, q0, dt);
+#else
 		// calculate variances and upper diagonal covariances for wind states
 		nextP[0][22] = P[0][22] + P[1][22]*SF[9] + P[2][22]*SF[11] + P[3][22]*SF[10] + P[10][22]*SF[14] + P[11][22]*SF[15] + P[12][22]*SPP[10];
 		nextP[1][22] = P[1][22] + P[0][22]*SF[8] + P[2][22]*SF[7] + P[3][22]*SF[11] - P[12][22]*SF[15] + P[11][22]*SPP[10] - (P[10][22]*q0)/2;
@@ -667,6 +734,7 @@ void Ekf::predictCovariance()
 		nextP[21][23] = P[21][23];
 		nextP[22][23] = P[22][23];
 		nextP[23][23] = P[23][23];
+#endif
 
 		// add process noise that is not from the IMU
 		for (unsigned i = 22; i <= 23; i++) {
@@ -675,27 +743,56 @@ void Ekf::predictCovariance()
 
 	}
 
+	// determine the contiguous ranges of states that have been predicted this cycle so
+	// that the copy into P can skip the rows and columns of inhibited state blocks. The
+	// terms for inactive blocks (earth field, body field and wind states) are unchanged
+	// by the prediction and are held at zero by fixCovarianceErrors().
+	uint8_t range_start[2] = {0, 22};
+	uint8_t range_end[2] = {16, 24};
+	uint8_t num_ranges = 1;
+
+	if (_control_status.flags.mag_3D) {
+		// the magnetic field block extends the always predicted range
+		range_end[0] = 22;
+	}
+
+	if (_control_status.flags.wind) {
+		if (range_end[0] == 22) {
+			// the wind block is contiguous with the predicted magnetic field block
+			range_end[0] = 24;
+
+		} else {
+			num_ranges = 2;
+		}
+	}
+
 	// stop position covariance growth if our total position variance reaches 100m
 	// this can happen if we lose gps for some time
 	if ((P[7][7] + P[8][8]) > 1e4f) {
 		for (uint8_t i = 7; i <= 8; i++) {
-			for (uint8_t j = 0; j < _k_num_states; j++) {
-				nextP[i][j] = P[i][j];
-				nextP[j][i] = P[j][i];
+			for (uint8_t r = 0; r < num_ranges; r++) {
+				for (uint8_t j = range_start[r]; j < range_end[r]; j++) {
+					nextP[i][j] = P[i][j];
+					nextP[j][i] = P[j][i];
+				}
 			}
 		}
 	}
 
 	// covariance matrix is symmetrical, so copy upper half to lower half
-	for (unsigned row = 1; row < _k_num_states; row++) {
-		for (unsigned column = 0 ; column < row; column++) {
-			P[row][column] = P[column][row] = nextP[column][row];
-		}
-	}
+	// and copy the variances (diagonals), visiting only the predicted ranges
+	for (uint8_t row_range = 0; row_range < num_ranges; row_range++) {
+		for (unsigned row = range_start[row_range]; row < range_end[row_range]; row++) {
+			for (uint8_t col_range = 0; col_range <= row_range; col_range++) {
+				unsigned last_col = (range_end[col_range] < row) ? range_end[col_range] : row;
+
+				for (unsigned column = range_start[col_range]; column < last_col; column++) {
+					P[row][column] = P[column][row] = nextP[column][row];
+				}
+			}
 
-	// copy variances (diagonals)
-	for (unsigned i = 0; i < _k_num_states; i++) {
-		P[i][i] = nextP[i][i];
+			P[row][row] = nextP[row][row];
+		}
 	}
 
 	// fix gross errors in the covariance matrix and ensure rows and
@@ -749,8 +846,7 @@ void Ekf::fixCovarianceErrors()
 
 	// accelerometer bias states
 	if ((_params.fusion_mode & MASK_INHIBIT_ACC_BIAS) || _accel_bias_inhibit) {
-		zeroRows(P, 13, 15);
-		zeroCols(P, 13, 15);
+		zeroRowsCols(P, 13, 15);
 
 	} else {
 		// Find the maximum delta velocity bias state variance and request a covariance reset if any variance is below the safe minimum
@@ -824,8 +920,7 @@ void Ekf::fixCovarianceErrors()
 			float varX = P[13][13];
 			float varY = P[14][14];
 			float varZ = P[15][15];
-			zeroRows(P, 13, 15);
-			zeroCols(P, 13, 15);
+			zeroRowsCols(P, 13, 15);
 			P[13][13] = varX;
 			P[14][14] = varY;
 			P[15][15] = varZ;
@@ -842,8 +937,7 @@ void Ekf::fixCovarianceErrors()
 
 	// magnetic field states
 	if (!_control_status.flags.mag_3D) {
-		zeroRows(P, 16, 21);
-		zeroCols(P, 16, 21);
+		zeroRowsCols(P, 16, 21);
 
 	} else {
 		// constrain variances
@@ -861,8 +955,7 @@ void Ekf::fixCovarianceErrors()
 
 	// wind velocity states
 	if (!_control_status.flags.wind) {
-		zeroRows(P, 22, 23);
-		zeroCols(P, 22, 23);
+		zeroRowsCols(P, 22, 23);
 
 	} else {
 		// constrain variances
@@ -878,12 +971,10 @@ void Ekf::fixCovarianceErrors()
 void Ekf::resetMagCovariance()
 {
 	// set the quaternion covariance terms to zero
-	zeroRows(P, 0, 3);
-	zeroCols(P, 0, 3);
+	zeroRowsCols(P, 0, 3);
 
 	// set the magnetic field covariance terms to zero
-	zeroRows(P, 16, 21);
-	zeroCols(P, 16, 21);
+	zeroRowsCols(P, 16, 21);
 
 	// set the field state variance to the observation variance
 	for (uint8_t rc_index = 16; rc_index <= 21; rc_index ++) {
@@ -894,8 +985,7 @@ void Ekf::resetMagCovariance()
 void Ekf::resetWindCovariance()
 {
 	// set the wind  covariance terms to zero
-	zeroRows(P, 22, 23);
-	zeroCols(P, 22, 23);
+	zeroRowsCols(P, 22, 23);
 
 	if (_tas_data_ready && (_imu_sample_delayed.time_us - _airspeed_sample_delayed.time_us < (uint64_t)5e5)) {
 		// Use airspeed and zer sideslip assumption to set initial covariance values for wind states
@@ -42,9 +42,17 @@
 #include "ekf.h"
 #include <ecl.h>
 #include <mathlib/mathlib.h>
+#include <mathlib/kalman_kernels.h>
 
+namespace kf = ecl::kalman;
+
+#ifndef EKF_NO_DRAG_FUSION
 void Ekf::fuseDrag()
 {
+#ifdef EKF_NO_WIND_STATES
+	// the wind velocity states are not part of this build
+	return;
+#else
 	float SH_ACC[4] = {}; // Variable used to optimise calculations of measurement jacobian
 	float H_ACC[24] = {}; // Observation Jacobian
 	float SK_ACC[9] = {}; // Variable used to optimise calculations of the Kalman gain vector
@@ -77,14 +85,10 @@ void Ekf::fuseDrag()
 	float vwe = _state.wind_vel(1);
 
 	// predicted specific forces
-	// calculate relative wind velocity in earth frame and rotte into body frame
-	Vector3f rel_wind;
-	rel_wind(0) = vn - vwn;
-	rel_wind(1) = ve - vwe;
-	rel_wind(2) = vd;
-	Dcmf earth_to_body(_state.quat_nominal);
-	earth_to_body = earth_to_body.transpose();
-	rel_wind = earth_to_body * rel_wind;
+	// refresh the shared wind relative kinematics (no-op if already current)
+	// and use the cached body frame relative wind velocity
+	updateWindRelKinematics();
+	const Vector3f &rel_wind = _wind_rel_kin.rel_wind_body;
 
 	// perform sequential fusion of XY specific forces
 	for (uint8_t axis_index = 0; axis_index < 2; axis_index++) {
@@ -98,14 +102,15 @@ void Ekf::fuseDrag()
 			// Limit lower value to prevent arithmetic exceptions
 			float Kacc = fmaxf(1e-1f, rho * BC_inv_x * airSpd);
 
-			SH_ACC[0] = sq(q0) + sq(q1) - sq(q2) - sq(q3);
+			// the shared projection and partial terms come from the cached kinematics block
+			SH_ACC[0] = _wind_rel_kin.R_bx_n;
 			SH_ACC[1] = vn - vwn;
 			SH_ACC[2] = ve - vwe;
-			SH_ACC[3] = 2.0f*q0*q3 + 2.0f*q1*q2;
-			H_ACC[0] = -Kacc*(2.0f*q0*SH_ACC[1] + 2.0f*q3*SH_ACC[2] - 2.0f*q2*vd);
-			H_ACC[1] = -Kacc*(2.0f*q1*SH_ACC[1] + 2.0f*q2*SH_ACC[2] + 2.0f*q3*vd);
-			H_ACC[2] = Kacc*(2.0f*q2*SH_ACC[1] - 2.0f*q1*SH_ACC[2] + 2.0f*q0*vd);
-			H_ACC[3] = -Kacc*(2.0f*q0*SH_ACC[2] - 2.0f*q3*SH_ACC[1] + 2.0f*q1*vd);
+			SH_ACC[3] = _wind_rel_kin.R_bx_e;
+			H_ACC[0] = -Kacc*_wind_rel_kin.vel_partial[0];
+			H_ACC[1] = -Kacc*_wind_rel_kin.vel_partial[1];
+			H_ACC[2] = Kacc*_wind_rel_kin.vel_partial[2];
+			H_ACC[3] = -Kacc*_wind_rel_kin.vel_partial[3];
 			H_ACC[4] = -Kacc*SH_ACC[0];
 			H_ACC[5] = -Kacc*SH_ACC[3];
 			H_ACC[6] = Kacc*(2.0f*q0*q2 - 2.0f*q1*q3);
@@ -116,10 +121,10 @@ void Ekf::fuseDrag()
 				return;
 			}
 			SK_ACC[0] = 1.0f/_drag_innov_var[0];
-			SK_ACC[1] = 2.0f*q0*SH_ACC[2] - 2.0f*q3*SH_ACC[1] + 2.0f*q1*vd;
-			SK_ACC[2] = 2.0f*q2*SH_ACC[1] - 2.0f*q1*SH_ACC[2] + 2.0f*q0*vd;
-			SK_ACC[3] = 2.0f*q0*SH_ACC[1] + 2.0f*q3*SH_ACC[2] - 2.0f*q2*vd;
-			SK_ACC[4] = 2.0f*q1*SH_ACC[1] + 2.0f*q2*SH_ACC[2] + 2.0f*q3*vd;
+			SK_ACC[1] = _wind_rel_kin.vel_partial[3];
+			SK_ACC[2] = _wind_rel_kin.vel_partial[2];
+			SK_ACC[3] = _wind_rel_kin.vel_partial[0];
+			SK_ACC[4] = _wind_rel_kin.vel_partial[1];
 			SK_ACC[5] = 2.0f*q0*q2 - 2.0f*q1*q3;
 			SK_ACC[6] = SH_ACC[3];
 // Don't allow modification of any states other than wind velocity at this stage of development - we only need a wind estimate.
@@ -160,7 +165,7 @@ void Ekf::fuseDrag()
 
 			float predAccel = -BC_inv_x * 0.5f * rho * sq(rel_wind(axis_index)) * drag_sign;
 			_drag_innov[axis_index] = predAccel - mea_acc;
-			_drag_test_ratio[axis_index] = sq(_drag_innov[axis_index]) / (25.0f * _drag_innov_var[axis_index]);
+			_innov_monitor.ratio.drag[axis_index] = sq(_drag_innov[axis_index]) / (25.0f * _drag_innov_var[axis_index]);
 
 		} else if (axis_index == 1) {
 			// Estimate the airspeed from the measured drag force and ballistic coefficient
@@ -174,10 +179,10 @@ void Ekf::fuseDrag()
 			SH_ACC[0] = sq(q0) - sq(q1) + sq(q2) - sq(q3);
 			SH_ACC[1] = vn - vwn;
 			SH_ACC[2] = ve - vwe;
-			H_ACC[0] = -Kacc*(2.0f*q0*SH_ACC[2] - 2.0f*q3*SH_ACC[1] + 2.0f*q1*vd);
-			H_ACC[1] = -Kacc*(2.0f*q2*SH_ACC[1] - 2.0f*q1*SH_ACC[2] + 2.0f*q0*vd);
-			H_ACC[2] = -Kacc*(2.0f*q1*SH_ACC[1] + 2.0f*q2*SH_ACC[2] + 2.0f*q3*vd);
-			H_ACC[3] = Kacc*(2.0f*q0*SH_ACC[1] + 2.0f*q3*SH_ACC[2] - 2.0f*q2*vd);
+			H_ACC[0] = -Kacc*_wind_rel_kin.vel_partial[3];
+			H_ACC[1] = -Kacc*_wind_rel_kin.vel_partial[2];
+			H_ACC[2] = -Kacc*_wind_rel_kin.vel_partial[1];
+			H_ACC[3] = Kacc*_wind_rel_kin.vel_partial[0];
 			H_ACC[4] = Kacc*(2.0f*q0*q3 - 2.0f*q1*q2);
 			H_ACC[5] = -Kacc*SH_ACC[0];
 			H_ACC[6] = -Kacc*(2.0f*q0*q1 + 2.0f*q2*q3);
@@ -189,10 +194,10 @@ void Ekf::fuseDrag()
 				return;
 			}
 			SK_ACC[0] = 1.0f/_drag_innov_var[1];
-			SK_ACC[1] = 2.0f*q0*SH_ACC[1] + 2.0f*q3*SH_ACC[2] - 2.0f*q2*vd;
-			SK_ACC[2] = 2.0f*q2*SH_ACC[1] - 2.0f*q1*SH_ACC[2] + 2.0f*q0*vd;
-			SK_ACC[3] = 2.0f*q0*SH_ACC[2] - 2.0f*q3*SH_ACC[1] + 2.0f*q1*vd;
-			SK_ACC[4] = 2.0f*q1*SH_ACC[1] + 2.0f*q2*SH_ACC[2] + 2.0f*q3*vd;
+			SK_ACC[1] = _wind_rel_kin.vel_partial[0];
+			SK_ACC[2] = _wind_rel_kin.vel_partial[2];
+			SK_ACC[3] = _wind_rel_kin.vel_partial[3];
+			SK_ACC[4] = _wind_rel_kin.vel_partial[1];
 			SK_ACC[5] = 2.0f*q0*q3 - 2.0f*q1*q2;
 			SK_ACC[6] = q0*q3 - q1*q2;
 			SK_ACC[7] = 2.0f*q0*q1 + 2.0f*q2*q3;
@@ -235,72 +240,29 @@ void Ekf::fuseDrag()
 
 			float predAccel = -BC_inv_y * 0.5f * rho * sq(rel_wind(axis_index)) * drag_sign;
 			_drag_innov[axis_index] = predAccel - mea_acc;
-			_drag_test_ratio[axis_index] = sq(_drag_innov[axis_index]) / (25.0f * _drag_innov_var[axis_index]);
+			_innov_monitor.ratio.drag[axis_index] = sq(_drag_innov[axis_index]) / (25.0f * _drag_innov_var[axis_index]);
 
 		}
 
 		// if the innovation consistency check fails then don't fuse the sample
-		if (_drag_test_ratio[axis_index] <= 1.0f) {
+		if (_innov_monitor.ratio.drag[axis_index] <= 1.0f) {
 			// apply covariance correction via P_new = (I -K*H)*P
-			// first calculate expression for KHP
-			// then calculate P - KHP
-			float KHP[_k_num_states][_k_num_states];
-			float KH[9];
-
-			for (unsigned row = 0; row < _k_num_states; row++) {
-
-				KH[0] = Kfusion[row] * H_ACC[0];
-				KH[1] = Kfusion[row] * H_ACC[1];
-				KH[2] = Kfusion[row] * H_ACC[2];
-				KH[3] = Kfusion[row] * H_ACC[3];
-				KH[4] = Kfusion[row] * H_ACC[4];
-				KH[5] = Kfusion[row] * H_ACC[5];
-				KH[6] = Kfusion[row] * H_ACC[6];
-				KH[7] = Kfusion[row] * H_ACC[22];
-				KH[8] = Kfusion[row] * H_ACC[23];
-
-				for (unsigned column = 0; column < _k_num_states; column++) {
-					float tmp = KH[0] * P[0][column];
-					tmp += KH[1] * P[1][column];
-					tmp += KH[2] * P[2][column];
-					tmp += KH[3] * P[3][column];
-					tmp += KH[4] * P[4][column];
-					tmp += KH[5] * P[5][column];
-					tmp += KH[6] * P[6][column];
-					tmp += KH[7] * P[22][column];
-					tmp += KH[8] * P[23][column];
-					KHP[row][column] = tmp;
-				}
-			}
+			// form the H*P row once - for symmetric P the correction K*H*P is then
+			// the rank-1 outer product of the gain and this row
+			float HP[_k_max_num_states];
+			const uint8_t h_idx[9] = {0, 1, 2, 3, 4, 5, 6, 22, 23};
+			const float h_val[9] = {H_ACC[0], H_ACC[1], H_ACC[2], H_ACC[3], H_ACC[4],
+						H_ACC[5], H_ACC[6], H_ACC[22], H_ACC[23]
+					       };
+			kf::sparseRowProduct(P, h_val, h_idx, 9, HP, _k_num_states);
 
 			// if the covariance correction will result in a negative variance, then
 			// the covariance marix is unhealthy and must be corrected
-			bool healthy = true;
-
-			//_fault_status.flags.bad_sideslip = false;
-			for (int i = 0; i < _k_num_states; i++) {
-				if (P[i][i] < KHP[i][i]) {
-					// zero rows and columns
-					zeroRows(P, i, i);
-					zeroCols(P, i, i);
-
-					//flag as unhealthy
-					healthy = false;
-
-					// update individual measurement health status
-					//_fault_status.flags.bad_sideslip = true;
-
-				}
-			}
+			const bool healthy = kf::rankOneDowndateHealthy(P, Kfusion, HP, _k_num_states);
 
-			// only apply covariance and state corrrections if healthy
 			if (healthy) {
 				// apply the covariance corrections
-				for (unsigned row = 0; row < _k_num_states; row++) {
-					for (unsigned column = 0; column < _k_num_states; column++) {
-						P[row][column] = P[row][column] - KHP[row][column];
-					}
-				}
+				kf::rankOneDowndate(P, Kfusion, HP, _k_num_states);
 
 				// correct the covariance marix for gross errors
 				fixCovarianceErrors();
@@ -308,7 +270,17 @@ void Ekf::fuseDrag()
 				// apply the state corrections
 				fuse(Kfusion, _drag_innov[axis_index]);
 
+			} else {
+				// zero the rows and columns of any state whose variance would have
+				// been driven negative by the correction
+				for (int i = 0; i < _k_num_states; i++) {
+					if (P[i][i] < Kfusion[i] * HP[i]) {
+						zeroRowsCols(P, i, i);
+					}
+				}
 			}
 		}
 	}
+#endif // EKF_NO_WIND_STATES
 }
+#endif // EKF_NO_DRAG_FUSION
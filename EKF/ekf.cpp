@@ -42,8 +42,20 @@
 #include "ekf.h"
 
 #include <ecl.h>
+#include <mathlib/fastmath.h>
 #include <mathlib/mathlib.h>
 
+namespace fm = ecl::fastmath;
+
+#ifdef EKF_INSTRUMENTATION
+// time a section of the filter update, compiled out to nothing when instrumentation is disabled
+#define EKF_PERF_BEGIN(section)	const uint64_t perf_start_##section = ecl_absolute_time()
+#define EKF_PERF_END(section)	perfUpdate(PERF_##section, perf_start_##section)
+#else
+#define EKF_PERF_BEGIN(section)
+#define EKF_PERF_END(section)
+#endif
+
 bool Ekf::init(uint64_t timestamp)
 {
 	bool ret = initialise_interface(timestamp);
@@ -61,6 +73,9 @@ bool Ekf::init(uint64_t timestamp)
 	_output_new.pos.setZero();
 	_output_new.quat_nominal.setZero();
 
+	_output_vel_correction.setZero();
+	_output_pos_correction.setZero();
+
 	_delta_angle_corr.setZero();
 	_imu_down_sampled.delta_ang.setZero();
 	_imu_down_sampled.delta_vel.setZero();
@@ -110,30 +125,156 @@ bool Ekf::update()
 	}
 
 	// Only run the filter if IMU data in the buffer has been updated
-	if (_imu_updated) {
+	if (_imu_updated && !quiescentFrameSkip()) {
+
+		// combine any deltas deferred while quiescent with the delayed sample,
+		// leaving the delayed sample itself untouched
+		_imu_sample_prediction = quiescentCombinedSample();
 
 		// perform state and covariance prediction for the main filter
-		predictState();
-		predictCovariance();
+		EKF_PERF_BEGIN(STATE_PREDICTION);
+		predictState(_imu_sample_prediction);
+		EKF_PERF_END(STATE_PREDICTION);
+
+		EKF_PERF_BEGIN(COVARIANCE_PREDICTION);
+		predictCovariance(_imu_sample_prediction);
+		EKF_PERF_END(COVARIANCE_PREDICTION);
 
 		// control fusion of observation data
+		EKF_PERF_BEGIN(FUSION_CONTROL);
 		controlFusionModes();
+		EKF_PERF_END(FUSION_CONTROL);
 
+#ifndef EKF_NO_TERRAIN_ESTIMATOR
 		// run a separate filter for terrain estimation
+		EKF_PERF_BEGIN(TERRAIN_ESTIMATOR);
 		runTerrainEstimator();
+		EKF_PERF_END(TERRAIN_ESTIMATOR);
+#else
+		// the height fusion control logic still needs the range data continuity
+		// check normally performed by the terrain estimator
+		checkRangeDataContinuity();
+#endif // EKF_NO_TERRAIN_ESTIMATOR
+
+		// the states changed, invalidate the cached derived outputs
+		_update_generation++;
 
 		updated = true;
 	}
 
 	// the output observer always runs
 	// Use full rate IMU data at the current time horizon
+	EKF_PERF_BEGIN(OUTPUT_PREDICTOR);
 	calculateOutputStates();
+	EKF_PERF_END(OUTPUT_PREDICTOR);
+
+	// commit the outputs for lock free readers on other threads
+	publishSnapshot();
+
+	return updated;
+}
+
+bool Ekf::update_sliced(uint64_t time_budget_us)
+{
+	if (!_filter_initialised) {
+		_filter_initialised = initialiseFilter();
+
+		if (!_filter_initialised) {
+			return false;
+		}
+	}
+
+	const uint64_t start_time = ecl_absolute_time();
+
+	// the output observer always runs so the caller sees fresh output states
+	// regardless of how the budget is spent
+	// Use full rate IMU data at the current time horizon
+	EKF_PERF_BEGIN(OUTPUT_PREDICTOR);
+	calculateOutputStates();
+	EKF_PERF_END(OUTPUT_PREDICTOR);
+
+	bool updated = false;
+	bool can_run = true;
+
+	// run pending phases until the budget is exhausted, always making progress by
+	// running at least one phase when one is pending
+	while (can_run) {
+		switch (_update_phase) {
+		case 0:
+			// a new update starts when IMU data in the buffer has been updated
+			if (!_imu_updated || quiescentFrameSkip()) {
+				can_run = false;
+				break;
+			}
+
+			// combine any deltas deferred while quiescent with the delayed sample;
+			// the member keeps the sample stable across the sliced phases
+			_imu_sample_prediction = quiescentCombinedSample();
+
+			{
+				EKF_PERF_BEGIN(STATE_PREDICTION);
+				predictState(_imu_sample_prediction);
+				EKF_PERF_END(STATE_PREDICTION);
+			}
+			_update_phase = 1;
+			break;
+
+		case 1: {
+				EKF_PERF_BEGIN(COVARIANCE_PREDICTION);
+				predictCovariance(_imu_sample_prediction);
+				EKF_PERF_END(COVARIANCE_PREDICTION);
+				_update_phase = 2;
+				break;
+			}
+
+		case 2: {
+				EKF_PERF_BEGIN(FUSION_CONTROL);
+				controlFusionModes();
+				EKF_PERF_END(FUSION_CONTROL);
+				_update_phase = 3;
+				break;
+			}
+
+		default: {
+#ifndef EKF_NO_TERRAIN_ESTIMATOR
+				EKF_PERF_BEGIN(TERRAIN_ESTIMATOR);
+				runTerrainEstimator();
+				EKF_PERF_END(TERRAIN_ESTIMATOR);
+#else
+				checkRangeDataContinuity();
+#endif // EKF_NO_TERRAIN_ESTIMATOR
+				_update_phase = 0;
+
+				// the states changed, invalidate the cached derived outputs
+				_update_generation++;
+
+				updated = true;
+				break;
+			}
+		}
+
+		if (updated) {
+			// the update has completed, the next one starts on the next call
+			can_run = false;
+		}
+
+		if (can_run && ((ecl_absolute_time() - start_time) >= time_budget_us)) {
+			can_run = false;
+		}
+	}
+
+	// commit the outputs for lock free readers on other threads
+	publishSnapshot();
 
 	return updated;
 }
 
 bool Ekf::initialiseFilter()
 {
+	if (_params.fast_align) {
+		return initialiseFilterFast();
+	}
+
 	// Keep accumulating measurements until we have a minimum of 10 samples for the required sensors
 
 	// Sum the IMU delta angle measurements
@@ -217,85 +358,226 @@ bool Ekf::initialiseFilter()
 
 	if (hgt_count_fail || mag_count_fail) {
 		return false;
+	}
+
+	return initialiseStatesAndCovariance();
+}
+
+// seed the states and covariance matrix from the accumulated tilt, heading and
+// height alignment data and reset the output predictor history to match
+bool Ekf::initialiseStatesAndCovariance()
+{
+	// reset variables that are shared with post alignment GPS checks
+	_gps_quality.reset_vertical_drift_filter();
+	_gps_alt_ref = 0.0f;
+
+	// Zero all of the states
+	_state.vel.setZero();
+	_state.pos.setZero();
+	_state.gyro_bias.setZero();
+	_state.accel_bias.setZero();
+	_state.mag_I.setZero();
+	_state.mag_B.setZero();
+	_state.wind_vel.setZero();
+
+	// get initial roll and pitch estimate from delta velocity vector, assuming vehicle is static
+	float pitch = 0.0f;
+	float roll = 0.0f;
+
+	if (_delVel_sum.norm() > 0.001f) {
+		_delVel_sum.normalize();
+		pitch = asinf(_delVel_sum(0));
+		roll = atan2f(-_delVel_sum(1), -_delVel_sum(2));
 
 	} else {
-		// reset variables that are shared with post alignment GPS checks
-		_gps_drift_velD = 0.0f;
-		_gps_alt_ref = 0.0f;
-
-		// Zero all of the states
-		_state.vel.setZero();
-		_state.pos.setZero();
-		_state.gyro_bias.setZero();
-		_state.accel_bias.setZero();
-		_state.mag_I.setZero();
-		_state.mag_B.setZero();
-		_state.wind_vel.setZero();
-
-		// get initial roll and pitch estimate from delta velocity vector, assuming vehicle is static
-		float pitch = 0.0f;
-		float roll = 0.0f;
-
-		if (_delVel_sum.norm() > 0.001f) {
-			_delVel_sum.normalize();
-			pitch = asinf(_delVel_sum(0));
-			roll = atan2f(-_delVel_sum(1), -_delVel_sum(2));
+		return false;
+	}
 
-		} else {
-			return false;
-		}
+	// calculate initial tilt alignment
+	Eulerf euler_init(roll, pitch, 0.0f);
+	_state.quat_nominal = Quatf(euler_init);
+	_output_new.quat_nominal = _state.quat_nominal;
 
-		// calculate initial tilt alignment
-		Eulerf euler_init(roll, pitch, 0.0f);
-		_state.quat_nominal = Quatf(euler_init);
-		_output_new.quat_nominal = _state.quat_nominal;
+	// update transformation matrix from body to world frame
+	_R_to_earth = quat_to_invrotmat(_state.quat_nominal);
+
+	// calculate the averaged magnetometer reading
+	Vector3f mag_init = _mag_filt_state;
 
-		// update transformation matrix from body to world frame
-		_R_to_earth = quat_to_invrotmat(_state.quat_nominal);
+	// calculate the initial magnetic field and yaw alignment
+	_control_status.flags.yaw_align = resetMagHeading(mag_init);
 
-		// calculate the averaged magnetometer reading
-		Vector3f mag_init = _mag_filt_state;
+	if (_control_status.flags.rng_hgt) {
+		// if we are using the range finder as the primary source, then calculate the baro height at origin so  we can use baro as a backup
+		// so it can be used as a backup ad set the initial height using the range finder
+		const baroSample &baro_newest = _baro_buffer.get_newest();
+		_baro_hgt_offset = baro_newest.hgt;
+		_state.pos(2) = -math::max(_rng_filt_state * _R_rng_to_earth_2_2, _params.rng_gnd_clearance);
+		ECL_INFO("EKF using range finder height - commencing alignment");
 
-		// calculate the initial magnetic field and yaw alignment
-		_control_status.flags.yaw_align = resetMagHeading(mag_init);
+	} else if (_control_status.flags.ev_hgt) {
+		// if we are using external vision data for height, then the vertical position state needs to be reset
+		// because the initialisation position is not the zero datum
+		resetHeight();
+
+	}
 
-		if (_control_status.flags.rng_hgt) {
-			// if we are using the range finder as the primary source, then calculate the baro height at origin so  we can use baro as a backup
-			// so it can be used as a backup ad set the initial height using the range finder
-			const baroSample &baro_newest = _baro_buffer.get_newest();
-			_baro_hgt_offset = baro_newest.hgt;
-			_state.pos(2) = -math::max(_rng_filt_state * _R_rng_to_earth_2_2, _params.rng_gnd_clearance);
-			ECL_INFO("EKF using range finder height - commencing alignment");
+	// initialise the state covariance matrix
+	initialiseCovariance();
 
-		} else if (_control_status.flags.ev_hgt) {
-			// if we are using external vision data for height, then the vertical position state needs to be reset
-			// because the initialisation position is not the zero datum
-			resetHeight();
+#ifndef EKF_NO_TERRAIN_ESTIMATOR
+	// try to initialise the terrain estimator
+	_terrain_initialised = initHagl();
+#endif // EKF_NO_TERRAIN_ESTIMATOR
 
+	// reset the essential fusion timeout counters
+	_time_last_hgt_fuse = _time_last_imu;
+	_time_last_pos_fuse = _time_last_imu;
+	_time_last_delpos_fuse = _time_last_imu;
+	_time_last_vel_fuse = _time_last_imu;
+	_time_last_hagl_fuse = _time_last_imu;
+	_time_last_of_fuse = _time_last_imu;
+
+	// reset the output predictor state history to match the EKF initial values
+	alignOutputFilter();
+
+	return true;
+}
+
+/*
+ * Fast alignment startup path, enabled by the fast_align parameter. The normal
+ * path waits for the delay horizon to flush two observation buffer lengths of
+ * data before it trusts the measurements, which costs several seconds from power
+ * on. This path batch averages the newest IMU, magnetometer and baro samples as
+ * they arrive and seeds the states from the averages as soon as a short fixed
+ * window is complete, accepting the risk that a sensor needing a settling time
+ * contributes its startup transient to the alignment.
+*/
+bool Ekf::initialiseFilterFast()
+{
+	// sum the delta velocity measurements at the downsampled rate for the tilt estimate
+	if (_imu_updated) {
+		_delVel_sum += _imu_buffer.get_newest().delta_vel;
+		_fast_align.imu_count++;
+	}
+
+	// sum the newest magnetometer and baro samples as they arrive, working at the
+	// current time horizon instead of waiting for the delayed horizon to fill
+	if (_mag_buffer.get_length() > 0) {
+		const magSample &mag_newest = _mag_buffer.get_newest();
+
+		if ((mag_newest.time_us != 0) && (mag_newest.time_us != _fast_align.last_mag_us)) {
+			_fast_align.mag_sum += mag_newest.mag;
+			_fast_align.mag_count++;
+			_fast_align.last_mag_us = mag_newest.time_us;
+		}
+	}
+
+	if (_baro_buffer.get_length() > 0) {
+		const baroSample &baro_newest = _baro_buffer.get_newest();
+
+		if ((baro_newest.time_us != 0) && (baro_newest.time_us != _fast_align.last_baro_us)) {
+			_fast_align.baro_sum += baro_newest.hgt;
+			_fast_align.baro_count++;
+			_fast_align.last_baro_us = baro_newest.time_us;
 		}
+	}
+
+	if ((_fast_align.imu_count < _k_fast_align_min_imu)
+	    || (_fast_align.mag_count < _k_fast_align_min_obs)
+	    || (_fast_align.baro_count < _k_fast_align_min_obs)) {
+		return false;
+	}
 
-		// initialise the state covariance matrix
-		initialiseCovariance();
+	// seed the quantities the normal path accumulates through the delay horizon.
+	// The summed delta velocity is consumed unnormalised by the tilt alignment.
+	_mag_filt_state = _fast_align.mag_sum * (1.0f / (float)_fast_align.mag_count);
+	_baro_hgt_offset = _fast_align.baro_sum / (float)_fast_align.baro_count;
 
-		// try to initialise the terrain estimator
-		_terrain_initialised = initHagl();
+	// baro is used as the initial height reference like the normal path, the
+	// height source switches later once the preferred sensor passes its checks
+	_primary_hgt_source = _params.vdist_sensor_type;
+	setControlBaroHeight();
 
-		// reset the essential fusion timeout counters
-		_time_last_hgt_fuse = _time_last_imu;
-		_time_last_pos_fuse = _time_last_imu;
-		_time_last_delpos_fuse = _time_last_imu;
-		_time_last_vel_fuse = _time_last_imu;
-		_time_last_hagl_fuse = _time_last_imu;
-		_time_last_of_fuse = _time_last_imu;
+	if (!initialiseStatesAndCovariance()) {
+		return false;
+	}
+
+	// the batch average bounds the tilt error well below the default switch on
+	// uncertainty, so credit it to the attitude covariance. The tilt alignment
+	// check then passes on the next variance evaluation instead of waiting for
+	// aiding data fusion to converge.
+	const float tilt_err = math::constrain(_params.accel_noise / CONSTANTS_ONE_G / sqrtf((float)_fast_align.imu_count),
+					       math::radians(0.5f), _params.initial_tilt_err);
+
+	Vector3f rot_vec_var;
+	rot_vec_var(0) = rot_vec_var(1) = sq(tilt_err);
+	rot_vec_var(2) = sq(fmaxf(_params.mag_heading_noise, tilt_err));
+	initialiseQuatCovariances(rot_vec_var);
+
+	return true;
+}
 
-		// reset the output predictor state history to match the EKF initial values
-		alignOutputFilter();
+bool Ekf::quiescentFrameSkip()
+{
+	// only defer work when sitting at rest on the ground with the tilt aligned; any
+	// other condition runs the full update immediately, consuming whatever has been
+	// accumulated so in-air behaviour is unchanged
+	const bool can_defer = _vehicle_at_rest && !_control_status.flags.in_air
+			       && _control_status.flags.tilt_align;
+
+	// _imu_updated stays latched until the next setIMUData() call, so repeated
+	// update() calls re-enter with the same delayed sample - each downsampled
+	// frame must be accumulated at most once and its duplicates skipped
+	const bool fresh_frame = _imu_sample_delayed.time_us != _quiescent_frame_us;
+	_quiescent_frame_us = _imu_sample_delayed.time_us;
+
+	if (!can_defer) {
+		return false;
+	}
 
+	if (!fresh_frame) {
+		// this frame has already been accumulated or processed
 		return true;
 	}
+
+	if (_quiescent_frame_count + 1 < _k_quiescent_decimation) {
+		// accumulate bias corrected deltas so the deferred prediction integrates the
+		// full interval. predictState() applies a single bias correction to the
+		// combined sample which then covers the frame it is run on
+		_quiescent_delta_ang += _imu_sample_delayed.delta_ang - _state.gyro_bias;
+		_quiescent_delta_vel += _imu_sample_delayed.delta_vel - _state.accel_bias;
+		_quiescent_delta_ang_dt += _imu_sample_delayed.delta_ang_dt;
+		_quiescent_delta_vel_dt += _imu_sample_delayed.delta_vel_dt;
+		_quiescent_frame_count++;
+		return true;
+	}
+
+	return false;
+}
+
+imuSample Ekf::quiescentCombinedSample()
+{
+	imuSample imu = _imu_sample_delayed;
+
+	if (_quiescent_frame_count > 0) {
+		// fold the deferred deltas into the sample driving this prediction,
+		// leaving the delayed sample itself untouched
+		imu.delta_ang += _quiescent_delta_ang;
+		imu.delta_vel += _quiescent_delta_vel;
+		imu.delta_ang_dt += _quiescent_delta_ang_dt;
+		imu.delta_vel_dt += _quiescent_delta_vel_dt;
+		_quiescent_delta_ang.setZero();
+		_quiescent_delta_vel.setZero();
+		_quiescent_delta_ang_dt = 0.0f;
+		_quiescent_delta_vel_dt = 0.0f;
+		_quiescent_frame_count = 0;
+	}
+
+	return imu;
 }
 
-void Ekf::predictState()
+void Ekf::predictState(const imuSample &imu)
 {
 	if (!_earth_rate_initialised) {
 		if (_NED_origin_initialised) {
@@ -305,11 +587,11 @@ void Ekf::predictState()
 	}
 
 	// apply imu bias corrections
-	Vector3f corrected_delta_ang = _imu_sample_delayed.delta_ang - _state.gyro_bias;
-	Vector3f corrected_delta_vel = _imu_sample_delayed.delta_vel - _state.accel_bias;
+	Vector3f corrected_delta_ang = imu.delta_ang - _state.gyro_bias;
+	Vector3f corrected_delta_vel = imu.delta_vel - _state.accel_bias;
 
 	// correct delta angles for earth rotation rate
-	corrected_delta_ang -= -_R_to_earth.transpose() * _earth_rate_NED * _imu_sample_delayed.delta_ang_dt;
+	corrected_delta_ang -= -_R_to_earth.transpose() * _earth_rate_NED * imu.delta_ang_dt;
 
 	// convert the delta angle to a delta quaternion
 	Quatf dq;
@@ -327,12 +609,16 @@ void Ekf::predictState()
 	// update transformation matrix from body to world frame
 	_R_to_earth = quat_to_invrotmat(_state.quat_nominal);
 
+	// prime the quaternion product cache consumed by the covariance
+	// prediction and the fusion observation jacobians
+	updateQuatProducts();
+
 	// Calculate an earth frame delta velocity
 	Vector3f corrected_delta_vel_ef = _R_to_earth * corrected_delta_vel;
 
 	// calculate a filtered horizontal acceleration with a 1 sec time constant
 	// this are used for manoeuvre detection elsewhere
-	float alpha = 1.0f - _imu_sample_delayed.delta_vel_dt;
+	float alpha = 1.0f - imu.delta_vel_dt;
 	_accel_lpf_NE(0) = _accel_lpf_NE(0) * alpha + corrected_delta_vel_ef(0);
 	_accel_lpf_NE(1) = _accel_lpf_NE(1) * alpha + corrected_delta_vel_ef(1);
 
@@ -340,15 +626,15 @@ void Ekf::predictState()
 	_state.vel += corrected_delta_vel_ef;
 
 	// compensate for acceleration due to gravity
-	_state.vel(2) += CONSTANTS_ONE_G * _imu_sample_delayed.delta_vel_dt;
+	_state.vel(2) += CONSTANTS_ONE_G * imu.delta_vel_dt;
 
 	// predict position states via trapezoidal integration of velocity
-	_state.pos += (vel_last + _state.vel) * _imu_sample_delayed.delta_vel_dt * 0.5f;
+	_state.pos += (vel_last + _state.vel) * imu.delta_vel_dt * 0.5f;
 
 	constrainStates();
 
 	// calculate an average filter update time
-	float input = 0.5f * (_imu_sample_delayed.delta_vel_dt + _imu_sample_delayed.delta_ang_dt);
+	float input = 0.5f * (imu.delta_vel_dt + imu.delta_ang_dt);
 
 	// filter and limit input between -50% and +100% of nominal value
 	input = math::constrain(input, 0.5f * FILTER_UPDATE_PERIOD_S, 2.0f * FILTER_UPDATE_PERIOD_S);
@@ -366,20 +652,65 @@ bool Ekf::collect_imu(const imuSample &imu)
 	_imu_down_sampled.delta_ang_dt += imu.delta_ang_dt;
 	_imu_down_sampled.delta_vel_dt += imu.delta_vel_dt;
 
-	// use a quaternion to accumulate delta angle data
-	// this quaternion represents the rotation from the start to end of the accumulation period
+	// fused downsampling kernel: one angle norm and one sincos serves both the
+	// quaternion accumulation and the rotation of the delta velocity data,
+	// replacing the quaternion construction, DCM conversion and two
+	// matrix-vector rotations of the per-sample scalar formulation
+	const float theta = imu.delta_ang.norm();
+
+	// delta quaternion for this sample, representing the rotation from the
+	// start to the end of the sample interval
 	Quatf delta_q;
-	delta_q.rotate(imu.delta_ang);
+	Vector3f axis;
+	float sin_theta = 0.0f;
+	float cos_theta = 1.0f;
+
+	if (theta > 1.0e-6f) {
+		axis = imu.delta_ang * (1.0f / theta);
+		float sin_half;
+		float cos_half;
+		fm::sincos(0.5f * theta, sin_half, cos_half);
+
+		// full angle terms for the delta velocity rotation via the double angle identities
+		sin_theta = 2.0f * sin_half * cos_half;
+		cos_theta = 1.0f - 2.0f * sin_half * sin_half;
+
+		delta_q(0) = cos_half;
+		delta_q(1) = axis(0) * sin_half;
+		delta_q(2) = axis(1) * sin_half;
+		delta_q(3) = axis(2) * sin_half;
+
+	} else {
+		// first order small angle approximation
+		delta_q(0) = 1.0f;
+		delta_q(1) = 0.5f * imu.delta_ang(0);
+		delta_q(2) = 0.5f * imu.delta_ang(1);
+		delta_q(3) = 0.5f * imu.delta_ang(2);
+	}
+
+	// this quaternion represents the rotation from the start to end of the accumulation period
 	_q_down_sampled = _q_down_sampled * delta_q;
 	_q_down_sampled.normalize();
 
-	// rotate the accumulated delta velocity data forward each time so it is always in the updated rotation frame
-	Dcmf delta_R(delta_q.inversed());
-	_imu_down_sampled.delta_vel = delta_R * _imu_down_sampled.delta_vel;
+	// rotate the accumulated delta velocity data forward so it is always in the updated
+	// rotation frame and accumulate the most recent delta velocity data at the updated
+	// rotation frame, assuming the effective sample time is halfway between the previous
+	// and current rotation frame:
+	// R(v_acc) + (v_new + R(v_new)) / 2 = R(v_acc + v_new / 2) + v_new / 2
+	// with the rotation applied directly using the Rodrigues formula
+	Vector3f half_vel_new = imu.delta_vel * 0.5f;
+	Vector3f vec = _imu_down_sampled.delta_vel + half_vel_new;
+	Vector3f rotated;
 
-	// accumulate the most recent delta velocity data at the updated rotation frame
-	// assume effective sample time is halfway between the previous and current rotation frame
-	_imu_down_sampled.delta_vel += (imu.delta_vel + delta_R * imu.delta_vel) * 0.5f;
+	if (theta > 1.0e-6f) {
+		rotated = vec * cos_theta - cross_product(axis, vec) * sin_theta
+			  + axis * (axis * vec) * (1.0f - cos_theta);
+
+	} else {
+		rotated = vec - cross_product(imu.delta_ang, vec);
+	}
+
+	_imu_down_sampled.delta_vel = rotated + half_vel_new;
 
 	// if the target time delta between filter prediction steps has been exceeded
 	// write the accumulated IMU data to the ring buffer
@@ -513,14 +844,25 @@ void Ekf::calculateOutputStates()
 		_vel_imu_rel_body_ned = _R_to_earth_now * vel_imu_rel_body;
 	}
 
+	// apply any staged low latency observation directly at the current time horizon
+	fuseAuxVelDirect();
+
 	// store the INS states in a ring buffer with the same length and time coordinates as the IMU data buffer
 	if (_imu_updated) {
-		_output_buffer.push(_output_new);
+		// the velocity and position states are stored without the accumulated corrections
+		// which are applied when samples are retrieved from the buffer. This allows each
+		// correction to be applied to the whole state history in constant time.
+		outputSample output_uncorrected = _output_new;
+		output_uncorrected.vel -= _output_vel_correction;
+		output_uncorrected.pos -= _output_pos_correction;
+		_output_buffer.push(output_uncorrected);
 		_output_vert_buffer.push(_output_vert_new);
 
 		// get the oldest INS state data from the ring buffer
 		// this data will be at the EKF fusion time horizon
 		_output_sample_delayed = _output_buffer.get_oldest();
+		_output_sample_delayed.vel += _output_vel_correction;
+		_output_sample_delayed.pos += _output_pos_correction;
 		_output_vert_delayed = _output_vert_buffer.get_oldest();
 
 		// calculate the quaternion delta between the INS and EKF quaternions at the EKF fusion time horizon
@@ -639,20 +981,111 @@ void Ekf::calculateOutputStates()
 			_pos_err_integ += pos_err;
 			const Vector3f pos_correction = pos_err * pos_gain + _pos_err_integ * sq(pos_gain) * 0.1f;
 
-			// loop through the output filter state history and apply the corrections to the velocity and position states
-			for (uint8_t index = 0; index < _output_buffer.get_length(); index++) {
-				// a constant velocity correction is applied
-				_output_buffer[index].vel += vel_correction;
+			// the same correction is applied to every buffered state so instead of
+			// rewriting the state history each update, accumulate the corrections and
+			// apply them when samples are retrieved from the buffer
+			_output_vel_correction += vel_correction;
+			_output_pos_correction += pos_correction;
+
+			// periodically fold the accumulated corrections into the stored history to
+			// prevent a loss of precision when they become large relative to the
+			// resolution of the stored states
+			if (_output_vel_correction.norm_squared() > sq(1.0f) || _output_pos_correction.norm_squared() > sq(1.0f)) {
+				for (uint8_t index = 0; index < _output_buffer.get_length(); index++) {
+					_output_buffer[index].vel += _output_vel_correction;
+					_output_buffer[index].pos += _output_pos_correction;
+				}
 
-				// a constant position correction is applied
-				_output_buffer[index].pos += pos_correction;
+				_output_vel_correction.setZero();
+				_output_pos_correction.setZero();
 			}
 
 			// update output state to corrected values
 			_output_new = _output_buffer.get_newest();
+			_output_new.vel += _output_vel_correction;
+			_output_new.pos += _output_pos_correction;
+		}
+	}
+}
+
+/*
+ * Fuse a staged auxiliary velocity observation directly into the output predictor
+ * velocity states at the current time horizon. Sensors selected for this path skip
+ * the delay horizon buffer round trip, which removes the FILTER_UPDATE_PERIOD_MS
+ * plus sensor delay latency from the correction. The complementary filter feedback
+ * keeps the output states consistent with the EKF solution at the tracking time
+ * constant, so a direct correction decays unless it is confirmed by the delayed
+ * horizon aiding sources.
+*/
+void Ekf::fuseAuxVelDirect()
+{
+	if (!_auxvel_direct_ready) {
+		return;
+	}
+
+	_auxvel_direct_ready = false;
+
+	// apply the same aiding source requirement as the delayed time horizon fusion
+	const bool primary_aiding = _control_status.flags.gps || _control_status.flags.ev_pos
+				    || _control_status.flags.opt_flow;
+
+	if (!primary_aiding) {
+		return;
+	}
+
+	for (unsigned i = 0; i < 2; i++) {
+		// the delayed horizon velocity variance is the best available proxy for the
+		// output state uncertainty
+		const float vel_var = P[4 + i][4 + i];
+		const float obs_var = fmaxf(_auxvel_direct_sample.velVarNE(i), sq(_params.auxvel_noise));
+		const float innov = _output_new.vel(i) - _auxvel_direct_sample.velNE(i);
+		const float innov_var = vel_var + obs_var;
+
+		_aux_vel_innov[i] = innov;
+
+		// innovation consistency check
+		if (sq(innov) > sq(_params.auxvel_gate) * innov_var) {
+			continue;
 		}
+
+		// correct the current horizon velocity state only. The correction is folded
+		// into the stored output history when the next sample is pushed.
+		_output_new.vel(i) -= innov * (vel_var / innov_var);
+	}
+}
+
+#ifdef EKF_INSTRUMENTATION
+void Ekf::perfUpdate(uint8_t section, uint64_t start_time)
+{
+	const uint64_t elapsed_us = ecl_absolute_time() - start_time;
+	perfCounter &counter = _perf_counters[section];
+
+	if (counter.count == 0 || elapsed_us < counter.min_us) {
+		counter.min_us = (uint32_t)elapsed_us;
+	}
+
+	if (elapsed_us > counter.max_us) {
+		counter.max_us = (uint32_t)elapsed_us;
+	}
+
+	counter.count++;
+	counter.total_us += elapsed_us;
+}
+
+void Ekf::get_perf_counters(perfCounter counters[PERF_SECTION_COUNT]) const
+{
+	for (unsigned i = 0; i < PERF_SECTION_COUNT; i++) {
+		counters[i] = _perf_counters[i];
+	}
+}
+
+void Ekf::reset_perf_counters()
+{
+	for (unsigned i = 0; i < PERF_SECTION_COUNT; i++) {
+		_perf_counters[i] = {};
 	}
 }
+#endif
 
 /*
  * Predict the previous quaternion output state forward using the latest IMU delta angle data.
@@ -40,7 +40,13 @@
  *
  */
 
+#pragma once
+
 #include "estimator_interface.h"
+#include "gps_quality.h"
+#include "Seqlock.h"
+
+struct checkpointCursor;
 
 class Ekf : public EstimatorInterface
 {
@@ -55,6 +61,17 @@ public:
 	// should be called every time new data is pushed into the filter
 	bool update();
 
+	// sliced alternative to update() which bounds the execution time of each call.
+	// The output predictor always runs so the caller sees fresh output states, then
+	// pending filter phases (state prediction, covariance prediction, fusion control,
+	// terrain estimation) are run until the time budget is exhausted, carrying the
+	// remainder over to the next call. At least one pending phase runs per call, so a
+	// budget of zero runs exactly one phase per call. A filter update spreads over up
+	// to four calls and should complete within one FILTER_UPDATE_PERIOD_MS, so call
+	// this at least four times faster than the downsampled prediction rate.
+	// returns true on the call that completes a filter update
+	bool update_sliced(uint64_t time_budget_us);
+
 	// gets the innovations of velocity and position measurements
 	// 0-2 vel, 3-5 pos
 	void get_vel_pos_innov(float vel_pos_innov[6]);
@@ -123,6 +140,23 @@ public:
 	// get the diagonal elements of the covariance matrix
 	void get_covariances(float *covariances);
 
+	// select the off diagonal covariance entries exported by get_covariances_compact()
+	// pairs holds num_pairs state index pairs; invalid or duplicate diagonal pairs are dropped
+	void set_covariance_record_pairs(const uint8_t (*pairs)[2], uint8_t num_pairs);
+
+	// fill a compact quantized covariance record in a single pass - see
+	// ekfCovarianceRecord in common.h for the encoding
+	void get_covariances_compact(ekfCovarianceRecord *rec);
+
+	// fill a packed snapshot of the filter outputs in a single pass, replacing
+	// the need to call the individual getters when publishing every cycle
+	void get_snapshot(ekfSnapshot *snap);
+
+	// copy the snapshot most recently committed by update() without taking any
+	// lock, so telemetry and logging threads never contend with the filter thread.
+	// Returns false until the first update has been published.
+	bool get_published_snapshot(ekfSnapshot *snap) const { return _published_snapshot.read(snap); }
+
 	// ask estimator for sensor data collection decision and do any preprocessing if required, returns true if not defined
 	bool collect_gps(uint64_t time_usec, struct gps_message *gps);
 
@@ -192,6 +226,10 @@ public:
 	// get the estimated terrain vertical position relative to the NED origin
 	void get_terrain_vert_pos(float *ret);
 
+	// copy the per zone terrain profile under a multi-zone rangefinder footprint
+	// into ret (up to RNG_MAX_ZONES entries) and return the number of valid zones
+	uint8_t get_terrain_profile(float *ret);
+
 	// get the accerometer bias in m/s/s
 	void get_accel_bias(float bias[3]);
 
@@ -244,9 +282,33 @@ public:
 	// use the latest IMU data at the current time horizon.
 	Quatf calculate_quaternion() const;
 
+	// return the number of bytes a checkpoint of the current filter state occupies
+	// the size varies with the buffer fill levels so it must be queried per checkpoint
+	size_t checkpoint_size();
+
+	// serialize the complete filter state into the caller provided buffer so a
+	// replacement instance can resume from it without re-converging, see checkpoint.h
+	// returns false when the buffer is too small
+	bool save_checkpoint(uint8_t *buffer, size_t buffer_size);
+
+	// restore the filter state from a checkpoint image saved by an instance that was
+	// initialised with the same parameters, see checkpoint.h
+	// returns false and leaves the filter requiring a normal init() when the image is
+	// incompatible or truncated
+	bool restore_checkpoint(const uint8_t *buffer, size_t buffer_size);
+
+#ifdef EKF_INSTRUMENTATION
+	// copy the execution time statistics recorded for each section of the filter update
+	void get_perf_counters(perfCounter counters[PERF_SECTION_COUNT]) const;
+
+	// reset the recorded execution time statistics
+	void reset_perf_counters();
+#endif
+
 private:
 
-	static constexpr uint8_t _k_num_states{24};		///< number of EKF states
+	static constexpr uint8_t _k_num_states{EKF_NUM_STATES};	///< number of active EKF states
+	static constexpr uint8_t _k_max_num_states{24};		///< dimension of the covariance storage which is fixed by the autogenerated equations
 
 	struct {
 		uint8_t velNE_counter;	///< number of horizontal position reset events (allow to wrap if count exceeds 255)
@@ -267,6 +329,23 @@ private:
 	stateSample _state{};		///< state struct of the ekf running at the delayed time horizon
 
 	bool _filter_initialised{false};	///< true when the EKF sttes and covariances been initialised
+
+	uint8_t _update_phase{0};	///< next pending phase of a sliced filter update (0 = start a new update)
+
+	// quiescent scheduling: when the vehicle is at rest on the ground the prediction and
+	// fusion stages only run on every _k_quiescent_decimation-th downsampled IMU frame,
+	// with the skipped frames' bias corrected deltas accumulated so the deferred
+	// prediction integrates the full interval. The output predictor is unaffected and
+	// keeps running at full rate
+	static constexpr uint8_t _k_quiescent_decimation{4};	///< ratio of downsampled IMU frames to filter updates when quiescent
+	uint8_t _quiescent_frame_count{0};	///< downsampled frames accumulated since the last full update
+	Vector3f _quiescent_delta_ang;		///< bias corrected delta angle accumulated over deferred quiescent frames (rad)
+	Vector3f _quiescent_delta_vel;		///< bias corrected delta velocity accumulated over deferred quiescent frames (m/sec)
+	float _quiescent_delta_ang_dt{0.0f};	///< integration period of _quiescent_delta_ang (sec)
+	float _quiescent_delta_vel_dt{0.0f};	///< integration period of _quiescent_delta_vel (sec)
+	uint64_t _quiescent_frame_us{0};	///< timestamp of the last downsampled frame seen by the quiescent scheduler (uSec)
+	imuSample _imu_sample_prediction{};	///< delayed IMU sample with deferred deltas folded in, driving the prediction phases
+
 	bool _earth_rate_initialised{false};	///< true when we know the earth rotatin rate (requires GPS)
 
 	bool _fuse_height{false};	///< true when baro height data should be fused
@@ -338,7 +417,7 @@ private:
 	float _last_static_yaw{0.0f};		///< last yaw angle recorded when on ground motion checks were passing (rad)
 	bool _vehicle_at_rest_prev{false};	///< true when the vehicle was at rest the previous time the status was checked
 
-	float P[_k_num_states][_k_num_states] {};	///< state covariance matrix
+	float P[_k_max_num_states][_k_max_num_states] {};	///< state covariance matrix
 
 	float _vel_pos_innov[6] {};	///< NED velocity and position innovations: 0-2 vel (m/sec),  3-5 pos (m)
 	float _vel_pos_innov_var[6] {};	///< NED velocity and position innovation variances: 0-2 vel ((m/sec)**2), 3-5 pos (m**2)
@@ -378,15 +457,12 @@ private:
 	Quatf _q_down_sampled;		///< down sampled quaternion (tracking delta angles between ekf update steps)
 	Vector3f _vel_err_integ;	///< integral of velocity tracking error (m)
 	Vector3f _pos_err_integ;	///< integral of position tracking error (m.s)
+	Vector3f _output_vel_correction;	///< accumulated velocity correction not yet folded into the stored output buffer states (m/s)
+	Vector3f _output_pos_correction;	///< accumulated position correction not yet folded into the stored output buffer states (m)
 	float _output_tracking_error[3] {}; ///< contains the magnitude of the angle, velocity and position track errors (rad, m/s, m)
 
 	// variables used for the GPS quality checks
-	float _gpsDriftVelN{0.0f};		///< GPS north position derivative (m/sec)
-	float _gpsDriftVelE{0.0f};		///< GPS east position derivative (m/sec)
-	float _gps_drift_velD{0.0f};		///< GPS down position derivative (m/sec)
-	float _gps_velD_diff_filt{0.0f};	///< GPS filtered Down velocity (m/sec)
-	float _gps_velN_filt{0.0f};		///< GPS filtered North velocity (m/sec)
-	float _gps_velE_filt{0.0f};		///< GPS filtered East velocity (m/sec)
+	GpsQualityChecks _gps_quality;		///< self-contained GPS quality check stage holding the drift filter states
 	uint64_t _last_gps_fail_us{0};		///< last system time in usec that the GPS failed it's checks
 	uint64_t _last_gps_pass_us{0};		///< last system time in usec that the GPS passed it's checks
 	float _gps_error_norm{1.0f};		///< normalised gps error
@@ -403,6 +479,20 @@ private:
 	uint64_t _time_last_mag{0};		///< measurement time of last magnetomter sample (uSec)
 	Vector3f _mag_filt_state;		///< filtered magnetometer measurement (Gauss)
 	Vector3f _delVel_sum;			///< summed delta velocity (m/sec)
+
+	// batch accumulators used by the fast alignment startup path
+	static constexpr uint8_t _k_fast_align_min_imu{25};	///< downsampled IMU samples required before fast alignment
+	static constexpr uint8_t _k_fast_align_min_obs{5};	///< magnetometer and baro samples required before fast alignment
+
+	struct {
+		Vector3f mag_sum;		///< summed magnetometer measurements (Gauss)
+		float baro_sum{0.0f};		///< summed baro height measurements (m)
+		uint8_t imu_count{0};		///< number of delta velocity samples summed
+		uint8_t mag_count{0};		///< number of magnetometer samples summed
+		uint8_t baro_count{0};		///< number of baro samples summed
+		uint64_t last_mag_us{0};	///< timestamp of the last magnetometer sample summed (uSec)
+		uint64_t last_baro_us{0};	///< timestamp of the last baro sample summed (uSec)
+	} _fast_align;
 	float _hgt_sensor_offset{0.0f};		///< set as necessary if desired to maintain the same height after a height reset (m)
 	float _baro_hgt_offset{0.0f};		///< baro height reading at the local NED origin (m)
 
@@ -427,6 +517,8 @@ private:
 	// Terrain height state estimation
 	float _terrain_vpos{0.0f};		///< estimated vertical position of the terrain underneath the vehicle in local NED frame (m)
 	float _terrain_var{1e4f};		///< variance of terrain position estimate (m**2)
+	float _terrain_profile_vpos[RNG_MAX_ZONES] {};	///< low pass filtered per zone terrain vertical position under the sensor footprint (m)
+	uint8_t _terrain_profile_len{0};	///< number of valid entries in _terrain_profile_vpos
 	float _hagl_innov{0.0f};		///< innovation of the last height above terrain measurement (m)
 	float _hagl_innov_var{0.0f};		///< innovation variance for the last height above terrain measurement (m**2)
 	uint64_t _time_last_hagl_fuse{0};		///< last system time that the hagl measurement failed it's checks (uSec)
@@ -457,21 +549,51 @@ private:
 	float _rng_stuck_min_val{0.0f};		///< minimum value for new rng measurement when being stuck
 	float _rng_stuck_max_val{0.0f};		///< maximum value for new rng measurement when being stuck
 
+#ifdef EKF_INSTRUMENTATION
+	perfCounter _perf_counters[PERF_SECTION_COUNT] {};	///< execution time statistics for each timed section of the filter update
+
+	// record the execution time of a timed section given the time at which it started
+	void perfUpdate(uint8_t section, uint64_t start_time);
+#endif
+
 	// update the real time complementary filter states. This includes the prediction
 	// and the correction step
 	void calculateOutputStates();
 
+	// fuse a staged auxiliary velocity observation directly into the output
+	// predictor states at the current time horizon, bypassing the delay horizon
+	// buffer round trip
+	void fuseAuxVelDirect();
+
 	// initialise filter states of both the delayed ekf and the real time complementary filter
 	bool initialiseFilter(void);
 
+	// fast alignment startup path that seeds the filter from a short batch
+	// average of the newest sensor samples, enabled by the fast_align parameter
+	bool initialiseFilterFast();
+
+	// seed the states and covariance matrix from the accumulated tilt, heading
+	// and height alignment data and reset the output predictor history to match
+	bool initialiseStatesAndCovariance();
+
 	// initialise ekf covariance matrix
 	void initialiseCovariance();
 
-	// predict ekf state
-	void predictState();
+	// predict ekf state using the supplied IMU sample
+	void predictState(const imuSample &imu);
 
-	// predict ekf covariance
-	void predictCovariance();
+	// returns true when the current downsampled IMU frame should be deferred because the
+	// vehicle is quiescent, accumulating its deltas for the next full update. Each frame
+	// is accumulated at most once even when update() is called repeatedly before the
+	// next IMU push
+	bool quiescentFrameSkip();
+
+	// returns the delayed IMU sample with any deltas deferred while quiescent folded
+	// in, consuming the accumulators and leaving the delayed sample itself untouched
+	imuSample quiescentCombinedSample();
+
+	// predict ekf covariance using the supplied IMU sample
+	void predictCovariance(const imuSample &imu);
 
 	// ekf sequential fusion of magnetometer measurements
 	void fuseMag();
@@ -491,6 +613,138 @@ private:
 	// fuse body frame drag specific forces for multi-rotor wind estimation
 	void fuseDrag();
 
+#ifndef EKF_NO_WIND_STATES
+	// wind relative kinematics shared by the airspeed, sideslip and drag fusions.
+	// The block is recomputed only when the states it derives from have changed,
+	// so fusions running back to back in one update cycle share one evaluation.
+	struct {
+		Quatf quat;		///< quaternion state snapshot the block was computed from
+		Vector3f vel;		///< velocity state snapshot the block was computed from (m/s)
+		Vector2f wind_vel;	///< wind velocity state snapshot the block was computed from (m/s)
+		Vector3f rel_wind_earth;	///< velocity relative to the wind in earth frame (m/s)
+		Vector3f rel_wind_body;		///< velocity relative to the wind in body frame (m/s)
+		float R_bx_n{0.0f};	///< projection of the body X axis onto north: q0^2 + q1^2 - q2^2 - q3^2
+		float R_bx_e{0.0f};	///< projection of the body X axis onto east: 2*(q0*q3 + q1*q2)
+		float vel_partial[4] {};	///< common partials of the body frame relative wind wrt the quaternion states
+		bool valid{false};
+	} _wind_rel_kin;
+
+	// refresh _wind_rel_kin if the states it derives from changed since the last call
+	void updateWindRelKinematics();
+#endif
+
+	// quaternion element products shared by the covariance prediction and the
+	// fusion observation jacobians - primed once per cycle by predictState()
+	// and refreshed lazily if a fusion corrects the quaternion in between
+	struct {
+		Quatf quat;	///< quaternion state snapshot the products were computed from
+		float q0q0{0.0f};	///< sq(q0)
+		float q1q1{0.0f};	///< sq(q1)
+		float q2q2{0.0f};	///< sq(q2)
+		float q3q3{0.0f};	///< sq(q3)
+		float q0q1{0.0f};	///< q0*q1
+		float q0q2{0.0f};	///< q0*q2
+		float q0q3{0.0f};	///< q0*q3
+		float q1q2{0.0f};	///< q1*q2
+		float q1q3{0.0f};	///< q1*q3
+		float q2q3{0.0f};	///< q2*q3
+		bool valid{false};
+	} _quat_prod;
+
+	// refresh _quat_prod if the quaternion states changed since the last call
+	void updateQuatProducts();
+
+	// Euler sequence the heading fusion observation model is linearised about.
+	// true selects a 321 (yaw-pitch-roll) sequence, false a 312 (yaw-roll-pitch)
+	// sequence. Refreshed with hysteresis by selectYawObservationSequence() so
+	// the linearisation only changes when the attitude moves decisively between
+	// regimes instead of being re-selected by every fusion
+	bool _yaw_obs_seq_321{true};
+
+	// re-select between the 321 and 312 Euler sequences used by fuseHeading()
+	void selectYawObservationSequence();
+
+	// configuration derived from the tuning parameters (floored gate sizes,
+	// squared noises) used on the per cycle control paths. The parameters are
+	// owned by the host through getParamHandle() and can change at any time,
+	// so controlFusionModes() detects a change by comparing against the
+	// snapshot and re-derives the block once per change instead of
+	// re-deriving the values on every update cycle
+	struct {
+		parameters snapshot{};			///< parameter values the block was derived from
+		float vel_innov_gate{1.0f};		///< vel_innov_gate floored to 1
+		float posNE_innov_gate{1.0f};		///< posNE_innov_gate floored to 1
+		float ev_innov_gate{1.0f};		///< ev_innov_gate floored to 1
+		float baro_noise_sq{0.0f};		///< sq(baro_noise)
+		float baro_innov_gate_sq{1.0f};		///< sq(baro_innov_gate)
+		float range_aid_innov_gate_sq{1.0f};	///< sq(range_aid_innov_gate)
+		float vert_innov_test_lim_quad{0.0f};	///< sq(sq(vert_innov_test_lim))
+		float pos_noaid_noise_floor{0.0f};	///< pos_noaid_noise floored by gps_pos_noise
+
+		// observation variances and gate sizes read by the fusion routines
+		float gps_vel_noise_floor{0.01f};	///< gps_vel_noise floored to 0.01
+		float gps_pos_noise_floor{0.01f};	///< gps_pos_noise floored to 0.01
+		float pos_noaid_noise_upper{0.01f};	///< pos_noaid_noise floored by gps_pos_noise_floor
+		float baro_obs_var{0.0f};		///< sq(baro_noise floored to 0.01)
+		float baro_innov_gate_fl{1.0f};		///< baro_innov_gate floored to 1
+		float range_noise_sq{0.0f};		///< sq(range_noise)
+		float range_innov_gate_fl{1.0f};	///< range_innov_gate floored to 1
+		float mag_obs_var{0.0f};		///< sq(mag_noise floored to 0)
+		float mag_innov_gate_sq{1.0f};		///< sq(mag_innov_gate floored to 1)
+		float mag_heading_obs_var{0.0f};	///< sq(mag_heading_noise floored to 0.01)
+		float heading_innov_gate_fl{1.0f};	///< heading_innov_gate floored to 1
+		float eas_noise_limited{0.5f};		///< eas_noise constrained to [0.5, 5]
+		float tas_innov_gate_sq{1.0f};		///< sq(tas_innov_gate floored to 1)
+
+		bool valid{false};
+	} _derived_params;
+
+	// re-derive _derived_params if the parameter struct contents changed since the last call
+	void updateDerivedParams();
+
+	// derived accuracy and status outputs cached across getter calls. Several
+	// consumers poll the getters every cycle, so the sqrt-of-variance and
+	// dead-reckoning terms are computed once per filter update: the generation
+	// counter is bumped whenever an update changes the states and the first
+	// getter call of a new generation refreshes the whole block
+	struct {
+		uint32_t generation{0};		///< value of _update_generation the block was derived from
+		float gpos_eph{0.0f};		///< 1-sigma horizontal WGS-84 position uncertainty (m)
+		float gpos_epv{0.0f};		///< 1-sigma vertical WGS-84 position uncertainty (m)
+		float lpos_eph{0.0f};		///< 1-sigma horizontal local position uncertainty (m)
+		float lpos_epv{0.0f};		///< 1-sigma vertical local position uncertainty (m)
+		float vel_evh{0.0f};		///< 1-sigma horizontal velocity uncertainty (m/s)
+		float vel_evv{0.0f};		///< 1-sigma vertical velocity uncertainty (m/s)
+		uint16_t soln_status{0};	///< bitmask describing which state estimates are valid
+	} _derived_outputs;
+
+	uint32_t _update_generation{1};	///< incremented whenever a filter update or restore changes the states
+
+	// state index pairs whose correlation coefficients are exported by
+	// get_covariances_compact(), defaulting to the attitude to gyro bias and
+	// velocity to position couplings used by post flight analysis
+	uint8_t _cov_record_pairs[ekfCovarianceRecord::MAX_CORRELATION_PAIRS][2] = {
+		{0, 10}, {1, 11}, {2, 12}, {4, 7}, {5, 8}, {6, 9}
+	};
+	uint8_t _cov_record_num_pairs{6};
+
+	// size of the concrete object for the memory accounting report
+	size_t objectSize() const override { return sizeof(*this); }
+
+	// output snapshot published at the end of each update() call. The sequence
+	// counter lets other threads retry-copy it lock free, so no mutex is shared
+	// between the filter deadline and the consumers
+	Seqlock<ekfSnapshot> _published_snapshot;
+
+	// commit a consistent copy of the outputs for lock free readers
+	void publishSnapshot();
+
+	// recompute the cached derived accuracy and status outputs
+	void refreshDerivedOutputs();
+
+	// recompute the solution status bitmask for the cached derived outputs
+	void refreshSolutionStatus();
+
 	// fuse velocity and position measurements (also barometer height)
 	void fuseVelPosHeight();
 
@@ -547,7 +801,7 @@ private:
 	void fixCovarianceErrors();
 
 	// make ekf covariance matrix symmetric between a nominated state indexe range
-	void makeSymmetrical(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last);
+	void makeSymmetrical(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last);
 
 	// constrain the ekf states
 	void constrainStates();
@@ -556,6 +810,15 @@ private:
 	// and a scalar innovation value
 	void fuse(float *K, float innovation);
 
+	// fuse a block of up to six observations that each directly observe a single state
+	// using a single gain calculation and a single covariance update
+	// returns false without modifying states or covariances if the update is unhealthy
+	bool fuseStateBlock(const uint8_t *state_index, const float *innovation, const float *R, uint8_t n_obs);
+
+	// invert a symmetric matrix of dimension size occupying the top left corner of A
+	// returns false if the matrix is singular or badly conditioned
+	bool inverseSymmetric(const float (&A)[6][6], float (&A_inv)[6][6], uint8_t size) const;
+
 	// calculate the earth rotation vector from a given latitude
 	void calcEarthRateNED(Vector3f &omega, float lat_rad) const;
 
@@ -626,22 +889,24 @@ private:
 	void setControlEVHeight();
 
 	// zero the specified range of rows in the state covariance matrix
-	void zeroRows(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last);
+	void zeroRows(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last);
 
 	// zero the specified range of columns in the state covariance matrix
-	void zeroCols(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last);
+	void zeroCols(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last);
+
+	// zero the specified range of rows and columns in the state covariance matrix
+	// in one fused pass, avoiding the duplicate stores of separate
+	// zeroRows() and zeroCols() calls
+	void zeroRowsCols(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last);
 
 	// zero the specified range of off diagonals in the state covariance matrix
-	void zeroOffDiag(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last);
+	void zeroOffDiag(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last);
 
 	// zero the specified range of off diagonals in the state covariance matrix
 	// set the diagonals to the supplied value
-	void setDiag(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last, float variance);
+	void setDiag(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last, float variance);
 
-	// calculate the measurement variance for the optical flow sensor
-	float calcOptFlowMeasVar();
-
-	// rotate quaternion covariances into variances for an equivalent rotation vector
+// rotate quaternion covariances into variances for an equivalent rotation vector
 	Vector3f calcRotVecVariances();
 
 	// initialise the quaternion covariances using rotation vector variances
@@ -659,4 +924,8 @@ private:
 	// check that the range finder data is continuous
 	void checkRangeDataContinuity();
 
+	// apply the checkpoint cursor to every serialized filter field, shared by
+	// the size query, save and restore paths
+	void checkpointFields(checkpointCursor &cursor);
+
 };
@@ -43,8 +43,11 @@
 
 #include <ecl.h>
 #include <mathlib/mathlib.h>
+#include <mathlib/kalman_kernels.h>
 #include <cstdlib>
 
+namespace kf = ecl::kalman;
+
 // Reset the velocity states. If we have a recent and valid
 // gps measurement then use for velocity initialisation
 bool Ekf::resetVelocity()
@@ -89,11 +92,10 @@ bool Ekf::resetVelocity()
 		}
 
 		// reset the velocity covariance terms
-		zeroRows(P, 4, 5);
-		zeroCols(P, 4, 5);
+		zeroRowsCols(P, 4, 5);
 
 		// reset the horizontal velocity variance using the optical flow noise variance
-		P[5][5] = P[4][4] = sq(range) * calcOptFlowMeasVar();
+		P[5][5] = P[4][4] = sq(range) * _flow_sample_delayed.losVar;
 
 	} else if (_control_status.flags.ev_pos) {
 		_state.vel.setZero();
@@ -169,8 +171,7 @@ bool Ekf::resetPosition()
 		}
 
 		// estimate is relative to initial positon in this mode, so we start with zero error.
-		zeroCols(P,7,8);
-		zeroRows(P,7,8);
+		zeroRowsCols(P, 7, 8);
 
 	} else {
 		// Used when falling back to non-aiding mode of operation
@@ -227,8 +228,7 @@ void Ekf::resetHeight()
 			_state.pos(2) = new_pos_down;
 
 			// reset the associated covariance values
-			zeroRows(P, 9, 9);
-			zeroCols(P, 9, 9);
+			zeroRowsCols(P, 9, 9);
 
 			// the state variance is the same as the observation
 			P[9][9] = sq(_params.range_noise);
@@ -252,8 +252,7 @@ void Ekf::resetHeight()
 			_state.pos(2) = _hgt_sensor_offset - baro_newest.hgt + _baro_hgt_offset;
 
 			// reset the associated covariance values
-			zeroRows(P, 9, 9);
-			zeroCols(P, 9, 9);
+			zeroRowsCols(P, 9, 9);
 
 			// the state variance is the same as the observation
 			P[9][9] = sq(_params.baro_noise);
@@ -270,8 +269,7 @@ void Ekf::resetHeight()
 			_state.pos(2) = _hgt_sensor_offset - gps_newest.hgt + _gps_alt_ref;
 
 			// reset the associated covarince values
-			zeroRows(P, 9, 9);
-			zeroCols(P, 9, 9);
+			zeroRowsCols(P, 9, 9);
 
 			// the state variance is the same as the observation
 			P[9][9] = sq(gps_newest.hacc);
@@ -306,8 +304,7 @@ void Ekf::resetHeight()
 	}
 
 	// reset the vertical velocity covariance values
-	zeroRows(P, 6, 6);
-	zeroCols(P, 6, 6);
+	zeroRowsCols(P, 6, 6);
 
 	// reset the vertical velocity state
 	if (_control_status.flags.gps && (_time_last_imu - gps_newest.time_us < 2 * GPS_MAX_INTERVAL)) {
@@ -405,7 +402,7 @@ bool Ekf::realignYawGPS()
 
 	if ((gpsSpeed > 5.0f) && (_gps_sample_delayed.sacc < (0.15f * gpsSpeed))) {
 		// check for excessive GPS velocity innovations
-		bool badVelInnov = ((_vel_pos_test_ratio[0] > 1.0f) || (_vel_pos_test_ratio[1] > 1.0f)) && _control_status.flags.gps;
+		bool badVelInnov = ((_innov_monitor.ratio.vel_pos[0] > 1.0f) || (_innov_monitor.ratio.vel_pos[1] > 1.0f)) && _control_status.flags.gps;
 
 		// calculate GPS course over ground angle
 		float gpsCOG = atan2f(_gps_sample_delayed.vel(1), _gps_sample_delayed.vel(0));
@@ -488,8 +485,7 @@ bool Ekf::realignYawGPS()
 			initialiseQuatCovariances(angle_err_var_vec);
 
 			// reset the corresponding rows and columns in the covariance matrix and set the variances on the magnetic field states to the measurement variance
-			zeroRows(P, 16, 21);
-			zeroCols(P, 16, 21);
+			zeroRowsCols(P, 16, 21);
 
 			for (uint8_t index = 16; index <= 21; index ++) {
 				P[index][index] = sq(_params.mag_noise);
@@ -522,8 +518,7 @@ bool Ekf::realignYawGPS()
 			_state.mag_I = _R_to_earth * _mag_sample_delayed.mag;
 
 			// reset the corresponding rows and columns in the covariance matrix and set the variances on the magnetic field states to the measurement variance
-			zeroRows(P, 16, 21);
-			zeroCols(P, 16, 21);
+			zeroRowsCols(P, 16, 21);
 
 			for (uint8_t index = 16; index <= 21; index ++) {
 				P[index][index] = sq(_params.mag_noise);
@@ -663,8 +658,7 @@ bool Ekf::resetMagHeading(Vector3f &mag_init)
 	_state.mag_I = _R_to_earth_after * mag_init;
 
 	// reset the corresponding rows and columns in the covariance matrix and set the variances on the magnetic field states to the measurement variance
-	zeroRows(P, 16, 21);
-	zeroCols(P, 16, 21);
+	zeroRowsCols(P, 16, 21);
 
 	for (uint8_t index = 16; index <= 21; index ++) {
 		P[index][index] = sq(_params.mag_noise);
@@ -767,13 +761,13 @@ void Ekf::calcMagDeclination()
 }
 
 // This function forces the covariance matrix to be symmetric
-void Ekf::makeSymmetrical(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last)
+// The upper triangle is treated as the reference copy because all covariance
+// updates write the upper triangle and mirror it into the lower triangle
+void Ekf::makeSymmetrical(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last)
 {
 	for (unsigned row = first; row <= last; row++) {
 		for (unsigned column = 0; column < row; column++) {
-			float tmp = (cov_mat[row][column] + cov_mat[column][row]) / 2;
-			cov_mat[row][column] = tmp;
-			cov_mat[column][row] = tmp;
+			cov_mat[row][column] = cov_mat[column][row];
 		}
 	}
 }
@@ -813,6 +807,101 @@ void Ekf::constrainStates()
 	}
 }
 
+#ifndef EKF_NO_WIND_STATES
+void Ekf::updateWindRelKinematics()
+{
+	// reuse the cached block if the states it derives from are unchanged - the
+	// comparison is exact because any state correction between fusions must
+	// force a recompute for the consumers to stay consistent
+	bool unchanged = _wind_rel_kin.valid;
+
+	for (int i = 0; i < 4; i++) {
+		unchanged = unchanged && (_wind_rel_kin.quat(i) == _state.quat_nominal(i));
+	}
+
+	for (int i = 0; i < 3; i++) {
+		unchanged = unchanged && (_wind_rel_kin.vel(i) == _state.vel(i));
+	}
+
+	for (int i = 0; i < 2; i++) {
+		unchanged = unchanged && (_wind_rel_kin.wind_vel(i) == _state.wind_vel(i));
+	}
+
+	if (unchanged) {
+		return;
+	}
+
+	const float q0 = _state.quat_nominal(0);
+	const float q1 = _state.quat_nominal(1);
+	const float q2 = _state.quat_nominal(2);
+	const float q3 = _state.quat_nominal(3);
+
+	// relative wind velocity in earth frame
+	_wind_rel_kin.rel_wind_earth(0) = _state.vel(0) - _state.wind_vel(0);
+	_wind_rel_kin.rel_wind_earth(1) = _state.vel(1) - _state.wind_vel(1);
+	_wind_rel_kin.rel_wind_earth(2) = _state.vel(2);
+
+	// rotate into body axes
+	Dcmf earth_to_body(_state.quat_nominal);
+	earth_to_body = earth_to_body.transpose();
+	_wind_rel_kin.rel_wind_body = earth_to_body * _wind_rel_kin.rel_wind_earth;
+
+	const float u = _wind_rel_kin.rel_wind_earth(0);
+	const float v = _wind_rel_kin.rel_wind_earth(1);
+	const float w = _wind_rel_kin.rel_wind_earth(2);
+
+	_wind_rel_kin.R_bx_n = sq(q0) + sq(q1) - sq(q2) - sq(q3);
+	_wind_rel_kin.R_bx_e = 2.0f*q0*q3 + 2.0f*q1*q2;
+
+	// partials of the body frame relative wind wrt the quaternion states that
+	// appear in both the sideslip and drag observation jacobians
+	_wind_rel_kin.vel_partial[0] = 2.0f*q0*u + 2.0f*q3*v - 2.0f*q2*w;
+	_wind_rel_kin.vel_partial[1] = 2.0f*q1*u + 2.0f*q2*v + 2.0f*q3*w;
+	_wind_rel_kin.vel_partial[2] = 2.0f*q2*u - 2.0f*q1*v + 2.0f*q0*w;
+	_wind_rel_kin.vel_partial[3] = 2.0f*q0*v - 2.0f*q3*u + 2.0f*q1*w;
+
+	_wind_rel_kin.quat = _state.quat_nominal;
+	_wind_rel_kin.vel = _state.vel;
+	_wind_rel_kin.wind_vel = _state.wind_vel;
+	_wind_rel_kin.valid = true;
+}
+#endif // EKF_NO_WIND_STATES
+
+void Ekf::updateQuatProducts()
+{
+	// reuse the cached products if the quaternion states are unchanged - the
+	// comparison is exact so consumers running after a quaternion correction
+	// always see products computed from the corrected states
+	bool unchanged = _quat_prod.valid;
+
+	for (int i = 0; i < 4; i++) {
+		unchanged = unchanged && (_quat_prod.quat(i) == _state.quat_nominal(i));
+	}
+
+	if (unchanged) {
+		return;
+	}
+
+	const float q0 = _state.quat_nominal(0);
+	const float q1 = _state.quat_nominal(1);
+	const float q2 = _state.quat_nominal(2);
+	const float q3 = _state.quat_nominal(3);
+
+	_quat_prod.q0q0 = q0*q0;
+	_quat_prod.q1q1 = q1*q1;
+	_quat_prod.q2q2 = q2*q2;
+	_quat_prod.q3q3 = q3*q3;
+	_quat_prod.q0q1 = q0*q1;
+	_quat_prod.q0q2 = q0*q2;
+	_quat_prod.q0q3 = q0*q3;
+	_quat_prod.q1q2 = q1*q2;
+	_quat_prod.q1q3 = q1*q3;
+	_quat_prod.q2q3 = q2*q3;
+
+	_quat_prod.quat = _state.quat_nominal;
+	_quat_prod.valid = true;
+}
+
 // calculate the earth rotation vector
 void Ekf::calcEarthRateNED(Vector3f &omega, float lat_rad) const
 {
@@ -959,6 +1048,126 @@ void Ekf::get_covariances(float *covariances)
 	}
 }
 
+// quantize a variance onto the log10 scale of ekfCovarianceRecord
+static uint16_t quantizeVariance(float var)
+{
+	if (!(var > 0.0f)) {
+		return 0;
+	}
+
+	const float q = (log10f(var) + 12.0f) * 4096.0f;
+	return (uint16_t)math::constrain(q, 1.0f, 65535.0f);
+}
+
+void Ekf::set_covariance_record_pairs(const uint8_t (*pairs)[2], uint8_t num_pairs)
+{
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < num_pairs && count < ekfCovarianceRecord::MAX_CORRELATION_PAIRS; i++) {
+		const uint8_t row = pairs[i][0];
+		const uint8_t col = pairs[i][1];
+
+		if (row < _k_num_states && col < _k_num_states && row != col) {
+			_cov_record_pairs[count][0] = row;
+			_cov_record_pairs[count][1] = col;
+			count++;
+		}
+	}
+
+	_cov_record_num_pairs = count;
+}
+
+// fill a compact quantized covariance record in a single pass
+void Ekf::get_covariances_compact(ekfCovarianceRecord *rec)
+{
+	rec->time_us = _imu_sample_delayed.time_us;
+
+	for (unsigned i = 0; i < _k_num_states; i++) {
+		rec->variances[i] = quantizeVariance(P[i][i]);
+	}
+
+	// zero the tail beyond the active states so reduced state builds never
+	// log uninitialized memory
+	for (unsigned i = _k_num_states; i < _k_max_num_states; i++) {
+		rec->variances[i] = 0;
+	}
+
+	for (uint8_t i = 0; i < _cov_record_num_pairs; i++) {
+		const uint8_t row = _cov_record_pairs[i][0];
+		const uint8_t col = _cov_record_pairs[i][1];
+		const float var_prod = P[row][row] * P[col][col];
+
+		float corr = 0.0f;
+
+		if (var_prod > 0.0f) {
+			corr = math::constrain(P[row][col] / sqrtf(var_prod), -1.0f, 1.0f);
+		}
+
+		rec->pairs[i][0] = row;
+		rec->pairs[i][1] = col;
+		rec->correlations[i] = (int16_t)(corr * 32767.0f);
+	}
+
+	for (uint8_t i = _cov_record_num_pairs; i < ekfCovarianceRecord::MAX_CORRELATION_PAIRS; i++) {
+		rec->pairs[i][0] = 0;
+		rec->pairs[i][1] = 0;
+		rec->correlations[i] = 0;
+	}
+
+	rec->num_correlations = _cov_record_num_pairs;
+}
+
+// fill a packed snapshot of the filter outputs in a single pass
+void Ekf::get_snapshot(ekfSnapshot *snap)
+{
+	copy_timestamp(&snap->time_us);
+	copy_quaternion(snap->quat_nominal);
+	get_velocity(snap->velocity);
+	get_position(snap->position);
+	get_gyro_bias(snap->gyro_bias);
+	get_accel_bias(snap->accel_bias);
+	get_state_delayed(snap->state_delayed);
+	get_covariances(snap->covariances);
+
+	// the getters only fill the active states - zero the tail so reduced state
+	// builds never expose uninitialized memory through the fixed width arrays
+	for (unsigned i = _k_num_states; i < _k_max_num_states; i++) {
+		snap->state_delayed[i] = 0.0f;
+		snap->covariances[i] = 0.0f;
+	}
+
+	get_output_tracking_error(snap->output_tracking_error);
+
+	memcpy(snap->vel_pos_innov, _vel_pos_innov, sizeof(snap->vel_pos_innov));
+	memcpy(snap->vel_pos_innov_var, _vel_pos_innov_var, sizeof(snap->vel_pos_innov_var));
+	memcpy(snap->mag_innov, _mag_innov, sizeof(snap->mag_innov));
+	memcpy(snap->mag_innov_var, _mag_innov_var, sizeof(snap->mag_innov_var));
+	memcpy(snap->flow_innov, _flow_innov, sizeof(snap->flow_innov));
+	memcpy(snap->flow_innov_var, _flow_innov_var, sizeof(snap->flow_innov_var));
+	snap->heading_innov = _heading_innov;
+	snap->heading_innov_var = _heading_innov_var;
+	snap->airspeed_innov = _airspeed_innov;
+	snap->airspeed_innov_var = _airspeed_innov_var;
+	snap->beta_innov = _beta_innov;
+	snap->beta_innov_var = _beta_innov_var;
+	snap->hagl_innov = _hagl_innov;
+	snap->hagl_innov_var = _hagl_innov_var;
+
+	snap->control_mode = _control_status.value;
+	snap->filter_fault_flags = _fault_status.value;
+	snap->innov_check_flags = _innov_check_fail_status.value;
+	get_ekf_soln_status(&snap->solution_status);
+	snap->gps_check_fail_flags = _gps_check_fail_status.value;
+}
+
+// commit a consistent copy of the outputs for lock free readers
+void Ekf::publishSnapshot()
+{
+	ekfSnapshot snap{};
+	get_snapshot(&snap);
+	_published_snapshot.write(snap);
+}
+
 // get the position and height of the ekf origin in WGS-84 coordinates and time the origin was set
 // return true if the origin is valid
 bool Ekf::get_ekf_origin(uint64_t *origin_time, map_projection_reference_s *origin_pos, float *origin_alt)
@@ -1009,42 +1218,59 @@ bool Ekf::get_gps_drift_metrics(float drift[3], bool *blocked)
 // get the 1-sigma horizontal and vertical position uncertainty of the ekf WGS-84 position
 void Ekf::get_ekf_gpos_accuracy(float *ekf_eph, float *ekf_epv)
 {
-	// report absolute accuracy taking into account the uncertainty in location of the origin
-	// If not aiding, return 0 for horizontal position estimate as no estimate is available
-	// TODO - allow for baro drift in vertical position error
-	float hpos_err = sqrtf(P[7][7] + P[8][8] + sq(_gps_origin_eph));
-
-	// If we are dead-reckoning, use the innovations as a conservative alternate measure of the horizontal position error
-	// The reason is that complete rejection of measurements is often caused by heading misalignment or inertial sensing errors
-	// and using state variances for accuracy reporting is overly optimistic in these situations
-	if (_is_dead_reckoning && (_control_status.flags.gps || _control_status.flags.ev_pos)) {
-		hpos_err = math::max(hpos_err, sqrtf(sq(_vel_pos_innov[3]) + sq(_vel_pos_innov[4])));
+	if (_derived_outputs.generation != _update_generation) {
+		refreshDerivedOutputs();
 	}
 
-	*ekf_eph = hpos_err;
-	*ekf_epv = sqrtf(P[9][9] + sq(_gps_origin_epv));
+	*ekf_eph = _derived_outputs.gpos_eph;
+	*ekf_epv = _derived_outputs.gpos_epv;
 }
 
 // get the 1-sigma horizontal and vertical position uncertainty of the ekf local position
 void Ekf::get_ekf_lpos_accuracy(float *ekf_eph, float *ekf_epv)
 {
+	if (_derived_outputs.generation != _update_generation) {
+		refreshDerivedOutputs();
+	}
+
+	*ekf_eph = _derived_outputs.lpos_eph;
+	*ekf_epv = _derived_outputs.lpos_epv;
+}
+
+// get the 1-sigma horizontal and vertical velocity uncertainty
+void Ekf::get_ekf_vel_accuracy(float *ekf_evh, float *ekf_evv)
+{
+	if (_derived_outputs.generation != _update_generation) {
+		refreshDerivedOutputs();
+	}
+
+	*ekf_evh = _derived_outputs.vel_evh;
+	*ekf_evv = _derived_outputs.vel_evv;
+}
+
+// recompute the derived accuracy and status outputs for the current filter generation
+void Ekf::refreshDerivedOutputs()
+{
+	// report absolute accuracy taking into account the uncertainty in location of the origin
+	// If not aiding, return 0 for horizontal position estimate as no estimate is available
 	// TODO - allow for baro drift in vertical position error
-	float hpos_err = sqrtf(P[7][7] + P[8][8]);
+	float gpos_err = sqrtf(P[7][7] + P[8][8] + sq(_gps_origin_eph));
+	float lpos_err = sqrtf(P[7][7] + P[8][8]);
 
 	// If we are dead-reckoning, use the innovations as a conservative alternate measure of the horizontal position error
 	// The reason is that complete rejection of measurements is often caused by heading misalignment or inertial sensing errors
 	// and using state variances for accuracy reporting is overly optimistic in these situations
 	if (_is_dead_reckoning && (_control_status.flags.gps || _control_status.flags.ev_pos)) {
-		hpos_err = math::max(hpos_err, sqrtf(sq(_vel_pos_innov[3]) + sq(_vel_pos_innov[4])));
+		const float pos_innov_err = sqrtf(sq(_vel_pos_innov[3]) + sq(_vel_pos_innov[4]));
+		gpos_err = math::max(gpos_err, pos_innov_err);
+		lpos_err = math::max(lpos_err, pos_innov_err);
 	}
 
-	*ekf_eph = hpos_err;
-	*ekf_epv = sqrtf(P[9][9]);
-}
+	_derived_outputs.gpos_eph = gpos_err;
+	_derived_outputs.gpos_epv = sqrtf(P[9][9] + sq(_gps_origin_epv));
+	_derived_outputs.lpos_eph = lpos_err;
+	_derived_outputs.lpos_epv = sqrtf(P[9][9]);
 
-// get the 1-sigma horizontal and vertical velocity uncertainty
-void Ekf::get_ekf_vel_accuracy(float *ekf_evh, float *ekf_evv)
-{
 	float hvel_err = sqrtf(P[4][4] + P[5][5]);
 
 	// If we are dead-reckoning, use the innovations as a conservative alternate measure of the horizontal velocity error
@@ -1065,8 +1291,12 @@ void Ekf::get_ekf_vel_accuracy(float *ekf_evh, float *ekf_evv)
 		hvel_err = math::max(hvel_err, vel_err_conservative);
 	}
 
-	*ekf_evh = hvel_err;
-	*ekf_evv = sqrtf(P[6][6]);
+	_derived_outputs.vel_evh = hvel_err;
+	_derived_outputs.vel_evv = sqrtf(P[6][6]);
+
+	refreshSolutionStatus();
+
+	_derived_outputs.generation = _update_generation;
 }
 
 /*
@@ -1131,8 +1361,7 @@ bool Ekf::reset_imu_bias()
 	_state.accel_bias.zero();
 
 	// Zero the corresponding covariances
-	zeroCols(P, 10, 15);
-	zeroRows(P, 10, 15);
+	zeroRowsCols(P, 10, 15);
 
 	// Set the corresponding variances to the values use for initial alignment
 	float dt = FILTER_UPDATE_PERIOD_S;
@@ -1158,24 +1387,40 @@ void Ekf::get_innovation_test_status(uint16_t *status, float *mag, float *vel, f
 {
 	// return the integer bitmask containing the consistency check pass/fail satus
 	*status = _innov_check_fail_status.value;
-	// return the largest magnetometer innovation test ratio
-	*mag = sqrtf(math::max(_yaw_test_ratio, math::max(math::max(_mag_test_ratio[0], _mag_test_ratio[1]), _mag_test_ratio[2])));
-	// return the largest NED velocity innovation test ratio
-	*vel = sqrtf(math::max(math::max(_vel_pos_test_ratio[0], _vel_pos_test_ratio[1]), _vel_pos_test_ratio[2]));
-	// return the largest NE position innovation test ratio
-	*pos = sqrtf(math::max(_vel_pos_test_ratio[3], _vel_pos_test_ratio[4]));
-	// return the vertical position innovation test ratio
-	*hgt = sqrtf(_vel_pos_test_ratio[5]);
-	// return the airspeed fusion innovation test ratio
-	*tas = sqrtf(_tas_test_ratio);
-	// return the terrain height innovation test ratio
-	*hagl = sqrtf(_terr_test_ratio);
-	// return the synthetic sideslip innovation test ratio
-	*beta = sqrtf(_beta_test_ratio);
+
+	// reduce the monitor bank to the per group maxima in a single pass. The group of
+	// each lane follows the lane ordering of innovation_test_ratios_u: yaw and mag XYZ
+	// report as one magnetometer group, the vel_pos lanes split into NED velocity,
+	// NE position and height, and the drag lanes are not reported here
+	static constexpr uint8_t NUM_GROUPS = 8;
+	static constexpr uint8_t lane_group[15] = {0, 0, 0, 0, 1, 1, 1, 2, 2, 3, 4, 5, 6, 7, 7};
+	float group_max[NUM_GROUPS] = {};
+
+	for (uint8_t i = 0; i < 15; i++) {
+		group_max[lane_group[i]] = math::max(group_max[lane_group[i]], _innov_monitor.bank[i]);
+	}
+
+	*mag = sqrtf(group_max[0]);
+	*vel = sqrtf(group_max[1]);
+	*pos = sqrtf(group_max[2]);
+	*hgt = sqrtf(group_max[3]);
+	*tas = sqrtf(group_max[4]);
+	*hagl = sqrtf(group_max[5]);
+	*beta = sqrtf(group_max[6]);
 }
 
 // return a bitmask integer that describes which state estimates are valid
 void Ekf::get_ekf_soln_status(uint16_t *status)
+{
+	if (_derived_outputs.generation != _update_generation) {
+		refreshDerivedOutputs();
+	}
+
+	*status = _derived_outputs.soln_status;
+}
+
+// recompute the solution status bitmask for the cached derived outputs
+void Ekf::refreshSolutionStatus()
 {
 	ekf_solution_status soln_status;
 
@@ -1189,12 +1434,12 @@ void Ekf::get_ekf_soln_status(uint16_t *status)
 	soln_status.flags.const_pos_mode = !soln_status.flags.velocity_horiz;
 	soln_status.flags.pred_pos_horiz_rel = soln_status.flags.pos_horiz_rel;
 	soln_status.flags.pred_pos_horiz_abs = soln_status.flags.pos_horiz_abs;
-	bool gps_vel_innov_bad = (_vel_pos_test_ratio[0] > 1.0f) || (_vel_pos_test_ratio[1] > 1.0f);
-	bool gps_pos_innov_bad = (_vel_pos_test_ratio[3] > 1.0f) || (_vel_pos_test_ratio[4] > 1.0f);
-	bool mag_innov_good = (_mag_test_ratio[0] < 1.0f) && (_mag_test_ratio[1] < 1.0f) && (_mag_test_ratio[2] < 1.0f) && (_yaw_test_ratio < 1.0f);
+	bool gps_vel_innov_bad = (_innov_monitor.ratio.vel_pos[0] > 1.0f) || (_innov_monitor.ratio.vel_pos[1] > 1.0f);
+	bool gps_pos_innov_bad = (_innov_monitor.ratio.vel_pos[3] > 1.0f) || (_innov_monitor.ratio.vel_pos[4] > 1.0f);
+	bool mag_innov_good = (_innov_monitor.ratio.mag[0] < 1.0f) && (_innov_monitor.ratio.mag[1] < 1.0f) && (_innov_monitor.ratio.mag[2] < 1.0f) && (_innov_monitor.ratio.yaw < 1.0f);
 	soln_status.flags.gps_glitch = (gps_vel_innov_bad || gps_pos_innov_bad) && mag_innov_good;
 	soln_status.flags.accel_error = _bad_vert_accel_detected;
-	*status = soln_status.value;
+	_derived_outputs.soln_status = soln_status.value;
 }
 
 // fuse measurement
@@ -1222,6 +1467,7 @@ void Ekf::fuse(float *K, float innovation)
 		_state.accel_bias(i) = _state.accel_bias(i) - K[i + 13] * innovation;
 	}
 
+#ifndef EKF_NO_MAG_STATES
 	for (unsigned i = 0; i < 3; i++) {
 		_state.mag_I(i) = _state.mag_I(i) - K[i + 16] * innovation;
 	}
@@ -1229,24 +1475,171 @@ void Ekf::fuse(float *K, float innovation)
 	for (unsigned i = 0; i < 3; i++) {
 		_state.mag_B(i) = _state.mag_B(i) - K[i + 19] * innovation;
 	}
+#endif // EKF_NO_MAG_STATES
 
+#ifndef EKF_NO_WIND_STATES
 	for (unsigned i = 0; i < 2; i++) {
 		_state.wind_vel(i) = _state.wind_vel(i) - K[i + 22] * innovation;
 	}
+#endif // EKF_NO_WIND_STATES
 }
 
-// zero specified range of rows in the state covariance matrix
-void Ekf::zeroRows(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last)
+// invert a symmetric matrix of dimension size occupying the top left corner of A using
+// Gauss-Jordan elimination with partial pivoting. Returns false if the matrix is singular
+// or badly conditioned.
+bool Ekf::inverseSymmetric(const float (&A)[6][6], float (&A_inv)[6][6], uint8_t size) const
 {
-	uint8_t row;
+	float work[6][12] = {};
 
-	for (row = first; row <= last; row++) {
-		memset(&cov_mat[row][0], 0, sizeof(cov_mat[0][0]) * 24);
+	// form the augmented matrix [A | I]
+	for (uint8_t row = 0; row < size; row++) {
+		for (uint8_t col = 0; col < size; col++) {
+			work[row][col] = A[row][col];
+		}
+
+		work[row][size + row] = 1.0f;
 	}
+
+	for (uint8_t col = 0; col < size; col++) {
+		// find the row with the largest pivot element
+		uint8_t pivot_row = col;
+
+		for (uint8_t row = col + 1; row < size; row++) {
+			if (fabsf(work[row][col]) > fabsf(work[pivot_row][col])) {
+				pivot_row = row;
+			}
+		}
+
+		if (fabsf(work[pivot_row][col]) < 1e-12f) {
+			return false;
+		}
+
+		if (pivot_row != col) {
+			for (uint8_t k = 0; k < 2 * size; k++) {
+				float temp = work[col][k];
+				work[col][k] = work[pivot_row][k];
+				work[pivot_row][k] = temp;
+			}
+		}
+
+		// normalise the pivot row
+		float pivot_inv = 1.0f / work[col][col];
+
+		for (uint8_t k = 0; k < 2 * size; k++) {
+			work[col][k] *= pivot_inv;
+		}
+
+		// eliminate the pivot column from all other rows
+		for (uint8_t row = 0; row < size; row++) {
+			if (row != col && work[row][col] != 0.0f) {
+				float factor = work[row][col];
+
+				for (uint8_t k = 0; k < 2 * size; k++) {
+					work[row][k] -= factor * work[col][k];
+				}
+			}
+		}
+	}
+
+	for (uint8_t row = 0; row < size; row++) {
+		for (uint8_t col = 0; col < size; col++) {
+			A_inv[row][col] = work[row][size + col];
+		}
+	}
+
+	return true;
+}
+
+// fuse a block of up to six observations that each directly observe a single state using
+// a single gain calculation and a single covariance update. Returns false without
+// modifying the states or covariances if the update would be unhealthy, allowing the
+// caller to fall back to sequential scalar fusion.
+bool Ekf::fuseStateBlock(const uint8_t *state_index, const float *innovation, const float *R, uint8_t n_obs)
+{
+	if (n_obs == 0 || n_obs > 6) {
+		return false;
+	}
+
+	// calculate the innovation covariance S = H*P*H' + R, where each row of H is a unit
+	// vector selecting the observed state
+	float S[6][6] = {};
+	float S_inv[6][6] = {};
+
+	for (uint8_t i = 0; i < n_obs; i++) {
+		for (uint8_t j = 0; j < n_obs; j++) {
+			S[i][j] = P[state_index[i]][state_index[j]];
+		}
+
+		S[i][i] += R[i];
+	}
+
+	if (!inverseSymmetric(S, S_inv, n_obs)) {
+		return false;
+	}
+
+	// calculate the block Kalman gain K = P*H'*S_inv
+	float K[_k_max_num_states][6];
+
+	for (unsigned row = 0; row < _k_num_states; row++) {
+		for (uint8_t i = 0; i < n_obs; i++) {
+			float sum = 0.0f;
+
+			for (uint8_t j = 0; j < n_obs; j++) {
+				sum += P[row][state_index[j]] * S_inv[j][i];
+			}
+
+			K[row][i] = sum;
+		}
+	}
+
+	// the covariance correction K*H*P is the rank-k downdate K * PHt', where the
+	// H*P row of each observation is the observed row of P - copy them out as the
+	// downdate overwrites P
+	float PHt[_k_max_num_states][6];
+
+	for (unsigned row = 0; row < _k_num_states; row++) {
+		for (uint8_t i = 0; i < n_obs; i++) {
+			PHt[row][i] = P[state_index[i]][row];
+		}
+	}
+
+	// if the covariance correction would result in a negative variance the covariance
+	// matrix is unhealthy and the block update must be rejected
+	if (!kf::rankKDowndateHealthy(P, K, PHt, n_obs, _k_num_states)) {
+		return false;
+	}
+
+	// apply the covariance corrections
+	kf::rankKDowndate(P, K, PHt, n_obs, _k_num_states);
+
+	// correct the covariance matrix for gross errors
+	fixCovarianceErrors();
+
+	// sum the state corrections for all observations and apply them in one step
+	float K_combined[_k_max_num_states];
+
+	for (unsigned row = 0; row < _k_num_states; row++) {
+		K_combined[row] = 0.0f;
+
+		for (uint8_t i = 0; i < n_obs; i++) {
+			K_combined[row] += K[row][i] * innovation[i];
+		}
+	}
+
+	fuse(K_combined, 1.0f);
+
+	return true;
+}
+
+// zero specified range of rows in the state covariance matrix
+void Ekf::zeroRows(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last)
+{
+	// the rows are contiguous in memory so the whole span is one store
+	memset(&cov_mat[first][0], 0, sizeof(cov_mat[0][0]) * _k_max_num_states * (1 + last - first));
 }
 
 // zero specified range of columns in the state covariance matrix
-void Ekf::zeroCols(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last)
+void Ekf::zeroCols(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last)
 {
 	uint8_t row;
 
@@ -1255,19 +1648,36 @@ void Ekf::zeroCols(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first
 	}
 }
 
-void Ekf::zeroOffDiag(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last)
+// zero specified range of rows and columns in the state covariance matrix
+void Ekf::zeroRowsCols(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last)
+{
+	// the row span is contiguous in memory so it is one store
+	zeroRows(cov_mat, first, last);
+
+	// the columns of the rows inside the span are already zero
+	uint8_t row;
+
+	for (row = 0; row < first; row++) {
+		memset(&cov_mat[row][first], 0, sizeof(cov_mat[0][0]) * (1 + last - first));
+	}
+
+	for (row = last + 1; row < _k_max_num_states; row++) {
+		memset(&cov_mat[row][first], 0, sizeof(cov_mat[0][0]) * (1 + last - first));
+	}
+}
+
+void Ekf::zeroOffDiag(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last)
 {
 	// save diagonal elements
 	uint8_t row;
-	float variances[_k_num_states];
+	float variances[_k_max_num_states];
 
 	for (row = first; row <= last; row++) {
 		variances[row] = cov_mat[row][row];
 	}
 
 	// zero rows and columns
-	zeroRows(cov_mat, first, last);
-	zeroCols(cov_mat, first, last);
+	zeroRowsCols(cov_mat, first, last);
 
 	// restore diagonals
 	for (row = first; row <= last; row++) {
@@ -1275,11 +1685,10 @@ void Ekf::zeroOffDiag(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t fi
 	}
 }
 
-void Ekf::setDiag(float (&cov_mat)[_k_num_states][_k_num_states], uint8_t first, uint8_t last, float variance)
+void Ekf::setDiag(float (&cov_mat)[_k_max_num_states][_k_max_num_states], uint8_t first, uint8_t last, float variance)
 {
-	// zero rows and columns
-	zeroRows(cov_mat, first, last);
-	zeroCols(cov_mat, first, last);
+	// zero rows and columns in one fused pass and re-seed the diagonal
+	zeroRowsCols(cov_mat, first, last);
 
 	// set diagonals
 	uint8_t row;
@@ -1474,8 +1883,7 @@ void Ekf::initialiseQuatCovariances(Vector3f &rot_vec_var)
 		float t44 = t17-t36;
 
 		// zero all the quaternion covariances
-		zeroRows(P, 0, 3);
-		zeroCols(P, 0, 3);
+		zeroRowsCols(P, 0, 3);
 
 		// Update the quaternion internal covariances using auto-code generated using matlab symbolic toolbox
 		P[0][0] = rot_vec_var(0)*t2*t9*t10*0.25f+rot_vec_var(1)*t4*t9*t10*0.25f+rot_vec_var(2)*t5*t9*t10*0.25f;
@@ -0,0 +1,236 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ekf_manager.cpp
+ * Manager for running multiple EKF instances in lockstep on multi-IMU hardware.
+ */
+
+#ifndef __PX4_NUTTX
+
+#include "ekf_manager.h"
+
+#include <ecl.h>
+
+EkfManager::~EkfManager()
+{
+	stop();
+}
+
+bool EkfManager::init(uint8_t num_instances, uint64_t timestamp)
+{
+	stop();
+
+	if (num_instances < 1 || num_instances > MAX_INSTANCES) {
+		ECL_ERR("manager: between 1 and %u instances supported", (unsigned)MAX_INSTANCES);
+		return false;
+	}
+
+	_instances = new Ekf[num_instances];
+
+	if (_instances == nullptr) {
+		return false;
+	}
+
+	_num_instances = num_instances;
+
+	// capture the tuning of the first instance as the initial master parameters
+	_params = *_instances[0].getParamHandle();
+
+	bool initialised = true;
+
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		initialised = _instances[i].init(timestamp) && initialised;
+	}
+
+	if (!initialised) {
+		stop();
+		return false;
+	}
+
+	// the first instance runs on the calling thread, start one worker for each
+	// additional instance
+	if (_num_instances > 1) {
+		_workers = new std::thread[_num_instances - 1];
+
+		for (uint8_t i = 1; i < _num_instances; i++) {
+			_workers[i - 1] = std::thread(&EkfManager::workerLoop, this, i);
+		}
+	}
+
+	return true;
+}
+
+void EkfManager::stop()
+{
+	if (_workers != nullptr) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_shutdown = true;
+		}
+		_cv.notify_all();
+
+		for (uint8_t i = 1; i < _num_instances; i++) {
+			_workers[i - 1].join();
+		}
+
+		delete[] _workers;
+		_workers = nullptr;
+		_shutdown = false;
+	}
+
+	delete[] _instances;
+	_instances = nullptr;
+	_num_instances = 0;
+}
+
+void EkfManager::setIMUData(uint8_t instance, uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
+			    float (&delta_ang)[3], float (&delta_vel)[3])
+{
+	if (instance < _num_instances) {
+		_instances[instance].setIMUData(time_usec, delta_ang_dt, delta_vel_dt, delta_ang, delta_vel);
+	}
+}
+
+void EkfManager::setMagData(uint64_t time_usec, float (&data)[3])
+{
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		_instances[i].setMagData(time_usec, data);
+	}
+}
+
+void EkfManager::setGpsData(uint64_t time_usec, struct gps_message *gps)
+{
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		_instances[i].setGpsData(time_usec, gps);
+	}
+}
+
+void EkfManager::setBaroData(uint64_t time_usec, float data)
+{
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		_instances[i].setBaroData(time_usec, data);
+	}
+}
+
+void EkfManager::setAirspeedData(uint64_t time_usec, float true_airspeed, float eas2tas)
+{
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		_instances[i].setAirspeedData(time_usec, true_airspeed, eas2tas);
+	}
+}
+
+void EkfManager::setRangeData(uint64_t time_usec, float data)
+{
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		_instances[i].setRangeData(time_usec, data);
+	}
+}
+
+void EkfManager::setOpticalFlowData(uint64_t time_usec, flow_message *flow)
+{
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		_instances[i].setOpticalFlowData(time_usec, flow);
+	}
+}
+
+bool EkfManager::update()
+{
+	if (_num_instances == 0) {
+		return false;
+	}
+
+	// propagate the master parameters so every instance runs this cycle with
+	// identical tuning
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		*_instances[i].getParamHandle() = _params;
+	}
+
+	// release the workers for this cycle
+	if (_num_instances > 1) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_cycle++;
+		_running = _num_instances - 1;
+	}
+
+	_cv.notify_all();
+
+	// the first instance runs on the calling thread
+	_updated[0] = _instances[0].update();
+
+	// wait for the workers to finish the cycle
+	if (_num_instances > 1) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cv.wait(lock, [this] { return _running == 0; });
+	}
+
+	bool updated = false;
+
+	for (uint8_t i = 0; i < _num_instances; i++) {
+		updated = updated || _updated[i];
+	}
+
+	return updated;
+}
+
+void EkfManager::workerLoop(uint8_t instance)
+{
+	uint32_t last_cycle = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [this, last_cycle] { return _shutdown || (_cycle != last_cycle); });
+
+			if (_shutdown) {
+				return;
+			}
+
+			last_cycle = _cycle;
+		}
+
+		// run the update outside the lock, the instance is not touched by any
+		// other thread during the cycle
+		_updated[instance] = _instances[instance].update();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running--;
+		}
+
+		// wake the calling thread when the last worker finishes
+		_cv.notify_all();
+	}
+}
+
+#endif // !__PX4_NUTTX
@@ -0,0 +1,114 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ekf_manager.h
+ * Manager for running multiple EKF instances in lockstep on multi-IMU hardware.
+ *
+ * All instances are tuned from a single master parameter block, IMU data is
+ * fed per instance and all other observations are broadcast, so every
+ * instance derives the same NED/WGS-84 origin from the shared GPS feed. The
+ * per-instance updates of one lockstep cycle are dispatched across a pool of
+ * worker threads so the redundancy scales across cores instead of
+ * multiplying the single-thread latency by the instance count.
+ */
+
+#pragma once
+
+#include "ekf.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class EkfManager
+{
+public:
+	EkfManager() = default;
+	~EkfManager();
+
+	// disallow copy, the instances and worker pool are owned exclusively
+	EkfManager(const EkfManager &) = delete;
+	EkfManager &operator=(const EkfManager &) = delete;
+
+	static constexpr uint8_t MAX_INSTANCES{4};	///< largest supported number of lockstep filter instances
+
+	// create and initialise the filter instances and start one worker thread
+	// per additional instance
+	bool init(uint8_t num_instances, uint64_t timestamp);
+
+	// stop the worker pool and destroy the filter instances
+	void stop();
+
+	// master tuning parameters, shared by all instances
+	// changes take effect at the start of the next update cycle
+	parameters *getParamHandle() { return &_params; }
+
+	// set IMU data for one instance
+	void setIMUData(uint8_t instance, uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
+			float (&delta_ang)[3], float (&delta_vel)[3]);
+
+	// broadcast observation data to all instances
+	void setMagData(uint64_t time_usec, float (&data)[3]);
+	void setGpsData(uint64_t time_usec, struct gps_message *gps);
+	void setBaroData(uint64_t time_usec, float data);
+	void setAirspeedData(uint64_t time_usec, float true_airspeed, float eas2tas);
+	void setRangeData(uint64_t time_usec, float data);
+	void setOpticalFlowData(uint64_t time_usec, flow_message *flow);
+
+	// run one update of every instance in parallel, blocks until all are done
+	// returns true if at least one instance completed a filter update
+	bool update();
+
+	// access one filter instance, e.g. to read out its states and status
+	Ekf &instance(uint8_t index) { return _instances[index]; }
+
+	uint8_t instance_count() const { return _num_instances; }
+
+private:
+	// entry point of the worker thread responsible for one instance
+	void workerLoop(uint8_t instance);
+
+	parameters _params{};			///< master parameter block copied to every instance before each update cycle
+
+	Ekf *_instances{nullptr};		///< filter instances, one per IMU
+	uint8_t _num_instances{0};		///< number of filter instances
+
+	std::thread *_workers{nullptr};		///< worker threads for the instances beyond the first, which runs on the calling thread
+	std::mutex _mutex;			///< protects the cycle and shutdown state shared with the workers
+	std::condition_variable _cv;		///< signals the start and completion of an update cycle
+	uint32_t _cycle{0};			///< update cycle counter, incremented to release the workers
+	uint8_t _running{0};			///< number of workers still busy in the current cycle
+	bool _shutdown{false};			///< commands the workers to exit
+	bool _updated[MAX_INSTANCES] {};	///< per instance update() return value of the current cycle
+};
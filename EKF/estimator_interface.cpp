@@ -45,7 +45,109 @@
 #include <ecl.h>
 #include <mathlib/mathlib.h>
 
+// round a byte count up to a multiple of 8 so that sample structs carved from the
+// buffer arena stay naturally aligned
+static size_t arenaRegionSize(size_t bytes)
+{
+	return (bytes + 7u) & ~(size_t)7u;
+}
+
+// arena footprint of one ring buffer: the sample structs plus the dense timestamp lane
+template <typename data_type>
+static size_t arenaBufferSize(uint8_t length)
+{
+	return arenaRegionSize(sizeof(data_type) * length) + arenaRegionSize(sizeof(uint64_t) * length);
+}
+
+// initialise a ring buffer using storage carved from the buffer arena and advance the
+// arena pointer past the region used
+template <typename data_type>
+static bool initFromArena(RingBuffer<data_type> &buffer, uint8_t length, uint8_t *&arena)
+{
+	data_type *samples = reinterpret_cast<data_type *>(arena);
+	arena += arenaRegionSize(sizeof(data_type) * length);
+	uint64_t *times = reinterpret_cast<uint64_t *>(arena);
+	arena += arenaRegionSize(sizeof(uint64_t) * length);
+	return buffer.init(samples, times, length);
+}
+
+// move an existing ring buffer into storage carved from a replacement arena and advance the
+// arena pointer past the region used
+template <typename data_type>
+static void migrateFromArena(RingBuffer<data_type> &buffer, uint8_t length, uint8_t *&arena)
+{
+	data_type *samples = reinterpret_cast<data_type *>(arena);
+	arena += arenaRegionSize(sizeof(data_type) * length);
+	uint64_t *times = reinterpret_cast<uint64_t *>(arena);
+	arena += arenaRegionSize(sizeof(uint64_t) * length);
+	buffer.migrate(samples, times, length);
+}
+
+// track the shortest time between accepted samples of an observation stream, used to
+// right-size the observation buffers to the rates the sensors actually deliver
+static void updateArrivalInterval(uint32_t &interval_us, uint64_t time_last, uint64_t time_now)
+{
+	if ((time_last > 0) && (time_now > time_last)) {
+		const uint64_t interval = time_now - time_last;
+
+		if ((interval_us == 0) || (interval < (uint64_t)interval_us)) {
+			interval_us = (uint32_t)interval;
+		}
+	}
+}
+
+// observation buffers are never shrunk below this length so that a sensor which starts
+// publishing later can still deliver data while the buffer lengths re-adapt
+#define MIN_OBS_BUFFER_LENGTH 2
+
+// time between checks of the buffer lengths against the measured sensor rates (usec)
+#define BUFFER_ADAPT_INTERVAL_US (uint64_t)10e6
+
 // Accumulate imu data and store to buffer at desired rate
+void EstimatorInterface::updateVibeMetrics(const imuSample &imu)
+{
+	if (_vibe_sample_count == 0) {
+		return;
+	}
+
+	// applying the per sample filter y = 0.99 * y + 0.01 * x n times with a constant
+	// input is equivalent to one application with gain 1 - 0.99^n, so the batch sees
+	// the same time constant the per sample formulation had
+	float decay = 1.0f;
+
+	for (uint8_t i = 0; i < _vibe_sample_count; i++) {
+		decay *= 0.99f;
+	}
+
+	const float gain = 1.0f - decay;
+	const float scale = 1.0f / (float)_vibe_sample_count;
+
+	// filter the RMS of the accumulated squared deltas - one square root per metric
+	// per cycle instead of one per raw sample
+	for (unsigned i = 0; i < 3; i++) {
+		_vibe_metrics[i] = decay * _vibe_metrics[i] + gain * sqrtf(_vibe_accum[i] * scale);
+		_vibe_accum[i] = 0.0f;
+	}
+
+	_vibe_sample_count = 0;
+
+	// detect if the vehicle is not moving when on ground
+	if (!_control_status.flags.in_air) {
+		if ((_vibe_metrics[1] * 4.0E4f > _params.is_moving_scaler)
+		    || (_vibe_metrics[2] * 2.1E2f > _params.is_moving_scaler)
+		    || ((imu.delta_ang.norm() / imu.delta_ang_dt) > 0.05f * _params.is_moving_scaler)) {
+
+			_time_last_move_detect_us = imu.time_us;
+		}
+
+		_vehicle_at_rest = ((imu.time_us - _time_last_move_detect_us) > (uint64_t)1E6);
+
+	} else {
+		_time_last_move_detect_us = imu.time_us;
+		_vehicle_at_rest = false;
+	}
+}
+
 void EstimatorInterface::setIMUData(uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
 				    float (&delta_ang)[3], float (&delta_vel)[3])
 {
@@ -69,46 +171,37 @@ void EstimatorInterface::setIMUData(uint64_t time_usec, uint64_t delta_ang_dt, u
 	imu_sample_new.delta_vel_dt = delta_vel_dt * 1e-6f;
 	imu_sample_new.time_us = time_usec;
 
-	// calculate a metric which indicates the amount of coning vibration
+	// accumulate the squared magnitudes of the coning and high frequency vibration
+	// deltas - the square roots and low pass filters are deferred to once per EKF
+	// cycle in updateVibeMetrics() to keep the per sample ingestion cost down
 	Vector3f temp = cross_product(imu_sample_new.delta_ang, _delta_ang_prev);
-	_vibe_metrics[0] = 0.99f * _vibe_metrics[0] + 0.01f * temp.norm();
+	_vibe_accum[0] += temp.norm_squared();
 
-	// calculate a metric which indiates the amount of high frequency gyro vibration
 	temp = imu_sample_new.delta_ang - _delta_ang_prev;
 	_delta_ang_prev = imu_sample_new.delta_ang;
-	_vibe_metrics[1] = 0.99f * _vibe_metrics[1] + 0.01f * temp.norm();
+	_vibe_accum[1] += temp.norm_squared();
 
-	// calculate a metric which indicates the amount of high fequency accelerometer vibration
 	temp = imu_sample_new.delta_vel - _delta_vel_prev;
 	_delta_vel_prev = imu_sample_new.delta_vel;
-	_vibe_metrics[2] = 0.99f * _vibe_metrics[2] + 0.01f * temp.norm();
-
-	// detect if the vehicle is not moving when on ground
-	if (!_control_status.flags.in_air) {
-		if ((_vibe_metrics[1] * 4.0E4f > _params.is_moving_scaler)
-				|| (_vibe_metrics[2] * 2.1E2f > _params.is_moving_scaler)
-				|| ((imu_sample_new.delta_ang.norm() / dt) > 0.05f * _params.is_moving_scaler)) {
+	_vibe_accum[2] += temp.norm_squared();
 
-			_time_last_move_detect_us = imu_sample_new.time_us;
-		}
-
-		_vehicle_at_rest = ((imu_sample_new.time_us - _time_last_move_detect_us) > (uint64_t)1E6);
-
-	} else {
-		_time_last_move_detect_us = imu_sample_new.time_us;
-		_vehicle_at_rest = false;
-	}
+	_vibe_sample_count++;
 
 	// accumulate and down-sample imu data and push to the buffer when new downsampled data becomes available
 	if (collect_imu(imu_sample_new)) {
 
+		// filter the accumulated vibration deltas and run the movement detection
+		// once per cycle - the 8 ms granularity is negligible against the 1 sec
+		// at rest detection hysteresis
+		updateVibeMetrics(imu_sample_new);
+
 		// down-sample the drag specific force data by accumulating and calculating the mean when
 		// sufficient samples have been collected
 		if ((_params.fusion_mode & MASK_USE_DRAG) && !_drag_buffer_fail) {
 
 			// Allocate the required buffer size if not previously done
 			// Do not retry if allocation has failed previously
-			if (_drag_buffer.get_length() < _obs_buffer_length) {
+			if (_drag_buffer.get_length() == 0) {
 				_drag_buffer_fail = !_drag_buffer.allocate(_obs_buffer_length);
 
 				if (_drag_buffer_fail) {
@@ -148,6 +241,21 @@ void EstimatorInterface::setIMUData(uint64_t time_usec, uint64_t delta_ang_dt, u
 				_drag_sample_time_dt = 0.0f;
 			}
 		}
+
+		// revisit the buffer lengths now that more sensor arrival intervals have been measured
+		updateBufferLengths(time_usec);
+	}
+}
+
+// Ingest a batch of consecutive IMU samples, oldest first
+void EstimatorInterface::setIMUData(unsigned count, const uint64_t *time_usec, const uint64_t *delta_ang_dt,
+				    const uint64_t *delta_vel_dt, const float (*delta_ang)[3], const float (*delta_vel)[3])
+{
+	for (unsigned i = 0; i < count; i++) {
+		float ang[3] = {delta_ang[i][0], delta_ang[i][1], delta_ang[i][2]};
+		float vel[3] = {delta_vel[i][0], delta_vel[i][1], delta_vel[i][2]};
+
+		setIMUData(time_usec[i], delta_ang_dt[i], delta_vel_dt[i], ang, vel);
 	}
 }
 
@@ -159,7 +267,7 @@ void EstimatorInterface::setMagData(uint64_t time_usec, float (&data)[3])
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_mag_buffer.get_length() < _obs_buffer_length) {
+	if (_mag_buffer.get_length() == 0) {
 		_mag_buffer_fail = !_mag_buffer.allocate(_obs_buffer_length);
 
 		if (_mag_buffer_fail) {
@@ -168,18 +276,34 @@ void EstimatorInterface::setMagData(uint64_t time_usec, float (&data)[3])
 		}
 	}
 
-	// limit data rate to prevent data being lost
+	// accumulate the incoming data so the buffer stores one pre-averaged sample
+	// per observation interval instead of dropping the surplus of a high rate feed
+	if (_mag_downsample.count == 0) {
+		_mag_downsample.time_first_us = time_usec;
+	}
+
+	_mag_downsample.mag_sum += Vector3f(data);
+	_mag_downsample.time_offset_sum_us += time_usec - _mag_downsample.time_first_us;
+	_mag_downsample.count++;
+
+	// push the averaged sample once the observation interval has elapsed
 	if (time_usec - _time_last_mag > _min_obs_interval_us) {
+		updateArrivalInterval(_mag_interval_us, _time_last_mag, time_usec);
 
 		magSample mag_sample_new;
-		mag_sample_new.time_us = time_usec - _params.mag_delay_ms * 1000;
+		// use the mid point of the averaging interval as the measurement time
+		mag_sample_new.time_us = _mag_downsample.time_first_us
+					 + _mag_downsample.time_offset_sum_us / _mag_downsample.count
+					 - _params.mag_delay_ms * 1000;
 
 		mag_sample_new.time_us -= FILTER_UPDATE_PERIOD_MS * 1000 / 2;
 		_time_last_mag = time_usec;
 
-		mag_sample_new.mag = Vector3f(data);
+		mag_sample_new.mag = _mag_downsample.mag_sum * (1.0f / (float)_mag_downsample.count);
 
 		_mag_buffer.push(mag_sample_new);
+
+		_mag_downsample = {};
 	}
 }
 
@@ -191,7 +315,7 @@ void EstimatorInterface::setGpsData(uint64_t time_usec, struct gps_message *gps)
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_gps_buffer.get_length() < _obs_buffer_length) {
+	if (_gps_buffer.get_length() == 0) {
 		_gps_buffer_fail = !_gps_buffer.allocate(_obs_buffer_length);
 
 		if (_gps_buffer_fail) {
@@ -204,6 +328,7 @@ void EstimatorInterface::setGpsData(uint64_t time_usec, struct gps_message *gps)
 	bool need_gps = (_params.fusion_mode & MASK_USE_GPS) || (_params.vdist_sensor_type == VDIST_SENSOR_GPS);
 
 	if (((time_usec - _time_last_gps) > _min_obs_interval_us) && need_gps && gps->fix_type > 2) {
+		updateArrivalInterval(_gps_interval_us, _time_last_gps, time_usec);
 		gpsSample gps_sample_new;
 		gps_sample_new.time_us = gps->time_usec - _params.gps_delay_ms * 1000;
 
@@ -237,6 +362,117 @@ void EstimatorInterface::setGpsData(uint64_t time_usec, struct gps_message *gps)
 	}
 }
 
+void EstimatorInterface::setGpsDataMultiReceiver(uint64_t time_usec, struct gps_message *gps, uint8_t instance)
+{
+	if (instance >= GPS_MAX_RECEIVERS) {
+		return;
+	}
+
+	_gps_blend.msg[instance] = *gps;
+	_gps_blend.time_last_arrival_us[instance] = time_usec;
+
+	// collect the receivers that can contribute to the blend, weighted by the
+	// inverse variance of the reported horizontal position accuracy. Position is
+	// the dominant GPS observation, so a receiver that reports half the position
+	// error carries four times the weight on all blended fields.
+	float weight[GPS_MAX_RECEIVERS] = {};
+	float weight_sum = 0.0f;
+
+	for (uint8_t i = 0; i < GPS_MAX_RECEIVERS; i++) {
+		const bool fresh = (_gps_blend.time_last_arrival_us[i] != 0)
+				   && ((time_usec - _gps_blend.time_last_arrival_us[i]) < GPS_RECEIVER_TIMEOUT_US);
+
+		if (fresh && _gps_blend.msg[i].fix_type > 2) {
+			const float eph = fmaxf(_gps_blend.msg[i].eph, 0.1f);
+			weight[i] = 1.0f / (eph * eph);
+			weight_sum += weight[i];
+		}
+	}
+
+	if (weight_sum <= 0.0f) {
+		// no receiver has a usable fix - forward the callers raw message and let
+		// the fix type check in setGpsData() reject it
+		setGpsData(time_usec, gps);
+		return;
+	}
+
+	// the blended sample is stamped with the newest contributing measurement time
+	uint64_t time_newest_us = 0;
+
+	for (uint8_t i = 0; i < GPS_MAX_RECEIVERS; i++) {
+		if ((weight[i] > 0.0f) && (_gps_blend.msg[i].time_usec > time_newest_us)) {
+			time_newest_us = _gps_blend.msg[i].time_usec;
+		}
+	}
+
+	// blend all fields in a single accumulation pass over the receivers
+	gps_message blended = {};
+	blended.time_usec = time_newest_us;
+	blended.fix_type = UINT8_MAX;
+	blended.vel_ned_valid = true;
+
+	double lat_deg = 0.0;
+	double lon_deg = 0.0;
+	double alt_m = 0.0;
+	float epv_var = 0.0f;
+	float sacc_var = 0.0f;
+
+	for (uint8_t i = 0; i < GPS_MAX_RECEIVERS; i++) {
+		if (weight[i] <= 0.0f) {
+			continue;
+		}
+
+		const gps_message &msg = _gps_blend.msg[i];
+		const float w = weight[i] / weight_sum;
+
+		double rcvr_lat_deg = msg.lat * 1e-7;
+		double rcvr_lon_deg = msg.lon * 1e-7;
+		double rcvr_alt_m = msg.alt * 1e-3;
+
+		// propagate an older receiver position to the blend time using its own
+		// velocity so the receivers measurement epochs do not have to line up
+		if (msg.vel_ned_valid && (msg.time_usec < time_newest_us)) {
+			const double dt = (double)(time_newest_us - msg.time_usec) * 1e-6;
+			const double lat_rad = rcvr_lat_deg * M_PI / 180.0;
+
+			rcvr_lat_deg += msg.vel_ned[0] * dt / CONSTANTS_RADIUS_OF_EARTH * 180.0 / M_PI;
+			rcvr_lon_deg += msg.vel_ned[1] * dt / (CONSTANTS_RADIUS_OF_EARTH * cos(lat_rad)) * 180.0 / M_PI;
+			rcvr_alt_m -= msg.vel_ned[2] * dt;
+		}
+
+		lat_deg += w * rcvr_lat_deg;
+		lon_deg += w * rcvr_lon_deg;
+		alt_m += w * rcvr_alt_m;
+
+		for (unsigned axis = 0; axis < 3; axis++) {
+			blended.vel_ned[axis] += w * msg.vel_ned[axis];
+		}
+
+		// the accuracy of an inverse variance weighted mean is 1/sum(1/var) for
+		// the weighting field, the remaining accuracies use the weighted mean of
+		// the reported variances
+		epv_var += w * msg.epv * msg.epv;
+		sacc_var += w * msg.sacc * msg.sacc;
+		blended.gdop += w * msg.gdop;
+
+		blended.fix_type = (msg.fix_type < blended.fix_type) ? msg.fix_type : blended.fix_type;
+		blended.nsats = (msg.nsats > blended.nsats) ? msg.nsats : blended.nsats;
+		blended.vel_ned_valid = blended.vel_ned_valid && msg.vel_ned_valid;
+	}
+
+	blended.lat = (int32_t)(lat_deg * 1e7);
+	blended.lon = (int32_t)(lon_deg * 1e7);
+	blended.alt = (int32_t)(alt_m * 1e3);
+	blended.eph = sqrtf(1.0f / weight_sum);
+	blended.epv = sqrtf(epv_var);
+	blended.sacc = sqrtf(sacc_var);
+	blended.vel_m_s = sqrtf(blended.vel_ned[0] * blended.vel_ned[0] + blended.vel_ned[1] * blended.vel_ned[1]);
+
+	// the rate limiter in setGpsData() keeps the buffer rate unchanged when both
+	// receivers forward their updates
+	setGpsData(time_usec, &blended);
+}
+
 void EstimatorInterface::setBaroData(uint64_t time_usec, float data)
 {
 	if (!_initialised || _baro_buffer_fail) {
@@ -245,7 +481,7 @@ void EstimatorInterface::setBaroData(uint64_t time_usec, float data)
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_baro_buffer.get_length() < _obs_buffer_length) {
+	if (_baro_buffer.get_length() == 0) {
 		_baro_buffer_fail = !_baro_buffer.allocate(_obs_buffer_length);
 
 		if (_baro_buffer_fail) {
@@ -254,12 +490,26 @@ void EstimatorInterface::setBaroData(uint64_t time_usec, float data)
 		}
 	}
 
-	// limit data rate to prevent data being lost
+	// accumulate the incoming data so the buffer stores one pre-averaged sample
+	// per observation interval instead of dropping the surplus of a high rate feed
+	if (_baro_downsample.count == 0) {
+		_baro_downsample.time_first_us = time_usec;
+	}
+
+	_baro_downsample.hgt_sum += data;
+	_baro_downsample.time_offset_sum_us += time_usec - _baro_downsample.time_first_us;
+	_baro_downsample.count++;
+
+	// push the averaged sample once the observation interval has elapsed
 	if (time_usec - _time_last_baro > _min_obs_interval_us) {
+		updateArrivalInterval(_baro_interval_us, _time_last_baro, time_usec);
 
 		baroSample baro_sample_new;
-		baro_sample_new.hgt = data;
-		baro_sample_new.time_us = time_usec - _params.baro_delay_ms * 1000;
+		baro_sample_new.hgt = _baro_downsample.hgt_sum / (float)_baro_downsample.count;
+		// use the mid point of the averaging interval as the measurement time
+		baro_sample_new.time_us = _baro_downsample.time_first_us
+					  + _baro_downsample.time_offset_sum_us / _baro_downsample.count
+					  - _params.baro_delay_ms * 1000;
 
 		baro_sample_new.time_us -= FILTER_UPDATE_PERIOD_MS * 1000 / 2;
 		_time_last_baro = time_usec;
@@ -267,6 +517,8 @@ void EstimatorInterface::setBaroData(uint64_t time_usec, float data)
 		baro_sample_new.time_us = math::max(baro_sample_new.time_us, _imu_sample_delayed.time_us);
 
 		_baro_buffer.push(baro_sample_new);
+
+		_baro_downsample = {};
 	}
 }
 
@@ -278,7 +530,7 @@ void EstimatorInterface::setAirspeedData(uint64_t time_usec, float true_airspeed
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_airspeed_buffer.get_length() < _obs_buffer_length) {
+	if (_airspeed_buffer.get_length() == 0) {
 		_airspeed_buffer_fail = !_airspeed_buffer.allocate(_obs_buffer_length);
 
 		if (_airspeed_buffer_fail) {
@@ -289,6 +541,7 @@ void EstimatorInterface::setAirspeedData(uint64_t time_usec, float true_airspeed
 
 	// limit data rate to prevent data being lost
 	if (time_usec - _time_last_airspeed > _min_obs_interval_us) {
+		updateArrivalInterval(_airspeed_interval_us, _time_last_airspeed, time_usec);
 		airspeedSample airspeed_sample_new;
 		airspeed_sample_new.true_airspeed = true_airspeed;
 		airspeed_sample_new.eas2tas = eas2tas;
@@ -308,7 +561,7 @@ void EstimatorInterface::setRangeData(uint64_t time_usec, float data)
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_range_buffer.get_length() < _obs_buffer_length) {
+	if (_range_buffer.get_length() == 0) {
 		_range_buffer_fail = !_range_buffer.allocate(_obs_buffer_length);
 
 		if (_range_buffer_fail) {
@@ -319,7 +572,8 @@ void EstimatorInterface::setRangeData(uint64_t time_usec, float data)
 
 	// limit data rate to prevent data being lost
 	if (time_usec - _time_last_range > _min_obs_interval_us) {
-		rangeSample range_sample_new;
+		updateArrivalInterval(_range_interval_us, _time_last_range, time_usec);
+		rangeSample range_sample_new = {};
 		range_sample_new.rng = data;
 		range_sample_new.time_us = time_usec - _params.range_delay_ms * 1000;
 		_time_last_range = time_usec;
@@ -328,6 +582,74 @@ void EstimatorInterface::setRangeData(uint64_t time_usec, float data)
 	}
 }
 
+// set multi-zone range data
+void EstimatorInterface::setRangeDataMultiZone(uint64_t time_usec, const float *data, unsigned num_zones)
+{
+	if (!_initialised || _range_buffer_fail || (num_zones == 0)) {
+		return;
+	}
+
+	// Allocate the required buffer size if not previously done
+	// Do not retry if allocation has failed previously
+	if (_range_buffer.get_length() == 0) {
+		_range_buffer_fail = !_range_buffer.allocate(_obs_buffer_length);
+
+		if (_range_buffer_fail) {
+			ECL_ERR("EKF range finder buffer allocation failed");
+			return;
+		}
+	}
+
+	// limit data rate to prevent data being lost
+	if (time_usec - _time_last_range > _min_obs_interval_us) {
+		updateArrivalInterval(_range_interval_us, _time_last_range, time_usec);
+		rangeSample range_sample_new = {};
+
+		if (num_zones > RNG_MAX_ZONES) {
+			num_zones = RNG_MAX_ZONES;
+		}
+
+		float range_sum = 0.0f;
+
+		for (unsigned i = 0; i < num_zones; i++) {
+			range_sample_new.rng_zone[i] = data[i];
+			range_sum += data[i];
+		}
+
+		// consumers that expect a single beam see the zone average
+		range_sample_new.rng = range_sum / num_zones;
+		range_sample_new.num_zones = num_zones;
+		range_sample_new.time_us = time_usec - _params.range_delay_ms * 1000;
+		_time_last_range = time_usec;
+
+		_range_buffer.push(range_sample_new);
+	}
+}
+
+// calculate the measurement variance for the optical flow sensor (rad/sec)^2
+float EstimatorInterface::calcOptFlowMeasVar(uint8_t quality)
+{
+	// calculate the observation noise variance - scaling noise linearly across flow quality range
+	float R_LOS_best = fmaxf(_params.flow_noise, 0.05f);
+	float R_LOS_worst = fmaxf(_params.flow_noise_qual_min, 0.05f);
+
+	// calculate a weighting that varies between 1 when flow quality is best and 0 when flow quality is worst
+	float weighting = (255.0f - (float)_params.flow_qual_min);
+
+	if (weighting >= 1.0f) {
+		weighting = math::constrain(((float)quality - (float)_params.flow_qual_min) / weighting, 0.0f,
+					    1.0f);
+
+	} else {
+		weighting = 0.0f;
+	}
+
+	// take the weighted average of the observation noie for the best and wort flow quality
+	float R_LOS = R_LOS_best * weighting + R_LOS_worst * (1.0f - weighting);
+
+	return R_LOS * R_LOS;
+}
+
 // set optical flow data
 void EstimatorInterface::setOpticalFlowData(uint64_t time_usec, flow_message *flow)
 {
@@ -337,7 +659,7 @@ void EstimatorInterface::setOpticalFlowData(uint64_t time_usec, flow_message *fl
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_flow_buffer.get_length() < _obs_buffer_length) {
+	if (_flow_buffer.get_length() == 0) {
 		_flow_buffer_fail = !_flow_buffer.allocate(_obs_buffer_length);
 
 		if (_flow_buffer_fail) {
@@ -383,8 +705,15 @@ void EstimatorInterface::setOpticalFlowData(uint64_t time_usec, flow_message *fl
 			// calculate the system time-stamp for the trailing edge of the flow data integration period
 			optflow_sample_new.time_us = time_usec - _params.flow_delay_ms * 1000;
 
-			// copy the quality metric returned by the PX4Flow sensor
+			// copy the quality metric returned by the PX4Flow sensor and derive the
+			// observation variance from it here, on the sensor thread, so the fusion
+			// hot path can consume a finished value
 			optflow_sample_new.quality = flow->quality;
+			optflow_sample_new.losVar = calcOptFlowMeasVar(flow->quality);
+
+			// screen the sensor gyro data once on ingestion
+			optflow_sample_new.gyro_valid = ISFINITE(flow->gyrodata(0)) && ISFINITE(flow->gyrodata(1))
+							&& ISFINITE(flow->gyrodata(2));
 
 			// NOTE: the EKF uses the reverse sign convention to the flow sensor. EKF assumes positive LOS rate is produced by a RH rotation of the image about the sensor axis.
 			// copy the optical and gyro measured delta angles
@@ -393,6 +722,7 @@ void EstimatorInterface::setOpticalFlowData(uint64_t time_usec, flow_message *fl
 
 			// convert integration interval to seconds
 			optflow_sample_new.dt = delta_time;
+			updateArrivalInterval(_flow_interval_us, _time_last_optflow, time_usec);
 			_time_last_optflow = time_usec;
 
 			_flow_buffer.push(optflow_sample_new);
@@ -409,7 +739,7 @@ void EstimatorInterface::setExtVisionData(uint64_t time_usec, ext_vision_message
 
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_ext_vision_buffer.get_length() < _obs_buffer_length) {
+	if (_ext_vision_buffer.get_length() == 0) {
 		_ev_buffer_fail = !_ext_vision_buffer.allocate(_obs_buffer_length);
 
 		if (_ev_buffer_fail) {
@@ -418,23 +748,71 @@ void EstimatorInterface::setExtVisionData(uint64_t time_usec, ext_vision_message
 		}
 	}
 
-	// limit data rate to prevent data being lost
+	// accumulate the incoming data so the buffer stores one pre-averaged sample
+	// per observation interval instead of dropping the surplus of a high rate feed
+	if (_ev_downsample.count == 0) {
+		_ev_downsample.time_first_us = time_usec;
+
+		for (unsigned i = 0; i < 4; i++) {
+			_ev_downsample.quat_ref[i] = evdata->quat(i);
+		}
+	}
+
+	// align the quaternion sign with the first sample of the interval so
+	// antipodal representations of the same rotation do not cancel
+	float quat_dot = 0.0f;
+
+	for (unsigned i = 0; i < 4; i++) {
+		quat_dot += evdata->quat(i) * _ev_downsample.quat_ref[i];
+	}
+
+	const float quat_sign = (quat_dot < 0.0f) ? -1.0f : 1.0f;
+
+	for (unsigned i = 0; i < 4; i++) {
+		_ev_downsample.quat_sum[i] += quat_sign * evdata->quat(i);
+	}
+
+	for (unsigned i = 0; i < 3; i++) {
+		_ev_downsample.pos_sum[i] += evdata->posNED(i);
+	}
+
+	_ev_downsample.pos_err_sum += evdata->posErr;
+	_ev_downsample.ang_err_sum += evdata->angErr;
+	_ev_downsample.time_offset_sum_us += time_usec - _ev_downsample.time_first_us;
+	_ev_downsample.count++;
+
+	// push the averaged sample once the observation interval has elapsed
 	if (time_usec - _time_last_ext_vision > _min_obs_interval_us) {
+		updateArrivalInterval(_ev_interval_us, _time_last_ext_vision, time_usec);
+		const float count_inv = 1.0f / (float)_ev_downsample.count;
+
 		extVisionSample ev_sample_new;
-		// calculate the system time-stamp for the mid point of the integration period
-		ev_sample_new.time_us = time_usec - _params.ev_delay_ms * 1000;
+		// use the mid point of the averaging interval as the measurement time
+		ev_sample_new.time_us = _ev_downsample.time_first_us
+					+ _ev_downsample.time_offset_sum_us / _ev_downsample.count
+					- _params.ev_delay_ms * 1000;
+
+		for (unsigned i = 0; i < 3; i++) {
+			ev_sample_new.posNED(i) = _ev_downsample.pos_sum[i] * count_inv;
+		}
 
-		// copy required data
-		ev_sample_new.angErr = evdata->angErr;
-		ev_sample_new.posErr = evdata->posErr;
-		ev_sample_new.quat = evdata->quat;
-		ev_sample_new.posNED = evdata->posNED;
+		// nearby quaternions average component wise when renormalised
+		for (unsigned i = 0; i < 4; i++) {
+			ev_sample_new.quat(i) = _ev_downsample.quat_sum[i] * count_inv;
+		}
+
+		if (_ev_downsample.count > 1) {
+			ev_sample_new.quat.normalize();
+		}
+		ev_sample_new.posErr = _ev_downsample.pos_err_sum * count_inv;
+		ev_sample_new.angErr = _ev_downsample.ang_err_sum * count_inv;
 
 		// record time for comparison next measurement
 		_time_last_ext_vision = time_usec;
 
 		_ext_vision_buffer.push(ev_sample_new);
 
+		_ev_downsample = {};
 	}
 }
 
@@ -444,9 +822,13 @@ void EstimatorInterface::setAuxVelData(uint64_t time_usec, float (&data)[2], flo
 		return;
 	}
 
+	// the direct fusion path corrects the output predictor states at the current
+	// time horizon, so the delay horizon buffer is not needed
+	const bool fuse_direct = (_params.fusion_mode & MASK_USE_AUXVEL_DIRECT);
+
 	// Allocate the required buffer size if not previously done
 	// Do not retry if allocation has failed previously
-	if (_auxvel_buffer.get_length() < _obs_buffer_length) {
+	if (!fuse_direct && _auxvel_buffer.get_length() == 0) {
 		_auxvel_buffer_fail = !_auxvel_buffer.allocate(_obs_buffer_length);
 
 		if (_auxvel_buffer_fail) {
@@ -457,6 +839,7 @@ void EstimatorInterface::setAuxVelData(uint64_t time_usec, float (&data)[2], flo
 
 	// limit data rate to prevent data being lost
 	if (time_usec - _time_last_auxvel > _min_obs_interval_us) {
+		updateArrivalInterval(_auxvel_interval_us, _time_last_auxvel, time_usec);
 
 		auxVelSample auxvel_sample_new;
 		auxvel_sample_new.time_us = time_usec - _params.auxvel_delay_ms * 1000;
@@ -467,7 +850,13 @@ void EstimatorInterface::setAuxVelData(uint64_t time_usec, float (&data)[2], flo
 		auxvel_sample_new.velNE = Vector2f(data);
 		auxvel_sample_new.velVarNE = Vector2f(variance);
 
-		_auxvel_buffer.push(auxvel_sample_new);
+		if (fuse_direct) {
+			_auxvel_direct_sample = auxvel_sample_new;
+			_auxvel_direct_ready = true;
+
+		} else {
+			_auxvel_buffer.push(auxvel_sample_new);
+		}
 	}
 }
 
@@ -495,15 +884,65 @@ bool EstimatorInterface::initialise_interface(uint64_t timestamp)
 	// limit to be no longer than the IMU buffer (we can't process data faster than the EKF prediction rate)
 	_obs_buffer_length = math::min(_obs_buffer_length, _imu_buffer_length);
 
-	if (!(_imu_buffer.allocate(_imu_buffer_length) &&
-	      _output_buffer.allocate(_imu_buffer_length) &&
-	      _output_vert_buffer.allocate(_imu_buffer_length))) {
+	// record the time window the observation buffers must cover so that the lengths can be
+	// re-checked against the measured sensor arrival rates at run time
+	_obs_window_us = (uint32_t)ekf_delay_ms * 1000;
+
+	// free any previous allocations before the arena is sized
+	unallocate_buffers();
+
+	// carve the storage for all data buffers from a single contiguous allocation to give
+	// deterministic startup behaviour, avoid heap fragmentation and keep the sample data
+	// cache adjacent. Each region is rounded up to an 8 byte boundary so that the sample
+	// structs stay naturally aligned.
+	const size_t arena_bytes = arenaBufferSize<imuSample>(_imu_buffer_length)
+				   + arenaBufferSize<outputSample>(_imu_buffer_length)
+				   + arenaBufferSize<outputVert>(_imu_buffer_length)
+				   + arenaBufferSize<gpsSample>(_obs_buffer_length)
+				   + arenaBufferSize<magSample>(_obs_buffer_length)
+				   + arenaBufferSize<baroSample>(_obs_buffer_length)
+				   + arenaBufferSize<rangeSample>(_obs_buffer_length)
+				   + arenaBufferSize<airspeedSample>(_obs_buffer_length)
+				   + arenaBufferSize<flowSample>(_obs_buffer_length)
+				   + arenaBufferSize<extVisionSample>(_obs_buffer_length)
+				   + arenaBufferSize<dragSample>(_obs_buffer_length)
+				   + arenaBufferSize<auxVelSample>(_obs_buffer_length);
+
+	_sample_arena = new uint64_t[arena_bytes / sizeof(uint64_t)];
+
+	if (_sample_arena == nullptr) {
+		ECL_ERR("EKF buffer allocation failed!");
+		return false;
+	}
+
+	_sample_arena_bytes = (uint32_t)arena_bytes;
 
+	uint8_t *arena = reinterpret_cast<uint8_t *>(_sample_arena);
+
+	bool buffers_ok = initFromArena(_imu_buffer, _imu_buffer_length, arena)
+			  && initFromArena(_output_buffer, _imu_buffer_length, arena)
+			  && initFromArena(_output_vert_buffer, _imu_buffer_length, arena)
+			  && initFromArena(_gps_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_mag_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_baro_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_range_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_airspeed_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_flow_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_ext_vision_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_drag_buffer, _obs_buffer_length, arena)
+			  && initFromArena(_auxvel_buffer, _obs_buffer_length, arena);
+
+	if (!buffers_ok) {
 		ECL_ERR("EKF buffer allocation failed!");
 		unallocate_buffers();
 		return false;
 	}
 
+	// latch the allocation into the peak tracking so a parameter change that grows
+	// the buffers is visible even if the report is only read later
+	memoryUsage usage;
+	get_memory_usage(&usage);
+
 	_dt_imu_avg = 0.0f;
 
 	_imu_sample_delayed.delta_ang.setZero();
@@ -523,6 +962,17 @@ bool EstimatorInterface::initialise_interface(uint64_t timestamp)
 	_time_last_optflow = 0;
 	_fault_status.value = 0;
 	_time_last_ext_vision = 0;
+
+	// restart the sensor arrival rate measurement used to adapt the buffer lengths
+	_gps_interval_us = 0;
+	_mag_interval_us = 0;
+	_baro_interval_us = 0;
+	_range_interval_us = 0;
+	_airspeed_interval_us = 0;
+	_flow_interval_us = 0;
+	_ev_interval_us = 0;
+	_auxvel_interval_us = 0;
+	_time_last_buffer_adapt = timestamp;
 	return true;
 }
 
@@ -541,6 +991,112 @@ void EstimatorInterface::unallocate_buffers()
 	_drag_buffer.unallocate();
 	_auxvel_buffer.unallocate();
 
+	delete[] _sample_arena;
+	_sample_arena = nullptr;
+	_sample_arena_bytes = 0;
+}
+
+uint8_t EstimatorInterface::requiredBufferLength(uint32_t interval_us) const
+{
+	if (interval_us == 0) {
+		// nothing received yet - keep the minimum so a sensor which starts publishing
+		// later is not locked out while the lengths re-adapt
+		return MIN_OBS_BUFFER_LENGTH;
+	}
+
+	// samples cannot be accepted faster than the minimum observation interval
+	interval_us = math::max(interval_us, (uint32_t)_min_obs_interval_us);
+
+	// length required to cover the fusion time horizon at the measured arrival interval
+	const uint16_t length = (uint16_t)(_obs_window_us / interval_us) + 1;
+
+	return (uint8_t)math::constrain((int)length, (int)MIN_OBS_BUFFER_LENGTH, (int)_obs_buffer_length);
+}
+
+void EstimatorInterface::updateBufferLengths(uint64_t now)
+{
+	// the length checks are cheap but a re-carve moves every buffer, so only revisit
+	// the lengths periodically
+	if ((_sample_arena == nullptr) || (now - _time_last_buffer_adapt < BUFFER_ADAPT_INTERVAL_US)) {
+		return;
+	}
+
+	_time_last_buffer_adapt = now;
+
+	const uint8_t gps_length = requiredBufferLength(_gps_interval_us);
+	const uint8_t mag_length = requiredBufferLength(_mag_interval_us);
+	const uint8_t baro_length = requiredBufferLength(_baro_interval_us);
+	const uint8_t range_length = requiredBufferLength(_range_interval_us);
+	const uint8_t airspeed_length = requiredBufferLength(_airspeed_interval_us);
+	const uint8_t flow_length = requiredBufferLength(_flow_interval_us);
+	const uint8_t ev_length = requiredBufferLength(_ev_interval_us);
+	const uint8_t auxvel_length = requiredBufferLength(_auxvel_interval_us);
+
+	// the drag buffer is filled internally at a fixed fraction of the filter update rate
+	uint8_t drag_length = MIN_OBS_BUFFER_LENGTH;
+
+	if (_params.fusion_mode & MASK_USE_DRAG) {
+		uint8_t min_sample_ratio = (uint8_t) ceilf((float)_imu_buffer_length / _obs_buffer_length);
+
+		if (min_sample_ratio < 5) {
+			min_sample_ratio = 5;
+		}
+
+		drag_length = requiredBufferLength((uint32_t)min_sample_ratio * FILTER_UPDATE_PERIOD_MS * 1000);
+	}
+
+	// nothing to do if every buffer already matches the measured rates
+	if (gps_length == _gps_buffer.get_length()
+	    && mag_length == _mag_buffer.get_length()
+	    && baro_length == _baro_buffer.get_length()
+	    && range_length == _range_buffer.get_length()
+	    && airspeed_length == _airspeed_buffer.get_length()
+	    && flow_length == _flow_buffer.get_length()
+	    && ev_length == _ext_vision_buffer.get_length()
+	    && drag_length == _drag_buffer.get_length()
+	    && auxvel_length == _auxvel_buffer.get_length()) {
+		return;
+	}
+
+	// carve a replacement arena sized for the rates actually seen and move the buffer
+	// contents across, then release the old allocation to reclaim the difference
+	const size_t arena_bytes = arenaBufferSize<imuSample>(_imu_buffer_length)
+				   + arenaBufferSize<outputSample>(_imu_buffer_length)
+				   + arenaBufferSize<outputVert>(_imu_buffer_length)
+				   + arenaBufferSize<gpsSample>(gps_length)
+				   + arenaBufferSize<magSample>(mag_length)
+				   + arenaBufferSize<baroSample>(baro_length)
+				   + arenaBufferSize<rangeSample>(range_length)
+				   + arenaBufferSize<airspeedSample>(airspeed_length)
+				   + arenaBufferSize<flowSample>(flow_length)
+				   + arenaBufferSize<extVisionSample>(ev_length)
+				   + arenaBufferSize<dragSample>(drag_length)
+				   + arenaBufferSize<auxVelSample>(auxvel_length);
+
+	uint64_t *arena_alloc = new uint64_t[arena_bytes / sizeof(uint64_t)];
+
+	if (arena_alloc == nullptr) {
+		// keep running with the existing buffers
+		return;
+	}
+
+	uint8_t *arena = reinterpret_cast<uint8_t *>(arena_alloc);
+
+	migrateFromArena(_imu_buffer, _imu_buffer_length, arena);
+	migrateFromArena(_output_buffer, _imu_buffer_length, arena);
+	migrateFromArena(_output_vert_buffer, _imu_buffer_length, arena);
+	migrateFromArena(_gps_buffer, gps_length, arena);
+	migrateFromArena(_mag_buffer, mag_length, arena);
+	migrateFromArena(_baro_buffer, baro_length, arena);
+	migrateFromArena(_range_buffer, range_length, arena);
+	migrateFromArena(_airspeed_buffer, airspeed_length, arena);
+	migrateFromArena(_flow_buffer, flow_length, arena);
+	migrateFromArena(_ext_vision_buffer, ev_length, arena);
+	migrateFromArena(_drag_buffer, drag_length, arena);
+	migrateFromArena(_auxvel_buffer, auxvel_length, arena);
+
+	delete[] _sample_arena;
+	_sample_arena = arena_alloc;
 }
 
 bool EstimatorInterface::local_position_is_valid()
@@ -566,3 +1122,62 @@ void EstimatorInterface::print_status()
 	ECL_INFO("output vert buffer: %d (%d Bytes)", _output_vert_buffer.get_length(), _output_vert_buffer.get_total_size());
 	ECL_INFO("drag buffer: %d (%d Bytes)", _drag_buffer.get_length(), _drag_buffer.get_total_size());
 }
+
+const char *EstimatorInterface::memory_buffer_name(uint8_t index)
+{
+	static const char *const names[MEM_NUM_BUFFERS] = {
+		"imu", "output", "output vert", "gps", "mag", "baro",
+		"range", "airspeed", "flow", "ext vision", "drag", "aux vel"
+	};
+
+	return (index < MEM_NUM_BUFFERS) ? names[index] : "?";
+}
+
+void EstimatorInterface::get_memory_usage(memoryUsage *usage)
+{
+	// per buffer sample storage in the order the arena is carved
+	usage->buffer_bytes[0] = (uint32_t)_imu_buffer.get_storage_size();
+	usage->buffer_bytes[1] = (uint32_t)_output_buffer.get_storage_size();
+	usage->buffer_bytes[2] = (uint32_t)_output_vert_buffer.get_storage_size();
+	usage->buffer_bytes[3] = (uint32_t)_gps_buffer.get_storage_size();
+	usage->buffer_bytes[4] = (uint32_t)_mag_buffer.get_storage_size();
+	usage->buffer_bytes[5] = (uint32_t)_baro_buffer.get_storage_size();
+	usage->buffer_bytes[6] = (uint32_t)_range_buffer.get_storage_size();
+	usage->buffer_bytes[7] = (uint32_t)_airspeed_buffer.get_storage_size();
+	usage->buffer_bytes[8] = (uint32_t)_flow_buffer.get_storage_size();
+	usage->buffer_bytes[9] = (uint32_t)_ext_vision_buffer.get_storage_size();
+	usage->buffer_bytes[10] = (uint32_t)_drag_buffer.get_storage_size();
+	usage->buffer_bytes[11] = (uint32_t)_auxvel_buffer.get_storage_size();
+
+	usage->output_predictor_bytes = usage->buffer_bytes[0] + usage->buffer_bytes[1] + usage->buffer_bytes[2];
+	usage->observation_bytes = 0;
+
+	for (uint8_t i = 3; i < MEM_NUM_BUFFERS; i++) {
+		usage->observation_bytes += usage->buffer_bytes[i];
+	}
+
+	// storage a buffer heap allocated itself instead of taking from the arena
+	usage->heap_bytes = 0;
+	usage->heap_bytes += _imu_buffer.owns_storage() ? usage->buffer_bytes[0] : 0;
+	usage->heap_bytes += _output_buffer.owns_storage() ? usage->buffer_bytes[1] : 0;
+	usage->heap_bytes += _output_vert_buffer.owns_storage() ? usage->buffer_bytes[2] : 0;
+	usage->heap_bytes += _gps_buffer.owns_storage() ? usage->buffer_bytes[3] : 0;
+	usage->heap_bytes += _mag_buffer.owns_storage() ? usage->buffer_bytes[4] : 0;
+	usage->heap_bytes += _baro_buffer.owns_storage() ? usage->buffer_bytes[5] : 0;
+	usage->heap_bytes += _range_buffer.owns_storage() ? usage->buffer_bytes[6] : 0;
+	usage->heap_bytes += _airspeed_buffer.owns_storage() ? usage->buffer_bytes[7] : 0;
+	usage->heap_bytes += _flow_buffer.owns_storage() ? usage->buffer_bytes[8] : 0;
+	usage->heap_bytes += _ext_vision_buffer.owns_storage() ? usage->buffer_bytes[9] : 0;
+	usage->heap_bytes += _drag_buffer.owns_storage() ? usage->buffer_bytes[10] : 0;
+	usage->heap_bytes += _auxvel_buffer.owns_storage() ? usage->buffer_bytes[11] : 0;
+
+	usage->arena_bytes = _sample_arena_bytes;
+	usage->object_bytes = (uint32_t)objectSize();
+	usage->total_bytes = usage->object_bytes + usage->arena_bytes + usage->heap_bytes;
+
+	if (usage->total_bytes > _peak_total_bytes) {
+		_peak_total_bytes = usage->total_bytes;
+	}
+
+	usage->peak_total_bytes = _peak_total_bytes;
+}
@@ -39,6 +39,8 @@
  *
  */
 
+#pragma once
+
 #include "common.h"
 #include "RingBuffer.h"
 
@@ -49,12 +51,14 @@
 
 using namespace estimator;
 
+struct checkpointCursor;
+
 class EstimatorInterface
 {
 
 public:
 	EstimatorInterface() = default;
-	virtual ~EstimatorInterface() = default;
+	virtual ~EstimatorInterface() { unallocate_buffers(); }
 
 	virtual bool init(uint64_t timestamp) = 0;
 	virtual bool update() = 0;
@@ -175,12 +179,26 @@ public:
 	// set delta angle imu data
 	void setIMUData(uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt, float (&delta_ang)[3], float (&delta_vel)[3]);
 
+	// set a batch of consecutive delta angle imu samples, e.g. a sensor FIFO burst read,
+	// in one call so the downsampling accumulators stay hot across the batch
+	void setIMUData(unsigned count, const uint64_t *time_usec, const uint64_t *delta_ang_dt,
+			const uint64_t *delta_vel_dt, const float (*delta_ang)[3], const float (*delta_vel)[3]);
+
 	// set magnetometer data
 	void setMagData(uint64_t time_usec, float (&data)[3]);
 
 	// set gps data
 	void setGpsData(uint64_t time_usec, struct gps_message *gps);
 
+	// maximum number of receivers accepted by setGpsDataMultiReceiver()
+	static constexpr uint8_t GPS_MAX_RECEIVERS = 2;
+
+	// set gps data from one of multiple receivers
+	// the receivers are blended into a single observation weighted by their reported
+	// horizontal position accuracy, with automatic fail-over when a receiver loses
+	// its fix or stops reporting. instance must be less than GPS_MAX_RECEIVERS.
+	void setGpsDataMultiReceiver(uint64_t time_usec, struct gps_message *gps, uint8_t instance);
+
 	// set baro data
 	void setBaroData(uint64_t time_usec, float data);
 
@@ -190,6 +208,10 @@ public:
 	// set range data
 	void setRangeData(uint64_t time_usec, float data);
 
+	// set multi-zone range data - all zones share one timestamp and are fused
+	// as a batch by the terrain estimator
+	void setRangeDataMultiZone(uint64_t time_usec, const float *data, unsigned num_zones);
+
 	// set optical flow data
 	// if optical flow sensor gyro delta angles are not available, set gyroXYZ vector fields to NaN and the EKF will use its internal delta angle data instead
 	void setOpticalFlowData(uint64_t time_usec, flow_message *flow);
@@ -394,13 +416,59 @@ public:
 
 	void print_status();
 
-	static constexpr unsigned FILTER_UPDATE_PERIOD_MS{8};	// ekf prediction period in milliseconds - this should ideally be an integer multiple of the IMU time delta
+	// number of data buffers reported by get_memory_usage(), in the order the
+	// storage is carved from the arena
+	static constexpr uint8_t MEM_NUM_BUFFERS = 12;
+
+	// memory accounting report filled by get_memory_usage(). All figures are in
+	// bytes; the sample storage of each buffer is reported individually so the
+	// effect of the buffer length and sensor delay parameters on RAM can be
+	// predicted deterministically instead of read off a map file.
+	struct memoryUsage {
+		uint32_t buffer_bytes[MEM_NUM_BUFFERS];	///< sample and timestamp storage of each data buffer, named by memory_buffer_name()
+		uint32_t output_predictor_bytes;	///< subtotal of the buffers sized by the IMU delay (imu, output, output vert)
+		uint32_t observation_bytes;		///< subtotal of the buffers sized by the observation interval
+		uint32_t arena_bytes;			///< size of the contiguous arena backing the buffer storage
+		uint32_t heap_bytes;			///< storage allocated outside the arena by individual buffers
+		uint32_t object_bytes;			///< size of the estimator object itself, including all buffer bookkeeping
+		uint32_t total_bytes;			///< object_bytes + arena_bytes + heap_bytes
+		uint32_t peak_total_bytes;		///< largest total observed since construction, survives re-initialisation
+	};
+
+	// name of a memoryUsage::buffer_bytes slot, e.g. for report printing
+	static const char *memory_buffer_name(uint8_t index);
+
+	// fill a memory accounting report covering all allocations made by the library
+	void get_memory_usage(memoryUsage *usage);
+
+	// ekf prediction period in milliseconds - this should ideally be an integer multiple of the IMU time delta
+	// can be overridden at build time (cmake -DEKF_FILTER_UPDATE_PERIOD_MS=4) to build library
+	// variants with a shorter or longer fusion horizon; every derived quantity (buffer
+	// lengths, downsampling thresholds, dt seeding) follows this constant at compile time
+#ifndef EKF_FILTER_UPDATE_PERIOD_MS
+#define EKF_FILTER_UPDATE_PERIOD_MS 8
+#endif
+	static constexpr unsigned FILTER_UPDATE_PERIOD_MS{EKF_FILTER_UPDATE_PERIOD_MS};
 	static constexpr float FILTER_UPDATE_PERIOD_S{FILTER_UPDATE_PERIOD_MS * 0.001f};
 
+	static_assert(FILTER_UPDATE_PERIOD_MS >= 1 && FILTER_UPDATE_PERIOD_MS <= 100,
+		      "EKF_FILTER_UPDATE_PERIOD_MS out of range");
+
 protected:
 
 	parameters _params;		// filter parameters
 
+	// calculate the optical flow LOS rate observation variance ((rad/sec)**2) from the
+	// sensor quality metric, scaling the tuning noise linearly across the quality range.
+	// Run on ingestion so the fusion hot path consumes a ready-to-use variance
+	float calcOptFlowMeasVar(uint8_t quality);
+
+	// filter the vibration deltas accumulated since the last EKF cycle into
+	// _vibe_metrics and run the on ground movement detection, using the supplied raw
+	// IMU sample for the angular rate check. Called once per downsampled cycle so the
+	// square roots and filter passes are off the per sample ingestion path
+	void updateVibeMetrics(const imuSample &imu);
+
 	/*
 	 OBS_BUFFER_LENGTH defines how many observations (non-IMU measurements) we can buffer
 	 which sets the maximum frequency at which we can process non-IMU measurements. Measurements that
@@ -420,6 +488,21 @@ protected:
 
 	unsigned _min_obs_interval_us{0}; // minimum time interval between observations that will guarantee data is not lost (usec)
 
+	// shortest time observed between accepted samples for each observation stream, used to
+	// adapt the observation buffer lengths to the rates the sensors actually deliver (usec)
+	// zero when no interval has been measured yet
+	uint32_t _gps_interval_us{0};
+	uint32_t _mag_interval_us{0};
+	uint32_t _baro_interval_us{0};
+	uint32_t _range_interval_us{0};
+	uint32_t _airspeed_interval_us{0};
+	uint32_t _flow_interval_us{0};
+	uint32_t _ev_interval_us{0};
+	uint32_t _auxvel_interval_us{0};
+
+	uint32_t _obs_window_us{0};	// time window the observation buffers are required to cover (usec)
+	uint64_t _time_last_buffer_adapt{0};	// last time the buffer lengths were checked against the measured sensor rates (usec)
+
 	float _dt_imu_avg{0.0f};	// average imu update period in s
 
 	imuSample _imu_sample_delayed{};	// captures the imu sample on the delayed time horizon
@@ -466,17 +549,10 @@ protected:
 	float _gps_origin_eph{0.0f}; // horizontal position uncertainty of the GPS origin
 	float _gps_origin_epv{0.0f}; // vertical position uncertainty of the GPS origin
 	struct map_projection_reference_s _pos_ref {};   // Contains WGS-84 position latitude and longitude (radians) of the EKF origin
-	struct map_projection_reference_s _gps_pos_prev {};   // Contains WGS-84 position latitude and longitude (radians) of the previous GPS message
-	float _gps_alt_prev{0.0f};	// height from the previous GPS message (m)
-
-	// innovation consistency check monitoring ratios
-	float _yaw_test_ratio{0.0f};          // yaw innovation consistency check ratio
-	float _mag_test_ratio[3] {};      // magnetometer XYZ innovation consistency check ratios
-	float _vel_pos_test_ratio[6] {};  // velocity and position innovation consistency check ratios
-	float _tas_test_ratio{0.0f};		// tas innovation consistency check ratio
-	float _terr_test_ratio{0.0f};		// height above terrain measurement innovation consistency check ratio
-	float _beta_test_ratio{0.0f};		// sideslip innovation consistency check ratio
-	float _drag_test_ratio[2] {};	// drag innovation cinsistency check ratio
+
+	// innovation consistency check monitoring ratios for all observation types,
+	// grouped into a single structure-of-arrays bank (see innovation_test_ratios_u)
+	innovation_test_ratios_u _innov_monitor{};
 	innovation_fault_status_u _innov_check_fail_status{};
 
 	bool _is_dead_reckoning{false};		// true if we are no longer fusing measurements that constrain horizontal velocity drift
@@ -490,6 +566,8 @@ protected:
 					// [0] Level of coning vibration in the IMU delta angles (rad^2)
 					// [1] high frequency vibraton level in the IMU delta angle data (rad)
 					// [2] high frequency vibration level in the IMU delta velocity data (m/s)
+	float _vibe_accum[3] {};	// accumulated squared per sample vibration deltas awaiting the per cycle filter pass
+	uint8_t _vibe_sample_count{0};	// number of raw IMU samples accumulated in _vibe_accum
 	float _gps_drift_metrics[3] {};	// Array containing GPS drift metrics
 					// [0] Horizontal position drift rate (m/s)
 					// [1] Vertical position drift rate (m/s)
@@ -498,6 +576,15 @@ protected:
 	uint64_t _time_last_move_detect_us{0};	// timestamp of last movement detection event in microseconds
 	bool _gps_drift_updated{false};	// true when _gps_drift_metrics has been updated and is ready for retrieval
 
+	// single allocation backing the storage of all data buffers
+	uint64_t *_sample_arena{nullptr};
+	uint32_t _sample_arena_bytes{0};	///< size of the arena allocation (bytes)
+	uint32_t _peak_total_bytes{0};		///< largest total allocation observed since construction (bytes)
+
+	// size of the concrete estimator object, so the memory accounting covers the
+	// derived class including all in-object buffer bookkeeping
+	virtual size_t objectSize() const { return sizeof(*this); }
+
 	// data buffer instances
 	RingBuffer<imuSample> _imu_buffer;
 	RingBuffer<gpsSample> _gps_buffer;
@@ -523,6 +610,22 @@ protected:
 	bool _drag_buffer_fail{false};
 	bool _auxvel_buffer_fail{false};
 
+	// a receiver no longer contributes to the blended GPS observation when it has
+	// not reported for this long (uSec)
+	static constexpr uint64_t GPS_RECEIVER_TIMEOUT_US = 500000;
+
+	// most recent message and arrival time from each receiver feeding the dual
+	// receiver blending stage in setGpsDataMultiReceiver()
+	struct {
+		gps_message msg[GPS_MAX_RECEIVERS] {};
+		uint64_t time_last_arrival_us[GPS_MAX_RECEIVERS] {};
+	} _gps_blend;
+
+	// staging area for the current horizon fast fusion path, which corrects the
+	// output predictor states directly and bypasses the delay horizon buffer
+	auxVelSample _auxvel_direct_sample {};
+	bool _auxvel_direct_ready{false};
+
 	uint64_t _time_last_imu{0};	// timestamp of last imu sample in microseconds
 	uint64_t _time_last_gps{0};	// timestamp of last gps measurement in microseconds
 	uint64_t _time_last_mag{0};	// timestamp of last magnetometer measurement in microseconds
@@ -530,6 +633,40 @@ protected:
 	uint64_t _time_last_range{0};	// timestamp of last range measurement in microseconds
 	uint64_t _time_last_airspeed{0};	// timestamp of last airspeed measurement in microseconds
 	uint64_t _time_last_ext_vision{0}; // timestamp of last external vision measurement in microseconds
+
+	// accumulator used by setExtVisionData() to downsample high rate external
+	// vision input to the fusion rate on ingest - the buffer then stores one
+	// pre-averaged sample per observation interval instead of dropping the
+	// surplus samples
+	struct {
+		float pos_sum[3] {};		///< sum of the NED position measurements (m)
+		float quat_sum[4] {};		///< component wise sum of the sign aligned quaternions
+		float quat_ref[4] {};		///< first quaternion of the interval used for sign alignment
+		float pos_err_sum{0.0f};	///< sum of the position accuracies (m)
+		float ang_err_sum{0.0f};	///< sum of the angular errors (rad)
+		uint64_t time_first_us{0};	///< timestamp of the first sample of the interval (uSec)
+		uint64_t time_offset_sum_us{0};	///< sum of the sample time offsets from time_first_us (uSec)
+		unsigned count{0};		///< number of samples accumulated
+	} _ev_downsample;
+
+	// accumulator used by setMagData() to average a high rate magnetometer feed
+	// down to the fusion rate on ingest - each stored sample then carries a lower
+	// noise measurement at no extra cost to the fusion path
+	struct {
+		Vector3f mag_sum;		///< sum of the magnetometer measurements (Gauss)
+		uint64_t time_first_us{0};	///< timestamp of the first sample of the interval (uSec)
+		uint64_t time_offset_sum_us{0};	///< sum of the sample time offsets from time_first_us (uSec)
+		unsigned count{0};		///< number of samples accumulated
+	} _mag_downsample;
+
+	// accumulator used by setBaroData(), same scheme as _mag_downsample
+	struct {
+		float hgt_sum{0.0f};		///< sum of the pressure altitude measurements (m)
+		uint64_t time_first_us{0};	///< timestamp of the first sample of the interval (uSec)
+		uint64_t time_offset_sum_us{0};	///< sum of the sample time offsets from time_first_us (uSec)
+		unsigned count{0};		///< number of samples accumulated
+	} _baro_downsample;
+
 	uint64_t _time_last_optflow{0};
 	uint64_t _time_last_gnd_effect_on{0};	//last time the baro ground effect compensation was turned on externally (uSec)
 	uint64_t _time_last_auxvel{0};
@@ -542,6 +679,18 @@ protected:
 	// free buffer memory
 	void unallocate_buffers();
 
+	// calculate the observation buffer length needed to cover the fusion time horizon at the
+	// measured sample arrival interval, limited to the worst case length calculated at startup
+	uint8_t requiredBufferLength(uint32_t interval_us) const;
+
+	// periodically compare the observation buffer lengths against the measured sensor arrival
+	// intervals and re-carve the buffer arena so that RAM is only held for the rates actually seen
+	void updateBufferLengths(uint64_t now);
+
+	// apply the checkpoint cursor to every serialized interface field, called by
+	// Ekf::checkpointFields() ahead of the filter specific fields
+	void checkpointInterfaceFields(checkpointCursor &cursor);
+
 	float _mag_declination_gps{0.0f};         // magnetic declination returned by the geo library using the last valid GPS position (rad)
 	float _mag_declination_to_save_deg{0.0f}; // magnetic declination to save to EKF2_MAG_DECL (deg)
 
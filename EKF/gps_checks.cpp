@@ -103,139 +103,173 @@ bool Ekf::collect_gps(uint64_t time_usec, struct gps_message *gps)
 /*
  * Return true if the GPS solution quality is adequate to set an origin for the EKF
  * and start GPS aiding.
- * All activated checks must pass for 10 seconds.
+ * The checks themselves are performed by the self-contained GpsQualityChecks stage so
+ * they can also run in the ingestion context; this wrapper supplies the filter state
+ * snapshot and unpacks the result record into the reported status variables.
+*/
+bool Ekf::gps_is_good(struct gps_message *gps)
+{
+	gpsCheckInputs inputs;
+	inputs.time_us = _time_last_imu;
+	inputs.in_air = _control_status.flags.in_air;
+	inputs.at_rest = _vehicle_at_rest;
+	inputs.ekf_vel_d = _state.vel(2);
+
+	gpsCheckResult result;
+	_gps_quality.run(_params, *gps, inputs, result);
+
+	_gps_check_fail_status = result.fail_status;
+	_gps_error_norm = result.error_norm;
+	memcpy(_gps_drift_metrics, result.drift_metrics, sizeof(_gps_drift_metrics));
+	_gps_drift_updated = result.drift_updated;
+	_last_gps_fail_us = result.last_fail_us;
+	_last_gps_pass_us = result.last_pass_us;
+
+	return result.passed;
+}
+
+/*
+ * Run the GPS solution quality checks on one message.
+ * All activated checks must pass for 10 seconds before the passed flag is set.
  * Checks are activated using the EKF2_GPS_CHECK bitmask parameter
  * Checks are adjusted using the EKF2_REQ_* parameters
 */
-bool Ekf::gps_is_good(struct gps_message *gps)
+void GpsQualityChecks::run(const parameters &params, const gps_message &gps, const gpsCheckInputs &in,
+			   gpsCheckResult &out)
 {
 	// Check the fix type
-	_gps_check_fail_status.flags.fix = (gps->fix_type < 3);
+	_fail_status.flags.fix = (gps.fix_type < 3);
 
 	// Check the number of satellites
-	_gps_check_fail_status.flags.nsats = (gps->nsats < _params.req_nsats);
+	_fail_status.flags.nsats = (gps.nsats < params.req_nsats);
 
 	// Check the geometric dilution of precision
-	_gps_check_fail_status.flags.gdop = (gps->gdop > _params.req_gdop);
+	_fail_status.flags.gdop = (gps.gdop > params.req_gdop);
 
 	// Check the reported horizontal and vertical position accuracy
-	_gps_check_fail_status.flags.hacc = (gps->eph > _params.req_hacc);
-	_gps_check_fail_status.flags.vacc = (gps->epv > _params.req_vacc);
+	_fail_status.flags.hacc = (gps.eph > params.req_hacc);
+	_fail_status.flags.vacc = (gps.epv > params.req_vacc);
 
 	// Check the reported speed accuracy
-	_gps_check_fail_status.flags.sacc = (gps->sacc > _params.req_sacc);
+	_fail_status.flags.sacc = (gps.sacc > params.req_sacc);
 
 	// check if GPS quality is degraded
-	_gps_error_norm = fmaxf((gps->eph / _params.req_hacc) , (gps->epv / _params.req_vacc));
-	_gps_error_norm = fmaxf(_gps_error_norm , (gps->sacc / _params.req_sacc));
+	out.error_norm = fmaxf((gps.eph / params.req_hacc) , (gps.epv / params.req_vacc));
+	out.error_norm = fmaxf(out.error_norm , (gps.sacc / params.req_sacc));
 
 	// Calculate time lapsed since last update, limit to prevent numerical errors and calculate a lowpass filter coefficient
 	const float filt_time_const = 10.0f;
-	float dt = fminf(fmaxf(float(_time_last_imu - _gps_pos_prev.timestamp) * 1e-6f, 0.001f), filt_time_const);
+	float dt = fminf(fmaxf(float(in.time_us - _pos_prev.timestamp) * 1e-6f, 0.001f), filt_time_const);
 	float filter_coef = dt / filt_time_const;
 
 	// The following checks are only valid when the vehicle is at rest
-	double lat = gps->lat * 1.0e-7;
-	double lon = gps->lon * 1.0e-7;
-	if (!_control_status.flags.in_air && _vehicle_at_rest) {
+	double lat = gps.lat * 1.0e-7;
+	double lon = gps.lon * 1.0e-7;
+	if (!in.in_air && in.at_rest) {
 		// Calculate position movement since last measurement
 		float delta_posN = 0.0f;
 		float delta_PosE = 0.0f;
 
 		// calculate position movement since last GPS fix
-		if (_gps_pos_prev.timestamp > 0) {
-			map_projection_project(&_gps_pos_prev, lat, lon, &delta_posN, &delta_PosE);
+		if (_pos_prev.timestamp > 0) {
+			map_projection_project(&_pos_prev, lat, lon, &delta_posN, &delta_PosE);
 
 		} else {
 			// no previous position has been set
-			map_projection_init_timestamped(&_gps_pos_prev, lat, lon, _time_last_imu);
-			_gps_alt_prev = 1e-3f * (float)gps->alt;
+			map_projection_init_timestamped(&_pos_prev, lat, lon, in.time_us);
+			_alt_prev = 1e-3f * (float)gps.alt;
 
 		}
 
 		// Calculate the horizontal drift velocity components and limit to 10x the threshold
-		float vel_limit = 10.0f * _params.req_hdrift;
+		float vel_limit = 10.0f * params.req_hdrift;
 		float velN = fminf(fmaxf(delta_posN / dt, -vel_limit), vel_limit);
 		float velE = fminf(fmaxf(delta_PosE / dt, -vel_limit), vel_limit);
 
 		// Apply a low pass filter
-		_gpsDriftVelN = velN * filter_coef + _gpsDriftVelN * (1.0f - filter_coef);
-		_gpsDriftVelE = velE * filter_coef + _gpsDriftVelE * (1.0f - filter_coef);
+		_driftVelN = velN * filter_coef + _driftVelN * (1.0f - filter_coef);
+		_driftVelE = velE * filter_coef + _driftVelE * (1.0f - filter_coef);
 
 		// Calculate the horizontal drift speed and fail if too high
-		_gps_drift_metrics[0] = sqrtf(_gpsDriftVelN * _gpsDriftVelN + _gpsDriftVelE * _gpsDriftVelE);
-		_gps_check_fail_status.flags.hdrift = (_gps_drift_metrics[0] > _params.req_hdrift);
+		_drift_metrics[0] = sqrtf(_driftVelN * _driftVelN + _driftVelE * _driftVelE);
+		_fail_status.flags.hdrift = (_drift_metrics[0] > params.req_hdrift);
 
 		// Calculate the vertical drift velocity and limit to 10x the threshold
-		float vz_drift_limit = 10.0f * _params.req_vdrift;
-		float gps_alt_m = 1e-3f * (float)gps->alt;
-		float velD = math::constrain(((_gps_alt_prev - gps_alt_m) / dt), -vz_drift_limit, vz_drift_limit);
+		float vz_drift_limit = 10.0f * params.req_vdrift;
+		float gps_alt_m = 1e-3f * (float)gps.alt;
+		float velD = math::constrain(((_alt_prev - gps_alt_m) / dt), -vz_drift_limit, vz_drift_limit);
 
 		// Apply a low pass filter to the vertical velocity
-		_gps_drift_velD = velD * filter_coef + _gps_drift_velD * (1.0f - filter_coef);
+		_drift_velD = velD * filter_coef + _drift_velD * (1.0f - filter_coef);
 
 		// Fail if the vertical drift speed is too high
-		_gps_drift_metrics[1] = fabsf(_gps_drift_velD);
-		_gps_check_fail_status.flags.vdrift = (_gps_drift_metrics[1] > _params.req_vdrift);
+		_drift_metrics[1] = fabsf(_drift_velD);
+		_fail_status.flags.vdrift = (_drift_metrics[1] > params.req_vdrift);
 
 		// Check the magnitude of the filtered horizontal GPS velocity
-		float vxy_drift_limit = 10.0f * _params.req_hdrift;
-		float gps_velN = fminf(fmaxf(gps->vel_ned[0], -vxy_drift_limit), vxy_drift_limit);
-		float gps_velE = fminf(fmaxf(gps->vel_ned[1], -vxy_drift_limit), vxy_drift_limit);
-		_gps_velN_filt = gps_velN * filter_coef + _gps_velN_filt * (1.0f - filter_coef);
-		_gps_velE_filt  = gps_velE * filter_coef + _gps_velE_filt  * (1.0f - filter_coef);
-		_gps_drift_metrics[2] = sqrtf(_gps_velN_filt * _gps_velN_filt + _gps_velE_filt * _gps_velE_filt);
-		_gps_check_fail_status.flags.hspeed = (_gps_drift_metrics[2] > _params.req_hdrift);
+		float vxy_drift_limit = 10.0f * params.req_hdrift;
+		float gps_velN = fminf(fmaxf(gps.vel_ned[0], -vxy_drift_limit), vxy_drift_limit);
+		float gps_velE = fminf(fmaxf(gps.vel_ned[1], -vxy_drift_limit), vxy_drift_limit);
+		_velN_filt = gps_velN * filter_coef + _velN_filt * (1.0f - filter_coef);
+		_velE_filt  = gps_velE * filter_coef + _velE_filt  * (1.0f - filter_coef);
+		_drift_metrics[2] = sqrtf(_velN_filt * _velN_filt + _velE_filt * _velE_filt);
+		_fail_status.flags.hspeed = (_drift_metrics[2] > params.req_hdrift);
 
-		_gps_drift_updated = true;
+		out.drift_updated = true;
 
-	} else if (_control_status.flags.in_air) {
+	} else if (in.in_air) {
 		// These checks are always declared as passed when flying
 		// If on ground and moving, the last result before movemenent commenced is kept
-		_gps_check_fail_status.flags.hdrift = false;
-		_gps_check_fail_status.flags.vdrift = false;
-		_gps_check_fail_status.flags.hspeed = false;
-		_gps_drift_updated = false;
+		_fail_status.flags.hdrift = false;
+		_fail_status.flags.vdrift = false;
+		_fail_status.flags.hspeed = false;
+		out.drift_updated = false;
 
 	} else {
 		// This is the case where the vehicle is on ground and IMU movement is blocking the drift calculation
-		_gps_drift_updated = true;
+		out.drift_updated = true;
 
 	}
 
 	// save GPS fix for next time
-	map_projection_init_timestamped(&_gps_pos_prev, lat, lon, _time_last_imu);
-	_gps_alt_prev = 1e-3f * (float)gps->alt;
+	map_projection_init_timestamped(&_pos_prev, lat, lon, in.time_us);
+	_alt_prev = 1e-3f * (float)gps.alt;
 
 	// Check  the filtered difference between GPS and EKF vertical velocity
-	float vz_diff_limit = 10.0f * _params.req_vdrift;
-	float vertVel = fminf(fmaxf((gps->vel_ned[2] - _state.vel(2)), -vz_diff_limit), vz_diff_limit);
-	_gps_velD_diff_filt = vertVel * filter_coef + _gps_velD_diff_filt * (1.0f - filter_coef);
-	_gps_check_fail_status.flags.vspeed = (fabsf(_gps_velD_diff_filt) > _params.req_vdrift);
+	float vz_diff_limit = 10.0f * params.req_vdrift;
+	float vertVel = fminf(fmaxf((gps.vel_ned[2] - in.ekf_vel_d), -vz_diff_limit), vz_diff_limit);
+	_velD_diff_filt = vertVel * filter_coef + _velD_diff_filt * (1.0f - filter_coef);
+	_fail_status.flags.vspeed = (fabsf(_velD_diff_filt) > params.req_vdrift);
 
 	// assume failed first time through
-	if (_last_gps_fail_us == 0) {
-		_last_gps_fail_us = _time_last_imu;
+	if (_last_fail_us == 0) {
+		_last_fail_us = in.time_us;
 	}
 
 	// if any user selected checks have failed, record the fail time
 	if (
-		_gps_check_fail_status.flags.fix ||
-		(_gps_check_fail_status.flags.nsats   && (_params.gps_check_mask & MASK_GPS_NSATS)) ||
-		(_gps_check_fail_status.flags.gdop    && (_params.gps_check_mask & MASK_GPS_GDOP)) ||
-		(_gps_check_fail_status.flags.hacc    && (_params.gps_check_mask & MASK_GPS_HACC)) ||
-		(_gps_check_fail_status.flags.vacc    && (_params.gps_check_mask & MASK_GPS_VACC)) ||
-		(_gps_check_fail_status.flags.sacc    && (_params.gps_check_mask & MASK_GPS_SACC)) ||
-		(_gps_check_fail_status.flags.hdrift  && (_params.gps_check_mask & MASK_GPS_HDRIFT)) ||
-		(_gps_check_fail_status.flags.vdrift  && (_params.gps_check_mask & MASK_GPS_VDRIFT)) ||
-		(_gps_check_fail_status.flags.hspeed  && (_params.gps_check_mask & MASK_GPS_HSPD)) ||
-		(_gps_check_fail_status.flags.vspeed  && (_params.gps_check_mask & MASK_GPS_VSPD))
+		_fail_status.flags.fix ||
+		(_fail_status.flags.nsats   && (params.gps_check_mask & MASK_GPS_NSATS)) ||
+		(_fail_status.flags.gdop    && (params.gps_check_mask & MASK_GPS_GDOP)) ||
+		(_fail_status.flags.hacc    && (params.gps_check_mask & MASK_GPS_HACC)) ||
+		(_fail_status.flags.vacc    && (params.gps_check_mask & MASK_GPS_VACC)) ||
+		(_fail_status.flags.sacc    && (params.gps_check_mask & MASK_GPS_SACC)) ||
+		(_fail_status.flags.hdrift  && (params.gps_check_mask & MASK_GPS_HDRIFT)) ||
+		(_fail_status.flags.vdrift  && (params.gps_check_mask & MASK_GPS_VDRIFT)) ||
+		(_fail_status.flags.hspeed  && (params.gps_check_mask & MASK_GPS_HSPD)) ||
+		(_fail_status.flags.vspeed  && (params.gps_check_mask & MASK_GPS_VSPD))
 	) {
-		_last_gps_fail_us = _time_last_imu;
+		_last_fail_us = in.time_us;
 	} else {
-		_last_gps_pass_us = _time_last_imu;
+		_last_pass_us = in.time_us;
 	}
 
+	// deliver the persistent flags, metrics and timestamps with the result
+	out.fail_status = _fail_status;
+	memcpy(out.drift_metrics, _drift_metrics, sizeof(out.drift_metrics));
+	out.last_fail_us = _last_fail_us;
+	out.last_pass_us = _last_pass_us;
+
 	// continuous period without fail of 10 seconds required to return a healthy status
-	return (_time_last_imu - _last_gps_fail_us > (uint64_t)1e7);
+	out.passed = (in.time_us - _last_fail_us > (uint64_t)1e7);
 }
@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_quality.h
+ * Self-contained GPS solution quality check pipeline stage.
+ *
+ * The checks take the raw GPS message plus a small snapshot of filter inputs
+ * and deliver a precomputed pass/fail and metrics record; all filtered drift
+ * states live inside the stage. The stage does not touch any estimator state,
+ * so it can run wherever the GPS message is received - in the collect_gps()
+ * ingestion context on the producer thread or on a worker - instead of
+ * absorbing the drift filters and divisions into the filter update cycle.
+ */
+
+#pragma once
+
+#include "common.h"
+
+#include <geo/geo.h>
+
+using namespace estimator;
+
+// filter state snapshot the checks depend on
+struct gpsCheckInputs {
+	uint64_t time_us{0};	///< filter time the evaluation is made at (uSec)
+	bool in_air{false};	///< true when the vehicle is airborne
+	bool at_rest{false};	///< true when the vehicle is at rest
+	float ekf_vel_d{0.0f};	///< current EKF down velocity estimate (m/sec)
+};
+
+// precomputed result record delivered to the filter
+struct gpsCheckResult {
+	gps_check_fail_status_u fail_status{};	///< individual check pass/fail flags
+	float error_norm{1.0f};		///< normalised accuracy error, > 1 when degraded
+	float drift_metrics[3] {};	///< horizontal drift rate, vertical drift rate, filtered horizontal speed
+	bool drift_updated{false};	///< true when drift_metrics were updated this call
+	uint64_t last_fail_us{0};	///< time an activated check last failed (uSec)
+	uint64_t last_pass_us{0};	///< time all activated checks last passed (uSec)
+	bool passed{false};		///< true after 10 seconds without an activated check failing
+};
+
+class GpsQualityChecks
+{
+public:
+	GpsQualityChecks() = default;
+
+	// run the checks on one GPS message and fill the result record
+	// checks are activated using the gps_check_mask parameter and adjusted using the req_* parameters
+	void run(const parameters &params, const gps_message &gps, const gpsCheckInputs &in, gpsCheckResult &out);
+
+	// reset the vertical drift filter, used when the filter (re)initialises its states
+	void reset_vertical_drift_filter() { _drift_velD = 0.0f; }
+
+private:
+	struct map_projection_reference_s _pos_prev {};	///< WGS-84 position of the previous GPS message
+	float _alt_prev{0.0f};		///< height from the previous GPS message (m)
+
+	// the drift related flags and metrics persist across calls because the last result
+	// before movement commenced is kept when the drift calculation is blocked
+	gps_check_fail_status_u _fail_status{};	///< individual check pass/fail flags
+	float _drift_metrics[3] {};	///< horizontal drift rate, vertical drift rate, filtered horizontal speed
+
+	float _driftVelN{0.0f};		///< GPS north position derivative (m/sec)
+	float _driftVelE{0.0f};		///< GPS east position derivative (m/sec)
+	float _drift_velD{0.0f};	///< GPS down position derivative (m/sec)
+	float _velD_diff_filt{0.0f};	///< GPS filtered Down velocity (m/sec)
+	float _velN_filt{0.0f};		///< GPS filtered North velocity (m/sec)
+	float _velE_filt{0.0f};		///< GPS filtered East velocity (m/sec)
+
+	uint64_t _last_fail_us{0};	///< last time an activated check failed (uSec)
+	uint64_t _last_pass_us{0};	///< last time all activated checks passed (uSec)
+};
@@ -0,0 +1,218 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ingest.cpp
+ * Lock free staging of sensor data arriving from a thread other than the filter thread.
+ */
+
+#ifndef __PX4_NUTTX
+
+#include "ingest.h"
+
+// stage a typed payload into a record using its native in-memory layout
+template <typename payload_type>
+static void storePayload(ingestRecord &record, uint8_t type, const payload_type &payload)
+{
+	record.type = type;
+	memcpy(record.payload, &payload, sizeof(payload));
+}
+
+// recover a typed payload from a record
+template <typename payload_type>
+static void loadPayload(const ingestRecord &record, payload_type &payload)
+{
+	memcpy(&payload, record.payload, sizeof(payload));
+}
+
+bool EkfIngest::init(uint16_t size)
+{
+	return _queue.allocate(size);
+}
+
+bool EkfIngest::pushImu(uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
+			float (&delta_ang)[3], float (&delta_vel)[3])
+{
+	replayImu imu = {};
+	imu.time_us = time_usec;
+	imu.delta_ang_dt = delta_ang_dt;
+	imu.delta_vel_dt = delta_vel_dt;
+	memcpy(imu.delta_ang, delta_ang, sizeof(imu.delta_ang));
+	memcpy(imu.delta_vel, delta_vel, sizeof(imu.delta_vel));
+
+	ingestRecord record;
+	storePayload(record, REPLAY_IMU, imu);
+
+	return _queue.push(record);
+}
+
+bool EkfIngest::pushMag(uint64_t time_usec, float (&data)[3])
+{
+	replayMag mag = {};
+	mag.time_us = time_usec;
+	memcpy(mag.mag, data, sizeof(mag.mag));
+
+	ingestRecord record;
+	storePayload(record, REPLAY_MAG, mag);
+
+	return _queue.push(record);
+}
+
+bool EkfIngest::pushBaro(uint64_t time_usec, float data)
+{
+	replayBaro baro = {};
+	baro.time_us = time_usec;
+	baro.hgt = data;
+
+	ingestRecord record;
+	storePayload(record, REPLAY_BARO, baro);
+
+	return _queue.push(record);
+}
+
+bool EkfIngest::pushGps(const gps_message &gps)
+{
+	replayGps record_gps = {};
+	record_gps.gps = gps;
+
+	ingestRecord record;
+	storePayload(record, REPLAY_GPS, record_gps);
+
+	return _queue.push(record);
+}
+
+bool EkfIngest::pushAirspeed(uint64_t time_usec, float true_airspeed, float eas2tas)
+{
+	replayAirspeed airspeed = {};
+	airspeed.time_us = time_usec;
+	airspeed.true_airspeed = true_airspeed;
+	airspeed.eas2tas = eas2tas;
+
+	ingestRecord record;
+	storePayload(record, REPLAY_AIRSPEED, airspeed);
+
+	return _queue.push(record);
+}
+
+bool EkfIngest::pushRange(uint64_t time_usec, float data)
+{
+	replayRange range = {};
+	range.time_us = time_usec;
+	range.rng = data;
+
+	ingestRecord record;
+	storePayload(record, REPLAY_RANGE, range);
+
+	return _queue.push(record);
+}
+
+bool EkfIngest::pushFlow(uint64_t time_usec, const flow_message &flow)
+{
+	replayFlow record_flow = {};
+	record_flow.time_us = time_usec;
+	record_flow.flow = flow;
+
+	ingestRecord record;
+	storePayload(record, REPLAY_FLOW, record_flow);
+
+	return _queue.push(record);
+}
+
+uint16_t EkfIngest::drainTo(Ekf &ekf)
+{
+	uint16_t drained = 0;
+	ingestRecord record;
+
+	while (_queue.pop(&record)) {
+		switch (record.type) {
+		case REPLAY_IMU: {
+				replayImu imu = {};
+				loadPayload(record, imu);
+				ekf.setIMUData(imu.time_us, imu.delta_ang_dt, imu.delta_vel_dt, imu.delta_ang, imu.delta_vel);
+				break;
+			}
+
+		case REPLAY_MAG: {
+				replayMag mag = {};
+				loadPayload(record, mag);
+				ekf.setMagData(mag.time_us, mag.mag);
+				break;
+			}
+
+		case REPLAY_BARO: {
+				replayBaro baro = {};
+				loadPayload(record, baro);
+				ekf.setBaroData(baro.time_us, baro.hgt);
+				break;
+			}
+
+		case REPLAY_GPS: {
+				replayGps gps = {};
+				loadPayload(record, gps);
+				ekf.setGpsData(gps.gps.time_usec, &gps.gps);
+				break;
+			}
+
+		case REPLAY_AIRSPEED: {
+				replayAirspeed airspeed = {};
+				loadPayload(record, airspeed);
+				ekf.setAirspeedData(airspeed.time_us, airspeed.true_airspeed, airspeed.eas2tas);
+				break;
+			}
+
+		case REPLAY_RANGE: {
+				replayRange range = {};
+				loadPayload(record, range);
+				ekf.setRangeData(range.time_us, range.rng);
+				break;
+			}
+
+		case REPLAY_FLOW: {
+				replayFlow flow = {};
+				loadPayload(record, flow);
+				ekf.setOpticalFlowData(flow.time_us, &flow.flow);
+				break;
+			}
+
+		default:
+			break;
+		}
+
+		drained++;
+	}
+
+	return drained;
+}
+
+#endif // !__PX4_NUTTX
@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ingest.h
+ * Lock free staging of sensor data arriving from a thread other than the filter thread.
+ *
+ * The EstimatorInterface setters assume single threaded access, which forces
+ * integrations that sample sensors from their own threads to serialize every
+ * push behind the mutex protecting the filter update. EkfIngest stages the raw
+ * setter arguments in a wait free single producer single consumer queue
+ * instead: the sensor thread pushes without ever contending with the filter
+ * thread, and the filter thread drains the staged records into the setters at
+ * the start of its cycle.
+ *
+ * Use one EkfIngest per producer thread and drain all of them before calling
+ * update(). The staged records reuse the replay payload layouts.
+ */
+
+#pragma once
+
+#include "replay.h"
+
+#include "SpscQueue.h"
+
+// size of the largest staged payload
+static constexpr size_t INGEST_MAX_PAYLOAD = sizeof(replayGps) > sizeof(replayFlow)
+		? (sizeof(replayGps) > sizeof(replayImu) ? sizeof(replayGps) : sizeof(replayImu))
+		: (sizeof(replayFlow) > sizeof(replayImu) ? sizeof(replayFlow) : sizeof(replayImu));
+
+// a single staged sensor input
+// the payload is stored as raw bytes so that sample types containing matrix vectors
+// can share one fixed size slot, using the same native layouts as the replay records
+struct ingestRecord {
+	uint64_t payload[(INGEST_MAX_PAYLOAD + 7) / 8];	///< payload bytes, kept 8 byte aligned
+	uint8_t type;					///< replayRecordType of the payload
+};
+
+class EkfIngest
+{
+public:
+	EkfIngest() = default;
+	~EkfIngest() = default;
+
+	// no copy, assignment, move, move assignment
+	EkfIngest(const EkfIngest &) = delete;
+	EkfIngest &operator=(const EkfIngest &) = delete;
+	EkfIngest(EkfIngest &&) = delete;
+	EkfIngest &operator=(EkfIngest &&) = delete;
+
+	// allocate a queue able to stage the given number of records
+	bool init(uint16_t size);
+
+	// producer side - called from the sensor thread, never blocks
+	// returns false when the queue is full and the sample is dropped
+	bool pushImu(uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
+		     float (&delta_ang)[3], float (&delta_vel)[3]);
+	bool pushMag(uint64_t time_usec, float (&data)[3]);
+	bool pushBaro(uint64_t time_usec, float data);
+	bool pushGps(const gps_message &gps);
+	bool pushAirspeed(uint64_t time_usec, float true_airspeed, float eas2tas);
+	bool pushRange(uint64_t time_usec, float data);
+	bool pushFlow(uint64_t time_usec, const flow_message &flow);
+
+	// consumer side - called from the filter thread
+	// feeds all staged records into the filter in arrival order and returns the
+	// number of records drained
+	uint16_t drainTo(Ekf &ekf);
+
+private:
+	SpscQueue<ingestRecord> _queue;
+};
@@ -43,32 +43,41 @@
 #include "ekf.h"
 #include <ecl.h>
 #include <mathlib/mathlib.h>
+#include <mathlib/kalman_kernels.h>
+
+namespace kf = ecl::kalman;
 
 void Ekf::fuseMag()
 {
+#ifdef EKF_NO_MAG_STATES
+	// the magnetic field states are not part of this build
+	return;
+#else
 	// assign intermediate variables
 	float q0 = _state.quat_nominal(0);
 	float q1 = _state.quat_nominal(1);
 	float q2 = _state.quat_nominal(2);
 	float q3 = _state.quat_nominal(3);
 
+	// refresh the shared quaternion products (no-op if already current)
+	updateQuatProducts();
+
 	float magN = _state.mag_I(0);
 	float magE = _state.mag_I(1);
 	float magD = _state.mag_I(2);
 
 	// XYZ Measurement uncertainty. Need to consider timing errors for fast rotations
-	float R_MAG = fmaxf(_params.mag_noise, 0.0f);
-	R_MAG = R_MAG * R_MAG;
+	float R_MAG = _derived_params.mag_obs_var;
 
 	// intermediate variables from algebraic optimisation
 	float SH_MAG[9];
 	SH_MAG[0] = 2.0f*magD*q3 + 2.0f*magE*q2 + 2.0f*magN*q1;
 	SH_MAG[1] = 2.0f*magD*q0 - 2.0f*magE*q1 + 2.0f*magN*q2;
 	SH_MAG[2] = 2.0f*magD*q1 + 2.0f*magE*q0 - 2.0f*magN*q3;
-	SH_MAG[3] = sq(q3);
-	SH_MAG[4] = sq(q2);
-	SH_MAG[5] = sq(q1);
-	SH_MAG[6] = sq(q0);
+	SH_MAG[3] = _quat_prod.q3q3;
+	SH_MAG[4] = _quat_prod.q2q2;
+	SH_MAG[5] = _quat_prod.q1q1;
+	SH_MAG[6] = _quat_prod.q0q0;
 	SH_MAG[7] = 2.0f*magN*q0;
 	SH_MAG[8] = 2.0f*magE*q3;
 
@@ -83,14 +92,75 @@ void Ekf::fuseMag()
 	_mag_innov[1] = (mag_I_rot(1) + _state.mag_B(1)) - _mag_sample_delayed.mag(1);
 	_mag_innov[2] = (mag_I_rot(2) + _state.mag_B(2)) - _mag_sample_delayed.mag(2);
 
-	// Observation jacobian and Kalman gain vectors
-	float H_MAG[24];
-	float Kfusion[24];
+	// Observation jacobian rows for the three axes. Each row has the same
+	// sparsity pattern covering the quaternion states, the earth field states and
+	// one body field bias state, so the gains, innovation covariance and
+	// covariance correction are formed from these entries only.
+	const uint8_t h_index[3][8] = {
+		{0, 1, 2, 3, 16, 17, 18, 19},
+		{0, 1, 2, 3, 16, 17, 18, 20},
+		{0, 1, 2, 3, 16, 17, 18, 21}
+	};
+	float H_val[3][8];
+
+	// X axis observation jacobians
+	H_val[0][0] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
+	H_val[0][1] = SH_MAG[0];
+	H_val[0][2] = -SH_MAG[1];
+	H_val[0][3] = SH_MAG[2];
+	H_val[0][4] = SH_MAG[5] - SH_MAG[4] - SH_MAG[3] + SH_MAG[6];
+	H_val[0][5] = 2.0f*_quat_prod.q0q3 + 2.0f*_quat_prod.q1q2;
+	H_val[0][6] = 2.0f*_quat_prod.q1q3 - 2.0f*_quat_prod.q0q2;
+	H_val[0][7] = 1.0f;
+
+	// Y axis observation jacobians
+	H_val[1][0] = SH_MAG[2];
+	H_val[1][1] = SH_MAG[1];
+	H_val[1][2] = SH_MAG[0];
+	H_val[1][3] = 2.0f*magD*q2 - SH_MAG[8] - SH_MAG[7];
+	H_val[1][4] = 2.0f*_quat_prod.q1q2 - 2.0f*_quat_prod.q0q3;
+	H_val[1][5] = SH_MAG[4] - SH_MAG[3] - SH_MAG[5] + SH_MAG[6];
+	H_val[1][6] = 2.0f*_quat_prod.q0q1 + 2.0f*_quat_prod.q2q3;
+	H_val[1][7] = 1.0f;
+
+	// Z axis observation jacobians
+	H_val[2][0] = SH_MAG[1];
+	H_val[2][1] = -SH_MAG[2];
+	H_val[2][2] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
+	H_val[2][3] = SH_MAG[0];
+	H_val[2][4] = 2.0f*_quat_prod.q0q2 + 2.0f*_quat_prod.q1q3;
+	H_val[2][5] = 2.0f*_quat_prod.q2q3 - 2.0f*_quat_prod.q0q1;
+	H_val[2][6] = SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6];
+	H_val[2][7] = 1.0f;
+
+	// calculate the innovation variances S = H*P*H' + R using only the 8 state
+	// sub-block covered by the jacobian sparsity - the full P*H' product over
+	// all states is deferred until the observations have passed the innovation
+	// consistency check so a rejected sample only pays for this cheap pass
+	float S[6][6] = {};
+	float S_inv[6][6] = {};
+
+	for (uint8_t i = 0; i < 3; i++) {
+		float var = 0.0f;
+
+		for (uint8_t k = 0; k < 8; k++) {
+			float sum = 0.0f;
+
+			for (uint8_t m = 0; m < 8; m++) {
+				sum += P[h_index[i][k]][h_index[i][m]] * H_val[i][m];
+			}
 
-	// X axis innovation variance
-	_mag_innov_var[0] = (P[19][19] + R_MAG + P[1][19]*SH_MAG[0] - P[2][19]*SH_MAG[1] + P[3][19]*SH_MAG[2] - P[16][19]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + (2.0f*q0*q3 + 2.0f*q1*q2)*(P[19][17] + P[1][17]*SH_MAG[0] - P[2][17]*SH_MAG[1] + P[3][17]*SH_MAG[2] - P[16][17]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][17]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][17]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][17]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - (2.0f*q0*q2 - 2.0f*q1*q3)*(P[19][18] + P[1][18]*SH_MAG[0] - P[2][18]*SH_MAG[1] + P[3][18]*SH_MAG[2] - P[16][18]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][18]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][18]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][18]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + (SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)*(P[19][0] + P[1][0]*SH_MAG[0] - P[2][0]*SH_MAG[1] + P[3][0]*SH_MAG[2] - P[16][0]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][0]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][0]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][0]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + P[17][19]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][19]*(2.0f*q0*q2 - 2.0f*q1*q3) + SH_MAG[0]*(P[19][1] + P[1][1]*SH_MAG[0] - P[2][1]*SH_MAG[1] + P[3][1]*SH_MAG[2] - P[16][1]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][1]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][1]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][1]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - SH_MAG[1]*(P[19][2] + P[1][2]*SH_MAG[0] - P[2][2]*SH_MAG[1] + P[3][2]*SH_MAG[2] - P[16][2]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][2]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][2]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][2]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + SH_MAG[2]*(P[19][3] + P[1][3]*SH_MAG[0] - P[2][3]*SH_MAG[1] + P[3][3]*SH_MAG[2] - P[16][3]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][3]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][3]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][3]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - (SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6])*(P[19][16] + P[1][16]*SH_MAG[0] - P[2][16]*SH_MAG[1] + P[3][16]*SH_MAG[2] - P[16][16]*(SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6]) + P[17][16]*(2.0f*q0*q3 + 2.0f*q1*q2) - P[18][16]*(2.0f*q0*q2 - 2.0f*q1*q3) + P[0][16]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + P[0][19]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2));
-	// check for a badly conditioned covariance matrix
+			var += H_val[i][k] * sum;
+		}
+
+		S[i][i] = var + R_MAG;
+	}
+
+	_mag_innov_var[0] = S[0][0];
+	_mag_innov_var[1] = S[1][1];
+	_mag_innov_var[2] = S[2][2];
 
+	// check for a badly conditioned covariance matrix
 	if (_mag_innov_var[0] >= R_MAG) {
 		// the innovation variance contribution from the state covariances is non-negative - no fault
 		_fault_status.flags.bad_mag_x = false;
@@ -106,10 +176,6 @@ void Ekf::fuseMag()
 
 	}
 
-	// Y axis innovation variance
-	_mag_innov_var[1] = (P[20][20] + R_MAG + P[0][20]*SH_MAG[2] + P[1][20]*SH_MAG[1] + P[2][20]*SH_MAG[0] - P[17][20]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - (2.0f*q0*q3 - 2.0f*q1*q2)*(P[20][16] + P[0][16]*SH_MAG[2] + P[1][16]*SH_MAG[1] + P[2][16]*SH_MAG[0] - P[17][16]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][16]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][16]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][16]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + (2.0f*q0*q1 + 2.0f*q2*q3)*(P[20][18] + P[0][18]*SH_MAG[2] + P[1][18]*SH_MAG[1] + P[2][18]*SH_MAG[0] - P[17][18]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][18]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][18]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][18]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - (SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)*(P[20][3] + P[0][3]*SH_MAG[2] + P[1][3]*SH_MAG[1] + P[2][3]*SH_MAG[0] - P[17][3]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][3]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][3]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][3]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - P[16][20]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][20]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_MAG[2]*(P[20][0] + P[0][0]*SH_MAG[2] + P[1][0]*SH_MAG[1] + P[2][0]*SH_MAG[0] - P[17][0]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][0]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][0]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][0]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + SH_MAG[1]*(P[20][1] + P[0][1]*SH_MAG[2] + P[1][1]*SH_MAG[1] + P[2][1]*SH_MAG[0] - P[17][1]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][1]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][1]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][1]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + SH_MAG[0]*(P[20][2] + P[0][2]*SH_MAG[2] + P[1][2]*SH_MAG[1] + P[2][2]*SH_MAG[0] - P[17][2]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][2]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][2]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][2]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - (SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6])*(P[20][17] + P[0][17]*SH_MAG[2] + P[1][17]*SH_MAG[1] + P[2][17]*SH_MAG[0] - P[17][17]*(SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6]) - P[16][17]*(2.0f*q0*q3 - 2.0f*q1*q2) + P[18][17]*(2.0f*q0*q1 + 2.0f*q2*q3) - P[3][17]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - P[3][20]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2));
-
-	// check for a badly conditioned covariance matrix
 	if (_mag_innov_var[1] >= R_MAG) {
 		// the innovation variance contribution from the state covariances is non-negative - no fault
 		_fault_status.flags.bad_mag_y = false;
@@ -125,10 +191,6 @@ void Ekf::fuseMag()
 
 	}
 
-	// Z axis innovation variance
-	_mag_innov_var[2] = (P[21][21] + R_MAG + P[0][21]*SH_MAG[1] - P[1][21]*SH_MAG[2] + P[3][21]*SH_MAG[0] + P[18][21]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + (2.0f*q0*q2 + 2.0f*q1*q3)*(P[21][16] + P[0][16]*SH_MAG[1] - P[1][16]*SH_MAG[2] + P[3][16]*SH_MAG[0] + P[18][16]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][16]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][16]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][16]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - (2.0f*q0*q1 - 2.0f*q2*q3)*(P[21][17] + P[0][17]*SH_MAG[1] - P[1][17]*SH_MAG[2] + P[3][17]*SH_MAG[0] + P[18][17]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][17]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][17]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][17]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + (SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)*(P[21][2] + P[0][2]*SH_MAG[1] - P[1][2]*SH_MAG[2] + P[3][2]*SH_MAG[0] + P[18][2]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][2]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][2]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][2]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + P[16][21]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][21]*(2.0f*q0*q1 - 2.0f*q2*q3) + SH_MAG[1]*(P[21][0] + P[0][0]*SH_MAG[1] - P[1][0]*SH_MAG[2] + P[3][0]*SH_MAG[0] + P[18][0]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][0]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][0]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][0]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) - SH_MAG[2]*(P[21][1] + P[0][1]*SH_MAG[1] - P[1][1]*SH_MAG[2] + P[3][1]*SH_MAG[0] + P[18][1]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][1]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][1]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][1]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + SH_MAG[0]*(P[21][3] + P[0][3]*SH_MAG[1] - P[1][3]*SH_MAG[2] + P[3][3]*SH_MAG[0] + P[18][3]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][3]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][3]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][3]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + (SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6])*(P[21][18] + P[0][18]*SH_MAG[1] - P[1][18]*SH_MAG[2] + P[3][18]*SH_MAG[0] + P[18][18]*(SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6]) + P[16][18]*(2.0f*q0*q2 + 2.0f*q1*q3) - P[17][18]*(2.0f*q0*q1 - 2.0f*q2*q3) + P[2][18]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2)) + P[2][21]*(SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2));
-
-	// check for a badly conditioned covariance matrix
 	if (_mag_innov_var[2] >= R_MAG) {
 		// the innovation variance contribution from the state covariances is non-negative - no fault
 		_fault_status.flags.bad_mag_z = false;
@@ -148,9 +210,9 @@ void Ekf::fuseMag()
 	bool healthy = true;
 
 	for (uint8_t index = 0; index <= 2; index++) {
-		_mag_test_ratio[index] = sq(_mag_innov[index]) / (sq(math::max(_params.mag_innov_gate, 1.0f)) * _mag_innov_var[index]);
+		_innov_monitor.ratio.mag[index] = sq(_mag_innov[index]) / (_derived_params.mag_innov_gate_sq * _mag_innov_var[index]);
 
-		if (_mag_test_ratio[index] > 1.0f) {
+		if (_innov_monitor.ratio.mag[index] > 1.0f) {
 			healthy = false;
 			_innov_check_fail_status.value |= (1 << (index + 3));
 
@@ -160,7 +222,7 @@ void Ekf::fuseMag()
 	}
 
 	// we are no longer using heading fusion so set the reported test level to zero
-	_yaw_test_ratio = 0.0f;
+	_innov_monitor.ratio.yaw = 0.0f;
 
 	// if any axis fails, abort the mag fusion
 	if (!healthy) {
@@ -169,257 +231,130 @@ void Ekf::fuseMag()
 
 	bool update_all_states = !_control_status.flags.update_mag_states_only && !_flt_mag_align_converging;
 
-	// update the states and covariance using sequential fusion of the magnetometer components
-	for (uint8_t index = 0; index <= 2; index++) {
+	// the observations have been accepted - calculate P*H' for the three
+	// observation rows once, it is reused for the gains and the covariance correction
+	float PHt[_k_max_num_states][3];
 
-		// Calculate Kalman gains and observation jacobians
-		if (index == 0) {
-			// Calculate X axis observation jacobians
-			memset(H_MAG, 0, sizeof(H_MAG));
-			H_MAG[0] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
-			H_MAG[1] = SH_MAG[0];
-			H_MAG[2] = -SH_MAG[1];
-			H_MAG[3] = SH_MAG[2];
-			H_MAG[16] = SH_MAG[5] - SH_MAG[4] - SH_MAG[3] + SH_MAG[6];
-			H_MAG[17] = 2.0f*q0*q3 + 2.0f*q1*q2;
-			H_MAG[18] = 2.0f*q1*q3 - 2.0f*q0*q2;
-			H_MAG[19] = 1.0f;
-
-			// Calculate X axis Kalman gains
-			float SK_MX[5];
-			SK_MX[0] = 1.0f / _mag_innov_var[0];
-			SK_MX[1] = SH_MAG[3] + SH_MAG[4] - SH_MAG[5] - SH_MAG[6];
-			SK_MX[2] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
-			SK_MX[3] = 2.0f*q0*q2 - 2.0f*q1*q3;
-			SK_MX[4] = 2.0f*q0*q3 + 2.0f*q1*q2;
-
-			if (update_all_states) {
-				Kfusion[0] = SK_MX[0]*(P[0][19] + P[0][1]*SH_MAG[0] - P[0][2]*SH_MAG[1] + P[0][3]*SH_MAG[2] + P[0][0]*SK_MX[2] - P[0][16]*SK_MX[1] + P[0][17]*SK_MX[4] - P[0][18]*SK_MX[3]);
-				Kfusion[1] = SK_MX[0]*(P[1][19] + P[1][1]*SH_MAG[0] - P[1][2]*SH_MAG[1] + P[1][3]*SH_MAG[2] + P[1][0]*SK_MX[2] - P[1][16]*SK_MX[1] + P[1][17]*SK_MX[4] - P[1][18]*SK_MX[3]);
-				Kfusion[2] = SK_MX[0]*(P[2][19] + P[2][1]*SH_MAG[0] - P[2][2]*SH_MAG[1] + P[2][3]*SH_MAG[2] + P[2][0]*SK_MX[2] - P[2][16]*SK_MX[1] + P[2][17]*SK_MX[4] - P[2][18]*SK_MX[3]);
-				Kfusion[3] = SK_MX[0]*(P[3][19] + P[3][1]*SH_MAG[0] - P[3][2]*SH_MAG[1] + P[3][3]*SH_MAG[2] + P[3][0]*SK_MX[2] - P[3][16]*SK_MX[1] + P[3][17]*SK_MX[4] - P[3][18]*SK_MX[3]);
-				Kfusion[4] = SK_MX[0]*(P[4][19] + P[4][1]*SH_MAG[0] - P[4][2]*SH_MAG[1] + P[4][3]*SH_MAG[2] + P[4][0]*SK_MX[2] - P[4][16]*SK_MX[1] + P[4][17]*SK_MX[4] - P[4][18]*SK_MX[3]);
-				Kfusion[5] = SK_MX[0]*(P[5][19] + P[5][1]*SH_MAG[0] - P[5][2]*SH_MAG[1] + P[5][3]*SH_MAG[2] + P[5][0]*SK_MX[2] - P[5][16]*SK_MX[1] + P[5][17]*SK_MX[4] - P[5][18]*SK_MX[3]);
-				Kfusion[6] = SK_MX[0]*(P[6][19] + P[6][1]*SH_MAG[0] - P[6][2]*SH_MAG[1] + P[6][3]*SH_MAG[2] + P[6][0]*SK_MX[2] - P[6][16]*SK_MX[1] + P[6][17]*SK_MX[4] - P[6][18]*SK_MX[3]);
-				Kfusion[7] = SK_MX[0]*(P[7][19] + P[7][1]*SH_MAG[0] - P[7][2]*SH_MAG[1] + P[7][3]*SH_MAG[2] + P[7][0]*SK_MX[2] - P[7][16]*SK_MX[1] + P[7][17]*SK_MX[4] - P[7][18]*SK_MX[3]);
-				Kfusion[8] = SK_MX[0]*(P[8][19] + P[8][1]*SH_MAG[0] - P[8][2]*SH_MAG[1] + P[8][3]*SH_MAG[2] + P[8][0]*SK_MX[2] - P[8][16]*SK_MX[1] + P[8][17]*SK_MX[4] - P[8][18]*SK_MX[3]);
-				Kfusion[9] = SK_MX[0]*(P[9][19] + P[9][1]*SH_MAG[0] - P[9][2]*SH_MAG[1] + P[9][3]*SH_MAG[2] + P[9][0]*SK_MX[2] - P[9][16]*SK_MX[1] + P[9][17]*SK_MX[4] - P[9][18]*SK_MX[3]);
-				Kfusion[10] = SK_MX[0]*(P[10][19] + P[10][1]*SH_MAG[0] - P[10][2]*SH_MAG[1] + P[10][3]*SH_MAG[2] + P[10][0]*SK_MX[2] - P[10][16]*SK_MX[1] + P[10][17]*SK_MX[4] - P[10][18]*SK_MX[3]);
-				Kfusion[11] = SK_MX[0]*(P[11][19] + P[11][1]*SH_MAG[0] - P[11][2]*SH_MAG[1] + P[11][3]*SH_MAG[2] + P[11][0]*SK_MX[2] - P[11][16]*SK_MX[1] + P[11][17]*SK_MX[4] - P[11][18]*SK_MX[3]);
-				Kfusion[12] = SK_MX[0]*(P[12][19] + P[12][1]*SH_MAG[0] - P[12][2]*SH_MAG[1] + P[12][3]*SH_MAG[2] + P[12][0]*SK_MX[2] - P[12][16]*SK_MX[1] + P[12][17]*SK_MX[4] - P[12][18]*SK_MX[3]);
-				Kfusion[13] = SK_MX[0]*(P[13][19] + P[13][1]*SH_MAG[0] - P[13][2]*SH_MAG[1] + P[13][3]*SH_MAG[2] + P[13][0]*SK_MX[2] - P[13][16]*SK_MX[1] + P[13][17]*SK_MX[4] - P[13][18]*SK_MX[3]);
-				Kfusion[14] = SK_MX[0]*(P[14][19] + P[14][1]*SH_MAG[0] - P[14][2]*SH_MAG[1] + P[14][3]*SH_MAG[2] + P[14][0]*SK_MX[2] - P[14][16]*SK_MX[1] + P[14][17]*SK_MX[4] - P[14][18]*SK_MX[3]);
-				Kfusion[15] = SK_MX[0]*(P[15][19] + P[15][1]*SH_MAG[0] - P[15][2]*SH_MAG[1] + P[15][3]*SH_MAG[2] + P[15][0]*SK_MX[2] - P[15][16]*SK_MX[1] + P[15][17]*SK_MX[4] - P[15][18]*SK_MX[3]);
-				Kfusion[22] = SK_MX[0]*(P[22][19] + P[22][1]*SH_MAG[0] - P[22][2]*SH_MAG[1] + P[22][3]*SH_MAG[2] + P[22][0]*SK_MX[2] - P[22][16]*SK_MX[1] + P[22][17]*SK_MX[4] - P[22][18]*SK_MX[3]);
-				Kfusion[23] = SK_MX[0]*(P[23][19] + P[23][1]*SH_MAG[0] - P[23][2]*SH_MAG[1] + P[23][3]*SH_MAG[2] + P[23][0]*SK_MX[2] - P[23][16]*SK_MX[1] + P[23][17]*SK_MX[4] - P[23][18]*SK_MX[3]);
-			} else {
-				for (uint8_t i = 0; i < 16; i++) {
-					Kfusion[i] = 0.0f;
-				}
+	for (unsigned row = 0; row < _k_num_states; row++) {
+		for (uint8_t i = 0; i < 3; i++) {
+			float sum = 0.0f;
 
-				Kfusion[22] = 0.0f;
-				Kfusion[23] = 0.0f;
+			for (uint8_t k = 0; k < 8; k++) {
+				sum += P[row][h_index[i][k]] * H_val[i][k];
 			}
 
-			Kfusion[16] = SK_MX[0]*(P[16][19] + P[16][1]*SH_MAG[0] - P[16][2]*SH_MAG[1] + P[16][3]*SH_MAG[2] + P[16][0]*SK_MX[2] - P[16][16]*SK_MX[1] + P[16][17]*SK_MX[4] - P[16][18]*SK_MX[3]);
-			Kfusion[17] = SK_MX[0]*(P[17][19] + P[17][1]*SH_MAG[0] - P[17][2]*SH_MAG[1] + P[17][3]*SH_MAG[2] + P[17][0]*SK_MX[2] - P[17][16]*SK_MX[1] + P[17][17]*SK_MX[4] - P[17][18]*SK_MX[3]);
-			Kfusion[18] = SK_MX[0]*(P[18][19] + P[18][1]*SH_MAG[0] - P[18][2]*SH_MAG[1] + P[18][3]*SH_MAG[2] + P[18][0]*SK_MX[2] - P[18][16]*SK_MX[1] + P[18][17]*SK_MX[4] - P[18][18]*SK_MX[3]);
-			Kfusion[19] = SK_MX[0]*(P[19][19] + P[19][1]*SH_MAG[0] - P[19][2]*SH_MAG[1] + P[19][3]*SH_MAG[2] + P[19][0]*SK_MX[2] - P[19][16]*SK_MX[1] + P[19][17]*SK_MX[4] - P[19][18]*SK_MX[3]);
-			Kfusion[20] = SK_MX[0]*(P[20][19] + P[20][1]*SH_MAG[0] - P[20][2]*SH_MAG[1] + P[20][3]*SH_MAG[2] + P[20][0]*SK_MX[2] - P[20][16]*SK_MX[1] + P[20][17]*SK_MX[4] - P[20][18]*SK_MX[3]);
-			Kfusion[21] = SK_MX[0]*(P[21][19] + P[21][1]*SH_MAG[0] - P[21][2]*SH_MAG[1] + P[21][3]*SH_MAG[2] + P[21][0]*SK_MX[2] - P[21][16]*SK_MX[1] + P[21][17]*SK_MX[4] - P[21][18]*SK_MX[3]);
-
-		} else if (index == 1) {
-			// Calculate Y axis observation jacobians
-			memset(H_MAG, 0, sizeof(H_MAG));
-			H_MAG[0] = SH_MAG[2];
-			H_MAG[1] = SH_MAG[1];
-			H_MAG[2] = SH_MAG[0];
-			H_MAG[3] = 2.0f*magD*q2 - SH_MAG[8] - SH_MAG[7];
-			H_MAG[16] = 2.0f*q1*q2 - 2.0f*q0*q3;
-			H_MAG[17] = SH_MAG[4] - SH_MAG[3] - SH_MAG[5] + SH_MAG[6];
-			H_MAG[18] = 2.0f*q0*q1 + 2.0f*q2*q3;
-			H_MAG[20] = 1.0f;
-
-			// Calculate Y axis Kalman gains
-			float SK_MY[5];
-			SK_MY[0] = 1.0f / _mag_innov_var[1];
-			SK_MY[1] = SH_MAG[3] - SH_MAG[4] + SH_MAG[5] - SH_MAG[6];
-			SK_MY[2] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
-			SK_MY[3] = 2.0f*q0*q3 - 2.0f*q1*q2;
-			SK_MY[4] = 2.0f*q0*q1 + 2.0f*q2*q3;
-
-			if (update_all_states) {
-				Kfusion[0] = SK_MY[0]*(P[0][20] + P[0][0]*SH_MAG[2] + P[0][1]*SH_MAG[1] + P[0][2]*SH_MAG[0] - P[0][3]*SK_MY[2] - P[0][17]*SK_MY[1] - P[0][16]*SK_MY[3] + P[0][18]*SK_MY[4]);
-				Kfusion[1] = SK_MY[0]*(P[1][20] + P[1][0]*SH_MAG[2] + P[1][1]*SH_MAG[1] + P[1][2]*SH_MAG[0] - P[1][3]*SK_MY[2] - P[1][17]*SK_MY[1] - P[1][16]*SK_MY[3] + P[1][18]*SK_MY[4]);
-				Kfusion[2] = SK_MY[0]*(P[2][20] + P[2][0]*SH_MAG[2] + P[2][1]*SH_MAG[1] + P[2][2]*SH_MAG[0] - P[2][3]*SK_MY[2] - P[2][17]*SK_MY[1] - P[2][16]*SK_MY[3] + P[2][18]*SK_MY[4]);
-				Kfusion[3] = SK_MY[0]*(P[3][20] + P[3][0]*SH_MAG[2] + P[3][1]*SH_MAG[1] + P[3][2]*SH_MAG[0] - P[3][3]*SK_MY[2] - P[3][17]*SK_MY[1] - P[3][16]*SK_MY[3] + P[3][18]*SK_MY[4]);
-				Kfusion[4] = SK_MY[0]*(P[4][20] + P[4][0]*SH_MAG[2] + P[4][1]*SH_MAG[1] + P[4][2]*SH_MAG[0] - P[4][3]*SK_MY[2] - P[4][17]*SK_MY[1] - P[4][16]*SK_MY[3] + P[4][18]*SK_MY[4]);
-				Kfusion[5] = SK_MY[0]*(P[5][20] + P[5][0]*SH_MAG[2] + P[5][1]*SH_MAG[1] + P[5][2]*SH_MAG[0] - P[5][3]*SK_MY[2] - P[5][17]*SK_MY[1] - P[5][16]*SK_MY[3] + P[5][18]*SK_MY[4]);
-				Kfusion[6] = SK_MY[0]*(P[6][20] + P[6][0]*SH_MAG[2] + P[6][1]*SH_MAG[1] + P[6][2]*SH_MAG[0] - P[6][3]*SK_MY[2] - P[6][17]*SK_MY[1] - P[6][16]*SK_MY[3] + P[6][18]*SK_MY[4]);
-				Kfusion[7] = SK_MY[0]*(P[7][20] + P[7][0]*SH_MAG[2] + P[7][1]*SH_MAG[1] + P[7][2]*SH_MAG[0] - P[7][3]*SK_MY[2] - P[7][17]*SK_MY[1] - P[7][16]*SK_MY[3] + P[7][18]*SK_MY[4]);
-				Kfusion[8] = SK_MY[0]*(P[8][20] + P[8][0]*SH_MAG[2] + P[8][1]*SH_MAG[1] + P[8][2]*SH_MAG[0] - P[8][3]*SK_MY[2] - P[8][17]*SK_MY[1] - P[8][16]*SK_MY[3] + P[8][18]*SK_MY[4]);
-				Kfusion[9] = SK_MY[0]*(P[9][20] + P[9][0]*SH_MAG[2] + P[9][1]*SH_MAG[1] + P[9][2]*SH_MAG[0] - P[9][3]*SK_MY[2] - P[9][17]*SK_MY[1] - P[9][16]*SK_MY[3] + P[9][18]*SK_MY[4]);
-				Kfusion[10] = SK_MY[0]*(P[10][20] + P[10][0]*SH_MAG[2] + P[10][1]*SH_MAG[1] + P[10][2]*SH_MAG[0] - P[10][3]*SK_MY[2] - P[10][17]*SK_MY[1] - P[10][16]*SK_MY[3] + P[10][18]*SK_MY[4]);
-				Kfusion[11] = SK_MY[0]*(P[11][20] + P[11][0]*SH_MAG[2] + P[11][1]*SH_MAG[1] + P[11][2]*SH_MAG[0] - P[11][3]*SK_MY[2] - P[11][17]*SK_MY[1] - P[11][16]*SK_MY[3] + P[11][18]*SK_MY[4]);
-				Kfusion[12] = SK_MY[0]*(P[12][20] + P[12][0]*SH_MAG[2] + P[12][1]*SH_MAG[1] + P[12][2]*SH_MAG[0] - P[12][3]*SK_MY[2] - P[12][17]*SK_MY[1] - P[12][16]*SK_MY[3] + P[12][18]*SK_MY[4]);
-				Kfusion[13] = SK_MY[0]*(P[13][20] + P[13][0]*SH_MAG[2] + P[13][1]*SH_MAG[1] + P[13][2]*SH_MAG[0] - P[13][3]*SK_MY[2] - P[13][17]*SK_MY[1] - P[13][16]*SK_MY[3] + P[13][18]*SK_MY[4]);
-				Kfusion[14] = SK_MY[0]*(P[14][20] + P[14][0]*SH_MAG[2] + P[14][1]*SH_MAG[1] + P[14][2]*SH_MAG[0] - P[14][3]*SK_MY[2] - P[14][17]*SK_MY[1] - P[14][16]*SK_MY[3] + P[14][18]*SK_MY[4]);
-				Kfusion[15] = SK_MY[0]*(P[15][20] + P[15][0]*SH_MAG[2] + P[15][1]*SH_MAG[1] + P[15][2]*SH_MAG[0] - P[15][3]*SK_MY[2] - P[15][17]*SK_MY[1] - P[15][16]*SK_MY[3] + P[15][18]*SK_MY[4]);
-				Kfusion[22] = SK_MY[0]*(P[22][20] + P[22][0]*SH_MAG[2] + P[22][1]*SH_MAG[1] + P[22][2]*SH_MAG[0] - P[22][3]*SK_MY[2] - P[22][17]*SK_MY[1] - P[22][16]*SK_MY[3] + P[22][18]*SK_MY[4]);
-				Kfusion[23] = SK_MY[0]*(P[23][20] + P[23][0]*SH_MAG[2] + P[23][1]*SH_MAG[1] + P[23][2]*SH_MAG[0] - P[23][3]*SK_MY[2] - P[23][17]*SK_MY[1] - P[23][16]*SK_MY[3] + P[23][18]*SK_MY[4]);
-			} else {
-				for (uint8_t i = 0; i < 16; i++) {
-					Kfusion[i] = 0.0f;
-				}
+			PHt[row][i] = sum;
+		}
+	}
 
-				Kfusion[22] = 0.0f;
-				Kfusion[23] = 0.0f;
+	// fill in the axis to axis cross covariances required for the combined update
+	for (uint8_t i = 0; i < 3; i++) {
+		for (uint8_t j = 0; j < 3; j++) {
+			if (i == j) {
+				continue;
 			}
 
-			Kfusion[16] = SK_MY[0]*(P[16][20] + P[16][0]*SH_MAG[2] + P[16][1]*SH_MAG[1] + P[16][2]*SH_MAG[0] - P[16][3]*SK_MY[2] - P[16][17]*SK_MY[1] - P[16][16]*SK_MY[3] + P[16][18]*SK_MY[4]);
-			Kfusion[17] = SK_MY[0]*(P[17][20] + P[17][0]*SH_MAG[2] + P[17][1]*SH_MAG[1] + P[17][2]*SH_MAG[0] - P[17][3]*SK_MY[2] - P[17][17]*SK_MY[1] - P[17][16]*SK_MY[3] + P[17][18]*SK_MY[4]);
-			Kfusion[18] = SK_MY[0]*(P[18][20] + P[18][0]*SH_MAG[2] + P[18][1]*SH_MAG[1] + P[18][2]*SH_MAG[0] - P[18][3]*SK_MY[2] - P[18][17]*SK_MY[1] - P[18][16]*SK_MY[3] + P[18][18]*SK_MY[4]);
-			Kfusion[19] = SK_MY[0]*(P[19][20] + P[19][0]*SH_MAG[2] + P[19][1]*SH_MAG[1] + P[19][2]*SH_MAG[0] - P[19][3]*SK_MY[2] - P[19][17]*SK_MY[1] - P[19][16]*SK_MY[3] + P[19][18]*SK_MY[4]);
-			Kfusion[20] = SK_MY[0]*(P[20][20] + P[20][0]*SH_MAG[2] + P[20][1]*SH_MAG[1] + P[20][2]*SH_MAG[0] - P[20][3]*SK_MY[2] - P[20][17]*SK_MY[1] - P[20][16]*SK_MY[3] + P[20][18]*SK_MY[4]);
-			Kfusion[21] = SK_MY[0]*(P[21][20] + P[21][0]*SH_MAG[2] + P[21][1]*SH_MAG[1] + P[21][2]*SH_MAG[0] - P[21][3]*SK_MY[2] - P[21][17]*SK_MY[1] - P[21][16]*SK_MY[3] + P[21][18]*SK_MY[4]);
-
-		} else if (index == 2) {
-			// calculate Z axis observation jacobians
-			memset(H_MAG, 0, sizeof(H_MAG));
-			H_MAG[0] = SH_MAG[1];
-			H_MAG[1] = -SH_MAG[2];
-			H_MAG[2] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
-			H_MAG[3] = SH_MAG[0];
-			H_MAG[16] = 2.0f*q0*q2 + 2.0f*q1*q3;
-			H_MAG[17] = 2.0f*q2*q3 - 2.0f*q0*q1;
-			H_MAG[18] = SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6];
-			H_MAG[21] = 1.0f;
-
-			// Calculate Z axis Kalman gains
-			float SK_MZ[5];
-			SK_MZ[0] = 1.0f / _mag_innov_var[2];
-			SK_MZ[1] = SH_MAG[3] - SH_MAG[4] - SH_MAG[5] + SH_MAG[6];
-			SK_MZ[2] = SH_MAG[7] + SH_MAG[8] - 2.0f*magD*q2;
-			SK_MZ[3] = 2.0f*q0*q1 - 2.0f*q2*q3;
-			SK_MZ[4] = 2.0f*q0*q2 + 2.0f*q1*q3;
-
-			if (update_all_states) {
-				Kfusion[0] = SK_MZ[0]*(P[0][21] + P[0][0]*SH_MAG[1] - P[0][1]*SH_MAG[2] + P[0][3]*SH_MAG[0] + P[0][2]*SK_MZ[2] + P[0][18]*SK_MZ[1] + P[0][16]*SK_MZ[4] - P[0][17]*SK_MZ[3]);
-				Kfusion[1] = SK_MZ[0]*(P[1][21] + P[1][0]*SH_MAG[1] - P[1][1]*SH_MAG[2] + P[1][3]*SH_MAG[0] + P[1][2]*SK_MZ[2] + P[1][18]*SK_MZ[1] + P[1][16]*SK_MZ[4] - P[1][17]*SK_MZ[3]);
-				Kfusion[2] = SK_MZ[0]*(P[2][21] + P[2][0]*SH_MAG[1] - P[2][1]*SH_MAG[2] + P[2][3]*SH_MAG[0] + P[2][2]*SK_MZ[2] + P[2][18]*SK_MZ[1] + P[2][16]*SK_MZ[4] - P[2][17]*SK_MZ[3]);
-				Kfusion[3] = SK_MZ[0]*(P[3][21] + P[3][0]*SH_MAG[1] - P[3][1]*SH_MAG[2] + P[3][3]*SH_MAG[0] + P[3][2]*SK_MZ[2] + P[3][18]*SK_MZ[1] + P[3][16]*SK_MZ[4] - P[3][17]*SK_MZ[3]);
-				Kfusion[4] = SK_MZ[0]*(P[4][21] + P[4][0]*SH_MAG[1] - P[4][1]*SH_MAG[2] + P[4][3]*SH_MAG[0] + P[4][2]*SK_MZ[2] + P[4][18]*SK_MZ[1] + P[4][16]*SK_MZ[4] - P[4][17]*SK_MZ[3]);
-				Kfusion[5] = SK_MZ[0]*(P[5][21] + P[5][0]*SH_MAG[1] - P[5][1]*SH_MAG[2] + P[5][3]*SH_MAG[0] + P[5][2]*SK_MZ[2] + P[5][18]*SK_MZ[1] + P[5][16]*SK_MZ[4] - P[5][17]*SK_MZ[3]);
-				Kfusion[6] = SK_MZ[0]*(P[6][21] + P[6][0]*SH_MAG[1] - P[6][1]*SH_MAG[2] + P[6][3]*SH_MAG[0] + P[6][2]*SK_MZ[2] + P[6][18]*SK_MZ[1] + P[6][16]*SK_MZ[4] - P[6][17]*SK_MZ[3]);
-				Kfusion[7] = SK_MZ[0]*(P[7][21] + P[7][0]*SH_MAG[1] - P[7][1]*SH_MAG[2] + P[7][3]*SH_MAG[0] + P[7][2]*SK_MZ[2] + P[7][18]*SK_MZ[1] + P[7][16]*SK_MZ[4] - P[7][17]*SK_MZ[3]);
-				Kfusion[8] = SK_MZ[0]*(P[8][21] + P[8][0]*SH_MAG[1] - P[8][1]*SH_MAG[2] + P[8][3]*SH_MAG[0] + P[8][2]*SK_MZ[2] + P[8][18]*SK_MZ[1] + P[8][16]*SK_MZ[4] - P[8][17]*SK_MZ[3]);
-				Kfusion[9] = SK_MZ[0]*(P[9][21] + P[9][0]*SH_MAG[1] - P[9][1]*SH_MAG[2] + P[9][3]*SH_MAG[0] + P[9][2]*SK_MZ[2] + P[9][18]*SK_MZ[1] + P[9][16]*SK_MZ[4] - P[9][17]*SK_MZ[3]);
-				Kfusion[10] = SK_MZ[0]*(P[10][21] + P[10][0]*SH_MAG[1] - P[10][1]*SH_MAG[2] + P[10][3]*SH_MAG[0] + P[10][2]*SK_MZ[2] + P[10][18]*SK_MZ[1] + P[10][16]*SK_MZ[4] - P[10][17]*SK_MZ[3]);
-				Kfusion[11] = SK_MZ[0]*(P[11][21] + P[11][0]*SH_MAG[1] - P[11][1]*SH_MAG[2] + P[11][3]*SH_MAG[0] + P[11][2]*SK_MZ[2] + P[11][18]*SK_MZ[1] + P[11][16]*SK_MZ[4] - P[11][17]*SK_MZ[3]);
-				Kfusion[12] = SK_MZ[0]*(P[12][21] + P[12][0]*SH_MAG[1] - P[12][1]*SH_MAG[2] + P[12][3]*SH_MAG[0] + P[12][2]*SK_MZ[2] + P[12][18]*SK_MZ[1] + P[12][16]*SK_MZ[4] - P[12][17]*SK_MZ[3]);
-				Kfusion[13] = SK_MZ[0]*(P[13][21] + P[13][0]*SH_MAG[1] - P[13][1]*SH_MAG[2] + P[13][3]*SH_MAG[0] + P[13][2]*SK_MZ[2] + P[13][18]*SK_MZ[1] + P[13][16]*SK_MZ[4] - P[13][17]*SK_MZ[3]);
-				Kfusion[14] = SK_MZ[0]*(P[14][21] + P[14][0]*SH_MAG[1] - P[14][1]*SH_MAG[2] + P[14][3]*SH_MAG[0] + P[14][2]*SK_MZ[2] + P[14][18]*SK_MZ[1] + P[14][16]*SK_MZ[4] - P[14][17]*SK_MZ[3]);
-				Kfusion[15] = SK_MZ[0]*(P[15][21] + P[15][0]*SH_MAG[1] - P[15][1]*SH_MAG[2] + P[15][3]*SH_MAG[0] + P[15][2]*SK_MZ[2] + P[15][18]*SK_MZ[1] + P[15][16]*SK_MZ[4] - P[15][17]*SK_MZ[3]);
-				Kfusion[22] = SK_MZ[0]*(P[22][21] + P[22][0]*SH_MAG[1] - P[22][1]*SH_MAG[2] + P[22][3]*SH_MAG[0] + P[22][2]*SK_MZ[2] + P[22][18]*SK_MZ[1] + P[22][16]*SK_MZ[4] - P[22][17]*SK_MZ[3]);
-				Kfusion[23] = SK_MZ[0]*(P[23][21] + P[23][0]*SH_MAG[1] - P[23][1]*SH_MAG[2] + P[23][3]*SH_MAG[0] + P[23][2]*SK_MZ[2] + P[23][18]*SK_MZ[1] + P[23][16]*SK_MZ[4] - P[23][17]*SK_MZ[3]);
-			} else {
-				for (uint8_t i = 0; i < 16; i++) {
-					Kfusion[i] = 0.0f;
-				}
+			float sum = 0.0f;
 
-				Kfusion[22] = 0.0f;
-				Kfusion[23] = 0.0f;
+			for (uint8_t k = 0; k < 8; k++) {
+				sum += H_val[i][k] * PHt[h_index[i][k]][j];
 			}
 
-			Kfusion[16] = SK_MZ[0]*(P[16][21] + P[16][0]*SH_MAG[1] - P[16][1]*SH_MAG[2] + P[16][3]*SH_MAG[0] + P[16][2]*SK_MZ[2] + P[16][18]*SK_MZ[1] + P[16][16]*SK_MZ[4] - P[16][17]*SK_MZ[3]);
-			Kfusion[17] = SK_MZ[0]*(P[17][21] + P[17][0]*SH_MAG[1] - P[17][1]*SH_MAG[2] + P[17][3]*SH_MAG[0] + P[17][2]*SK_MZ[2] + P[17][18]*SK_MZ[1] + P[17][16]*SK_MZ[4] - P[17][17]*SK_MZ[3]);
-			Kfusion[18] = SK_MZ[0]*(P[18][21] + P[18][0]*SH_MAG[1] - P[18][1]*SH_MAG[2] + P[18][3]*SH_MAG[0] + P[18][2]*SK_MZ[2] + P[18][18]*SK_MZ[1] + P[18][16]*SK_MZ[4] - P[18][17]*SK_MZ[3]);
-			Kfusion[19] = SK_MZ[0]*(P[19][21] + P[19][0]*SH_MAG[1] - P[19][1]*SH_MAG[2] + P[19][3]*SH_MAG[0] + P[19][2]*SK_MZ[2] + P[19][18]*SK_MZ[1] + P[19][16]*SK_MZ[4] - P[19][17]*SK_MZ[3]);
-			Kfusion[20] = SK_MZ[0]*(P[20][21] + P[20][0]*SH_MAG[1] - P[20][1]*SH_MAG[2] + P[20][3]*SH_MAG[0] + P[20][2]*SK_MZ[2] + P[20][18]*SK_MZ[1] + P[20][16]*SK_MZ[4] - P[20][17]*SK_MZ[3]);
-			Kfusion[21] = SK_MZ[0]*(P[21][21] + P[21][0]*SH_MAG[1] - P[21][1]*SH_MAG[2] + P[21][3]*SH_MAG[0] + P[21][2]*SK_MZ[2] + P[21][18]*SK_MZ[1] + P[21][16]*SK_MZ[4] - P[21][17]*SK_MZ[3]);
-
-		} else {
-			return;
+			S[i][j] = sum;
 		}
+	}
 
-		// apply covariance correction via P_new = (I -K*H)*P
-		// first calculate expression for KHP
-		// then calculate P - KHP
-		float KHP[_k_num_states][_k_num_states];
-		float KH[10];
+	// invert the innovation covariance for the combined gain calculation
+	if (!inverseSymmetric(S, S_inv, 3)) {
+		// the innovation covariance is badly conditioned
+		resetMagCovariance();
+		ECL_ERR("EKF mag fusion numerical error - covariance reset");
+		return;
+	}
 
-		for (unsigned row = 0; row < _k_num_states; row++) {
+	// calculate the combined Kalman gains K = P*H'*S_inv for all three axes
+	float Kfusion[_k_max_num_states][3];
 
-			KH[0] = Kfusion[row] * H_MAG[0];
-			KH[1] = Kfusion[row] * H_MAG[1];
-			KH[2] = Kfusion[row] * H_MAG[2];
-			KH[3] = Kfusion[row] * H_MAG[3];
-			KH[4] = Kfusion[row] * H_MAG[16];
-			KH[5] = Kfusion[row] * H_MAG[17];
-			KH[6] = Kfusion[row] * H_MAG[18];
-			KH[7] = Kfusion[row] * H_MAG[19];
-			KH[8] = Kfusion[row] * H_MAG[20];
-			KH[9] = Kfusion[row] * H_MAG[21];
-
-			for (unsigned column = 0; column < _k_num_states; column++) {
-				float tmp = KH[0] * P[0][column];
-				tmp += KH[1] * P[1][column];
-				tmp += KH[2] * P[2][column];
-				tmp += KH[3] * P[3][column];
-				tmp += KH[4] * P[16][column];
-				tmp += KH[5] * P[17][column];
-				tmp += KH[6] * P[18][column];
-				tmp += KH[7] * P[19][column];
-				tmp += KH[8] * P[20][column];
-				tmp += KH[9] * P[21][column];
-				KHP[row][column] = tmp;
-			}
+	for (unsigned row = 0; row < _k_num_states; row++) {
+		if (!update_all_states && (row < 16 || row > 21)) {
+			// only the magnetic field states are allowed to be modified
+			Kfusion[row][0] = Kfusion[row][1] = Kfusion[row][2] = 0.0f;
+			continue;
 		}
 
-		// if the covariance correction will result in a negative variance, then
-		// the covariance marix is unhealthy and must be corrected
-		_fault_status.flags.bad_mag_x = false;
-		_fault_status.flags.bad_mag_y = false;
-		_fault_status.flags.bad_mag_z = false;
+		for (uint8_t i = 0; i < 3; i++) {
+			float sum = 0.0f;
 
-		for (int i = 0; i < _k_num_states; i++) {
-			if (P[i][i] < KHP[i][i]) {
-				// zero rows and columns
-				zeroRows(P, i, i);
-				zeroCols(P, i, i);
+			for (uint8_t j = 0; j < 3; j++) {
+				sum += PHt[row][j] * S_inv[j][i];
+			}
 
-				//flag as unhealthy
-				healthy = false;
+			Kfusion[row][i] = sum;
+		}
+	}
 
-				// update individual measurement health status
-				if (index == 0) {
-					_fault_status.flags.bad_mag_x = true;
+	// the covariance correction K*H*P for the combined update is the rank-3
+	// downdate K * PHt' - for symmetric P the P*H' columns already computed for
+	// the gains are the H*P rows the correction needs
 
-				} else if (index == 1) {
-					_fault_status.flags.bad_mag_y = true;
+	// if the covariance correction will result in a negative variance, then
+	// the covariance marix is unhealthy and must be corrected
+	healthy = healthy && kf::rankKDowndateHealthy(P, Kfusion, PHt, 3, _k_num_states);
 
-				} else if (index == 2) {
-					_fault_status.flags.bad_mag_z = true;
-				}
+	// the combined update does not attribute a fault to a single axis
+	_fault_status.flags.bad_mag_x = !healthy;
+	_fault_status.flags.bad_mag_y = !healthy;
+	_fault_status.flags.bad_mag_z = !healthy;
+
+	if (!healthy) {
+		// zero the rows and columns of any state whose variance would have been
+		// driven negative by the correction
+		for (int i = 0; i < _k_num_states; i++) {
+			const float diag = Kfusion[i][0] * PHt[i][0] + Kfusion[i][1] * PHt[i][1]
+					   + Kfusion[i][2] * PHt[i][2];
+
+			if (P[i][i] < diag) {
+				zeroRowsCols(P, i, i);
 			}
 		}
+	}
 
-		// only apply covariance and state corrrections if healthy
-		if (healthy) {
-			// apply the covariance corrections
-			for (unsigned row = 0; row < _k_num_states; row++) {
-				for (unsigned column = 0; column < _k_num_states; column++) {
-					P[row][column] = P[row][column] - KHP[row][column];
-				}
-			}
+	// only apply covariance and state corrrections if healthy
+	if (healthy) {
+		// apply the covariance corrections
+		kf::rankKDowndate(P, Kfusion, PHt, 3, _k_num_states);
 
-			// correct the covariance marix for gross errors
-			fixCovarianceErrors();
+		// correct the covariance marix for gross errors
+		fixCovarianceErrors();
 
-			// apply the state corrections
-			fuse(Kfusion, _mag_innov[index]);
+		// sum the state corrections for the three axes and apply them in one step
+		float K_combined[_k_max_num_states];
 
+		for (unsigned row = 0; row < _k_num_states; row++) {
+			K_combined[row] = Kfusion[row][0] * _mag_innov[0];
+			K_combined[row] += Kfusion[row][1] * _mag_innov[1];
+			K_combined[row] += Kfusion[row][2] * _mag_innov[2];
 		}
+
+		fuse(K_combined, 1.0f);
+	}
+#endif // EKF_NO_MAG_STATES
+}
+
+void Ekf::selectYawObservationSequence()
+{
+	// a 321 sequence is best when the vehicle is closer to level because the yaw
+	// observation jacobian degrades as the roll approaches the vertical, and
+	// vice-versa for a 312 sequence. Apply a 10% switching margin so the sequence
+	// is only re-selected when the attitude moves decisively into the other regime
+	const float t20 = fabsf(_R_to_earth(2, 0));
+	const float t21 = fabsf(_R_to_earth(2, 1));
+
+	if (_yaw_obs_seq_321) {
+		_yaw_obs_seq_321 = (t20 < 1.1f * t21) || (t20 < 1e-6f);
+
+	} else {
+		_yaw_obs_seq_321 = (1.1f * t20 < t21);
 	}
 }
 
@@ -437,38 +372,48 @@ void Ekf::fuseHeading()
 	Vector3f mag_earth_pred;
 	float measured_hdg;
 
-	// determine if a 321 or 312 Euler sequence is best
-	if (fabsf(_R_to_earth(2, 0)) < fabsf(_R_to_earth(2, 1))) {
-		// calculate observation jacobian when we are observing the first rotation in a 321 sequence
-		float t9 = q0*q3;
-		float t10 = q1*q2;
-		float t2 = t9+t10;
-		float t3 = q0*q0;
-		float t4 = q1*q1;
-		float t5 = q2*q2;
-		float t6 = q3*q3;
-		float t7 = t3+t4-t5-t6;
-		float t8 = t7*t7;
-		if (t8 > 1e-6f) {
-			t8 = 1.0f/t8;
-		} else {
-			return;
-		}
-		float t11 = t2*t2;
-		float t12 = t8*t11*4.0f;
-		float t13 = t12+1.0f;
-		float t14;
-		if (fabsf(t13) > 1e-6f) {
-			t14 = 1.0f/t13;
-		} else {
-			return;
-		}
+	// refresh the shared quaternion products (no-op if already current)
+	updateQuatProducts();
+
+	// re-select between the 321 and 312 Euler sequences only when the attitude has
+	// moved decisively between regimes so consecutive fusions share a linearisation
+	selectYawObservationSequence();
+
+	// calculate the observation jacobian. The autogenerated expressions for the 321
+	// and 312 sequences are identical apart from the sign of the terms involving the
+	// second and third rotations, so a single kernel evaluates either sequence with
+	// the sign selected from the cached sequence flag
+	const float ss = _yaw_obs_seq_321 ? 1.0f : -1.0f;
+	const float t3 = _quat_prod.q0q0;
+	const float t4 = _quat_prod.q1q1;
+	const float t5 = _quat_prod.q2q2;
+	const float t6 = _quat_prod.q3q3;
+	const float t2 = _quat_prod.q0q3 + ss*_quat_prod.q1q2;
+	const float t7 = t3 - t6 + ss*(t4 - t5);
+	float t8 = t7*t7;
+
+	if (t8 > 1e-6f) {
+		t8 = 1.0f/t8;
+	} else {
+		return;
+	}
+
+	const float t11 = t2*t2;
+	const float t13 = t8*t11*4.0f + 1.0f;
+	float t14;
 
-		H_YAW[0] = t8*t14*(q3*t3-q3*t4+q3*t5+q3*t6+q0*q1*q2*2.0f)*-2.0f;
-		H_YAW[1] = t8*t14*(-q2*t3+q2*t4+q2*t5+q2*t6+q0*q1*q3*2.0f)*-2.0f;
-		H_YAW[2] = t8*t14*(q1*t3+q1*t4+q1*t5-q1*t6+q0*q2*q3*2.0f)*2.0f;
-		H_YAW[3] = t8*t14*(q0*t3+q0*t4-q0*t5+q0*t6+q1*q2*q3*2.0f)*2.0f;
+	if (fabsf(t13) > 1e-6f) {
+		t14 = 1.0f/t13;
+	} else {
+		return;
+	}
+
+	H_YAW[0] = t8*t14*(q3*t3 + q3*t6 + ss*(q3*t5 - q3*t4 + q0*q1*q2*2.0f))*-2.0f;
+	H_YAW[1] = t8*t14*(q2*t4 + q2*t5 + ss*(q2*t6 - q2*t3 + q0*q1*q3*2.0f))*-2.0f;
+	H_YAW[2] = t8*t14*(q1*t4 + q1*t5 + ss*(q1*t3 - q1*t6 + q0*q2*q3*2.0f))*2.0f;
+	H_YAW[3] = t8*t14*(q0*t3 + q0*t6 + ss*(q0*t4 - q0*t5 + q1*q2*q3*2.0f))*2.0f;
 
+	if (_yaw_obs_seq_321) {
 		// rotate the magnetometer measurement into earth frame
 		Eulerf euler321(_state.quat_nominal);
 		predicted_hdg = euler321(2); // we will need the predicted heading to calculate the innovation
@@ -504,37 +449,6 @@ void Ekf::fuseHeading()
 		}
 
 	} else {
-		// calculate observaton jacobian when we are observing a rotation in a 312 sequence
-		float t9 = q0*q3;
-		float t10 = q1*q2;
-		float t2 = t9-t10;
-		float t3 = q0*q0;
-		float t4 = q1*q1;
-		float t5 = q2*q2;
-		float t6 = q3*q3;
-		float t7 = t3-t4+t5-t6;
-		float t8 = t7*t7;
-		if (t8 > 1e-6f) {
-			t8 = 1.0f/t8;
-		} else {
-			return;
-		}
-		float t11 = t2*t2;
-		float t12 = t8*t11*4.0f;
-		float t13 = t12+1.0f;
-		float t14;
-
-		if (fabsf(t13) > 1e-6f) {
-			t14 = 1.0f/t13;
-		} else {
-			return;
-		}
-
-		H_YAW[0] = t8*t14*(q3*t3+q3*t4-q3*t5+q3*t6-q0*q1*q2*2.0f)*-2.0f;
-		H_YAW[1] = t8*t14*(q2*t3+q2*t4+q2*t5-q2*t6-q0*q1*q3*2.0f)*-2.0f;
-		H_YAW[2] = t8*t14*(-q1*t3+q1*t4+q1*t5+q1*t6-q0*q2*q3*2.0f)*2.0f;
-		H_YAW[3] = t8*t14*(q0*t3-q0*t4+q0*t5+q0*t6-q1*q2*q3*2.0f)*2.0f;
-
 		/* Calculate the 312 sequence euler angles that rotate from earth to body frame
 		 * Derived from https://github.com/PX4/ecl/blob/master/matlab/scripts/Inertial%20Nav%20EKF/quat2yaw312.m
 		 * Body to nav frame transformation using a yaw-roll-pitch rotation sequence is given by:
@@ -601,7 +515,7 @@ void Ekf::fuseHeading()
 	// Calculate the observation variance
 	if (_control_status.flags.mag_hdg) {
 		// using magnetic heading tuning parameter
-		R_YAW = sq(fmaxf(_params.mag_heading_noise, 1.0e-2f));
+		R_YAW = _derived_params.mag_heading_obs_var;
 
 	} else if (_control_status.flags.ev_yaw) {
 		// using error estimate from external vision data
@@ -616,7 +530,7 @@ void Ekf::fuseHeading()
 	measured_hdg = wrap_pi(measured_hdg);
 
 	// calculate the innovation and define the innovaton gate
-	float innov_gate = math::max(_params.heading_innov_gate, 1.0f);
+	float innov_gate = _derived_params.heading_innov_gate_fl;
 	if (_mag_use_inhibit) {
 		// The magnetomer cannot be trusted but we need to fuse a heading to prevent a badly
 		// conditoned covariance matrix developing over time.
@@ -681,7 +595,7 @@ void Ekf::fuseHeading()
 
 	// calculate the Kalman gains
 	// only calculate gains for states we are using
-	float Kfusion[_k_num_states] = {};
+	float Kfusion[_k_max_num_states] = {};
 
 	for (uint8_t row = 0; row <= 15; row++) {
 		Kfusion[row] = 0.0f;
@@ -706,13 +620,13 @@ void Ekf::fuseHeading()
 	}
 
 	// innovation test ratio
-	_yaw_test_ratio = sq(_heading_innov) / (sq(innov_gate) * _heading_innov_var);
+	_innov_monitor.ratio.yaw = sq(_heading_innov) / (sq(innov_gate) * _heading_innov_var);
 
 	// we are no longer using 3-axis fusion so set the reported test levels to zero
-	memset(_mag_test_ratio, 0, sizeof(_mag_test_ratio));
+	memset(_innov_monitor.ratio.mag, 0, sizeof(_innov_monitor.ratio.mag));
 
 	// set the magnetometer unhealthy if the test fails
-	if (_yaw_test_ratio > 1.0f) {
+	if (_innov_monitor.ratio.yaw > 1.0f) {
 		_innov_check_fail_status.flags.reject_yaw = true;
 
 		// if we are in air we don't want to fuse the measurement
@@ -732,55 +646,20 @@ void Ekf::fuseHeading()
 	}
 
 	// apply covariance correction via P_new = (I -K*H)*P
-	// first calculate expression for KHP
-	// then calculate P - KHP
-	float KHP[_k_num_states][_k_num_states];
-	float KH[4];
-
-	for (unsigned row = 0; row < _k_num_states; row++) {
-
-		KH[0] = Kfusion[row] * H_YAW[0];
-		KH[1] = Kfusion[row] * H_YAW[1];
-		KH[2] = Kfusion[row] * H_YAW[2];
-		KH[3] = Kfusion[row] * H_YAW[3];
-
-		for (unsigned column = 0; column < _k_num_states; column++) {
-			float tmp = KH[0] * P[0][column];
-			tmp += KH[1] * P[1][column];
-			tmp += KH[2] * P[2][column];
-			tmp += KH[3] * P[3][column];
-			KHP[row][column] = tmp;
-		}
-	}
+	// form the H*P row once - for symmetric P the correction K*H*P is then the
+	// rank-1 outer product of the gain and this row
+	float HP[_k_max_num_states];
+	const uint8_t h_idx[4] = {0, 1, 2, 3};
+	kf::sparseRowProduct(P, H_YAW, h_idx, 4, HP, _k_num_states);
 
 	// if the covariance correction will result in a negative variance, then
 	// the covariance marix is unhealthy and must be corrected
-	bool healthy = true;
-	_fault_status.flags.bad_mag_hdg = false;
-
-	for (int i = 0; i < _k_num_states; i++) {
-		if (P[i][i] < KHP[i][i]) {
-			// zero rows and columns
-			zeroRows(P, i, i);
-			zeroCols(P, i, i);
-
-			//flag as unhealthy
-			healthy = false;
-
-			// update individual measurement health status
-			_fault_status.flags.bad_mag_hdg = true;
+	const bool healthy = kf::rankOneDowndateHealthy(P, Kfusion, HP, _k_num_states);
+	_fault_status.flags.bad_mag_hdg = !healthy;
 
-		}
-	}
-
-	// only apply covariance and state corrrections if healthy
 	if (healthy) {
 		// apply the covariance corrections
-		for (unsigned row = 0; row < _k_num_states; row++) {
-			for (unsigned column = 0; column < _k_num_states; column++) {
-				P[row][column] = P[row][column] - KHP[row][column];
-			}
-		}
+		kf::rankOneDowndate(P, Kfusion, HP, _k_num_states);
 
 		// correct the covariance marix for gross errors
 		fixCovarianceErrors();
@@ -788,11 +667,23 @@ void Ekf::fuseHeading()
 		// apply the state corrections
 		fuse(Kfusion, _heading_innov);
 
+	} else {
+		// zero the rows and columns of any state whose variance would have
+		// been driven negative by the correction
+		for (int i = 0; i < _k_num_states; i++) {
+			if (P[i][i] < Kfusion[i] * HP[i]) {
+				zeroRowsCols(P, i, i);
+			}
+		}
 	}
 }
 
 void Ekf::fuseDeclination()
 {
+#ifdef EKF_NO_MAG_STATES
+	// the magnetic field states are not part of this build
+	return;
+#else
 	// assign intermediate state variables
 	float magN = _state.mag_I(0);
 	float magE = _state.mag_I(1);
@@ -840,7 +731,7 @@ void Ekf::fuseDeclination()
 	H_DECL[17] = magN*t21;
 
 	// Calculate the Kalman gains
-	float Kfusion[_k_num_states] = {};
+	float Kfusion[_k_max_num_states] = {};
 	Kfusion[0] = -t4*t13*(P[0][16]*magE-P[0][17]*magN);
 	Kfusion[1] = -t4*t13*(P[1][16]*magE-P[1][17]*magN);
 	Kfusion[2] = -t4*t13*(P[2][16]*magE-P[2][17]*magN);
@@ -871,50 +762,22 @@ void Ekf::fuseDeclination()
 	innovation = math::constrain(innovation, -0.5f, 0.5f);
 
 	// apply covariance correction via P_new = (I -K*H)*P
-	// first calculate expression for KHP
-	// then calculate P - KHP
-	// take advantage of the empty columns in KH to reduce the number of operations
-	float KHP[_k_num_states][_k_num_states];
-	float KH[2];
-	for (unsigned row = 0; row < _k_num_states; row++) {
-
-		KH[0] = Kfusion[row] * H_DECL[16];
-		KH[1] = Kfusion[row] * H_DECL[17];
-
-		for (unsigned column = 0; column < _k_num_states; column++) {
-			float tmp = KH[0] * P[16][column];
-			tmp += KH[1] * P[17][column];
-			KHP[row][column] = tmp;
-		}
-	}
+	// form the H*P row once, taking advantage of the two non-zero jacobian
+	// entries - for symmetric P the correction K*H*P is then the rank-1 outer
+	// product of the gain and this row
+	float HP[_k_max_num_states];
+	const uint8_t h_idx[2] = {16, 17};
+	const float h_val[2] = {H_DECL[16], H_DECL[17]};
+	kf::sparseRowProduct(P, h_val, h_idx, 2, HP, _k_num_states);
 
 	// if the covariance correction will result in a negative variance, then
 	// the covariance marix is unhealthy and must be corrected
-	bool healthy = true;
-	_fault_status.flags.bad_mag_decl = false;
-	for (int i = 0; i < _k_num_states; i++) {
-		if (P[i][i] < KHP[i][i]) {
-			// zero rows and columns
-			zeroRows(P, i, i);
-			zeroCols(P, i, i);
-
-			//flag as unhealthy
-			healthy = false;
-
-			// update individual measurement health status
-			_fault_status.flags.bad_mag_decl = true;
+	const bool healthy = kf::rankOneDowndateHealthy(P, Kfusion, HP, _k_num_states);
+	_fault_status.flags.bad_mag_decl = !healthy;
 
-		}
-	}
-
-	// only apply covariance and state corrrections if healthy
 	if (healthy) {
 		// apply the covariance corrections
-		for (unsigned row = 0; row < _k_num_states; row++) {
-			for (unsigned column = 0; column < _k_num_states; column++) {
-				P[row][column] = P[row][column] - KHP[row][column];
-			}
-		}
+		kf::rankOneDowndate(P, Kfusion, HP, _k_num_states);
 
 		// correct the covariance marix for gross errors
 		fixCovarianceErrors();
@@ -922,5 +785,14 @@ void Ekf::fuseDeclination()
 		// apply the state corrections
 		fuse(Kfusion, innovation);
 
+	} else {
+		// zero the rows and columns of any state whose variance would have
+		// been driven negative by the correction
+		for (int i = 0; i < _k_num_states; i++) {
+			if (P[i][i] < Kfusion[i] * HP[i]) {
+				zeroRowsCols(P, i, i);
+			}
+		}
 	}
+#endif // EKF_NO_MAG_STATES
 }
@@ -0,0 +1,296 @@
+#!/usr/bin/env python
+"""
+cse_codegen.py - common sub-expression elimination for the auto-generated
+EKF fusion kernels.
+
+The symbolic derivations under matlab/generated emit single C statements in
+which the same algebraic sub-terms are expanded inline many times over
+(OptimiseAlgebra.m names the observation jacobian terms, but the innovation
+variance and Kalman gain statements repeat them verbatim). The C compiler
+does not fully recover the sharing at -O2, so the committed kernels pay for
+the redundancy on every fusion step.
+
+This tool re-derives the sharing mechanically. It parses the C assignment
+statements of a generated kernel, hashes every sub-expression structurally,
+and emits an equivalent statement list in which each sub-term that occurs
+more than once is computed exactly once into a named temporary. Temporaries
+are introduced strictly bottom-up and every surviving expression keeps the
+association order of the input, so the emitted kernel is bit-identical to
+the original under IEEE float evaluation - it can be diffed numerically
+against the hand-written code before being folded in.
+
+The number of temporaries is capped (--temps) so the working set stays
+within the FP register file of the small in-order cores the filter runs on;
+when the cap is hit the candidates with the smallest recomputation saving
+are inlined again.
+
+Only the Python standard library is required, so the kernels can be
+regenerated on any build machine without MATLAB or a symbolic maths
+package:
+
+    python cse_codegen.py "../generated/Inertial Nav EKF/Sideslip Fusion.txt"
+"""
+
+from __future__ import print_function
+
+import argparse
+import ast
+import re
+import sys
+
+# float literal suffix is stripped for parsing and restored when printing
+_FLOAT_SUFFIX = re.compile(r'\b(\d+\.\d*(?:[eE][-+]?\d+)?|\d+[eE][-+]?\d+)f\b')
+
+_BINOPS = {
+    ast.Add: ' + ',
+    ast.Sub: ' - ',
+    ast.Mult: '*',
+    ast.Div: '/',
+}
+
+# printing precedence - higher binds tighter
+_PREC = {
+    ast.Add: 1,
+    ast.Sub: 1,
+    ast.Mult: 2,
+    ast.Div: 2,
+}
+
+
+def parse_statements(text):
+    """Extract `lhs = rhs;` assignments from a generated kernel file.
+
+    Comments and bare declarations (`float X[n];`) are dropped. Returns a
+    list of (lhs string, rhs ast) tuples in file order.
+    """
+    # strip line comments, join continuation lines, split on ';'
+    code = re.sub(r'//[^\n]*', '', text)
+    statements = []
+
+    for raw in code.split(';'):
+        raw = ' '.join(raw.split())
+
+        if '=' not in raw:
+            continue
+
+        lhs, rhs = raw.split('=', 1)
+        lhs = lhs.strip()
+
+        # drop a leading type from combined declaration-assignments
+        if lhs.startswith('float '):
+            lhs = lhs[len('float '):].strip()
+
+        rhs = _FLOAT_SUFFIX.sub(r'\1', rhs.strip())
+
+        try:
+            tree = ast.parse(rhs, mode='eval').body
+
+        except SyntaxError:
+            print('cse_codegen: skipping unparseable statement: %s = ...' % lhs,
+                  file=sys.stderr)
+            continue
+
+        statements.append((lhs, tree))
+
+    return statements
+
+
+def node_key(node):
+    """Structural identity of a sub-expression."""
+    return ast.dump(node)
+
+
+def node_ops(node):
+    """Number of arithmetic operations in a sub-expression."""
+    return sum(1 for n in ast.walk(node)
+               if isinstance(n, (ast.BinOp, ast.UnaryOp, ast.Call)))
+
+
+def count_subexpressions(statements, counts):
+    for _, rhs in statements:
+        for node in ast.walk(rhs):
+            if isinstance(node, ast.BinOp):
+                counts[node_key(node)] = counts.get(node_key(node), 0) + 1
+
+
+def select_temporaries(statements, max_temps, min_ops):
+    """Pick the sub-expressions worth naming, best saving first."""
+    counts = {}
+    count_subexpressions(statements, counts)
+
+    samples = {}
+
+    for _, rhs in statements:
+        for node in ast.walk(rhs):
+            if isinstance(node, ast.BinOp):
+                samples.setdefault(node_key(node), node)
+
+    candidates = []
+
+    for key, count in counts.items():
+        ops = node_ops(samples[key])
+
+        if count >= 2 and ops >= min_ops:
+            # recomputation saving if this sub-expression is named
+            candidates.append(((count - 1) * ops, key))
+
+    candidates.sort(reverse=True)
+
+    return set(key for _, key in candidates[:max_temps])
+
+
+class Emitter(object):
+    """Renders the statement list back to C, defining temporaries on first
+    use and replacing later occurrences by name."""
+
+    def __init__(self, promoted, prefix):
+        self._promoted = promoted
+        self._prefix = prefix
+        self._names = {}	# sub-expression key -> C name
+        self._num_temps = 0
+        self._lines = []
+
+    def run(self, statements):
+        for lhs, rhs in statements:
+            key = node_key(rhs)
+
+            # define temporaries for repeated inner terms, but let this
+            # statement's own result provide the name for its full RHS
+            self._define_temporaries(rhs, skip=key)
+
+            if key in self._names:
+                # the derivation already computed this value - alias it
+                self._lines.append('%s = %s;' % (lhs, self._names[key]))
+
+            else:
+                self._lines.append('%s = %s;' % (lhs, self._render(rhs, top=True)))
+
+            # later statements can refer back to this result by name
+            self._names.setdefault(key, lhs)
+
+        return self._lines
+
+    def _define_temporaries(self, node, skip=None):
+        # post-order so that inner temporaries are defined first
+        for child in ast.iter_child_nodes(node):
+            self._define_temporaries(child, skip)
+
+        key = node_key(node)
+
+        if key != skip and key in self._promoted and key not in self._names:
+            name = '%s%u' % (self._prefix, self._num_temps)
+            self._num_temps += 1
+            self._lines.append('const float %s = %s;' % (name, self._render(node, top=True)))
+            self._names[key] = name
+
+    def _render(self, node, top=False):
+        if not top:
+            name = self._names.get(node_key(node))
+
+            if name is not None:
+                return name
+
+        if isinstance(node, ast.BinOp):
+            op_type = type(node.op)
+            prec = _PREC[op_type]
+            left = self._render(node.left)
+            right = self._render(node.right)
+
+            if isinstance(node.left, ast.BinOp) and _PREC[type(node.left.op)] < prec \
+			and node_key(node.left) not in self._names:
+                left = '(%s)' % left
+
+            # parenthesise the right operand whenever it would re-associate,
+            # so the input evaluation order is preserved exactly
+            if isinstance(node.right, ast.BinOp) and _PREC[type(node.right.op)] <= prec \
+			and node_key(node.right) not in self._names:
+                right = '(%s)' % right
+
+            return '%s%s%s' % (left, _BINOPS[op_type], right)
+
+        if isinstance(node, ast.UnaryOp) and isinstance(node.op, ast.USub):
+            operand = self._render(node.operand)
+
+            if isinstance(node.operand, ast.BinOp) and node_key(node.operand) not in self._names:
+                operand = '(%s)' % operand
+
+            return '-%s' % operand
+
+        if isinstance(node, ast.Call):
+            args = ', '.join(self._render(a) for a in node.args)
+            return '%s(%s)' % (self._render(node.func), args)
+
+        if isinstance(node, ast.Subscript):
+            return '%s[%s]' % (self._render(node.value), self._render_index(node.slice))
+
+        if isinstance(node, ast.Name):
+            return node.id
+
+        if isinstance(node, ast.Num):	# python < 3.8
+            return self._render_number(node.n)
+
+        if hasattr(ast, 'Constant') and isinstance(node, ast.Constant):
+            return self._render_number(node.value)
+
+        raise NotImplementedError('cannot render %s' % ast.dump(node))
+
+    def _render_index(self, node):
+        if hasattr(ast, 'Index') and isinstance(node, ast.Index):
+            node = node.value
+
+        return self._render(node)
+
+    @staticmethod
+    def _render_number(value):
+        if isinstance(value, float):
+            text = repr(value)
+
+            if 'e' not in text and '.' not in text:
+                text += '.0'
+
+            return text + 'f'
+
+        return repr(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='emit a common-subexpression-'
+                                     'eliminated version of a generated EKF fusion kernel')
+    parser.add_argument('kernel', help='generated kernel file, e.g. '
+                        '"../generated/Inertial Nav EKF/Sideslip Fusion.txt"')
+    parser.add_argument('-o', '--output', default=None,
+                        help='output file (default: stdout)')
+    parser.add_argument('--prefix', default='CS',
+                        help='temporary variable name prefix (default: CS)')
+    parser.add_argument('--temps', type=int, default=24,
+                        help='maximum number of temporaries (default: 24)')
+    parser.add_argument('--min-ops', type=int, default=1,
+                        help='smallest sub-expression worth naming, in '
+                        'arithmetic operations (default: 1)')
+    args = parser.parse_args()
+
+    with open(args.kernel) as f:
+        statements = parse_statements(f.read())
+
+    if not statements:
+        print('cse_codegen: no assignment statements found in %s' % args.kernel,
+              file=sys.stderr)
+        return 1
+
+    promoted = select_temporaries(statements, args.temps, args.min_ops)
+    lines = Emitter(promoted, args.prefix).run(statements)
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write('// generated by cse_codegen.py from %s - do not edit by hand\n' % args.kernel)
+
+    for line in lines:
+        out.write(line + '\n')
+
+    if args.output:
+        out.close()
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
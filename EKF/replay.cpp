@@ -0,0 +1,309 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file replay.cpp
+ * Faster than realtime replay of recorded sensor streams through the EKF.
+ */
+
+#ifndef __PX4_NUTTX
+
+#include "replay.h"
+
+#include <ecl.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr uint32_t REPLAY_MAGIC = 0x524C4345;	// "ECLR"
+constexpr uint32_t REPLAY_VERSION = 1;
+}
+
+EkfReplay::~EkfReplay()
+{
+	close();
+}
+
+bool EkfReplay::open(const char *filename)
+{
+	close();
+
+	const int fd = ::open(filename, O_RDONLY);
+
+	if (fd < 0) {
+		ECL_ERR("replay: failed to open %s", filename);
+		return false;
+	}
+
+	struct stat file_stat;
+
+	if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(replayFileHeader)) {
+		ECL_ERR("replay: %s is not a sensor stream", filename);
+		::close(fd);
+		return false;
+	}
+
+	// map privately so the samples can be handed to the non-const interface
+	// setters without modifying the file
+	void *data = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+	// the mapping persists after the descriptor is closed
+	::close(fd);
+
+	if (data == MAP_FAILED) {
+		ECL_ERR("replay: failed to map %s", filename);
+		return false;
+	}
+
+	const replayFileHeader *header = (const replayFileHeader *)data;
+
+	if (header->magic != REPLAY_MAGIC || header->version != REPLAY_VERSION) {
+		ECL_ERR("replay: %s is not a version %u sensor stream", filename, (unsigned)REPLAY_VERSION);
+		munmap(data, (size_t)file_stat.st_size);
+		return false;
+	}
+
+	_data = (uint8_t *)data;
+	_size = (size_t)file_stat.st_size;
+
+	return true;
+}
+
+void EkfReplay::close()
+{
+	if (_data != nullptr) {
+		munmap(_data, _size);
+		_data = nullptr;
+		_size = 0;
+	}
+}
+
+uint32_t EkfReplay::run(Ekf &ekf)
+{
+	if (_data == nullptr) {
+		return 0;
+	}
+
+	uint32_t updates = 0;
+	size_t offset = sizeof(replayFileHeader);
+
+	while (offset + sizeof(replayRecord) <= _size) {
+		const replayRecord *record = (const replayRecord *)(_data + offset);
+		uint8_t *payload = _data + offset + sizeof(replayRecord);
+
+		if (offset + sizeof(replayRecord) + record->size > _size) {
+			// truncated final record, e.g. from a recorder killed mid-write
+			break;
+		}
+
+		switch (record->type) {
+		case REPLAY_IMU: {
+				replayImu &imu = *(replayImu *)payload;
+				ekf.setIMUData(imu.time_us, imu.delta_ang_dt, imu.delta_vel_dt, imu.delta_ang, imu.delta_vel);
+
+				if (ekf.update()) {
+					updates++;
+				}
+			}
+			break;
+
+		case REPLAY_MAG: {
+				replayMag &mag = *(replayMag *)payload;
+				ekf.setMagData(mag.time_us, mag.mag);
+			}
+			break;
+
+		case REPLAY_BARO: {
+				replayBaro &baro = *(replayBaro *)payload;
+				ekf.setBaroData(baro.time_us, baro.hgt);
+			}
+			break;
+
+		case REPLAY_GPS: {
+				replayGps &gps = *(replayGps *)payload;
+				ekf.setGpsData(gps.gps.time_usec, &gps.gps);
+			}
+			break;
+
+		case REPLAY_AIRSPEED: {
+				replayAirspeed &airspeed = *(replayAirspeed *)payload;
+				ekf.setAirspeedData(airspeed.time_us, airspeed.true_airspeed, airspeed.eas2tas);
+			}
+			break;
+
+		case REPLAY_RANGE: {
+				replayRange &range = *(replayRange *)payload;
+				ekf.setRangeData(range.time_us, range.rng);
+			}
+			break;
+
+		case REPLAY_FLOW: {
+				replayFlow &flow = *(replayFlow *)payload;
+				ekf.setOpticalFlowData(flow.time_us, &flow.flow);
+			}
+			break;
+
+		default:
+			// record from a newer writer, skip it
+			break;
+		}
+
+		offset += sizeof(replayRecord) + record->size;
+	}
+
+	return updates;
+}
+
+EkfReplayRecorder::~EkfReplayRecorder()
+{
+	close();
+}
+
+bool EkfReplayRecorder::open(const char *filename)
+{
+	close();
+
+	_file = fopen(filename, "wb");
+
+	if (_file == nullptr) {
+		ECL_ERR("replay: failed to create %s", filename);
+		return false;
+	}
+
+	replayFileHeader header = {};
+	header.magic = REPLAY_MAGIC;
+	header.version = REPLAY_VERSION;
+	fwrite(&header, sizeof(header), 1, _file);
+
+	return true;
+}
+
+void EkfReplayRecorder::close()
+{
+	if (_file != nullptr) {
+		fclose(_file);
+		_file = nullptr;
+	}
+}
+
+void EkfReplayRecorder::writeRecord(uint8_t type, const void *payload, uint32_t size)
+{
+	if (_file == nullptr) {
+		return;
+	}
+
+	replayRecord record = {};
+	record.type = type;
+	record.size = size;
+	fwrite(&record, sizeof(record), 1, _file);
+	fwrite(payload, size, 1, _file);
+}
+
+void EkfReplayRecorder::recordImu(uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
+				  const float (&delta_ang)[3], const float (&delta_vel)[3])
+{
+	replayImu imu = {};
+	imu.time_us = time_usec;
+	imu.delta_ang_dt = delta_ang_dt;
+	imu.delta_vel_dt = delta_vel_dt;
+
+	for (unsigned i = 0; i < 3; i++) {
+		imu.delta_ang[i] = delta_ang[i];
+		imu.delta_vel[i] = delta_vel[i];
+	}
+
+	writeRecord(REPLAY_IMU, &imu, sizeof(imu));
+}
+
+void EkfReplayRecorder::recordMag(uint64_t time_usec, const float (&data)[3])
+{
+	replayMag mag = {};
+	mag.time_us = time_usec;
+
+	for (unsigned i = 0; i < 3; i++) {
+		mag.mag[i] = data[i];
+	}
+
+	writeRecord(REPLAY_MAG, &mag, sizeof(mag));
+}
+
+void EkfReplayRecorder::recordBaro(uint64_t time_usec, float data)
+{
+	replayBaro baro = {};
+	baro.time_us = time_usec;
+	baro.hgt = data;
+
+	writeRecord(REPLAY_BARO, &baro, sizeof(baro));
+}
+
+void EkfReplayRecorder::recordGps(const gps_message &gps)
+{
+	replayGps record = {};
+	record.gps = gps;
+
+	writeRecord(REPLAY_GPS, &record, sizeof(record));
+}
+
+void EkfReplayRecorder::recordAirspeed(uint64_t time_usec, float true_airspeed, float eas2tas)
+{
+	replayAirspeed airspeed = {};
+	airspeed.time_us = time_usec;
+	airspeed.true_airspeed = true_airspeed;
+	airspeed.eas2tas = eas2tas;
+
+	writeRecord(REPLAY_AIRSPEED, &airspeed, sizeof(airspeed));
+}
+
+void EkfReplayRecorder::recordRange(uint64_t time_usec, float data)
+{
+	replayRange range = {};
+	range.time_us = time_usec;
+	range.rng = data;
+
+	writeRecord(REPLAY_RANGE, &range, sizeof(range));
+}
+
+void EkfReplayRecorder::recordFlow(uint64_t time_usec, const flow_message &flow)
+{
+	replayFlow record = {};
+	record.time_us = time_usec;
+	record.flow = flow;
+
+	writeRecord(REPLAY_FLOW, &record, sizeof(record));
+}
+
+#endif // !__PX4_NUTTX
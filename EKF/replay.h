@@ -0,0 +1,177 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file replay.h
+ * Faster than realtime replay of recorded sensor streams through the EKF.
+ *
+ * A recorded stream is a packed sequence of timestamped sensor records.
+ * EkfReplayRecorder appends samples to a stream file in arrival order and
+ * EkfReplay memory-maps a stream and pumps the samples straight from the
+ * mapping into the filter, so a full flight replays without per-sample
+ * parsing, copies or heap allocation.
+ *
+ * The record payloads use the native in-memory layout of the sample
+ * structures, so a stream must be replayed on the same architecture and
+ * library version that recorded it. Records with an unknown type are
+ * skipped, which allows new sensor types to be appended to the format.
+ */
+
+#pragma once
+
+#include "ekf.h"
+
+#include <cstdio>
+
+// identifies the payload carried by a replay record
+enum replayRecordType : uint8_t {
+	REPLAY_IMU = 0,
+	REPLAY_MAG,
+	REPLAY_BARO,
+	REPLAY_GPS,
+	REPLAY_AIRSPEED,
+	REPLAY_RANGE,
+	REPLAY_FLOW
+};
+
+// stream file header
+struct replayFileHeader {
+	uint32_t magic;			///< REPLAY_MAGIC
+	uint32_t version;		///< REPLAY_VERSION of the writer
+};
+
+// precedes every payload in the stream, payload sizes are multiples of eight
+// bytes so all records stay naturally aligned within the mapping
+struct replayRecord {
+	uint8_t type;			///< replayRecordType of the payload
+	uint8_t pad[3];
+	uint32_t size;			///< payload size (bytes)
+};
+
+struct replayImu {
+	uint64_t time_us;		///< timestamp of the measurement (uSec)
+	uint64_t delta_ang_dt;		///< delta angle integration period (uSec)
+	uint64_t delta_vel_dt;		///< delta velocity integration period (uSec)
+	float delta_ang[3];		///< delta angle in body frame (rad)
+	float delta_vel[3];		///< delta velocity in body frame (m/sec)
+};
+
+struct replayMag {
+	uint64_t time_us;		///< timestamp of the measurement (uSec)
+	float mag[3];			///< NED magnetometer body frame measurements (Gauss)
+};
+
+struct replayBaro {
+	uint64_t time_us;		///< timestamp of the measurement (uSec)
+	float hgt;			///< barometric height (m)
+};
+
+struct replayGps {
+	gps_message gps;		///< GPS measurement, timestamped by gps.time_usec
+};
+
+struct replayAirspeed {
+	uint64_t time_us;		///< timestamp of the measurement (uSec)
+	float true_airspeed;		///< true airspeed (m/sec)
+	float eas2tas;			///< equivalent to true airspeed conversion factor
+};
+
+struct replayRange {
+	uint64_t time_us;		///< timestamp of the measurement (uSec)
+	float rng;			///< range finder distance (m)
+};
+
+struct replayFlow {
+	uint64_t time_us;		///< timestamp of the measurement (uSec)
+	flow_message flow;		///< optical flow measurement
+};
+
+class EkfReplay
+{
+public:
+	EkfReplay() = default;
+	~EkfReplay();
+
+	// disallow copy, the mapping is owned exclusively
+	EkfReplay(const EkfReplay &) = delete;
+	EkfReplay &operator=(const EkfReplay &) = delete;
+
+	// memory-map a recorded sensor stream
+	// returns false if the file cannot be mapped or is not a valid stream
+	bool open(const char *filename);
+
+	// release the mapping
+	void close();
+
+	// pump all recorded samples into the filter in recorded order, running one
+	// filter update per IMU sample
+	// returns the number of completed filter updates
+	uint32_t run(Ekf &ekf);
+
+private:
+	uint8_t *_data{nullptr};	///< mapped stream, mapped privately so samples can be handed to the non-const interface setters
+	size_t _size{0};		///< size of the mapping (bytes)
+};
+
+class EkfReplayRecorder
+{
+public:
+	EkfReplayRecorder() = default;
+	~EkfReplayRecorder();
+
+	// disallow copy, the stream file is owned exclusively
+	EkfReplayRecorder(const EkfReplayRecorder &) = delete;
+	EkfReplayRecorder &operator=(const EkfReplayRecorder &) = delete;
+
+	// create or truncate a stream file and write the file header
+	bool open(const char *filename);
+
+	// flush and close the stream file
+	void close();
+
+	// append one sample, arguments mirror the EstimatorInterface setters
+	void recordImu(uint64_t time_usec, uint64_t delta_ang_dt, uint64_t delta_vel_dt,
+		       const float (&delta_ang)[3], const float (&delta_vel)[3]);
+	void recordMag(uint64_t time_usec, const float (&data)[3]);
+	void recordBaro(uint64_t time_usec, float data);
+	void recordGps(const gps_message &gps);
+	void recordAirspeed(uint64_t time_usec, float true_airspeed, float eas2tas);
+	void recordRange(uint64_t time_usec, float data);
+	void recordFlow(uint64_t time_usec, const flow_message &flow);
+
+private:
+	// write a record header followed by its payload
+	void writeRecord(uint8_t type, const void *payload, uint32_t size);
+
+	FILE *_file{nullptr};		///< stream file being written
+};
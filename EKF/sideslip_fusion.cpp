@@ -43,9 +43,17 @@
 #include "ekf.h"
 #include <ecl.h>
 #include <mathlib/mathlib.h>
+#include <mathlib/kalman_kernels.h>
 
+namespace kf = ecl::kalman;
+
+#ifndef EKF_NO_SIDESLIP_FUSION
 void Ekf::fuseSideslip()
 {
+#ifdef EKF_NO_WIND_STATES
+	// the wind velocity states are not part of this build
+	return;
+#else
 	float SH_BETA[13] = {}; // Varialbe used to optimise calculations of measurement jacobian
 	float H_BETA[24] = {}; // Observation Jacobian
 	float SK_BETA[8] = {}; // Varialbe used to optimise calculations of the Kalman gain vector
@@ -67,24 +75,19 @@ void Ekf::fuseSideslip()
 	float vwn = _state.wind_vel(0);
 	float vwe = _state.wind_vel(1);
 
-	// relative wind velocity in earth frame
-	Vector3f rel_wind;
-	rel_wind(0) = vn - vwn;
-	rel_wind(1) = ve - vwe;
-	rel_wind(2) = vd;
-
-	Dcmf earth_to_body(_state.quat_nominal);
-	earth_to_body = earth_to_body.transpose(); //Why transpose?
+	// refresh the shared wind relative kinematics (no-op if already current)
+	updateWindRelKinematics();
 
-	// rotate into body axes
-	rel_wind = earth_to_body * rel_wind;
+	// relative wind velocity rotated into body axes
+	const Vector3f &rel_wind = _wind_rel_kin.rel_wind_body;
 
 	// perform fusion of assumed sideslip  = 0
 	if (rel_wind.norm() > 7.0f) {
 		// Calculate the observation jacobians
 
-		// intermediate variable from algebraic optimisation
-		SH_BETA[0] = (vn - vwn)*(sq(q0) + sq(q1) - sq(q2) - sq(q3)) - vd*(2.0f*q0*q2 - 2.0f*q1*q3) + (ve - vwe)*(2.0f*q0*q3 + 2.0f*q1*q2);
+		// intermediate variable from algebraic optimisation - the shared
+		// projection and partial terms come from the cached kinematics block
+		SH_BETA[0] = (vn - vwn)*_wind_rel_kin.R_bx_n - vd*(2.0f*q0*q2 - 2.0f*q1*q3) + (ve - vwe)*_wind_rel_kin.R_bx_e;
 
 		if (fabsf(SH_BETA[0]) <= 1e-9f) {
 			return;
@@ -96,11 +99,11 @@ void Ekf::fuseSideslip()
 		SH_BETA[4] = 1.0f/sq(SH_BETA[0]);
 		SH_BETA[5] = 1.0f/SH_BETA[0];
 		SH_BETA[6] = SH_BETA[5]*(sq(q0) - sq(q1) + sq(q2) - sq(q3));
-		SH_BETA[7] = sq(q0) + sq(q1) - sq(q2) - sq(q3);
-		SH_BETA[8] = 2.0f*q0*SH_BETA[3] - 2.0f*q3*SH_BETA[2] + 2.0f*q1*vd;
-		SH_BETA[9] = 2.0f*q0*SH_BETA[2] + 2.0f*q3*SH_BETA[3] - 2.0f*q2*vd;
-		SH_BETA[10] = 2.0f*q2*SH_BETA[2] - 2.0f*q1*SH_BETA[3] + 2.0f*q0*vd;
-		SH_BETA[11] = 2.0f*q1*SH_BETA[2] + 2.0f*q2*SH_BETA[3] + 2.0f*q3*vd;
+		SH_BETA[7] = _wind_rel_kin.R_bx_n;
+		SH_BETA[8] = _wind_rel_kin.vel_partial[3];
+		SH_BETA[9] = _wind_rel_kin.vel_partial[0];
+		SH_BETA[10] = _wind_rel_kin.vel_partial[2];
+		SH_BETA[11] = _wind_rel_kin.vel_partial[1];
 		SH_BETA[12] = 2.0f*q0*q3;
 
 		H_BETA[0] = SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9];
@@ -121,7 +124,19 @@ void Ekf::fuseSideslip()
 		bool update_wind_only = !_is_wind_dead_reckoning;
 
 		// intermediate variables - note SK_BETA[0] is 1/(innovation variance)
-		_beta_innov_var = (R_BETA - (SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7])*(P[22][4]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][4]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][4]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][4]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][4]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][4]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][4]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][4]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][4]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) + (SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7])*(P[22][22]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][22]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][22]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][22]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][22]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][22]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][22]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][22]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][22]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) + (SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2))*(P[22][5]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][5]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][5]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][5]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][5]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][5]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][5]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][5]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][5]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) - (SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2))*(P[22][23]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][23]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][23]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][23]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][23]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][23]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][23]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][23]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][23]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) + (SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9])*(P[22][0]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][0]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][0]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][0]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][0]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][0]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][0]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][0]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][0]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) + (SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11])*(P[22][1]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][1]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][1]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][1]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][1]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][1]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][1]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][1]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][1]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) + (SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10])*(P[22][2]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][2]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][2]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][2]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][2]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][2]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][2]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][2]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][2]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) - (SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8])*(P[22][3]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][3]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][3]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][3]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][3]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][3]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][3]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][3]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][3]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))) + (SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))*(P[22][6]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) - P[4][6]*(SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7]) + P[5][6]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) - P[23][6]*(SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2)) + P[0][6]*(SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9]) + P[1][6]*(SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11]) + P[2][6]*(SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10]) - P[3][6]*(SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8]) + P[6][6]*(SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3))));
+		// common sub-expressions hoisted using matlab/scripts/cse_codegen.py - the
+		// gain terms SK_BETA[1-7] are the jacobian terms the generated innovation
+		// variance statement previously expanded inline (regenerate with the
+		// ekf_codegen build target rather than editing the expressions by hand)
+		SK_BETA[1] = H_BETA[22];
+		SK_BETA[2] = H_BETA[5];
+		SK_BETA[3] = H_BETA[6];
+		SK_BETA[4] = H_BETA[1];
+		SK_BETA[5] = H_BETA[0];
+		SK_BETA[6] = H_BETA[2];
+		SK_BETA[7] = -H_BETA[3];
+
+		_beta_innov_var = (R_BETA - SK_BETA[1]*(P[22][4]*SK_BETA[1] - P[4][4]*SK_BETA[1] + P[5][4]*SK_BETA[2] - P[23][4]*SK_BETA[2] + P[0][4]*SK_BETA[5] + P[1][4]*SK_BETA[4] + P[2][4]*SK_BETA[6] - P[3][4]*SK_BETA[7] + P[6][4]*SK_BETA[3]) + SK_BETA[1]*(P[22][22]*SK_BETA[1] - P[4][22]*SK_BETA[1] + P[5][22]*SK_BETA[2] - P[23][22]*SK_BETA[2] + P[0][22]*SK_BETA[5] + P[1][22]*SK_BETA[4] + P[2][22]*SK_BETA[6] - P[3][22]*SK_BETA[7] + P[6][22]*SK_BETA[3]) + SK_BETA[2]*(P[22][5]*SK_BETA[1] - P[4][5]*SK_BETA[1] + P[5][5]*SK_BETA[2] - P[23][5]*SK_BETA[2] + P[0][5]*SK_BETA[5] + P[1][5]*SK_BETA[4] + P[2][5]*SK_BETA[6] - P[3][5]*SK_BETA[7] + P[6][5]*SK_BETA[3]) - SK_BETA[2]*(P[22][23]*SK_BETA[1] - P[4][23]*SK_BETA[1] + P[5][23]*SK_BETA[2] - P[23][23]*SK_BETA[2] + P[0][23]*SK_BETA[5] + P[1][23]*SK_BETA[4] + P[2][23]*SK_BETA[6] - P[3][23]*SK_BETA[7] + P[6][23]*SK_BETA[3]) + SK_BETA[5]*(P[22][0]*SK_BETA[1] - P[4][0]*SK_BETA[1] + P[5][0]*SK_BETA[2] - P[23][0]*SK_BETA[2] + P[0][0]*SK_BETA[5] + P[1][0]*SK_BETA[4] + P[2][0]*SK_BETA[6] - P[3][0]*SK_BETA[7] + P[6][0]*SK_BETA[3]) + SK_BETA[4]*(P[22][1]*SK_BETA[1] - P[4][1]*SK_BETA[1] + P[5][1]*SK_BETA[2] - P[23][1]*SK_BETA[2] + P[0][1]*SK_BETA[5] + P[1][1]*SK_BETA[4] + P[2][1]*SK_BETA[6] - P[3][1]*SK_BETA[7] + P[6][1]*SK_BETA[3]) + SK_BETA[6]*(P[22][2]*SK_BETA[1] - P[4][2]*SK_BETA[1] + P[5][2]*SK_BETA[2] - P[23][2]*SK_BETA[2] + P[0][2]*SK_BETA[5] + P[1][2]*SK_BETA[4] + P[2][2]*SK_BETA[6] - P[3][2]*SK_BETA[7] + P[6][2]*SK_BETA[3]) - SK_BETA[7]*(P[22][3]*SK_BETA[1] - P[4][3]*SK_BETA[1] + P[5][3]*SK_BETA[2] - P[23][3]*SK_BETA[2] + P[0][3]*SK_BETA[5] + P[1][3]*SK_BETA[4] + P[2][3]*SK_BETA[6] - P[3][3]*SK_BETA[7] + P[6][3]*SK_BETA[3]) + SK_BETA[3]*(P[22][6]*SK_BETA[1] - P[4][6]*SK_BETA[1] + P[5][6]*SK_BETA[2] - P[23][6]*SK_BETA[2] + P[0][6]*SK_BETA[5] + P[1][6]*SK_BETA[4] + P[2][6]*SK_BETA[6] - P[3][6]*SK_BETA[7] + P[6][6]*SK_BETA[3]));
 		if (_beta_innov_var >= R_BETA) {
 			SK_BETA[0] = 1.0f / _beta_innov_var;
 			_fault_status.flags.bad_sideslip = false;
@@ -144,14 +159,6 @@ void Ekf::fuseSideslip()
 			return;
 		}
 
-		SK_BETA[1] = SH_BETA[5]*(SH_BETA[12] - 2.0f*q1*q2) + SH_BETA[1]*SH_BETA[4]*SH_BETA[7];
-		SK_BETA[2] = SH_BETA[6] - SH_BETA[1]*SH_BETA[4]*(SH_BETA[12] + 2.0f*q1*q2);
-		SK_BETA[3] = SH_BETA[5]*(2.0f*q0*q1 + 2.0f*q2*q3) + SH_BETA[1]*SH_BETA[4]*(2.0f*q0*q2 - 2.0f*q1*q3);
-		SK_BETA[4] = SH_BETA[5]*SH_BETA[10] - SH_BETA[1]*SH_BETA[4]*SH_BETA[11];
-		SK_BETA[5] = SH_BETA[5]*SH_BETA[8] - SH_BETA[1]*SH_BETA[4]*SH_BETA[9];
-		SK_BETA[6] = SH_BETA[5]*SH_BETA[11] + SH_BETA[1]*SH_BETA[4]*SH_BETA[10];
-		SK_BETA[7] = SH_BETA[5]*SH_BETA[9] + SH_BETA[1]*SH_BETA[4]*SH_BETA[8];
-
 		// Calculate Kalman gains
 		if (update_wind_only) {
 			// If we are getting aiding from other sources, then don't allow the sideslip fusion to affect the non-windspeed states
@@ -202,10 +209,10 @@ void Ekf::fuseSideslip()
 		_beta_innov = rel_wind(1) / rel_wind(0);
 
 		// Compute the ratio of innovation to gate size
-		_beta_test_ratio = sq(_beta_innov) / (sq(fmaxf(_params.beta_innov_gate, 1.0f)) * _beta_innov_var);
+		_innov_monitor.ratio.beta = sq(_beta_innov) / (sq(fmaxf(_params.beta_innov_gate, 1.0f)) * _beta_innov_var);
 
 		// if the innovation consistency check fails then don't fuse the sample and indicate bad beta health
-		if (_beta_test_ratio > 1.0f) {
+		if (_innov_monitor.ratio.beta > 1.0f) {
 			_innov_check_fail_status.flags.reject_sideslip = true;
 			return;
 
@@ -217,69 +224,41 @@ void Ekf::fuseSideslip()
 		_time_last_beta_fuse = _time_last_imu;
 
 		// apply covariance correction via P_new = (I -K*H)*P
-		// first calculate expression for KHP
-		// then calculate P - KHP
-		float KHP[_k_num_states][_k_num_states];
-		float KH[9];
-
-		for (unsigned row = 0; row < _k_num_states; row++) {
-			KH[0] = Kfusion[row] * H_BETA[0];
-			KH[1] = Kfusion[row] * H_BETA[1];
-			KH[2] = Kfusion[row] * H_BETA[2];
-			KH[3] = Kfusion[row] * H_BETA[3];
-			KH[4] = Kfusion[row] * H_BETA[4];
-			KH[5] = Kfusion[row] * H_BETA[5];
-			KH[6] = Kfusion[row] * H_BETA[6];
-			KH[7] = Kfusion[row] * H_BETA[22];
-			KH[8] = Kfusion[row] * H_BETA[23];
-
-			for (unsigned column = 0; column < _k_num_states; column++) {
-				float tmp = KH[0] * P[0][column];
-				tmp += KH[1] * P[1][column];
-				tmp += KH[2] * P[2][column];
-				tmp += KH[3] * P[3][column];
-				tmp += KH[4] * P[4][column];
-				tmp += KH[5] * P[5][column];
-				tmp += KH[6] * P[6][column];
-				tmp += KH[7] * P[22][column];
-				tmp += KH[8] * P[23][column];
-				KHP[row][column] = tmp;
-			}
-		}
+		// form the H*P row once - for symmetric P the correction K*H*P is then the
+		// rank-1 outer product of the gain and this row
+		float HP[_k_max_num_states];
+		const uint8_t h_idx[9] = {0, 1, 2, 3, 4, 5, 6, 22, 23};
+		const float h_val[9] = {H_BETA[0], H_BETA[1], H_BETA[2], H_BETA[3], H_BETA[4],
+					H_BETA[5], H_BETA[6], H_BETA[22], H_BETA[23]
+				       };
+		kf::sparseRowProduct(P, h_val, h_idx, 9, HP, _k_num_states);
 
 		// if the covariance correction will result in a negative variance, then
 		// the covariance marix is unhealthy and must be corrected
-		bool healthy = true;
-		_fault_status.flags.bad_sideslip = false;
-
-		for (int i = 0; i < _k_num_states; i++) {
-			if (P[i][i] < KHP[i][i]) {
-				// zero rows and columns
-				zeroRows(P, i, i);
-				zeroCols(P, i, i);
-
-				//flag as unhealthy
-				healthy = false;
-
-				// update individual measurement health status
-				_fault_status.flags.bad_sideslip = true;
-			}
-		}
+		const bool healthy = kf::rankOneDowndateHealthy(P, Kfusion, HP, _k_num_states);
+		_fault_status.flags.bad_sideslip = !healthy;
 
-		// only apply covariance and state corrrections if healthy
 		if (healthy) {
 			// apply the covariance corrections
-			for (unsigned row = 0; row < _k_num_states; row++) {
-				for (unsigned column = 0; column < _k_num_states; column++) {
-					P[row][column] = P[row][column] - KHP[row][column];
-				}
-			}
+			kf::rankOneDowndate(P, Kfusion, HP, _k_num_states);
 
 			// correct the covariance marix for gross errors
 			fixCovarianceErrors();
 
 			// apply the state corrections
 			fuse(Kfusion, _beta_innov);
+
+		} else {
+			// zero the rows and columns of any state whose variance would have
+			// been driven negative by the correction
+			for (int i = 0; i < _k_num_states; i++) {
+				if (P[i][i] < Kfusion[i] * HP[i]) {
+					zeroRows(P, i, i);
+					zeroCols(P, i, i);
+				}
+			}
 		}
 	}
+#endif // EKF_NO_WIND_STATES
 }
+#endif // EKF_NO_SIDESLIP_FUSION
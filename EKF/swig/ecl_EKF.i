@@ -26,6 +26,21 @@
 %apply (float IN_ARRAY1[ANY]) {(float delta_ang[3]), (float delta_vel[3])};
 %apply (float IN_ARRAY1[ANY]) {(float mag_data[3])};
 
+// batch interface: whole sensor arrays are handed over in one call and consumed
+// through the buffer protocol (zero-copy for contiguous float32/uint64 arrays),
+// the update loop then runs entirely in C++ without interpreter crossings
+%apply (float* IN_ARRAY2, int DIM1, int DIM2) {
+    (float *imu_delta_ang, int imu_ang_rows, int imu_ang_cols),
+    (float *imu_delta_vel, int imu_vel_rows, int imu_vel_cols),
+    (float *mag_batch, int mag_rows, int mag_cols)
+};
+%apply (unsigned long long* IN_ARRAY1, int DIM1) {
+    (unsigned long long *mag_time_us, int mag_times),
+    (unsigned long long *baro_time_us, int baro_times)
+};
+%apply (float* IN_ARRAY1, int DIM1) {(float *baro_batch, int baro_rows)};
+%apply (float* INPLACE_ARRAY2, int DIM1, int DIM2) {(float *state_out, int state_rows, int state_cols)};
+
 %inline {
     struct ekf_control_mode_flags_t {
         bool tilt_align; // 0 - true if the filter tilt alignment is complete
@@ -241,6 +256,66 @@
        return result;
    }
 
+    // Run the filter over whole sensor arrays in one call. The IMU samples are
+    // spaced imu_dt_us apart starting at time_start_us + imu_dt_us, the mag and
+    // baro samples carry their own timestamps and are pushed once the IMU time
+    // passes them, matching the per-sample call sequence of update_sensors() in
+    // the pytest harness. The delayed time horizon state vector after every IMU
+    // step is written into the caller provided (n, 24) float32 state_out array.
+    // Returns the number of completed filter updates, or -1 when the array
+    // shapes are inconsistent.
+    int update_batch(unsigned long long time_start_us, unsigned long long imu_dt_us,
+                     float *imu_delta_ang, int imu_ang_rows, int imu_ang_cols,
+                     float *imu_delta_vel, int imu_vel_rows, int imu_vel_cols,
+                     unsigned long long *mag_time_us, int mag_times,
+                     float *mag_batch, int mag_rows, int mag_cols,
+                     unsigned long long *baro_time_us, int baro_times,
+                     float *baro_batch, int baro_rows,
+                     float *state_out, int state_rows, int state_cols) {
+        if (imu_ang_cols != 3 || imu_vel_cols != 3 || imu_vel_rows != imu_ang_rows
+            || mag_cols != 3 || mag_rows != mag_times || baro_rows != baro_times
+            || state_rows != imu_ang_rows || state_cols != 24) {
+            return -1;
+        }
+
+        int mag_index = 0;
+        int baro_index = 0;
+        int num_updates = 0;
+
+        for (int i = 0; i < imu_ang_rows; ++i) {
+            const uint64_t now = time_start_us + (unsigned long long)(i + 1) * imu_dt_us;
+
+            for (int k = 0; k < 3; ++k) {
+                last_imu_delta_ang[k] = imu_delta_ang[i * 3 + k];
+                last_imu_delta_vel[k] = imu_delta_vel[i * 3 + k];
+            }
+
+            self->setIMUData(now, imu_dt_us, imu_dt_us, last_imu_delta_ang, last_imu_delta_vel);
+
+            while (mag_index < mag_times && mag_time_us[mag_index] <= now) {
+                for (int k = 0; k < 3; ++k) {
+                    last_mag_data[k] = mag_batch[mag_index * 3 + k];
+                }
+
+                self->setMagData(mag_time_us[mag_index], last_mag_data);
+                ++mag_index;
+            }
+
+            while (baro_index < baro_times && baro_time_us[baro_index] <= now) {
+                self->setBaroData(baro_time_us[baro_index], baro_batch[baro_index]);
+                ++baro_index;
+            }
+
+            if (self->update()) {
+                ++num_updates;
+            }
+
+            self->get_state_delayed(&state_out[i * 24]);
+        }
+
+        return num_updates;
+    }
+
    %rename (get_position) get_position_;
    void get_position_(float out[3]) {
        return self->get_position(out);
@@ -43,6 +43,7 @@
 #include <ecl.h>
 #include <mathlib/mathlib.h>
 
+#ifndef EKF_NO_TERRAIN_ESTIMATOR
 bool Ekf::initHagl()
 {
 	// get most recent range measurement from buffer
@@ -113,13 +114,70 @@ void Ekf::runTerrainEstimator()
 	// Update terrain validity
 	update_terrain_valid();
 }
+#endif // EKF_NO_TERRAIN_ESTIMATOR
 
+#ifndef EKF_NO_TERRAIN_ESTIMATOR
 void Ekf::fuseHagl()
 {
 	// If the vehicle is excessively tilted, do not try to fuse range finder observations
 	if (_R_rng_to_earth_2_2 > _params.range_cos_max_tilt) {
-		// get a height above ground measurement from the range finder assuming a flat earth
-		float meas_hagl = _range_sample_delayed.rng * _R_rng_to_earth_2_2;
+		float meas_hagl;
+		float obs_variance;
+
+		if (_range_sample_delayed.num_zones > 1) {
+			// multi-zone sensors are fused as a batch: each zone observes the
+			// same terrain state with unity observation jacobian, so fusing the
+			// information weighted mean of the zones in one scalar update is
+			// algebraically identical to fusing the zones sequentially. The per
+			// zone terms are computed in flat array passes the compiler can
+			// vectorize instead of decimating the sensor to one zone per cycle.
+			const unsigned num_zones = _range_sample_delayed.num_zones;
+			float zone_hagl[RNG_MAX_ZONES];
+			float zone_inv_var[RNG_MAX_ZONES];
+
+			for (unsigned i = 0; i < num_zones; i++) {
+				zone_hagl[i] = _range_sample_delayed.rng_zone[i] * _R_rng_to_earth_2_2;
+			}
+
+			for (unsigned i = 0; i < num_zones; i++) {
+				zone_inv_var[i] = 1.0f / (sq(_params.range_noise) + sq(_params.range_noise_scaler *
+							  _range_sample_delayed.rng_zone[i]));
+			}
+
+			float info_sum = 0.0f;
+			float weighted_hagl = 0.0f;
+
+			for (unsigned i = 0; i < num_zones; i++) {
+				info_sum += zone_inv_var[i];
+				weighted_hagl += zone_hagl[i] * zone_inv_var[i];
+			}
+
+			meas_hagl = weighted_hagl / info_sum;
+
+			// the vehicle height uncertainty is common to all zones so it is added once
+			obs_variance = fmaxf(P[9][9], 0.0f) + 1.0f / info_sum;
+
+			// update the low pass filtered terrain profile under the sensor footprint
+			if (_terrain_profile_len == num_zones) {
+				for (unsigned i = 0; i < num_zones; i++) {
+					_terrain_profile_vpos[i] = 0.5f * (_terrain_profile_vpos[i] + _state.pos(2) + zone_hagl[i]);
+				}
+
+			} else {
+				for (unsigned i = 0; i < num_zones; i++) {
+					_terrain_profile_vpos[i] = _state.pos(2) + zone_hagl[i];
+				}
+
+				_terrain_profile_len = num_zones;
+			}
+
+		} else {
+			// get a height above ground measurement from the range finder assuming a flat earth
+			meas_hagl = _range_sample_delayed.rng * _R_rng_to_earth_2_2;
+
+			// calculate the observation variance adding the variance of the vehicles own height uncertainty
+			obs_variance = fmaxf(P[9][9], 0.0f) + sq(_params.range_noise) + sq(_params.range_noise_scaler * _range_sample_delayed.rng);
+		}
 
 		// predict the hagl from the vehicle position and terrain height
 		float pred_hagl = _terrain_vpos - _state.pos(2);
@@ -127,17 +185,14 @@ void Ekf::fuseHagl()
 		// calculate the innovation
 		_hagl_innov = pred_hagl - meas_hagl;
 
-		// calculate the observation variance adding the variance of the vehicles own height uncertainty
-		float obs_variance = fmaxf(P[9][9], 0.0f) + sq(_params.range_noise) + sq(_params.range_noise_scaler * _range_sample_delayed.rng);
-
 		// calculate the innovation variance - limiting it to prevent a badly conditioned fusion
 		_hagl_innov_var = fmaxf(_terrain_var + obs_variance, obs_variance);
 
 		// perform an innovation consistency check and only fuse data if it passes
 		float gate_size = fmaxf(_params.range_innov_gate, 1.0f);
-		_terr_test_ratio = sq(_hagl_innov) / (sq(gate_size) * _hagl_innov_var);
+		_innov_monitor.ratio.terr = sq(_hagl_innov) / (sq(gate_size) * _hagl_innov_var);
 
-		if (_terr_test_ratio <= 1.0f) {
+		if (_innov_monitor.ratio.terr <= 1.0f) {
 			// calculate the Kalman gain
 			float gain = _terrain_var / _hagl_innov_var;
 			// correct the state
@@ -161,6 +216,7 @@ void Ekf::fuseHagl()
 		return;
 	}
 }
+#endif // EKF_NO_TERRAIN_ESTIMATOR
 
 // return true if the terrain height estimate is valid
 bool Ekf::get_terrain_valid()
@@ -186,6 +242,13 @@ void Ekf::get_terrain_vert_pos(float *ret)
 	memcpy(ret, &_terrain_vpos, sizeof(float));
 }
 
+// get the per zone terrain profile under a multi-zone rangefinder footprint
+uint8_t Ekf::get_terrain_profile(float *ret)
+{
+	memcpy(ret, _terrain_profile_vpos, sizeof(float) * _terrain_profile_len);
+	return _terrain_profile_len;
+}
+
 void Ekf::get_hagl_innov(float *hagl_innov)
 {
 	memcpy(hagl_innov, &_hagl_innov, sizeof(_hagl_innov));
@@ -0,0 +1,190 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file benchmark.cpp
+ * Microbenchmarks for the EKF hot paths
+ *
+ * Runs the filter through a simulated stationary flight and reports the
+ * execution time of Ekf::update() and of RingBuffer::pop_first_older_than().
+ * When the library is built with EKF_INSTRUMENTATION the per phase breakdown
+ * of the update (state prediction, covariance prediction, fusion control
+ * including the measurement fusions, terrain estimator and output predictor)
+ * is reported as well.
+ */
+
+#include <EKF/ekf.h>	// also provides RingBuffer.h
+#include <EKF/tests/stationary_fixture.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+namespace
+{
+
+// execution time statistics for one benchmarked operation
+struct runStats {
+	uint64_t count{0};
+	uint64_t total_ns{0};
+	uint64_t min_ns{UINT64_MAX};
+	uint64_t max_ns{0};
+};
+
+uint64_t timeNowNs()
+{
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void record(runStats &stats, uint64_t elapsed_ns)
+{
+	stats.count++;
+	stats.total_ns += elapsed_ns;
+
+	if (elapsed_ns < stats.min_ns) {
+		stats.min_ns = elapsed_ns;
+	}
+
+	if (elapsed_ns > stats.max_ns) {
+		stats.max_ns = elapsed_ns;
+	}
+}
+
+void report(const char *name, uint64_t count, uint64_t min_ns, uint64_t mean_ns, uint64_t max_ns)
+{
+	printf("%-32s %8" PRIu64 " calls  min %7" PRIu64 " ns  mean %7" PRIu64 " ns  max %8" PRIu64 " ns\n",
+	       name, count, min_ns, mean_ns, max_ns);
+}
+
+void report(const char *name, const runStats &stats)
+{
+	if (stats.count > 0) {
+		report(name, stats.count, stats.min_ns, stats.total_ns / stats.count, stats.max_ns);
+	}
+}
+
+// run the filter on a simulated stationary vehicle and time each update
+void benchmarkFilterUpdate()
+{
+	Ekf ekf;
+
+	stationaryFixture fix;	// 250 Hz IMU rate
+	uint64_t time_usec = 1000;
+
+	ekf.init(time_usec);
+
+	runStats update_stats;
+
+	// 60 simulated seconds, the first second is consumed by filter initialisation
+	for (int i = 0; i < 15000; i++) {
+		fix.feed(ekf, time_usec);
+
+		const uint64_t start_ns = timeNowNs();
+		ekf.update();
+		record(update_stats, timeNowNs() - start_ns);
+
+		time_usec += fix.imu_period_us;
+	}
+
+	report("Ekf::update()", update_stats);
+
+#ifdef EKF_INSTRUMENTATION
+	// report the sections timed inside the update, the measurement fusions
+	// (fuse, fuseMag, fuseVelPosHeight, ...) are accounted to the fusion
+	// control section that calls them
+	const char *section_names[PERF_SECTION_COUNT] = {
+		"  predictState()",
+		"  predictCovariance()",
+		"  controlFusionModes()",
+		"  runTerrainEstimator()",
+		"  calculateOutputStates()"
+	};
+
+	perfCounter counters[PERF_SECTION_COUNT];
+	ekf.get_perf_counters(counters);
+
+	for (unsigned i = 0; i < PERF_SECTION_COUNT; i++) {
+		if (counters[i].count > 0) {
+			report(section_names[i], counters[i].count, (uint64_t)counters[i].min_us * 1000,
+			       counters[i].total_us * 1000 / counters[i].count, (uint64_t)counters[i].max_us * 1000);
+		}
+	}
+
+#else
+	printf("rebuild with -DEKF_INSTRUMENTATION=ON for the per phase breakdown of the update\n");
+#endif
+}
+
+// time the buffer retrieval used to collect measurements at the fusion time horizon
+void benchmarkBufferRetrieval()
+{
+	struct sample {
+		uint64_t time_us;
+		float data[3];
+	};
+
+	RingBuffer<sample> buffer;
+	buffer.allocate(24);
+
+	const uint64_t sample_period_us = 4000;
+	const uint64_t delay_us = 10 * sample_period_us;
+	uint64_t time_usec = 1000000;
+
+	runStats pop_stats;
+
+	for (int i = 0; i < 100000; i++) {
+		sample s = {};
+		s.time_us = time_usec;
+		buffer.push(s);
+
+		sample popped;
+		const uint64_t start_ns = timeNowNs();
+		buffer.pop_first_older_than(time_usec - delay_us, &popped);
+		record(pop_stats, timeNowNs() - start_ns);
+
+		time_usec += sample_period_us;
+	}
+
+	report("RingBuffer::pop_first_older_than", pop_stats);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	benchmarkFilterUpdate();
+	benchmarkBufferRetrieval();
+
+	return 0;
+}
@@ -0,0 +1,280 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file flight_benchmark.cpp
+ * Canned-flight regression benchmark with per-cycle budget enforcement
+ *
+ * Replays two deterministic flight traces (a multirotor takeoff, hover and
+ * box pattern and a fixed-wing cruise with coordinated turns) through
+ * Ekf::update() with the full GPS, baro and mag fusion paths active, and
+ * records the wall time of every update cycle. The run fails when the mean
+ * or 99th percentile cycle cost exceeds its budget, so slowdowns in
+ * control.cpp or covariance.cpp are caught by the test suite instead of in
+ * flight testing.
+ *
+ * The traces are generated from closed-form trajectories so the dataset is
+ * committed as a few dozen lines of code instead of a binary blob and is
+ * bit-identical on every run. The default budgets are deliberately loose so
+ * the test passes on slow or shared build machines; CI deployments with
+ * known hardware can tighten them through the environment variables
+ * ECL_EKF_BUDGET_MEAN_US and ECL_EKF_BUDGET_P99_US.
+ */
+
+#include <EKF/ekf.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+constexpr uint64_t IMU_PERIOD_US = 4000;	// 250 Hz IMU rate
+constexpr float IMU_DT = 1e-6f * (float)IMU_PERIOD_US;
+constexpr unsigned GPS_DECIMATION = 50;		// 5 Hz GPS rate
+constexpr float GRAVITY = 9.80665f;
+
+// home position of both traces
+constexpr double HOME_LAT_DEG = 47.3977;
+constexpr double HOME_LON_DEG = 8.5456;
+constexpr float HOME_ALT_M = 488.0f;
+constexpr double RAD_PER_M = 1.0 / 6371000.0;
+
+// NED magnetic field seen from the traces, matching the default declination
+const float MAG_NED[3] = {0.21f, 0.0f, 0.43f};
+
+uint64_t timeNowNs()
+{
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// state of a canned trajectory at one instant, yaw-only attitude
+struct trajectoryPoint {
+	float pos_ned[3];	// position relative to home (m)
+	float vel_ned[3];	// velocity (m/sec)
+	float acc_ned[3];	// acceleration (m/sec**2)
+	float yaw;		// heading (rad)
+	float yaw_rate;		// heading rate (rad/sec)
+};
+
+// multirotor trace: 5s on ground, 5s vertical takeoff to 10m, then a hover
+// that transitions into a horizontal box pattern flown with yaw turns
+void multirotorTrajectory(float t, trajectoryPoint &p)
+{
+	p = {};
+
+	if (t < 5.0f) {
+		// at rest on the ground
+		return;
+	}
+
+	if (t < 10.0f) {
+		// takeoff: smooth climb to 10m using a raised-cosine profile
+		float phase = (t - 5.0f) / 5.0f;
+		p.pos_ned[2] = -10.0f * 0.5f * (1.0f - cosf((float)M_PI * phase));
+		p.vel_ned[2] = -10.0f * 0.5f * (float)M_PI / 5.0f * sinf((float)M_PI * phase);
+		p.acc_ned[2] = -10.0f * 0.5f * (float)M_PI * (float)M_PI / 25.0f * cosf((float)M_PI * phase);
+		return;
+	}
+
+	// box pattern at 10m altitude: sinusoidal lane changes in north and east
+	// with the heading following the track
+	float tm = t - 10.0f;
+	p.pos_ned[0] = 20.0f * sinf(0.2f * tm);
+	p.vel_ned[0] = 20.0f * 0.2f * cosf(0.2f * tm);
+	p.acc_ned[0] = -20.0f * 0.04f * sinf(0.2f * tm);
+	p.pos_ned[1] = 20.0f * (1.0f - cosf(0.2f * tm));
+	p.vel_ned[1] = 20.0f * 0.2f * sinf(0.2f * tm);
+	p.acc_ned[1] = 20.0f * 0.04f * cosf(0.2f * tm);
+	p.pos_ned[2] = -10.0f;
+	p.yaw = 0.5f * sinf(0.1f * tm);
+	p.yaw_rate = 0.05f * cosf(0.1f * tm);
+}
+
+// fixed-wing trace: 5s stationary (pre-arm), then a 15 m/s cruise that rolls
+// into a continuous coordinated turn, holding altitude at 50m
+void fixedwingTrajectory(float t, trajectoryPoint &p)
+{
+	p = {};
+
+	if (t < 5.0f) {
+		return;
+	}
+
+	const float speed = 15.0f;
+	const float turn_rate = 0.15f;	// rad/sec, approx 24 deg bank at 15 m/s
+	float tm = t - 5.0f;
+	float heading = turn_rate * tm;
+
+	p.pos_ned[0] = speed / turn_rate * sinf(heading);
+	p.pos_ned[1] = speed / turn_rate * (1.0f - cosf(heading));
+	p.pos_ned[2] = -50.0f;
+	p.vel_ned[0] = speed * cosf(heading);
+	p.vel_ned[1] = speed * sinf(heading);
+	p.acc_ned[0] = -speed * turn_rate * sinf(heading);
+	p.acc_ned[1] = speed * turn_rate * cosf(heading);
+	p.yaw = heading;
+	p.yaw_rate = turn_rate;
+}
+
+// feed one trace through a fresh filter, recording the per-cycle wall time
+void replayTrace(const char *name, void (*trajectory)(float, trajectoryPoint &), float duration_sec,
+		 std::vector<uint64_t> &cycle_ns)
+{
+	Ekf ekf;
+	uint64_t time_usec = 1000;
+	ekf.init(time_usec);
+
+	const unsigned num_cycles = (unsigned)(duration_sec / IMU_DT);
+	cycle_ns.reserve(cycle_ns.size() + num_cycles);
+
+	trajectoryPoint p;
+
+	for (unsigned i = 0; i < num_cycles; i++) {
+		float t = (float)i * IMU_DT;
+		trajectory(t, p);
+
+		float sin_yaw = sinf(p.yaw);
+		float cos_yaw = cosf(p.yaw);
+
+		// specific force in NED and rotated into the yaw-only body frame
+		float sf_ned[3] = {p.acc_ned[0], p.acc_ned[1], p.acc_ned[2] - GRAVITY};
+		float delta_vel[3] = {
+			(cos_yaw * sf_ned[0] + sin_yaw * sf_ned[1]) * IMU_DT,
+			(-sin_yaw * sf_ned[0] + cos_yaw * sf_ned[1]) * IMU_DT,
+			sf_ned[2] * IMU_DT
+		};
+		float delta_ang[3] = {0.0f, 0.0f, p.yaw_rate * IMU_DT};
+
+		// magnetometer measurement in the body frame
+		float mag[3] = {
+			cos_yaw * MAG_NED[0] + sin_yaw * MAG_NED[1],
+			-sin_yaw * MAG_NED[0] + cos_yaw * MAG_NED[1],
+			MAG_NED[2]
+		};
+
+		float baro = HOME_ALT_M - p.pos_ned[2];
+
+		ekf.setIMUData(time_usec, IMU_PERIOD_US, IMU_PERIOD_US, delta_ang, delta_vel);
+		ekf.setMagData(time_usec, mag);
+		ekf.setBaroData(time_usec, baro);
+
+		if (i % GPS_DECIMATION == 0) {
+			gps_message gps = {};
+			gps.time_usec = time_usec;
+			gps.lat = (int32_t)((HOME_LAT_DEG + (double)p.pos_ned[0] * RAD_PER_M * 180.0 / M_PI) * 1e7);
+			gps.lon = (int32_t)((HOME_LON_DEG + (double)p.pos_ned[1] * RAD_PER_M * 180.0 / M_PI /
+					     cos(HOME_LAT_DEG * M_PI / 180.0)) * 1e7);
+			gps.alt = (int32_t)((HOME_ALT_M - p.pos_ned[2]) * 1e3f);
+			gps.fix_type = 3;
+			gps.eph = 0.7f;
+			gps.epv = 1.2f;
+			gps.sacc = 0.3f;
+			gps.vel_m_s = sqrtf(p.vel_ned[0] * p.vel_ned[0] + p.vel_ned[1] * p.vel_ned[1]);
+			gps.vel_ned[0] = p.vel_ned[0];
+			gps.vel_ned[1] = p.vel_ned[1];
+			gps.vel_ned[2] = p.vel_ned[2];
+			gps.vel_ned_valid = true;
+			gps.nsats = 16;
+			gps.gdop = 1.1f;
+			ekf.setGpsData(time_usec, &gps);
+		}
+
+		const uint64_t start_ns = timeNowNs();
+		ekf.update();
+		cycle_ns.push_back(timeNowNs() - start_ns);
+
+		time_usec += IMU_PERIOD_US;
+	}
+
+	// the trace must actually exercise the filter, not just feed rejected data
+	assert(ekf.attitude_valid());
+	printf("%-12s %6u cycles replayed\n", name, num_cycles);
+}
+
+uint64_t budgetFromEnv(const char *name, uint64_t default_us)
+{
+	const char *value = getenv(name);
+
+	if (value != nullptr && atoll(value) > 0) {
+		return (uint64_t)atoll(value);
+	}
+
+	return default_us;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	std::vector<uint64_t> cycle_ns;
+
+	replayTrace("multirotor", multirotorTrajectory, 90.0f, cycle_ns);
+	replayTrace("fixed-wing", fixedwingTrajectory, 90.0f, cycle_ns);
+
+	assert(!cycle_ns.empty());
+
+	uint64_t total_ns = 0;
+
+	for (uint64_t v : cycle_ns) {
+		total_ns += v;
+	}
+
+	std::sort(cycle_ns.begin(), cycle_ns.end());
+
+	const uint64_t mean_us = total_ns / cycle_ns.size() / 1000;
+	const uint64_t p99_us = cycle_ns[cycle_ns.size() * 99 / 100] / 1000;
+	const uint64_t max_us = cycle_ns.back() / 1000;
+
+	// loose defaults that hold on slow build machines, tighten via environment on known hardware
+	const uint64_t budget_mean_us = budgetFromEnv("ECL_EKF_BUDGET_MEAN_US", 500);
+	const uint64_t budget_p99_us = budgetFromEnv("ECL_EKF_BUDGET_P99_US", 2000);
+
+	printf("Ekf::update() per-cycle cost: mean %" PRIu64 " us (budget %" PRIu64 " us), "
+	       "p99 %" PRIu64 " us (budget %" PRIu64 " us), max %" PRIu64 " us\n",
+	       mean_us, budget_mean_us, p99_us, budget_p99_us, max_us);
+
+	if (mean_us > budget_mean_us || p99_us > budget_p99_us) {
+		printf("FAILED: per-cycle budget exceeded\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,157 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ingest.cpp
+ * Tests for the lock free sensor ingestion queue
+ */
+
+#include <EKF/ingest.h>
+#include <EKF/tests/stationary_fixture.h>
+
+#include <cassert>
+#include <cstdio>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+	// Test 1: records are drained in the order they were pushed and a full
+	// queue rejects further pushes without blocking
+	{
+		SpscQueue<ingestRecord> queue;
+		assert(queue.allocate(4));
+
+		ingestRecord record = {};
+
+		for (uint64_t i = 0; i < 4; i++) {
+			record.payload[0] = i;
+			assert(queue.push(record));
+		}
+
+		// full
+		assert(!queue.push(record));
+
+		for (uint64_t i = 0; i < 4; i++) {
+			assert(queue.pop(&record));
+			assert(record.payload[0] == i);
+		}
+
+		// empty
+		assert(!queue.pop(&record));
+	}
+
+	// Test 2: a producer thread and a consumer thread never lose or reorder records
+	{
+		SpscQueue<ingestRecord> queue;
+		assert(queue.allocate(16));
+
+		const uint64_t num_records = 100000;
+
+		std::thread producer([&queue, num_records] {
+			ingestRecord record = {};
+
+			for (uint64_t i = 0; i < num_records; i++) {
+				record.payload[0] = i;
+
+				// spin until a slot is free, the producer never blocks on a lock
+				while (!queue.push(record)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		ingestRecord record = {};
+
+		for (uint64_t i = 0; i < num_records; i++) {
+			while (!queue.pop(&record)) {
+				std::this_thread::yield();
+			}
+
+			assert(record.payload[0] == i);
+		}
+
+		producer.join();
+	}
+
+	stationaryFixture fix;
+
+	// Test 3: samples staged from a sensor thread keep the filter running and
+	// converging just like a direct feed
+	{
+		Ekf ekf;
+		ekf.init(1000);
+
+		EkfIngest ingest;
+		assert(ingest.init(16));
+
+		uint32_t staged_updates = 0;
+		uint32_t drained = 0;
+
+		std::thread sensor_thread([&ingest, &fix] {
+			uint64_t time_usec = 1000;
+
+			for (int i = 0; i < 1250; i++) {
+				while (!ingest.pushImu(time_usec, fix.imu_period_us, fix.imu_period_us, fix.delta_ang, fix.delta_vel)) {
+					std::this_thread::yield();
+				}
+
+				while (!ingest.pushMag(time_usec, fix.mag)) {
+					std::this_thread::yield();
+				}
+
+				while (!ingest.pushBaro(time_usec, fix.baro)) {
+					std::this_thread::yield();
+				}
+
+				time_usec += fix.imu_period_us;
+			}
+		});
+
+		// drain until every staged record has been fed to the filter
+		while (drained < 3 * 1250) {
+			drained += ingest.drainTo(ekf);
+
+			if (ekf.update()) {
+				staged_updates++;
+			}
+		}
+
+		sensor_thread.join();
+
+		assert(staged_updates > 0);
+		assert(ekf.attitude_valid());
+	}
+
+	return 0;
+}
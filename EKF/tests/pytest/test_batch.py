@@ -0,0 +1,133 @@
+###############################################################################
+#
+# Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name ECL nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+###############################################################################
+
+"""Tests for the batch update interface of the ecl's EKF
+"""
+from __future__ import print_function
+from __future__ import unicode_literals
+from __future__ import division
+from __future__ import absolute_import
+
+import numpy as np
+import pytest
+
+from test_utils import ecl_EKF
+from test_utils import float_array
+from test_utils import update_sensors
+
+TIME_START_USEC = 1000
+DT_USEC = 5000
+
+
+def make_batch_arrays(n_samples):
+    """Build constant zero-motion sensor arrays for a batch run
+    """
+    times = TIME_START_USEC + DT_USEC * np.arange(1, n_samples + 1,
+                                                  dtype=np.uint64)
+    delta_ang = np.zeros((n_samples, 3), dtype=np.float32)
+    delta_vel = np.tile(
+        float_array([0.0, 0.0, -ecl_EKF.one_g]) * DT_USEC / 1e6,
+        (n_samples, 1))
+    mag = np.tile(float_array([1.0, 0.0, 0.0]), (n_samples, 1))
+    baro = np.zeros(n_samples, dtype=np.float32)
+    return times, delta_ang, delta_vel, mag, baro
+
+
+def test_batch_matches_per_sample_loop():
+    """The batch entry point must reproduce the per-sample call sequence
+    """
+    n_samples = 1000
+    times, delta_ang, delta_vel, mag, baro = make_batch_arrays(n_samples)
+
+    batch_ekf = ecl_EKF.Ekf()
+    state_out = np.zeros((n_samples, 24), dtype=np.float32)
+    n_updates = batch_ekf.update_batch(TIME_START_USEC, DT_USEC,
+                                       delta_ang, delta_vel,
+                                       times, mag,
+                                       times, baro,
+                                       state_out)
+    assert n_updates > 0
+
+    loop_ekf = ecl_EKF.Ekf()
+    time_usec = TIME_START_USEC + DT_USEC
+
+    for _ in range(n_samples):
+        update_sensors(loop_ekf, time_usec, DT_USEC)
+        loop_ekf.update()
+        time_usec += DT_USEC
+
+    loop_state = loop_ekf.get_state_delayed()
+
+    for i in range(24):
+        assert state_out[-1, i] == loop_state[i]
+
+
+def test_batch_rejects_inconsistent_shapes():
+    """Mismatched array shapes must be rejected without running the filter
+    """
+    n_samples = 10
+    times, delta_ang, delta_vel, mag, baro = make_batch_arrays(n_samples)
+    state_out = np.zeros((n_samples, 24), dtype=np.float32)
+
+    ekf = ecl_EKF.Ekf()
+    assert ekf.update_batch(TIME_START_USEC, DT_USEC,
+                            delta_ang[:-1], delta_vel,
+                            times, mag,
+                            times, baro,
+                            state_out) == -1
+    assert ekf.update_batch(TIME_START_USEC, DT_USEC,
+                            delta_ang, delta_vel,
+                            times[:-1], mag,
+                            times, baro,
+                            state_out) == -1
+
+
+@pytest.mark.benchmark
+def test_batch_update_benchmark(benchmark):
+    """Benchmark a batch run against the per-sample loop cost
+    """
+    n_samples = 1000
+    times, delta_ang, delta_vel, mag, baro = make_batch_arrays(n_samples)
+    state_out = np.zeros((n_samples, 24), dtype=np.float32)
+
+    def run_batch():
+        """Run a fresh filter over the batch arrays
+        """
+        ekf = ecl_EKF.Ekf()
+        ekf.update_batch(TIME_START_USEC, DT_USEC,
+                         delta_ang, delta_vel,
+                         times, mag,
+                         times, baro,
+                         state_out)
+
+    benchmark(run_batch)
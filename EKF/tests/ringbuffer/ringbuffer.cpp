@@ -48,6 +48,21 @@ struct sample {
 	float data[3];
 };
 
+// linear blend used by the pop_interpolated() test
+sample interpolateSample(const sample &older, const sample &newer, uint64_t time_us)
+{
+	const float weight = (float)(time_us - older.time_us) / (float)(newer.time_us - older.time_us);
+
+	sample blended;
+	blended.time_us = time_us;
+
+	for (int i = 0; i < 3; i++) {
+		blended.data[i] = older.data[i] + weight * (newer.data[i] - older.data[i]);
+	}
+
+	return blended;
+}
+
 int main(int argc, char *argv[])
 {
 	sample x;
@@ -116,5 +131,126 @@ int main(int argc, char *argv[])
 	assert(buffer.pop_first_older_than(z.time_us + 100, &pop) == true);
 	assert(pop.time_us == z.time_us);
 
+	// Test 5: search across the buffer wrap around point
+	buffer.allocate(3);
+
+	for (uint64_t t = 1; t <= 5; t++) {
+		sample s;
+		s.time_us = t * 1000000;
+		s.data[0] = s.data[1] = s.data[2] = (float)t;
+		buffer.push(s);
+	}
+
+	// buffer now holds t = 3,4,5 seconds with the oldest stored after the newest
+	assert(buffer.pop_first_older_than(4000000 + 100, &pop) == true);
+	assert(pop.time_us == 4000000);
+	assert(buffer.get_oldest().time_us == 5000000);
+
+	// Test 6: migrating the contents to replacement storage
+	buffer.allocate(8);
+
+	for (uint64_t t = 1; t <= 8; t++) {
+		sample s;
+		s.time_us = t * 1000000;
+		s.data[0] = s.data[1] = s.data[2] = (float)t;
+		buffer.push(s);
+	}
+
+	// shrinking keeps the newest samples in time order
+	sample storage_small[3];
+	uint64_t times_small[3];
+	assert(buffer.migrate(storage_small, times_small, 3) == true);
+	assert(buffer.get_length() == 3);
+	assert(buffer.get_newest().time_us == 8000000);
+	assert(buffer.get_oldest().time_us == 6000000);
+	assert(buffer.pop_first_older_than(7000000 + 100, &pop) == true);
+	assert(pop.time_us == 7000000);
+
+	// growing keeps the contents and allows more samples to be stored
+	sample storage_big[6];
+	uint64_t times_big[6];
+	assert(buffer.migrate(storage_big, times_big, 6) == true);
+	assert(buffer.get_length() == 6);
+	assert(buffer.get_newest().time_us == 8000000);
+
+	for (uint64_t t = 9; t <= 12; t++) {
+		sample s;
+		s.time_us = t * 1000000;
+		s.data[0] = s.data[1] = s.data[2] = (float)t;
+		buffer.push(s);
+	}
+
+	assert(buffer.get_newest().time_us == 12000000);
+	assert(buffer.pop_first_older_than(11000000 + 100, &pop) == true);
+	assert(pop.time_us == 11000000);
+
+	// invalid replacement storage is rejected
+	assert(buffer.migrate(nullptr, times_small, 3) == false);
+	assert(buffer.migrate(storage_small, nullptr, 3) == false);
+	assert(buffer.migrate(storage_small, times_small, 0) == false);
+
+	// Test 7: interpolated retrieval blends the two samples bracketing the timestamp
+	buffer.allocate(4);
+
+	for (uint64_t t = 1; t <= 4; t++) {
+		sample s;
+		s.time_us = t * 50000;
+		s.data[0] = s.data[1] = s.data[2] = (float)t;
+		buffer.push(s);
+	}
+
+	assert(buffer.pop_interpolated(125000, &pop) == true);
+	assert(pop.time_us == 125000);
+	assert(pop.data[0] == 2.5f);
+
+	// the samples older than the requested time are dropped, the newer bracketing
+	// sample remains available
+	assert(buffer.get_oldest().time_us == 150000);
+
+	// with no newer sample stored the newest sample is returned unchanged
+	assert(buffer.pop_interpolated(200000 + 10, &pop) == true);
+	assert(pop.time_us == 200000);
+	assert(pop.data[0] == 4.0f);
+
+	// Test 8: fixed capacity mode stores the samples in-class without heap usage
+	RingBuffer<sample, 4> fixed_buffer;
+
+	// lengths up to the compiled-in capacity succeed, anything larger is rejected
+	assert(fixed_buffer.allocate(3) == true);
+	assert(fixed_buffer.get_length() == 3);
+	assert(fixed_buffer.allocate(5) == false);
+	assert(fixed_buffer.allocate(4) == true);
+
+	fixed_buffer.push(x);
+	fixed_buffer.push(y);
+	fixed_buffer.push(z);
+	assert(fixed_buffer.get_newest().time_us == z.time_us);
+	assert(fixed_buffer.get_oldest().time_us == x.time_us);
+
+	assert(fixed_buffer.pop_first_older_than(y.time_us + 100, &pop) == true);
+	assert(pop.time_us == y.time_us);
+
+	// Test 9: ordered content access used by the checkpoint serialization
+	RingBuffer<sample> snap_buffer;
+	assert(snap_buffer.allocate(3) == true);
+	snap_buffer.clear();
+	assert(snap_buffer.entries() == 0);
+
+	snap_buffer.push(x);
+	snap_buffer.push(y);
+	assert(snap_buffer.entries() == 2);
+	assert(snap_buffer.peek_ordered(0).time_us == x.time_us);
+	assert(snap_buffer.peek_ordered(1).time_us == y.time_us);
+
+	// overwriting the oldest sample keeps the ordering oldest to newest
+	snap_buffer.push(z);
+	snap_buffer.push(x);
+	assert(snap_buffer.entries() == 3);
+	assert(snap_buffer.peek_ordered(0).time_us == y.time_us);
+	assert(snap_buffer.peek_ordered(2).time_us == x.time_us);
+
+	snap_buffer.clear();
+	assert(snap_buffer.entries() == 0);
+
 	return 0;
 }
@@ -0,0 +1,119 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file sliced.cpp
+ * Tests for the sliced filter execution mode
+ */
+
+#include <EKF/ekf.h>
+#include <EKF/tests/stationary_fixture.h>
+
+#include <cassert>
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+	// minor cycle at 1kHz, the 8ms filter period leaves eight slices per update
+	stationaryFixture fix(1000);
+
+	// Test 1: the synchronous reference run
+	uint32_t sync_updates = 0;
+	{
+		Ekf ekf;
+		ekf.init(1000);
+
+		uint64_t time_usec = 1000;
+
+		for (int i = 0; i < 5000; i++) {
+			fix.feed(ekf, time_usec);
+
+			if (ekf.update()) {
+				sync_updates++;
+			}
+
+			time_usec += fix.imu_period_us;
+		}
+
+		assert(sync_updates > 0);
+		assert(ekf.attitude_valid());
+	}
+
+	// Test 2: a budget of zero runs one phase per call, a filter update completes
+	// within four minor cycles and the filter converges just like the synchronous run
+	{
+		Ekf ekf;
+		ekf.init(1000);
+
+		uint32_t sliced_updates = 0;
+		uint64_t time_usec = 1000;
+
+		for (int i = 0; i < 5000; i++) {
+			fix.feed(ekf, time_usec);
+
+			if (ekf.update_sliced(0)) {
+				sliced_updates++;
+			}
+
+			time_usec += fix.imu_period_us;
+		}
+
+		assert(sliced_updates == sync_updates);
+		assert(ekf.attitude_valid());
+	}
+
+	// Test 3: a generous budget completes each update in a single call
+	{
+		Ekf ekf;
+		ekf.init(1000);
+
+		uint32_t sliced_updates = 0;
+		uint64_t time_usec = 1000;
+
+		for (int i = 0; i < 5000; i++) {
+			fix.feed(ekf, time_usec);
+
+			if (ekf.update_sliced(1000000)) {
+				sliced_updates++;
+			}
+
+			time_usec += fix.imu_period_us;
+		}
+
+		assert(sliced_updates == sync_updates);
+		assert(ekf.attitude_valid());
+	}
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file stationary_fixture.h
+ * Shared stationary vehicle feed for the EKF test mains. Every test drives the
+ * filter from the same constants so a regression visible in one feed cannot
+ * hide from the others behind diverging copies.
+ */
+
+#pragma once
+
+#include <EKF/ekf.h>
+
+// stationary vehicle, the accelerometer measures the specific force opposing gravity
+struct stationaryFixture {
+	uint64_t imu_period_us;
+	float delta_ang[3];
+	float delta_vel[3];
+	float mag[3];
+	float baro;
+
+	explicit stationaryFixture(uint64_t period_us = 4000) :
+		imu_period_us(period_us),
+		delta_ang{0.0f, 0.0f, 0.0f},
+		delta_vel{0.0f, 0.0f, -9.81f * 1e-6f * (float)period_us},
+		mag{0.2f, 0.0f, 0.4f},
+		baro(120.2f)
+	{
+	}
+
+	// feed one IMU, magnetometer and baro sample directly to the filter
+	void feed(Ekf &ekf, uint64_t time_usec)
+	{
+		ekf.setIMUData(time_usec, imu_period_us, imu_period_us, delta_ang, delta_vel);
+		ekf.setMagData(time_usec, mag);
+		ekf.setBaroData(time_usec, baro);
+	}
+};
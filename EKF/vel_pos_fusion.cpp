@@ -44,6 +44,9 @@
 #include "ekf.h"
 #include <ecl.h>
 #include <mathlib/mathlib.h>
+#include <mathlib/kalman_kernels.h>
+
+namespace kf = ecl::kalman;
 
 void Ekf::fuseVelPosHeight()
 {
@@ -76,12 +79,12 @@ void Ekf::fuseVelPosHeight()
 	if (_fuse_vert_vel) {
 		fuse_map[2] = true;
 		// observation variance - use receiver reported accuracy with parameter setting the minimum value
-		R[2] = fmaxf(_params.gps_vel_noise, 0.01f);
+		R[2] = _derived_params.gps_vel_noise_floor;
 		// use scaled horizontal speed accuracy assuming typical ratio of VDOP/HDOP
 		R[2] = 1.5f * fmaxf(R[2], _gps_sample_delayed.sacc);
 		R[2] = R[2] * R[2];
 		// innovation gate size
-		gate_size[2] = fmaxf(_params.vel_innov_gate, 1.0f);
+		gate_size[2] = _derived_params.vel_innov_gate;
 	}
 
 	if (_fuse_pos) {
@@ -100,10 +103,9 @@ void Ekf::fuseVelPosHeight()
 			// vertical position innovation - baro measurement has opposite sign to earth z axis
 			innovation[5] = _state.pos(2) + _baro_sample_delayed.hgt - _baro_hgt_offset - _hgt_sensor_offset;
 			// observation variance - user parameter defined
-			R[5] = fmaxf(_params.baro_noise, 0.01f);
-			R[5] = R[5] * R[5];
+			R[5] = _derived_params.baro_obs_var;
 			// innovation gate size
-			gate_size[5] = fmaxf(_params.baro_innov_gate, 1.0f);
+			gate_size[5] = _derived_params.baro_innov_gate_fl;
 
 			// Compensate for positive static pressure transients (negative vertical position innovations)
 			// casued by rotor wash ground interaction by applying a temporary deadzone to baro innovations.
@@ -127,12 +129,12 @@ void Ekf::fuseVelPosHeight()
 			innovation[5] = _state.pos(2) + _gps_sample_delayed.hgt - _gps_alt_ref - _hgt_sensor_offset;
 			// observation variance - receiver defined and parameter limited
 			// use scaled horizontal position accuracy assuming typical ratio of VDOP/HDOP
-			float lower_limit = fmaxf(_params.gps_pos_noise, 0.01f);
-			float upper_limit = fmaxf(_params.pos_noaid_noise, lower_limit);
+			float lower_limit = _derived_params.gps_pos_noise_floor;
+			float upper_limit = _derived_params.pos_noaid_noise_upper;
 			R[5] = 1.5f * math::constrain(_gps_sample_delayed.vacc, lower_limit, upper_limit);
 			R[5] = R[5] * R[5];
 			// innovation gate size
-			gate_size[5] = fmaxf(_params.baro_innov_gate, 1.0f);
+			gate_size[5] = _derived_params.baro_innov_gate_fl;
 
 		} else if (_control_status.flags.rng_hgt && (_R_rng_to_earth_2_2 > _params.range_cos_max_tilt)) {
 			fuse_map[5] = true;
@@ -140,9 +142,9 @@ void Ekf::fuseVelPosHeight()
 			innovation[5] = _state.pos(2) - (-math::max(_range_sample_delayed.rng * _R_rng_to_earth_2_2,
 							 _params.rng_gnd_clearance)) - _hgt_sensor_offset;
 			// observation variance - user parameter defined
-			R[5] = fmaxf((sq(_params.range_noise) + sq(_params.range_noise_scaler * _range_sample_delayed.rng)) * sq(_R_rng_to_earth_2_2), 0.01f);
+			R[5] = fmaxf((_derived_params.range_noise_sq + sq(_params.range_noise_scaler * _range_sample_delayed.rng)) * sq(_R_rng_to_earth_2_2), 0.01f);
 			// innovation gate size
-			gate_size[5] = fmaxf(_params.range_innov_gate, 1.0f);
+			gate_size[5] = _derived_params.range_innov_gate_fl;
 
 		} else if (_control_status.flags.ev_hgt) {
 			fuse_map[5] = true;
@@ -152,7 +154,7 @@ void Ekf::fuseVelPosHeight()
 			R[5] = fmaxf(_ev_sample_delayed.posErr, 0.01f);
 			R[5] = R[5] * R[5];
 			// innovation gate size
-			gate_size[5] = fmaxf(_params.ev_innov_gate, 1.0f);
+			gate_size[5] = _derived_params.ev_innov_gate;
 		}
 
 		// update innovation class variable for logging purposes
@@ -166,7 +168,7 @@ void Ekf::fuseVelPosHeight()
 			unsigned state_index = obs_index + 4;	// we start with vx and this is the 4. state
 			_vel_pos_innov_var[obs_index] = P[state_index][state_index] + R[obs_index];
 			// Compute the ratio of innovation to gate size
-			_vel_pos_test_ratio[obs_index] = sq(innovation[obs_index]) / (sq(gate_size[obs_index]) *
+			_innov_monitor.ratio.vel_pos[obs_index] = sq(innovation[obs_index]) / (sq(gate_size[obs_index]) *
 							 _vel_pos_innov_var[obs_index]);
 		}
 	}
@@ -175,12 +177,12 @@ void Ekf::fuseVelPosHeight()
 	// treat 3D velocity, 2D position and height as separate sensors
 	// always pass position checks if using synthetic position measurements or yet to complete tilt alignment
 	// always pass height checks if yet to complete tilt alignment
-	bool vel_check_pass = (_vel_pos_test_ratio[0] <= 1.0f) && (_vel_pos_test_ratio[1] <= 1.0f)
-			      && (_vel_pos_test_ratio[2] <= 1.0f);
+	bool vel_check_pass = (_innov_monitor.ratio.vel_pos[0] <= 1.0f) && (_innov_monitor.ratio.vel_pos[1] <= 1.0f)
+			      && (_innov_monitor.ratio.vel_pos[2] <= 1.0f);
 	innov_check_pass_map[2] = innov_check_pass_map[1] = innov_check_pass_map[0] = vel_check_pass;
-	bool pos_check_pass = ((_vel_pos_test_ratio[3] <= 1.0f) && (_vel_pos_test_ratio[4] <= 1.0f)) || !_control_status.flags.tilt_align;
+	bool pos_check_pass = ((_innov_monitor.ratio.vel_pos[3] <= 1.0f) && (_innov_monitor.ratio.vel_pos[4] <= 1.0f)) || !_control_status.flags.tilt_align;
 	innov_check_pass_map[4] = innov_check_pass_map[3] = pos_check_pass;
-	innov_check_pass_map[5] = (_vel_pos_test_ratio[5] <= 1.0f) || !_control_status.flags.tilt_align;
+	innov_check_pass_map[5] = (_innov_monitor.ratio.vel_pos[5] <= 1.0f) || !_control_status.flags.tilt_align;
 
 	// record the successful velocity fusion event
 	if ((_fuse_hor_vel || _fuse_hor_vel_aux || _fuse_vert_vel) && vel_check_pass) {
@@ -221,6 +223,45 @@ void Ekf::fuseVelPosHeight()
 
 	_fuse_height = false;
 
+	// attempt to fuse all observations that passed their innovation checks using a single
+	// block measurement update - one gain calculation and one covariance update instead of
+	// one full covariance update per observation
+	uint8_t obs_state_index[6];
+	float obs_innov[6];
+	float obs_var[6];
+	uint8_t n_obs = 0;
+
+	for (unsigned obs_index = 0; obs_index < 6; obs_index++) {
+		if (fuse_map[obs_index] && innov_check_pass_map[obs_index]) {
+			obs_state_index[n_obs] = obs_index + 4;	// we start with vx and this is the 4. state
+			obs_innov[n_obs] = innovation[obs_index];
+			obs_var[n_obs] = R[obs_index];
+			n_obs++;
+		}
+	}
+
+	if (n_obs > 0 && fuseStateBlock(obs_state_index, obs_innov, obs_var, n_obs)) {
+		// update individual measurement health status
+		for (uint8_t i = 0; i < n_obs; i++) {
+			switch (obs_state_index[i]) {
+			case 4: _fault_status.flags.bad_vel_N = false; break;
+
+			case 5: _fault_status.flags.bad_vel_E = false; break;
+
+			case 6: _fault_status.flags.bad_vel_D = false; break;
+
+			case 7: _fault_status.flags.bad_pos_N = false; break;
+
+			case 8: _fault_status.flags.bad_pos_E = false; break;
+
+			case 9: _fault_status.flags.bad_pos_D = false; break;
+			}
+		}
+
+		return;
+	}
+
+	// the block update has been rejected so fall back to sequential scalar fusion
 	for (unsigned obs_index = 0; obs_index < 6; obs_index++) {
 		// skip fusion if not requested or checks have failed
 		if (!fuse_map[obs_index] || !innov_check_pass_map[obs_index]) {
@@ -235,78 +276,51 @@ void Ekf::fuseVelPosHeight()
 		}
 
 		// update covarinace matrix via Pnew = (I - KH)P
-		float KHP[_k_num_states][_k_num_states];
-
-		for (unsigned row = 0; row < _k_num_states; row++) {
-			for (unsigned column = 0; column < _k_num_states; column++) {
-				KHP[row][column] = Kfusion[row] * P[state_index][column];
-			}
-		}
+		// for a direct state observation the H*P row is the observed row of P, and
+		// for symmetric P the correction K*H*P is the rank-1 outer product of the
+		// gain and this row - copy it out as the downdate overwrites P
+		float HP[_k_max_num_states];
+		memcpy(HP, P[state_index], sizeof(float) * _k_num_states);
 
 		// if the covariance correction will result in a negative variance, then
 		// the covariance marix is unhealthy and must be corrected
-		bool healthy = true;
-
-		for (int i = 0; i < _k_num_states; i++) {
-			if (P[i][i] < KHP[i][i]) {
-				// zero rows and columns
-				zeroRows(P, i, i);
-				zeroCols(P, i, i);
-
-				//flag as unhealthy
-				healthy = false;
-
-				// update individual measurement health status
-				if (obs_index == 0) {
-					_fault_status.flags.bad_vel_N = true;
-
-				} else if (obs_index == 1) {
-					_fault_status.flags.bad_vel_E = true;
-
-				} else if (obs_index == 2) {
-					_fault_status.flags.bad_vel_D = true;
-
-				} else if (obs_index == 3) {
-					_fault_status.flags.bad_pos_N = true;
-
-				} else if (obs_index == 4) {
-					_fault_status.flags.bad_pos_E = true;
-
-				} else if (obs_index == 5) {
-					_fault_status.flags.bad_pos_D = true;
+		const bool healthy = kf::rankOneDowndateHealthy(P, Kfusion, HP, _k_num_states);
+
+		if (!healthy) {
+			// zero the rows and columns of any state whose variance would have
+			// been driven negative by the correction
+			for (int i = 0; i < _k_num_states; i++) {
+				if (P[i][i] < Kfusion[i] * HP[i]) {
+					zeroRows(P, i, i);
+					zeroCols(P, i, i);
 				}
+			}
+		}
 
-			} else {
-				// update individual measurement health status
-				if (obs_index == 0) {
-					_fault_status.flags.bad_vel_N = false;
+		// update individual measurement health status
+		if (obs_index == 0) {
+			_fault_status.flags.bad_vel_N = !healthy;
 
-				} else if (obs_index == 1) {
-					_fault_status.flags.bad_vel_E = false;
+		} else if (obs_index == 1) {
+			_fault_status.flags.bad_vel_E = !healthy;
 
-				} else if (obs_index == 2) {
-					_fault_status.flags.bad_vel_D = false;
+		} else if (obs_index == 2) {
+			_fault_status.flags.bad_vel_D = !healthy;
 
-				} else if (obs_index == 3) {
-					_fault_status.flags.bad_pos_N = false;
+		} else if (obs_index == 3) {
+			_fault_status.flags.bad_pos_N = !healthy;
 
-				} else if (obs_index == 4) {
-					_fault_status.flags.bad_pos_E = false;
+		} else if (obs_index == 4) {
+			_fault_status.flags.bad_pos_E = !healthy;
 
-				} else if (obs_index == 5) {
-					_fault_status.flags.bad_pos_D = false;
-				}
-			}
+		} else if (obs_index == 5) {
+			_fault_status.flags.bad_pos_D = !healthy;
 		}
 
 		// only apply covariance and state corrrections if healthy
 		if (healthy) {
 			// apply the covariance corrections
-			for (unsigned row = 0; row < _k_num_states; row++) {
-				for (unsigned column = 0; column < _k_num_states; column++) {
-					P[row][column] = P[row][column] - KHP[row][column];
-				}
-			}
+			kf::rankOneDowndate(P, Kfusion, HP, _k_num_states);
 
 			// correct the covariance marix for gross errors
 			fixCovarianceErrors();
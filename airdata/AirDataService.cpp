@@ -0,0 +1,114 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file AirDataService.cpp
+ * A cached ISA air density and EAS-to-TAS service.
+ */
+
+#include "AirDataService.hpp"
+
+#include <math.h>
+
+// ISA density relative to sea level at 15C, tabulated every 500 m from -1000 m
+// to 20000 m. Tropospheric nodes follow (1 - 2.25577e-5 * h)^4.25588; above
+// 11000 m the profile is isothermal at 216.65 K. The linear interpolation error
+// between nodes is below 0.1% of the density, well inside baro sensor accuracy
+const float AirDataService::_density_ratio_table[AirDataService::NUM_NODES] = {
+	1.0995674f, 1.0488801f, 1.0000000f, 0.9528818f,
+	0.9074811f, 0.8637540f, 0.8216573f, 0.7811483f,
+	0.7421852f, 0.7047264f, 0.6687314f, 0.6341600f,
+	0.6009727f, 0.5691306f, 0.5385956f, 0.5093298f,
+	0.4812964f, 0.4544589f, 0.4287815f, 0.4042289f,
+	0.3807666f, 0.3583605f, 0.3369773f, 0.3165841f,
+	0.2971487f, 0.2746236f, 0.2538060f, 0.2345664f,
+	0.2167853f, 0.2003521f, 0.1851646f, 0.1711283f,
+	0.1581561f, 0.1461672f, 0.1350871f, 0.1248469f,
+	0.1153830f, 0.1066365f, 0.0985530f, 0.0910823f,
+	0.0841778f, 0.0777968f, 0.0718995f
+};
+
+void
+AirDataService::update(float baro_alt_m)
+{
+	if (!ISFINITE(baro_alt_m)) {
+		return;
+	}
+
+	// skip the refresh when the altitude has not moved enough to change the outputs
+	if (_outputs_valid && fabsf(baro_alt_m - _last_alt) < ALT_REFRESH_THRESHOLD_M) {
+		return;
+	}
+
+	_last_alt = baro_alt_m;
+	_outputs_valid = true;
+
+	const float alt = math::constrain(baro_alt_m, NODE_BASE_ALT_M,
+					  NODE_BASE_ALT_M + (NUM_NODES - 1) * NODE_SPACING_M);
+
+	// walk the interpolation node from its previous position - the altitude moves by
+	// a small fraction of the node spacing between consecutive baro samples
+	while ((_node > 0) && (alt < NODE_BASE_ALT_M + _node * NODE_SPACING_M)) {
+		_node--;
+	}
+
+	while ((_node + 2 < NUM_NODES) && (alt >= NODE_BASE_ALT_M + (_node + 1) * NODE_SPACING_M)) {
+		_node++;
+	}
+
+	const float frac = (alt - (NODE_BASE_ALT_M + _node * NODE_SPACING_M)) / NODE_SPACING_M;
+	float ratio = _density_ratio_table[_node]
+		      + frac * (_density_ratio_table[_node + 1] - _density_ratio_table[_node]);
+
+	if (fabsf(_temp_offset) > 0.01f) {
+		// ideal gas correction for a non-ISA outside air temperature at the same pressure
+		const float T_isa = 288.15f - 0.0065f * math::min(alt, 11000.0f);
+		ratio *= T_isa / (T_isa + _temp_offset);
+	}
+
+	_density = CONSTANTS_AIR_DENSITY_SEA_LEVEL_15C * ratio;
+	_eas2tas = 1.0f / sqrtf(ratio);
+}
+
+void
+AirDataService::set_temperature_offset(float delta_celsius)
+{
+	if (!ISFINITE(delta_celsius) || (fabsf(delta_celsius - _temp_offset) < 0.01f)) {
+		return;
+	}
+
+	_temp_offset = delta_celsius;
+
+	// force a refresh on the next update
+	_outputs_valid = false;
+}
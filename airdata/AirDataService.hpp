@@ -0,0 +1,92 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file AirDataService.hpp
+ * A cached ISA air density and EAS-to-TAS service.
+ *
+ * Maintains the ambient air density and the equivalent-to-true airspeed
+ * conversion factor from barometric altitude samples using a linearly
+ * interpolated ISA table, so consumers (drag fusion, TECS, airspeed
+ * scaling) share one cheap update per baro sample instead of evaluating
+ * the powf based barometric formula independently.
+ */
+
+#pragma once
+
+#include <ecl.h>
+#include <mathlib/mathlib.h>
+#include <geo/geo.h>
+
+class AirDataService
+{
+public:
+	AirDataService() = default;
+	~AirDataService() = default;
+
+	// no copy, assignment, move, move assignment
+	AirDataService(const AirDataService &) = delete;
+	AirDataService &operator=(const AirDataService &) = delete;
+	AirDataService(AirDataService &&) = delete;
+	AirDataService &operator=(AirDataService &&) = delete;
+
+	// update the cached density and EAS2TAS from a barometric pressure altitude (m AMSL).
+	// The interpolation node is tracked incrementally between calls and the outputs are
+	// only recomputed when the altitude has moved enough to change them
+	void update(float baro_alt_m);
+
+	// offset of the outside air temperature from the ISA profile (Celsius), applied as
+	// an ideal gas correction to the density at the same pressure
+	void set_temperature_offset(float delta_celsius);
+
+	float get_air_density() const { return _density; }
+	float get_eas2tas() const { return _eas2tas; }
+
+private:
+	// ISA density ratio table nodes, NODE_SPACING_M apart starting at NODE_BASE_ALT_M
+	static constexpr unsigned NUM_NODES = 43;
+	static constexpr float NODE_BASE_ALT_M = -1000.0f;
+	static constexpr float NODE_SPACING_M = 500.0f;
+
+	// altitude change below which the cached outputs are considered current (m)
+	static constexpr float ALT_REFRESH_THRESHOLD_M = 0.5f;
+
+	static const float _density_ratio_table[NUM_NODES];
+
+	float _density{CONSTANTS_AIR_DENSITY_SEA_LEVEL_15C};	///< ambient air density (kg/m**3)
+	float _eas2tas{1.0f};		///< equivalent to true airspeed conversion factor
+	float _temp_offset{0.0f};	///< outside air temperature offset from ISA (C)
+	float _last_alt{0.0f};		///< altitude the cached outputs were computed for (m)
+	unsigned _node{2};		///< interpolation node of the last update
+	bool _outputs_valid{false};	///< true once update() has run at least once
+};
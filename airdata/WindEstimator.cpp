@@ -38,6 +38,10 @@
 
 #include "WindEstimator.hpp"
 
+#include <mathlib/kalman_kernels.h>
+
+namespace kf = ecl::kalman;
+
 bool
 WindEstimator::initialise(const matrix::Vector3f &velI, const matrix::Vector2f &velIvar, const float tas_meas)
 {
@@ -77,12 +81,8 @@ WindEstimator::initialise(const matrix::Vector3f &velI, const matrix::Vector2f &
 
 	// get an estimate of the state covariance matrix given the estimated variance of ground velocity
 	// and measured airspeed
-	_P.setZero();
-	_P(w_n, w_n) = velIvar(0);
-	_P(w_e, w_e) = velIvar(1);
-	_P(tas, tas) = 0.0001f;
-
-	_P = L * _P * L.transpose();
+	const float P_diag[3] = {velIvar(0), velIvar(1), 0.0001f};
+	kf::diagonalSandwich(L, P_diag, _P);
 
 	// reset the timestamp for measurement rejection
 	_time_rejected_tas = 0;
@@ -98,16 +98,29 @@ WindEstimator::update(uint64_t time_now)
 		return;
 	}
 
-	// run covariance prediction at 1Hz
-	if (time_now - _time_last_update < 1000 * 1000 || _time_last_update == 0) {
-		if (_time_last_update == 0) {
-			_time_last_update = time_now;
-		}
+	// the fusions pull the covariance forward lazily before computing their
+	// gains, so this only has to bound the interval between predictions for
+	// stretches without any measurements
+	if (_time_last_update != 0 && time_now - _time_last_update < 1000 * 1000) {
+		return;
+	}
+
+	predict_covariance(time_now);
+}
 
+void
+WindEstimator::predict_covariance(uint64_t time_now)
+{
+	if (_time_last_update == 0) {
+		_time_last_update = time_now;
 		return;
 	}
 
-	float dt = (float)(time_now - _time_last_update) * 1e-6f;
+	if (time_now <= _time_last_update) {
+		return;
+	}
+
+	const float dt = (float)(time_now - _time_last_update) * 1e-6f;
 	_time_last_update = time_now;
 
 	float q_w = _wind_p_var;
@@ -115,20 +128,16 @@ WindEstimator::update(uint64_t time_now)
 
 	float SPP0 = dt * dt;
 	float SPP1 = SPP0 * q_w;
-	float SPP2 = SPP1 + _P(0, 1);
-
-	matrix::Matrix3f P_next;
-
-	P_next(0, 0) = SPP1 + _P(0, 0);
-	P_next(0, 1) = SPP2;
-	P_next(0, 2) = _P(0, 2);
-	P_next(1, 0) = SPP2;
-	P_next(1, 1) = SPP1 + _P(1, 1);
-	P_next(1, 2) = _P(1, 2);
-	P_next(2, 0) = _P(0, 2);
-	P_next(2, 1) = _P(1, 2);
-	P_next(2, 2) = SPP0 * q_k_tas + _P(2, 2);
-	_P = P_next;
+
+	// the state transition is identity so the prediction reduces to adding the
+	// process noise in place - no intermediate matrix or copy back is needed
+	_P(0, 0) += SPP1;
+	_P(0, 1) += SPP1;
+	_P(1, 0) = _P(0, 1);
+	_P(1, 1) += SPP1;
+	_P(2, 0) = _P(0, 2);
+	_P(2, 1) = _P(1, 2);
+	_P(2, 2) += SPP0 * q_k_tas;
 }
 
 void
@@ -150,6 +159,10 @@ WindEstimator::fuse_airspeed(uint64_t time_now, const float true_airspeed, const
 
 	_time_last_airspeed_fuse = time_now;
 
+	// propagate the covariance over the time elapsed since the last prediction
+	// so the gain is computed from the current uncertainty
+	predict_covariance(time_now);
+
 	// assign helper variables
 	const float v_n = velI(0);
 	const float v_e = velI(1);
@@ -161,16 +174,14 @@ WindEstimator::fuse_airspeed(uint64_t time_now, const float true_airspeed, const
 	const float HH0 = sqrtf(v_d * v_d + (v_e - w_e) * (v_e - w_e) + (v_n - w_n) * (v_n - w_n));
 	const float HH1 = k_tas / HH0;
 
-	matrix::Matrix<float, 1, 3> H_tas;
-	H_tas(0, 0) = HH1 * (-v_n + w_n);
-	H_tas(0, 1) = HH1 * (-v_e + w_e);
-	H_tas(0, 2) = HH0;
+	const float H_tas[3] = {HH1 * (-v_n + w_n), HH1 * (-v_e + w_e), HH0};
 
-	matrix::Matrix<float, 3, 1> K = _P * H_tas.transpose();
+	// fused kernel computes P * H', S = H * P * H' + R and K = P * H' / S in
+	// a single pass without intermediate matrix temporaries
+	float K[3];
+	float PH[3];
+	const float S = kf::scalarMeasurementGain(_P, H_tas, _tas_var, K, PH);
 
-	const matrix::Matrix<float, 1, 1> S = H_tas * _P * H_tas.transpose() + _tas_var;
-
-	K /= (S._data[0][0]);
 	// compute innovation
 	const float airspeed_pred = _state(tas) * sqrtf((v_n - _state(w_n)) * (v_n - _state(w_n)) + (v_e - _state(w_e)) *
 				    (v_e - _state(w_e)) + v_d * v_d);
@@ -178,7 +189,7 @@ WindEstimator::fuse_airspeed(uint64_t time_now, const float true_airspeed, const
 	_tas_innov = true_airspeed - airspeed_pred;
 
 	// innovation variance
-	_tas_innov_var = S._data[0][0];
+	_tas_innov_var = S;
 
 	bool reinit_filter = false;
 	bool meas_is_rejected = false;
@@ -197,12 +208,12 @@ WindEstimator::fuse_airspeed(uint64_t time_now, const float true_airspeed, const
 	}
 
 	// apply correction to state
-	_state(w_n) += _tas_innov * K(0, 0);
-	_state(w_e) += _tas_innov * K(1, 0);
-	_state(tas) += _tas_innov * K(2, 0);
+	_state(w_n) += _tas_innov * K[0];
+	_state(w_e) += _tas_innov * K[1];
+	_state(tas) += _tas_innov * K[2];
 
-	// update covariance matrix
-	_P = _P - K * H_tas * _P;
+	// update covariance matrix in place, reusing the P * H' product
+	kf::scalarMeasurementCovarianceUpdate(_P, K, PH);
 
 	run_sanity_checks();
 }
@@ -222,6 +233,10 @@ WindEstimator::fuse_beta(uint64_t time_now, const matrix::Vector3f &velI, const
 
 	_time_last_beta_fuse = time_now;
 
+	// propagate the covariance over the time elapsed since the last prediction
+	// so the gain is computed from the current uncertainty
+	predict_covariance(time_now);
+
 	const float v_n = velI(0);
 	const float v_e = velI(1);
 	const float v_d = velI(2);
@@ -246,17 +261,12 @@ WindEstimator::fuse_beta(uint64_t time_now, const matrix::Vector3f &velI, const
 	float HB16 = (HB4 * (-HB10 + HB11 + HB9) + HB6 * (-HB1 + HB3) + v_d * (HB0 * q_att(1) + 2.0f * q_att(2) * q_att(3))) /
 		     (HB14 * HB14);
 
-	matrix::Matrix<float, 1, 3> H_beta;
-	H_beta(0, 0) = HB13 * HB16 + HB15 * (HB1 - HB3);
-	H_beta(0, 1) = HB15 * (HB12 - HB7 + HB8) + HB16 * HB5;
-	H_beta(0, 2) = 0;
-
-	// compute kalman gain
-	matrix::Matrix<float, 3, 1> K = _P * H_beta.transpose();
-
-	const matrix::Matrix<float, 1, 1> S = H_beta * _P * H_beta.transpose() + _beta_var;
+	const float H_beta[3] = {HB13 * HB16 + HB15 * (HB1 - HB3), HB15 * (HB12 - HB7 + HB8) + HB16 * HB5, 0.0f};
 
-	K /= (S._data[0][0]);
+	// compute kalman gain with the fused single pass kernel
+	float K[3];
+	float PH[3];
+	const float S = kf::scalarMeasurementGain(_P, H_beta, _beta_var, K, PH);
 
 	// compute predicted side slip angle
 	matrix::Vector3f rel_wind(velI(0) - _state(w_n), velI(1) - _state(w_e), velI(2));
@@ -271,7 +281,7 @@ WindEstimator::fuse_beta(uint64_t time_now, const matrix::Vector3f &velI, const
 	const float beta_pred = rel_wind(1) / rel_wind(0);
 
 	_beta_innov = 0.0f - beta_pred;
-	_beta_innov_var = S._data[0][0];
+	_beta_innov_var = S;
 
 	bool reinit_filter = false;
 	bool meas_is_rejected = false;
@@ -291,12 +301,12 @@ WindEstimator::fuse_beta(uint64_t time_now, const matrix::Vector3f &velI, const
 	}
 
 	// apply correction to state
-	_state(w_n) += _beta_innov * K(0, 0);
-	_state(w_e) += _beta_innov * K(1, 0);
-	_state(tas) += _beta_innov * K(2, 0);
+	_state(w_n) += _beta_innov * K[0];
+	_state(w_e) += _beta_innov * K[1];
+	_state(tas) += _beta_innov * K[2];
 
-	// update covariance matrix
-	_P = _P - K * H_beta * _P;
+	// update covariance matrix in place, reusing the P * H' product
+	kf::scalarMeasurementCovarianceUpdate(_P, K, PH);
 
 	run_sanity_checks();
 }
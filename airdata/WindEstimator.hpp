@@ -124,5 +124,8 @@ private:
 	// initialise state and state covariance matrix
 	bool initialise(const matrix::Vector3f &velI, const matrix::Vector2f &velIvar, const float tas_meas);
 
+	// propagate the state covariance over the time elapsed since the last prediction
+	void predict_covariance(uint64_t time_now);
+
 	void run_sanity_checks();
 };
@@ -0,0 +1,119 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file WindEstimatorBatch.cpp
+ * Batch ingestion front end for running one WindEstimator per airspeed sensor.
+ */
+
+#include "WindEstimatorBatch.hpp"
+
+WindEstimatorBatch::WindEstimatorBatch(unsigned num_instances) :
+	_num_instances(num_instances < MAX_INSTANCES ? num_instances : MAX_INSTANCES)
+{
+}
+
+void
+WindEstimatorBatch::update(uint64_t time_now)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].update(time_now);
+	}
+}
+
+void
+WindEstimatorBatch::fuse_airspeed(uint64_t time_now, const float true_airspeed[], const matrix::Vector3f &velI,
+				  const matrix::Vector2f &velIvar)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		if (ISFINITE(true_airspeed[i])) {
+			_instances[i].fuse_airspeed(time_now, true_airspeed[i], velI, velIvar);
+		}
+	}
+}
+
+void
+WindEstimatorBatch::fuse_beta(uint64_t time_now, const matrix::Vector3f &velI, const matrix::Quatf &q_att)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].fuse_beta(time_now, velI, q_att);
+	}
+}
+
+void
+WindEstimatorBatch::set_wind_p_noise(float wind_sigma)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].set_wind_p_noise(wind_sigma);
+	}
+}
+
+void
+WindEstimatorBatch::set_tas_scale_p_noise(float tas_scale_sigma)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].set_tas_scale_p_noise(tas_scale_sigma);
+	}
+}
+
+void
+WindEstimatorBatch::set_tas_noise(float tas_sigma)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].set_tas_noise(tas_sigma);
+	}
+}
+
+void
+WindEstimatorBatch::set_beta_noise(float beta_var)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].set_beta_noise(beta_var);
+	}
+}
+
+void
+WindEstimatorBatch::set_tas_gate(uint8_t gate_size)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].set_tas_gate(gate_size);
+	}
+}
+
+void
+WindEstimatorBatch::set_beta_gate(uint8_t gate_size)
+{
+	for (unsigned i = 0; i < _num_instances; i++) {
+		_instances[i].set_beta_gate(gate_size);
+	}
+}
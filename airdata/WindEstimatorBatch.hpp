@@ -0,0 +1,107 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file WindEstimatorBatch.hpp
+ * Batch ingestion front end for running one WindEstimator per airspeed sensor.
+ *
+ * Vehicles with redundant pitot systems run one wind and airspeed scale
+ * estimator per sensor for cross-checking. This wrapper keeps the estimator
+ * instances in one contiguous in-class array and drives the prediction and
+ * fusion of all of them in a single call per cycle, so the per-instance
+ * kernels run back-to-back over adjacent memory with the shared vehicle
+ * state loaded once.
+ */
+
+#pragma once
+
+#include "WindEstimator.hpp"
+
+class WindEstimatorBatch
+{
+public:
+	static constexpr unsigned MAX_INSTANCES = 4;
+
+	/**
+	 * @param num_instances number of estimators to run, clipped to MAX_INSTANCES
+	 */
+	WindEstimatorBatch(unsigned num_instances);
+	~WindEstimatorBatch() = default;
+
+	// no copy, assignment, move, move assignment
+	WindEstimatorBatch(const WindEstimatorBatch &) = delete;
+	WindEstimatorBatch &operator=(const WindEstimatorBatch &) = delete;
+	WindEstimatorBatch(WindEstimatorBatch &&) = delete;
+	WindEstimatorBatch &operator=(WindEstimatorBatch &&) = delete;
+
+	unsigned num_instances() const { return _num_instances; }
+
+	/**
+	 * Access one estimator for per-sensor queries (innovations, wind estimate)
+	 * or per-sensor tuning. The index is not range checked.
+	 */
+	WindEstimator &instance(unsigned i) { return _instances[i]; }
+
+	/**
+	 * Run the covariance prediction of all estimators in one pass.
+	 */
+	void update(uint64_t time_now);
+
+	/**
+	 * Fuse one true airspeed measurement per estimator in one pass.
+	 *
+	 * @param true_airspeed one measurement per instance, NAN entries are skipped
+	 * @param velI the vehicle velocity shared by all instances
+	 * @param velIvar the horizontal velocity variances shared by all instances
+	 */
+	void fuse_airspeed(uint64_t time_now, const float true_airspeed[], const matrix::Vector3f &velI,
+			   const matrix::Vector2f &velIvar);
+
+	/**
+	 * Fuse the zero sideslip pseudo measurement into all estimators in one pass.
+	 */
+	void fuse_beta(uint64_t time_now, const matrix::Vector3f &velI, const matrix::Quatf &q_att);
+
+	/* Broadcast tuning to all instances */
+	void set_wind_p_noise(float wind_sigma);
+	void set_tas_scale_p_noise(float tas_scale_sigma);
+	void set_tas_noise(float tas_sigma);
+	void set_beta_noise(float beta_var);
+	void set_tas_gate(uint8_t gate_size);
+	void set_beta_gate(uint8_t gate_size);
+
+private:
+	WindEstimator _instances[MAX_INSTANCES];	///< estimators in one contiguous array
+
+	unsigned _num_instances;			///< number of estimators in use
+};
@@ -0,0 +1,100 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ecl_attitude_controller.cpp
+ * Implementation of the combined fixed-wing attitude controller pass.
+ *
+ * Authors and acknowledgements in header.
+ */
+
+#include "ecl_attitude_controller.h"
+#include <math.h>
+#include <mathlib/fastmath.h>
+#include <mathlib/mathlib.h>
+
+namespace fm = ecl::fastmath;
+
+void ECL_AttitudeController::control(const ECL_ControlData &ctl_data, ECL_AttitudeControlOutputs &out,
+				     bool control_wheel)
+{
+	/* attitude error to euler rate setpoint for every axis */
+	out.roll_rate_setpoint = _roll_ctrl.control_attitude(ctl_data);
+	out.pitch_rate_setpoint = _pitch_ctrl.control_attitude(ctl_data);
+	out.yaw_rate_setpoint = _yaw_ctrl.control_attitude(ctl_data);
+
+	/* feed the euler rate setpoints back into the control data seen by the body rate
+	 * controllers, as the per-axis call sequence would */
+	ECL_ControlData axes_data = ctl_data;
+	axes_data.roll_rate_setpoint = out.roll_rate_setpoint;
+	axes_data.pitch_rate_setpoint = out.pitch_rate_setpoint;
+	axes_data.yaw_rate_setpoint = out.yaw_rate_setpoint;
+
+	/* Transform the setpoints to body angular rates (jacobian). The rows of the
+	 * jacobian share their trigonometric terms, so they are evaluated once here for
+	 * all axes instead of inside each control_euler_rate(). */
+	float sin_roll;
+	float cos_roll;
+	float sin_pitch;
+	float cos_pitch;
+	fm::sincos(ctl_data.roll, sin_roll, cos_roll);
+	fm::sincos(ctl_data.pitch, sin_pitch, cos_pitch);
+
+	_roll_ctrl.set_bodyrate_setpoint(out.roll_rate_setpoint
+					 - sin_pitch * out.yaw_rate_setpoint);
+	_pitch_ctrl.set_bodyrate_setpoint(cos_roll * out.pitch_rate_setpoint
+					  + cos_pitch * sin_roll * out.yaw_rate_setpoint);
+	_yaw_ctrl.set_bodyrate_setpoint(-sin_roll * out.pitch_rate_setpoint
+					+ cos_roll * cos_pitch * out.yaw_rate_setpoint);
+
+	/* body angular rate error to constrained actuator demand */
+	out.aileron = _roll_ctrl.control_bodyrate(axes_data);
+	out.elevator = _pitch_ctrl.control_bodyrate(axes_data);
+	out.rudder = _yaw_ctrl.control_bodyrate(axes_data);
+
+	if (control_wheel) {
+		_wheel_ctrl.control_attitude(axes_data);
+		out.wheel = _wheel_ctrl.control_bodyrate(axes_data);
+
+	} else {
+		out.wheel = 0.0f;
+	}
+}
+
+void ECL_AttitudeController::reset_integrators()
+{
+	_roll_ctrl.reset_integrator();
+	_pitch_ctrl.reset_integrator();
+	_yaw_ctrl.reset_integrator();
+	_wheel_ctrl.reset_integrator();
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ecl_attitude_controller.h
+ * Definition of a combined fixed-wing attitude controller running all axes in one pass.
+ *
+ * The roll, pitch, yaw and wheel controllers are usually run back-to-back every control
+ * cycle against the same ECL_ControlData struct. This facade owns the four per-axis
+ * controllers and evaluates the full attitude -> euler rate -> body rate cascade for
+ * all of them in a single call, sharing the euler rate to body rate jacobian
+ * trigonometry between the axes instead of re-evaluating it inside each
+ * control_euler_rate().
+ *
+ * @author Lorenz Meier <lm@inf.ethz.ch>
+ * @author Thomas Gubler <thomasgubler@gmail.com>
+ */
+
+#ifndef ECL_ATTITUDE_CONTROLLER_H
+#define ECL_ATTITUDE_CONTROLLER_H
+
+#include "ecl_controller.h"
+#include "ecl_pitch_controller.h"
+#include "ecl_roll_controller.h"
+#include "ecl_wheel_controller.h"
+#include "ecl_yaw_controller.h"
+
+// results of one combined controller pass
+struct ECL_AttitudeControlOutputs {
+	float roll_rate_setpoint;
+	float pitch_rate_setpoint;
+	float yaw_rate_setpoint;
+	float aileron;
+	float elevator;
+	float rudder;
+	float wheel;
+};
+
+class ECL_AttitudeController
+{
+public:
+	ECL_AttitudeController() = default;
+	~ECL_AttitudeController() = default;
+
+	// the per-axis controllers stay externally configurable through their usual setters
+	ECL_RollController &roll_controller() { return _roll_ctrl; }
+	ECL_PitchController &pitch_controller() { return _pitch_ctrl; }
+	ECL_YawController &yaw_controller() { return _yaw_ctrl; }
+	ECL_WheelController &wheel_controller() { return _wheel_ctrl; }
+
+	/**
+	 * Run the full cascade for all axes.
+	 *
+	 * Equivalent to calling control_attitude() and control_euler_rate() on the roll,
+	 * pitch and yaw controllers in sequence with the euler rate setpoints fed back
+	 * into the control data, plus the wheel controller when control_wheel is set.
+	 *
+	 * @param ctl_data the shared vehicle state, the *_rate_setpoint members are ignored
+	 * @param out the euler rate setpoints and constrained actuator demands
+	 * @param control_wheel also run the wheel controller (ground operation)
+	 */
+	void control(const ECL_ControlData &ctl_data, ECL_AttitudeControlOutputs &out, bool control_wheel = false);
+
+	void reset_integrators();
+
+private:
+	ECL_RollController _roll_ctrl;
+	ECL_PitchController _pitch_ctrl;
+	ECL_YawController _yaw_ctrl;
+	ECL_WheelController _wheel_ctrl;
+};
+
+#endif // ECL_ATTITUDE_CONTROLLER_H
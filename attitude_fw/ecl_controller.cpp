@@ -63,10 +63,46 @@ ECL_Controller::ECL_Controller(const char *name) :
 	_integrator(0.0f),
 	_rate_error(0.0f),
 	_rate_setpoint(0.0f),
-	_bodyrate_setpoint(0.0f)
+	_bodyrate_setpoint(0.0f),
+	_airspeed_trim(0.0f),
+	_gain_sched_airspeed_min(0.0f),
+	_gain_sched_airspeed_max(0.0f),
+	_gain_sched_table{},
+	_gain_sched_enabled(false),
+	_gain_sched_dirty(false)
 {
 }
 
+float ECL_Controller::control_bodyrate(const struct ECL_ControlData &ctl_data)
+{
+	/* get the usual dt estimate */
+	uint64_t dt_micros = ecl_elapsed_time(&_last_run);
+	_last_run = ecl_absolute_time();
+	float dt = (float)dt_micros * 1e-6f;
+
+	/* lock integral for long intervals */
+	bool lock_integrator = ctl_data.lock_integrator;
+
+	if (dt_micros > 500000) {
+		lock_integrator = true;
+	}
+
+	return control_bodyrate_fixed_dt(ctl_data, dt, lock_integrator);
+}
+
+void ECL_Controller::update_integrator(float id)
+{
+	/*
+	 * anti-windup: do not allow integrator to increase if actuator is at limit,
+	 * only allow motion back towards center. The ternary form keeps this branch-free.
+	 */
+	id = (_last_output < -1.0f) ? math::max(id, 0.0f) : id;
+	id = (_last_output > 1.0f) ? math::min(id, 0.0f) : id;
+
+	/* add and constrain */
+	_integrator = math::constrain(_integrator + id * _k_i, -_integrator_max, _integrator_max);
+}
+
 void ECL_Controller::reset_integrator()
 {
 	_integrator = 0.0f;
@@ -82,16 +118,76 @@ void ECL_Controller::set_time_constant(float time_constant)
 void ECL_Controller::set_k_p(float k_p)
 {
 	_k_p = k_p;
+	_gain_sched_dirty = true;
 }
 
 void ECL_Controller::set_k_i(float k_i)
 {
 	_k_i = k_i;
+	_gain_sched_dirty = true;
 }
 
 void ECL_Controller::set_k_ff(float k_ff)
 {
 	_k_ff = k_ff;
+	_gain_sched_dirty = true;
+}
+
+void ECL_Controller::set_airspeed_scaling(float airspeed_trim, float airspeed_min, float airspeed_max)
+{
+	if (airspeed_trim > 0.0f && airspeed_min > 0.0f && airspeed_max > airspeed_min) {
+		_airspeed_trim = airspeed_trim;
+		_gain_sched_airspeed_min = airspeed_min;
+		_gain_sched_airspeed_max = airspeed_max;
+		_gain_sched_enabled = true;
+		_gain_sched_dirty = true;
+
+	} else {
+		_gain_sched_enabled = false;
+	}
+}
+
+ECL_Controller::ScheduledGains ECL_Controller::scheduled_gains(float airspeed)
+{
+	if (_gain_sched_dirty) {
+		// regenerate the table - only runs after a gain or airspeed band change,
+		// the periodic loop below is a lookup plus multiply-add
+		for (unsigned bin = 0; bin < GAIN_SCHED_BINS; bin++) {
+			const float bin_airspeed = _gain_sched_airspeed_min
+						   + (_gain_sched_airspeed_max - _gain_sched_airspeed_min)
+						   * (float)bin / (float)(GAIN_SCHED_BINS - 1);
+			const float s = _airspeed_trim / bin_airspeed;
+
+			_gain_sched_table[bin].ff = _k_ff * s;
+			_gain_sched_table[bin].p = _k_p * s * s;
+			_gain_sched_table[bin].scaler = s;
+		}
+
+		_gain_sched_dirty = false;
+	}
+
+	if (!ISFINITE(airspeed)) {
+		// airspeed is NaN, +- INF or not available, pick center of band
+		airspeed = 0.5f * (_gain_sched_airspeed_min + _gain_sched_airspeed_max);
+	}
+
+	// interpolate between the two neighbouring bins
+	float pos = (airspeed - _gain_sched_airspeed_min)
+		    / (_gain_sched_airspeed_max - _gain_sched_airspeed_min) * (float)(GAIN_SCHED_BINS - 1);
+	pos = math::constrain(pos, 0.0f, (float)(GAIN_SCHED_BINS - 1));
+
+	const unsigned index = math::min((unsigned)pos, GAIN_SCHED_BINS - 2);
+	const float frac = pos - (float)index;
+
+	const ScheduledGains &lo = _gain_sched_table[index];
+	const ScheduledGains &hi = _gain_sched_table[index + 1];
+
+	ScheduledGains out;
+	out.ff = lo.ff + frac * (hi.ff - lo.ff);
+	out.p = lo.p + frac * (hi.p - lo.p);
+	out.scaler = lo.scaler + frac * (hi.scaler - lo.scaler);
+
+	return out;
 }
 
 void ECL_Controller::set_integrator_max(float max)
@@ -143,3 +239,21 @@ float ECL_Controller::constrain_airspeed(float airspeed, float minspeed, float m
 
 	return airspeed_result;
 }
+
+void ECL_RateControlGroup::register_axis(ECL_Controller *controller)
+{
+	if (controller != nullptr && _num_axes < MAX_AXES) {
+		_axes[_num_axes++] = controller;
+	}
+}
+
+void ECL_RateControlGroup::control_bodyrates(const struct ECL_ControlData &ctl_data, float dt, float outputs[])
+{
+	ecl_abstime cycle_start = ecl_absolute_time();
+
+	for (unsigned i = 0; i < _num_axes; i++) {
+		outputs[i] = _axes[i]->control_bodyrate_fixed_dt(ctl_data, dt, ctl_data.lock_integrator);
+	}
+
+	_last_cycle_time_us = ecl_elapsed_time(&cycle_start);
+}
@@ -80,7 +80,22 @@ public:
 
 	virtual float control_attitude(const struct ECL_ControlData &ctl_data) = 0;
 	virtual float control_euler_rate(const struct ECL_ControlData &ctl_data) = 0;
-	virtual float control_bodyrate(const struct ECL_ControlData &ctl_data) = 0;
+
+	/**
+	 * Run the body rate loop with the usual internally measured time step.
+	 *
+	 * Measures dt since the last call, locks the integrator over long
+	 * intervals and forwards to control_bodyrate_fixed_dt().
+	 */
+	float control_bodyrate(const struct ECL_ControlData &ctl_data);
+
+	/**
+	 * Run the body rate loop with an externally supplied time step.
+	 *
+	 * Used by ECL_RateControlGroup to advance several axes from one
+	 * fixed step without per-axis time measurements.
+	 */
+	virtual float control_bodyrate_fixed_dt(const struct ECL_ControlData &ctl_data, float dt, bool lock_integrator) = 0;
 
 	/* Setters */
 	void set_time_constant(float time_constant);
@@ -91,6 +106,19 @@ public:
 	void set_max_rate(float max_rate);
 	void set_bodyrate_setpoint(float rate);
 
+	/**
+	 * Configure the airspeed gain schedule.
+	 *
+	 * When configured the body rate loops replace the per-cycle products with
+	 * the airspeed scaler by an interpolated lookup into a table of pre-scaled
+	 * gains spanning [airspeed_min, airspeed_max], using the scaler model
+	 * s = airspeed_trim / airspeed. The table is regenerated lazily whenever a
+	 * gain setter or this method invalidates it, so the 500 Hz loop only pays
+	 * for the lookup. Pass a non-positive trim airspeed or an empty band to
+	 * disable the schedule and return to the caller supplied scaler.
+	 */
+	void set_airspeed_scaling(float airspeed_trim, float airspeed_min, float airspeed_max);
+
 	/* Getters */
 	float get_rate_error();
 	float get_desired_rate();
@@ -112,5 +140,80 @@ protected:
 	float _rate_error;
 	float _rate_setpoint;
 	float _bodyrate_setpoint;
+
+	/* pre-scaled gains for one airspeed bin of the gain schedule */
+	struct ScheduledGains {
+		float ff;	///< feed forward gain pre-multiplied with the scaler
+		float p;	///< rate error gain pre-multiplied with the squared scaler
+		float scaler;	///< the scaler itself, for the integrator input and yaw style outputs
+	};
+
+	// bin count chosen so the linear interpolation of the squared scaler stays
+	// within a fraction of a percent over a typical 1:2.5 airspeed band
+	static constexpr unsigned GAIN_SCHED_BINS = 17;
+
+	bool gain_schedule_active() const { return _gain_sched_enabled; }
+
+	/**
+	 * Interpolated pre-scaled gains for the given airspeed, constrained to the
+	 * configured band. Rebuilds the table first if a setter has invalidated it.
+	 */
+	ScheduledGains scheduled_gains(float airspeed);
+
+	float _airspeed_trim;
+	float _gain_sched_airspeed_min;
+	float _gain_sched_airspeed_max;
+	ScheduledGains _gain_sched_table[GAIN_SCHED_BINS];
+	bool _gain_sched_enabled;
+	bool _gain_sched_dirty;
+
 	float constrain_airspeed(float airspeed, float minspeed, float maxspeed);
+
+	/**
+	 * Advance the integrator by the already rate-error and dt scaled input id.
+	 *
+	 * Applies branch-free anti-windup against the last unconstrained output
+	 * and the symmetric integrator limit. Shared by all subclasses so the
+	 * saturation handling lives in one place.
+	 */
+	void update_integrator(float id);
+};
+
+/**
+ * Fixed-step rate loop engine.
+ *
+ * Advances all registered axes from one call with a single shared time
+ * step, replacing the per-axis time measurements of the individual
+ * control_bodyrate() calls and giving one place to instrument the
+ * rate loop timing.
+ */
+class ECL_RateControlGroup
+{
+public:
+	/**
+	 * Register an axis controller. Axes run in registration order.
+	 */
+	void register_axis(ECL_Controller *controller);
+
+	unsigned num_axes() const { return _num_axes; }
+
+	/**
+	 * Run the body rate loop of every registered axis with the time step dt.
+	 *
+	 * outputs must hold num_axes() entries and receives the constrained
+	 * actuator commands in registration order.
+	 */
+	void control_bodyrates(const struct ECL_ControlData &ctl_data, float dt, float outputs[]);
+
+	/**
+	 * Execution time of the last control_bodyrates() call in microseconds.
+	 */
+	uint64_t last_cycle_time_us() const { return _last_cycle_time_us; }
+
+private:
+	static constexpr unsigned MAX_AXES = 4;	///< roll, pitch, yaw and optionally wheel
+
+	ECL_Controller *_axes[MAX_AXES] {};
+	unsigned _num_axes{0};
+	uint64_t _last_cycle_time_us{0};
 };
@@ -42,8 +42,11 @@
 #include <math.h>
 #include <float.h>
 #include <geo/geo.h>
+#include <mathlib/fastmath.h>
 #include <mathlib/mathlib.h>
 
+namespace fm = ecl::fastmath;
+
 ECL_PitchController::ECL_PitchController() :
 	ECL_Controller("pitch"),
 	_max_rate_neg(0.0f),
@@ -72,7 +75,8 @@ float ECL_PitchController::control_attitude(const struct ECL_ControlData &ctl_da
 	return _rate_setpoint;
 }
 
-float ECL_PitchController::control_bodyrate(const struct ECL_ControlData &ctl_data)
+float ECL_PitchController::control_bodyrate_fixed_dt(const struct ECL_ControlData &ctl_data, float dt,
+		bool lock_integrator)
 {
 	/* Do not calculate control signal with bad inputs */
 	if (!(ISFINITE(ctl_data.roll) &&
@@ -86,38 +90,24 @@ float ECL_PitchController::control_bodyrate(const struct ECL_ControlData &ctl_da
 		return math::constrain(_last_output, -1.0f, 1.0f);
 	}
 
-	/* get the usual dt estimate */
-	uint64_t dt_micros = ecl_elapsed_time(&_last_run);
-	_last_run = ecl_absolute_time();
-	float dt = (float)dt_micros * 1e-6f;
-
-	/* lock integral for long intervals */
-	bool lock_integrator = ctl_data.lock_integrator;
-
-	if (dt_micros > 500000) {
-		lock_integrator = true;
-	}
-
 	_rate_error = _bodyrate_setpoint - ctl_data.body_y_rate;
 
-	if (!lock_integrator && _k_i > 0.0f) {
+	if (gain_schedule_active()) {
+		/* pre-scaled gains from the airspeed schedule replace the scaler products */
+		const ScheduledGains g = scheduled_gains(ctl_data.airspeed);
 
-		float id = _rate_error * dt * ctl_data.scaler;
+		if (!lock_integrator && _k_i > 0.0f) {
+			update_integrator(_rate_error * dt * g.scaler);
+		}
 
-		/*
-		 * anti-windup: do not allow integrator to increase if actuator is at limit
-		 */
-		if (_last_output < -1.0f) {
-			/* only allow motion to center: increase value */
-			id = math::max(id, 0.0f);
+		_last_output = _bodyrate_setpoint * g.ff + _rate_error * g.p + _integrator;
 
-		} else if (_last_output > 1.0f) {
-			/* only allow motion to center: decrease value */
-			id = math::min(id, 0.0f);
-		}
+		return math::constrain(_last_output, -1.0f, 1.0f);
+	}
 
-		/* add and constrain */
-		_integrator = math::constrain(_integrator + id * _k_i, -_integrator_max, _integrator_max);
+	if (!lock_integrator && _k_i > 0.0f) {
+		/* anti-windup and constraint handled by the shared engine */
+		update_integrator(_rate_error * dt * ctl_data.scaler);
 	}
 
 	/* Apply PI rate controller and store non-limited output */
@@ -131,8 +121,11 @@ float ECL_PitchController::control_bodyrate(const struct ECL_ControlData &ctl_da
 float ECL_PitchController::control_euler_rate(const struct ECL_ControlData &ctl_data)
 {
 	/* Transform setpoint to body angular rates (jacobian) */
-	_bodyrate_setpoint = cosf(ctl_data.roll) * _rate_setpoint +
-			     cosf(ctl_data.pitch) * sinf(ctl_data.roll) * ctl_data.yaw_rate_setpoint;
+	float sin_roll;
+	float cos_roll;
+	fm::sincos(ctl_data.roll, sin_roll, cos_roll);
+	_bodyrate_setpoint = cos_roll * _rate_setpoint +
+			     fm::cos(ctl_data.pitch) * sin_roll * ctl_data.yaw_rate_setpoint;
 
 	set_bodyrate_setpoint(_bodyrate_setpoint);
 
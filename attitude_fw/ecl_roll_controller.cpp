@@ -41,8 +41,11 @@
 #include "ecl_roll_controller.h"
 #include <float.h>
 #include <geo/geo.h>
+#include <mathlib/fastmath.h>
 #include <mathlib/mathlib.h>
 
+namespace fm = ecl::fastmath;
+
 ECL_RollController::ECL_RollController() :
 	ECL_Controller("roll")
 {
@@ -64,7 +67,8 @@ float ECL_RollController::control_attitude(const struct ECL_ControlData &ctl_dat
 	return _rate_setpoint;
 }
 
-float ECL_RollController::control_bodyrate(const struct ECL_ControlData &ctl_data)
+float ECL_RollController::control_bodyrate_fixed_dt(const struct ECL_ControlData &ctl_data, float dt,
+		bool lock_integrator)
 {
 	/* Do not calculate control signal with bad inputs */
 	if (!(ISFINITE(ctl_data.pitch) &&
@@ -77,39 +81,25 @@ float ECL_RollController::control_bodyrate(const struct ECL_ControlData &ctl_dat
 		return math::constrain(_last_output, -1.0f, 1.0f);
 	}
 
-	/* get the usual dt estimate */
-	uint64_t dt_micros = ecl_elapsed_time(&_last_run);
-	_last_run = ecl_absolute_time();
-	float dt = (float)dt_micros * 1e-6f;
-
-	/* lock integral for long intervals */
-	bool lock_integrator = ctl_data.lock_integrator;
-
-	if (dt_micros > 500000) {
-		lock_integrator = true;
-	}
-
 	/* Calculate body angular rate error */
 	_rate_error = _bodyrate_setpoint - ctl_data.body_x_rate; //body angular rate error
 
-	if (!lock_integrator && _k_i > 0.0f) {
+	if (gain_schedule_active()) {
+		/* pre-scaled gains from the airspeed schedule replace the scaler products */
+		const ScheduledGains g = scheduled_gains(ctl_data.airspeed);
 
-		float id = _rate_error * dt * ctl_data.scaler;
+		if (!lock_integrator && _k_i > 0.0f) {
+			update_integrator(_rate_error * dt * g.scaler);
+		}
 
-		/*
-		* anti-windup: do not allow integrator to increase if actuator is at limit
-		*/
-		if (_last_output < -1.0f) {
-			/* only allow motion to center: increase value */
-			id = math::max(id, 0.0f);
+		_last_output = _bodyrate_setpoint * g.ff + _rate_error * g.p + _integrator;
 
-		} else if (_last_output > 1.0f) {
-			/* only allow motion to center: decrease value */
-			id = math::min(id, 0.0f);
-		}
+		return math::constrain(_last_output, -1.0f, 1.0f);
+	}
 
-		/* add and constrain */
-		_integrator = math::constrain(_integrator + id * _k_i, -_integrator_max, _integrator_max);
+	if (!lock_integrator && _k_i > 0.0f) {
+		/* anti-windup and constraint handled by the shared engine */
+		update_integrator(_rate_error * dt * ctl_data.scaler);
 	}
 
 	/* Apply PI rate controller and store non-limited output */
@@ -123,7 +113,7 @@ float ECL_RollController::control_bodyrate(const struct ECL_ControlData &ctl_dat
 float ECL_RollController::control_euler_rate(const struct ECL_ControlData &ctl_data)
 {
 	/* Transform setpoint to body angular rates (jacobian) */
-	_bodyrate_setpoint = ctl_data.roll_rate_setpoint - sinf(ctl_data.pitch) * ctl_data.yaw_rate_setpoint;
+	_bodyrate_setpoint = ctl_data.roll_rate_setpoint - fm::sin(ctl_data.pitch) * ctl_data.yaw_rate_setpoint;
 
 	set_bodyrate_setpoint(_bodyrate_setpoint);
 
@@ -51,7 +51,8 @@ ECL_WheelController::ECL_WheelController() :
 {
 }
 
-float ECL_WheelController::control_bodyrate(const struct ECL_ControlData &ctl_data)
+float ECL_WheelController::control_bodyrate_fixed_dt(const struct ECL_ControlData &ctl_data, float dt,
+		bool lock_integrator)
 {
 	/* Do not calculate control signal with bad inputs */
 	if (!(ISFINITE(ctl_data.body_z_rate) &&
@@ -60,18 +61,6 @@ float ECL_WheelController::control_bodyrate(const struct ECL_ControlData &ctl_da
 		return math::constrain(_last_output, -1.0f, 1.0f);
 	}
 
-	/* get the usual dt estimate */
-	uint64_t dt_micros = ecl_elapsed_time(&_last_run);
-	_last_run = ecl_absolute_time();
-	float dt = (float)dt_micros * 1e-6f;
-
-	/* lock integral for long intervals */
-	bool lock_integrator = ctl_data.lock_integrator;
-
-	if (dt_micros > 500000) {
-		lock_integrator = true;
-	}
-
 	/* input conditioning */
 	float min_speed = 1.0f;
 
@@ -79,23 +68,8 @@ float ECL_WheelController::control_bodyrate(const struct ECL_ControlData &ctl_da
 	_rate_error = _rate_setpoint - ctl_data.body_z_rate; //body angular rate error
 
 	if (!lock_integrator && _k_i > 0.0f && ctl_data.groundspeed > min_speed) {
-
-		float id = _rate_error * dt * ctl_data.groundspeed_scaler;
-
-		/*
-		 * anti-windup: do not allow integrator to increase if actuator is at limit
-		 */
-		if (_last_output < -1.0f) {
-			/* only allow motion to center: increase value */
-			id = math::max(id, 0.0f);
-
-		} else if (_last_output > 1.0f) {
-			/* only allow motion to center: decrease value */
-			id = math::min(id, 0.0f);
-		}
-
-		/* add and constrain */
-		_integrator = math::constrain(_integrator + id * _k_i, -_integrator_max, _integrator_max);
+		/* anti-windup and constraint handled by the shared engine */
+		update_integrator(_rate_error * dt * ctl_data.groundspeed_scaler);
 	}
 
 	/* Apply PI rate controller and store non-limited output */
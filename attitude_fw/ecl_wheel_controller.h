@@ -60,7 +60,7 @@ public:
 
 	float control_attitude(const struct ECL_ControlData &ctl_data);
 
-	float control_bodyrate(const struct ECL_ControlData &ctl_data);
+	float control_bodyrate_fixed_dt(const struct ECL_ControlData &ctl_data, float dt, bool lock_integrator) override;
 
 	float control_euler_rate(const struct ECL_ControlData &ctl_data) {return 0;}
 };
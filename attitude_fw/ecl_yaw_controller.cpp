@@ -41,8 +41,11 @@
 #include "ecl_yaw_controller.h"
 #include <float.h>
 #include <geo/geo.h>
+#include <mathlib/fastmath.h>
 #include <mathlib/mathlib.h>
 
+namespace fm = ecl::fastmath;
+
 ECL_YawController::ECL_YawController() :
 	ECL_Controller("yaw"),
 	_coordinated_min_speed(1.0f),
@@ -110,7 +113,11 @@ float ECL_YawController::control_attitude_impl_openloop(const struct ECL_Control
 
 	if (!inverted) {
 		/* Calculate desired yaw rate from coordinated turn constraint / (no side forces) */
-		_rate_setpoint = tanf(constrained_roll) * cosf(ctl_data.pitch) * CONSTANTS_ONE_G / (ctl_data.airspeed <
+		/* tan is evaluated as sin/cos from a fused sincos, roll is constrained away from +-90 deg above */
+		float sin_roll;
+		float cos_roll;
+		fm::sincos(constrained_roll, sin_roll, cos_roll);
+		_rate_setpoint = (sin_roll / cos_roll) * fm::cos(ctl_data.pitch) * CONSTANTS_ONE_G / (ctl_data.airspeed <
 				 ctl_data.airspeed_min ? ctl_data.airspeed_min : ctl_data.airspeed);
 	}
 
@@ -122,7 +129,8 @@ float ECL_YawController::control_attitude_impl_openloop(const struct ECL_Control
 	return _rate_setpoint;
 }
 
-float ECL_YawController::control_bodyrate(const struct ECL_ControlData &ctl_data)
+float ECL_YawController::control_bodyrate_fixed_dt(const struct ECL_ControlData &ctl_data, float dt,
+		bool lock_integrator)
 {
 	/* Do not calculate control signal with bad inputs */
 	if (!(ISFINITE(ctl_data.roll) && ISFINITE(ctl_data.pitch) && ISFINITE(ctl_data.body_y_rate) &&
@@ -132,18 +140,6 @@ float ECL_YawController::control_bodyrate(const struct ECL_ControlData &ctl_data
 		return math::constrain(_last_output, -1.0f, 1.0f);
 	}
 
-	/* get the usual dt estimate */
-	uint64_t dt_micros = ecl_elapsed_time(&_last_run);
-	_last_run = ecl_absolute_time();
-	float dt = (float)dt_micros * 1e-6f;
-
-	/* lock integral for long intervals */
-	bool lock_integrator = ctl_data.lock_integrator;
-
-	if (dt_micros > 500000) {
-		lock_integrator = true;
-	}
-
 	/* input conditioning */
 	float airspeed = ctl_data.airspeed;
 
@@ -165,23 +161,18 @@ float ECL_YawController::control_bodyrate(const struct ECL_ControlData &ctl_data
 	_rate_error = _bodyrate_setpoint - ctl_data.body_z_rate; // body angular rate error
 
 	if (!lock_integrator && _k_i > 0.0f && airspeed > 0.5f * ctl_data.airspeed_min) {
+		/* anti-windup and constraint handled by the shared engine */
+		update_integrator(_rate_error * dt);
+	}
 
-		float id = _rate_error * dt;
-
-		/*
-		 * anti-windup: do not allow integrator to increase if actuator is at limit
-		 */
-		if (_last_output < -1.0f) {
-			/* only allow motion to center: increase value */
-			id = math::max(id, 0.0f);
+	if (gain_schedule_active()) {
+		/* pre-scaled gains from the airspeed schedule replace the scaler products */
+		const ScheduledGains g = scheduled_gains(airspeed);
 
-		} else if (_last_output > 1.0f) {
-			/* only allow motion to center: decrease value */
-			id = math::min(id, 0.0f);
-		}
+		_last_output = _bodyrate_setpoint * g.ff * g.scaler + _rate_error * g.p
+			       + _integrator * g.scaler * g.scaler;
 
-		/* add and constrain */
-		_integrator = math::constrain(_integrator + id * _k_i, -_integrator_max, _integrator_max);
+		return math::constrain(_last_output, -1.0f, 1.0f);
 	}
 
 	/* Apply PI rate controller and store non-limited output */
@@ -201,8 +192,11 @@ float ECL_YawController::control_attitude_impl_accclosedloop(const struct ECL_Co
 float ECL_YawController::control_euler_rate(const struct ECL_ControlData &ctl_data)
 {
 	/* Transform setpoint to body angular rates (jacobian) */
-	_bodyrate_setpoint = -sinf(ctl_data.roll) * ctl_data.pitch_rate_setpoint +
-			     cosf(ctl_data.roll) * cosf(ctl_data.pitch) * _rate_setpoint;
+	float sin_roll;
+	float cos_roll;
+	fm::sincos(ctl_data.roll, sin_roll, cos_roll);
+	_bodyrate_setpoint = -sin_roll * ctl_data.pitch_rate_setpoint +
+			     cos_roll * fm::cos(ctl_data.pitch) * _rate_setpoint;
 
 	set_bodyrate_setpoint(_bodyrate_setpoint);
 
@@ -53,20 +53,44 @@ using ecl_abstime = hrt_abstime;
 
 #else
 
+#include <chrono>
 #include <cstdio>
 #include <cstdint>
 
-#define ecl_absolute_time() (0)
-#define ecl_elapsed_time(t) (*t * 0UL) // TODO: add simple time functions
-
 using ecl_abstime = uint64_t;
 
+// monotonic system time in microseconds, counted from the first call
+static inline ecl_abstime ecl_absolute_time()
+{
+	using namespace std::chrono;
+	static const steady_clock::time_point start = steady_clock::now();
+	return (ecl_abstime)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+#define ecl_elapsed_time(t) (ecl_absolute_time() - *t)
+
 #define ECL_INFO printf
 #define ECL_WARN printf
 #define ECL_ERR printf
 
 #endif /* PX4_POSIX || PX4_NUTTX */
 
+#if defined(ECL_DEFERRED_LOG)
+
+// route the log macros into the deferred diagnostics ring so the estimator
+// thread never blocks on console I/O, see ecl_diag.h for the drain side
+#include <ecl_diag.h>
+
+#undef ECL_INFO
+#undef ECL_WARN
+#undef ECL_ERR
+
+#define ECL_INFO(...) ecl_diag_push(ECL_DIAG_INFO, __VA_ARGS__)
+#define ECL_WARN(...) ecl_diag_push(ECL_DIAG_WARN, __VA_ARGS__)
+#define ECL_ERR(...)  ecl_diag_push(ECL_DIAG_ERR, __VA_ARGS__)
+
+#endif /* ECL_DEFERRED_LOG */
+
 
 #if defined(__PX4_QURT)
 
@@ -0,0 +1,124 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ecl_diag.h
+ * Deferred diagnostics ring for the library log macros.
+ *
+ * When the library is built with ECL_DEFERRED_LOG the ECL_INFO / ECL_WARN /
+ * ECL_ERR macros render their message into a fixed size record and push it to
+ * a lock free single producer single consumer ring instead of writing to the
+ * console. The estimator thread never blocks on console I/O; the host drains
+ * the ring at leisure with ecl_diag_pop() from one other thread and decides
+ * where the records go. When the ring is full new records are dropped and
+ * counted, so a stalled consumer can never stall the filter.
+ *
+ * This header is included by ecl.h after the time shim is declared, it is not
+ * meant to be included directly.
+ */
+
+#pragma once
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+
+#include <EKF/SpscQueue.h>
+
+// severity of a diagnostics record, matching the three log macros
+enum ecl_diag_level : uint8_t {
+	ECL_DIAG_INFO = 0,
+	ECL_DIAG_WARN,
+	ECL_DIAG_ERR
+};
+
+// one fixed size diagnostics record
+struct ecl_diag_record {
+	uint64_t time_us;	///< time the event was recorded
+	uint8_t level;		///< ecl_diag_level severity
+	char msg[87];		///< rendered message, always nul terminated
+};
+
+// number of records the ring can hold before new records are dropped
+static constexpr uint16_t ECL_DIAG_RING_LENGTH = 32;
+
+namespace ecl_diag_detail
+{
+
+// process wide diagnostics ring, created on first use
+inline SpscQueue<ecl_diag_record> &ring()
+{
+	static SpscQueue<ecl_diag_record> instance;
+	static bool allocated = instance.allocate(ECL_DIAG_RING_LENGTH);
+	(void)allocated;
+	return instance;
+}
+
+inline std::atomic<uint32_t> &dropped_counter()
+{
+	static std::atomic<uint32_t> counter{0};
+	return counter;
+}
+
+} // namespace ecl_diag_detail
+
+// producer side, called by the log macros from the estimator thread
+__attribute__((format(printf, 2, 3)))
+inline void ecl_diag_push(ecl_diag_level level, const char *fmt, ...)
+{
+	ecl_diag_record record;
+	record.time_us = ecl_absolute_time();
+	record.level = level;
+
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(record.msg, sizeof(record.msg), fmt, args);
+	va_end(args);
+
+	if (!ecl_diag_detail::ring().push(record)) {
+		ecl_diag_detail::dropped_counter().fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+// consumer side, called by the host from one draining thread
+// returns false when no record is pending
+inline bool ecl_diag_pop(ecl_diag_record *record)
+{
+	return ecl_diag_detail::ring().pop(record);
+}
+
+// number of records dropped because the ring was full
+inline uint32_t ecl_diag_dropped()
+{
+	return ecl_diag_detail::dropped_counter().load(std::memory_order_relaxed);
+}
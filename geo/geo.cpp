@@ -58,7 +58,7 @@ using matrix::wrap_2pi;
  */
 
 static struct map_projection_reference_s mp_ref;
-static struct globallocal_converter_reference_s gl_ref = {0.0f, false};
+static struct globallocal_converter_reference_s gl_ref = {};
 
 bool map_projection_global_initialized()
 {
@@ -94,6 +94,7 @@ int map_projection_init_timestamped(struct map_projection_reference_s *ref, doub
 	ref->lon_rad = math::radians(lon_0);
 	ref->sin_lat = sin(ref->lat_rad);
 	ref->cos_lat = cos(ref->lat_rad);
+	ref->fast_radius_rad = (double)CONSTANTS_PROJECTION_FAST_RADIUS / CONSTANTS_RADIUS_OF_EARTH;
 
 	ref->timestamp = timestamp;
 	ref->init_done = true;
@@ -101,6 +102,22 @@ int map_projection_init_timestamped(struct map_projection_reference_s *ref, doub
 	return 0;
 }
 
+int map_projection_set_fast_radius(struct map_projection_reference_s *ref, float radius_m)
+{
+	if (!map_projection_initialized(ref)) {
+		return -1;
+	}
+
+	ref->fast_radius_rad = (double)math::max(radius_m, 0.0f) / CONSTANTS_RADIUS_OF_EARTH;
+
+	return 0;
+}
+
+int map_projection_global_set_fast_radius(float radius_m)
+{
+	return map_projection_set_fast_radius(&mp_ref, radius_m);
+}
+
 //lat_0, lon_0 are expected to be in correct format: -> 47.1234567 and not 471234567
 int map_projection_init(struct map_projection_reference_s *ref, double lat_0, double lon_0)
 {
@@ -138,6 +155,20 @@ int map_projection_project(const struct map_projection_reference_s *ref, double
 	const double lat_rad = math::radians(lat);
 	const double lon_rad = math::radians(lon);
 
+	const double d_lat = lat_rad - ref->lat_rad;
+	const double d_lon = lon_rad - ref->lon_rad;
+
+	// within the fast radius a second order expansion about the reference point matches
+	// the exact solution to millimetres and avoids the trig below - the expansion is not
+	// used close to the poles where the meridian convergence term becomes ill conditioned
+	if ((fabs(d_lat) < ref->fast_radius_rad) && (fabs(d_lon * ref->cos_lat) < ref->fast_radius_rad)
+	    && (ref->cos_lat > 0.01)) {
+		*x = static_cast<float>((d_lat + d_lon * d_lon * ref->sin_lat * ref->cos_lat * 0.5) * CONSTANTS_RADIUS_OF_EARTH);
+		*y = static_cast<float>(d_lon * (ref->cos_lat - d_lat * ref->sin_lat) * CONSTANTS_RADIUS_OF_EARTH);
+
+		return 0;
+	}
+
 	const double sin_lat = sin(lat_rad);
 	const double cos_lat = cos(lat_rad);
 
@@ -171,6 +202,21 @@ int map_projection_reproject(const struct map_projection_reference_s *ref, float
 
 	const double x_rad = (double)x / CONSTANTS_RADIUS_OF_EARTH;
 	const double y_rad = (double)y / CONSTANTS_RADIUS_OF_EARTH;
+
+	// invert the second order expansion used by map_projection_project() inside the
+	// fast radius so projecting and reprojecting round trips without any trig
+	if ((fabs(x_rad) < ref->fast_radius_rad) && (fabs(y_rad) < ref->fast_radius_rad)
+	    && (ref->cos_lat > 0.01)) {
+		const double d_lon_approx = y_rad / ref->cos_lat;
+		const double d_lat = x_rad - d_lon_approx * d_lon_approx * ref->sin_lat * ref->cos_lat * 0.5;
+		const double d_lon = y_rad / (ref->cos_lat - d_lat * ref->sin_lat);
+
+		*lat = math::degrees(ref->lat_rad + d_lat);
+		*lon = math::degrees(ref->lon_rad + d_lon);
+
+		return 0;
+	}
+
 	const double c = sqrt(x_rad * x_rad + y_rad * y_rad);
 
 	if (fabs(c) > 0) {
@@ -267,6 +313,74 @@ int globallocalconverter_getref(double *lat_0, double *lon_0, float *alt_0)
 	return 0;
 }
 
+int globallocalconverter_init(struct globallocal_converter_reference_s *gl, double lat_0, double lon_0, float alt_0,
+			      uint64_t timestamp)
+{
+	gl->alt = alt_0;
+
+	if (map_projection_init_timestamped(&gl->projection, lat_0, lon_0, timestamp) != 0) {
+		gl->init_done = false;
+		return -1;
+	}
+
+	gl->init_done = true;
+
+	return 0;
+}
+
+bool globallocalconverter_initialized(const struct globallocal_converter_reference_s *gl)
+{
+	return gl->init_done && map_projection_initialized(&gl->projection);
+}
+
+int globallocalconverter_tolocal(const struct globallocal_converter_reference_s *gl, double lat, double lon, float alt,
+				 float *x, float *y, float *z)
+{
+	if (!globallocalconverter_initialized(gl)) {
+		return -1;
+	}
+
+	map_projection_project(&gl->projection, lat, lon, x, y);
+	*z = gl->alt - alt;
+
+	return 0;
+}
+
+int globallocalconverter_toglobal(const struct globallocal_converter_reference_s *gl, float x, float y, float z,
+				  double *lat, double *lon, float *alt)
+{
+	if (!globallocalconverter_initialized(gl)) {
+		return -1;
+	}
+
+	map_projection_reproject(&gl->projection, x, y, lat, lon);
+	*alt = gl->alt - z;
+
+	return 0;
+}
+
+int globallocalconverter_getref(const struct globallocal_converter_reference_s *gl, double *lat_0, double *lon_0,
+				float *alt_0)
+{
+	if (!globallocalconverter_initialized(gl)) {
+		return -1;
+	}
+
+	if (lat_0 != nullptr) {
+		*lat_0 = math::degrees(gl->projection.lat_rad);
+	}
+
+	if (lon_0 != nullptr) {
+		*lon_0 = math::degrees(gl->projection.lon_rad);
+	}
+
+	if (alt_0 != nullptr) {
+		*alt_0 = gl->alt;
+	}
+
+	return 0;
+}
+
 float get_distance_to_next_waypoint(double lat_now, double lon_now, double lat_next, double lon_next)
 {
 	const double lat_now_rad = math::radians(lat_now);
@@ -282,6 +396,52 @@ float get_distance_to_next_waypoint(double lat_now, double lon_now, double lat_n
 	return static_cast<float>(CONSTANTS_RADIUS_OF_EARTH * 2.0 * c);
 }
 
+void get_distance_to_waypoints(double lat_now, double lon_now, const double lat_next[], const double lon_next[],
+			       float distance[], unsigned count)
+{
+	// hoist the trig of the shared current position out of the loop - the loop body
+	// keeps the evaluation order of get_distance_to_next_waypoint() so both variants
+	// return identical results
+	const double lat_now_rad = math::radians(lat_now);
+	const double lon_now_rad = math::radians(lon_now);
+	const double cos_lat_now = cos(lat_now_rad);
+
+	for (unsigned i = 0; i < count; i++) {
+		const double lat_next_rad = math::radians(lat_next[i]);
+
+		const double d_lat = lat_next_rad - lat_now_rad;
+		const double d_lon = math::radians(lon_next[i]) - lon_now_rad;
+
+		const double a = sin(d_lat / 2.0) * sin(d_lat / 2.0) + sin(d_lon / 2.0) * sin(d_lon / 2.0) * cos_lat_now * cos(lat_next_rad);
+
+		const double c = atan2(sqrt(a), sqrt(1.0 - a));
+
+		distance[i] = static_cast<float>(CONSTANTS_RADIUS_OF_EARTH * 2.0 * c);
+	}
+}
+
+void get_bearing_to_waypoints(double lat_now, double lon_now, const double lat_next[], const double lon_next[],
+			      float bearing[], unsigned count)
+{
+	const double lat_now_rad = math::radians(lat_now);
+	const double cos_lat_now = cos(lat_now_rad);
+	const double sin_lat_now = sin(lat_now_rad);
+
+	for (unsigned i = 0; i < count; i++) {
+		const double lat_next_rad = math::radians(lat_next[i]);
+
+		const double cos_lat_next = cos(lat_next_rad);
+		const double d_lon = math::radians(lon_next[i] - lon_now);
+
+		/* conscious mix of double and float trig function to maximize speed and efficiency */
+
+		const float y = static_cast<float>(sin(d_lon) * cos_lat_next);
+		const float x = static_cast<float>(cos_lat_now * sin(lat_next_rad) - sin_lat_now * cos_lat_next * cos(d_lon));
+
+		bearing[i] = wrap_pi(atan2f(y, x));
+	}
+}
+
 void create_waypoint_from_line_and_dist(double lat_A, double lon_A, double lat_B, double lon_B, float dist,
 					double *lat_target, double *lon_target)
 {
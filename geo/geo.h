@@ -63,6 +63,11 @@ static constexpr float  CONSTANTS_RADIUS_OF_EARTH_F = CONSTANTS_RADIUS_OF_EARTH;
 
 static constexpr float CONSTANTS_EARTH_SPIN_RATE = 7.2921150e-5f;				// radians/second (rad/s)
 
+// default radius around the projection reference point within which the linearized
+// fast projection path is used - the expansion error inside this radius is at the
+// millimetre level, far below GPS accuracy
+static constexpr float CONSTANTS_PROJECTION_FAST_RADIUS = 5000.0f;				// meters (m)
+
 
 // XXX remove
 struct crosstrack_error_s {
@@ -78,10 +83,12 @@ struct map_projection_reference_s {
 	double lon_rad;
 	double sin_lat;
 	double cos_lat;
+	double fast_radius_rad;
 	bool init_done;
 };
 
 struct globallocal_converter_reference_s {
+	struct map_projection_reference_s projection;
 	float alt;
 	bool init_done;
 };
@@ -152,6 +159,26 @@ int map_projection_init_timestamped(struct map_projection_reference_s *ref, doub
  */
 int map_projection_init(struct map_projection_reference_s *ref, double lat_0, double lon_0);
 
+/**
+ * Set the radius around the reference point within which projections use the
+ * linearized fast path instead of the exact azimuthal equidistant equations.
+ *
+ * The fast path expands the projection to second order about the reference
+ * point using the cached reference trig, so points inside the radius are
+ * transformed without any trigonometric calls. Pass 0 to always use the
+ * exact equations. New projections default to CONSTANTS_PROJECTION_FAST_RADIUS.
+ *
+ * @param radius_m fast path radius in meters
+ * @return 0 if map_projection_init was called before, -1 else
+ */
+int map_projection_set_fast_radius(struct map_projection_reference_s *ref, float radius_m);
+
+/**
+ * Set the fast path radius of the global map projection
+ * @return 0 if the global projection was initialized before, -1 else
+ */
+int map_projection_global_set_fast_radius(float radius_m);
+
 /**
  * Transforms a point in the geographic coordinate system to the local
  * azimuthal equidistant plane using the global projection
@@ -228,6 +255,42 @@ int globallocalconverter_toglobal(float x, float y, float z,  double *lat, doubl
  */
 int globallocalconverter_getref(double *lat_0, double *lon_0, float *alt_0);
 
+/**
+ * Initialize a caller owned global/local converter.
+ *
+ * Unlike the unsuffixed functions above, which route through a single
+ * file static reference, these overloads keep all projection state in the
+ * converter passed by the caller. Independent estimator instances and
+ * replay threads can therefore convert concurrently without locking, as
+ * long as each thread uses its own converter.
+ */
+int globallocalconverter_init(struct globallocal_converter_reference_s *gl, double lat_0, double lon_0, float alt_0,
+			      uint64_t timestamp);
+
+/**
+ * Checks if the converter given as argument was initialized
+ * @return true if it was initialized before, false else
+ */
+bool globallocalconverter_initialized(const struct globallocal_converter_reference_s *gl);
+
+/**
+ * Convert from global position coordinates to local position coordinates using the given converter
+ */
+int globallocalconverter_tolocal(const struct globallocal_converter_reference_s *gl, double lat, double lon, float alt,
+				 float *x, float *y, float *z);
+
+/**
+ * Convert from local position coordinates to global position coordinates using the given converter
+ */
+int globallocalconverter_toglobal(const struct globallocal_converter_reference_s *gl, float x, float y, float z,
+				  double *lat, double *lon, float *alt);
+
+/**
+ * Get reference position of the given converter
+ */
+int globallocalconverter_getref(const struct globallocal_converter_reference_s *gl, double *lat_0, double *lon_0,
+				float *alt_0);
+
 /**
  * Returns the distance to the next waypoint in meters.
  *
@@ -238,6 +301,23 @@ int globallocalconverter_getref(double *lat_0, double *lon_0, float *alt_0);
  */
 float get_distance_to_next_waypoint(double lat_now, double lon_now, double lat_next, double lon_next);
 
+/**
+ * Returns the distances to a list of waypoints in meters.
+ *
+ * The trig of the shared current position is computed once, so calling this is
+ * considerably cheaper than calling get_distance_to_next_waypoint() per waypoint.
+ * The results are identical to the per waypoint function.
+ *
+ * @param lat_now current position in degrees (47.1234567°, not 471234567°)
+ * @param lon_now current position in degrees (8.1234567°, not 81234567°)
+ * @param lat_next waypoint latitudes in degrees
+ * @param lon_next waypoint longitudes in degrees
+ * @param distance output distances in meters, one per waypoint
+ * @param count number of waypoints
+ */
+void get_distance_to_waypoints(double lat_now, double lon_now, const double lat_next[], const double lon_next[],
+			       float distance[], unsigned count);
+
 /**
  * Creates a new waypoint C on the line of two given waypoints (A, B) at certain distance
  * from waypoint A
@@ -277,6 +357,23 @@ void waypoint_from_heading_and_distance(double lat_start, double lon_start, floa
  */
 float get_bearing_to_next_waypoint(double lat_now, double lon_now, double lat_next, double lon_next);
 
+/**
+ * Returns the bearings to a list of waypoints in radians.
+ *
+ * The trig of the shared current position is computed once, so calling this is
+ * considerably cheaper than calling get_bearing_to_next_waypoint() per waypoint.
+ * The results are identical to the per waypoint function.
+ *
+ * @param lat_now current position in degrees (47.1234567°, not 471234567°)
+ * @param lon_now current position in degrees (8.1234567°, not 81234567°)
+ * @param lat_next waypoint latitudes in degrees
+ * @param lon_next waypoint longitudes in degrees
+ * @param bearing output bearings in radians, one per waypoint
+ * @param count number of waypoints
+ */
+void get_bearing_to_waypoints(double lat_now, double lon_now, const double lat_next[], const double lon_next[],
+			      float bearing[], unsigned count);
+
 void get_vector_to_next_waypoint(double lat_now, double lon_now, double lat_next, double lon_next, float *v_n, float *v_e);
 
 void get_vector_to_next_waypoint_fast(double lat_now, double lon_now, double lat_next, double lon_next, float *v_n, float *v_e);
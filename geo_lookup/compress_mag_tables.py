@@ -0,0 +1,181 @@
+#!/usr/bin/env python
+"""
+compress_mag_tables.py - produce the delta compressed magnetic field tables.
+
+Input is one CSV grid export per field component (declination, inclination,
+strength), as produced by the NOAA IGRF grid calculator: one `lat,lon,value`
+line per sample on a uniform grid covering the same area in the same order
+for all three components. Output is a C translation unit defining the three
+mag_compressed_table_s instances consumed by geo_mag_declination.cpp when
+GEO_MAG_COMPRESSED_TABLES is enabled.
+
+Values are quantized to `--scale` units (e.g. 0.1 degrees). Each row is
+stored as an int16 base count plus nibble packed signed deltas along
+longitude; a nibble of -8 escapes to a signed 8 bit delta in the following
+two nibbles. The script fails if a delta does not fit 8 bits - pick a
+coarser scale in that case.
+
+    python compress_mag_tables.py declination.csv inclination.csv strength.csv \\
+        --scale 1.0 -o geo_mag_tables_compressed.cpp
+"""
+
+from __future__ import print_function
+
+import argparse
+import sys
+
+
+def read_grid(path):
+    """Read a lat,lon,value CSV into (sorted lats, sorted lons, value dict)."""
+    values = {}
+
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+
+            if not line or line.startswith('#'):
+                continue
+
+            lat_s, lon_s, val_s = line.split(',')
+            values[(float(lat_s), float(lon_s))] = float(val_s)
+
+    lats = sorted(set(k[0] for k in values))
+    lons = sorted(set(k[1] for k in values))
+
+    if len(values) != len(lats) * len(lons):
+        raise SystemExit('%s: not a full grid (%u samples, %ux%u grid)'
+                         % (path, len(values), len(lats), len(lons)))
+
+    res = lats[1] - lats[0]
+
+    for seq in (lats, lons):
+        for a, b in zip(seq, seq[1:]):
+            if abs((b - a) - res) > 1e-6:
+                raise SystemExit('%s: grid spacing is not uniform' % path)
+
+    return lats, lons, values
+
+
+def pack_rows(lats, lons, values, scale, path):
+    """Quantize and delta encode the grid; returns (bases, offsets, stream)."""
+    bases = []
+    offsets = []
+    stream = []	    # nibbles
+
+    for lat in lats:
+        counts = [int(round(values[(lat, lon)] / scale)) for lon in lons]
+
+        if not -32768 <= counts[0] <= 32767:
+            raise SystemExit('%s: row base %d does not fit int16 - use a coarser --scale'
+                             % (path, counts[0]))
+
+        # rows start byte aligned so they can be decoded independently
+        if len(stream) % 2:
+            stream.append(0)
+
+        bases.append(counts[0])
+        offsets.append(len(stream) // 2)
+
+        for prev, cur in zip(counts, counts[1:]):
+            delta = cur - prev
+
+            if -7 <= delta <= 7:
+                stream.append(delta & 0xf)
+
+            elif -128 <= delta <= 127:
+                stream.append(0x8)	# escape
+                stream.append((delta >> 4) & 0xf)
+                stream.append(delta & 0xf)
+
+            else:
+                raise SystemExit('%s: delta %d at lat %g does not fit 8 bits - use a coarser --scale'
+                                 % (path, delta, lat))
+
+    if len(stream) % 2:
+        stream.append(0)
+
+    packed = [(stream[i] << 4) | stream[i + 1] for i in range(0, len(stream), 2)]
+
+    if max(offsets) > 0xffff:
+        raise SystemExit('%s: delta stream exceeds 64 KiB per table' % path)
+
+    return bases, offsets, packed
+
+
+def emit_array(out, ctype, name, data, per_line=24):
+    out.write('static constexpr %s %s[%u] = {\n' % (ctype, name, len(data)))
+
+    for i in range(0, len(data), per_line):
+        out.write('\t' + ','.join(str(v) for v in data[i:i + per_line]) + ',\n')
+
+    out.write('};\n\n')
+
+
+def flit(v):
+    """Format a python float as a C float literal."""
+    s = '%g' % v
+
+    if '.' not in s and 'e' not in s:
+        s += '.0'
+
+    return s + 'f'
+
+
+def emit_table(out, name, lats, lons, scale, bases, offsets, packed):
+    emit_array(out, 'int16_t', name + '_base', bases)
+    emit_array(out, 'uint16_t', name + '_offset', offsets)
+    emit_array(out, 'uint8_t', name + '_deltas', packed)
+
+    out.write('const mag_compressed_table_s %s = {\n' % name)
+    out.write('\t%s,\t// sampling_res\n' % flit(lats[1] - lats[0]))
+    out.write('\t%s, %s,\t// min_lat, max_lat\n' % (flit(lats[0]), flit(lats[-1])))
+    out.write('\t%s, %s,\t// min_lon, max_lon\n' % (flit(lons[0]), flit(lons[-1])))
+    out.write('\t%u, %u,\t// num_lat, num_lon\n' % (len(lats), len(lons)))
+    out.write('\t%s,\t// scale\n' % flit(scale))
+    out.write('\t%s_base,\n' % name)
+    out.write('\t%s_offset,\n' % name)
+    out.write('\t%s_deltas,\n' % name)
+    out.write('};\n\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='compress magnetic field grid exports')
+    parser.add_argument('declination')
+    parser.add_argument('inclination')
+    parser.add_argument('strength')
+    parser.add_argument('--scale', type=float, default=1.0,
+                        help='value units per stored count (default: 1.0)')
+    parser.add_argument('-o', '--output', default='geo_mag_tables_compressed.cpp')
+    args = parser.parse_args()
+
+    grids = [read_grid(p) for p in (args.declination, args.inclination, args.strength)]
+
+    if not all(g[0] == grids[0][0] and g[1] == grids[0][1] for g in grids):
+        raise SystemExit('the three components must share one grid')
+
+    lats, lons = grids[0][0], grids[0][1]
+    raw_bytes = 0
+    packed_bytes = 0
+
+    with open(args.output, 'w') as out:
+        out.write('/* generated by compress_mag_tables.py - do not edit by hand */\n\n')
+        out.write('#include "geo_mag_compressed.h"\n\n')
+        out.write('#ifdef GEO_MAG_COMPRESSED_TABLES\n\n')
+
+        for name, (glats, glons, values), path in zip(
+                ('mag_declination_compressed', 'mag_inclination_compressed', 'mag_strength_compressed'),
+                grids, (args.declination, args.inclination, args.strength)):
+            bases, offsets, packed = pack_rows(glats, glons, values, args.scale, path)
+            emit_table(out, name, glats, glons, args.scale, bases, offsets, packed)
+            raw_bytes += 4 * len(glats) * len(glons)
+            packed_bytes += 2 * len(bases) + 2 * len(offsets) + len(packed)
+
+        out.write('#endif // GEO_MAG_COMPRESSED_TABLES\n')
+
+    print('%s: %ux%u grid, %u bytes packed (float tables would be %u bytes)'
+          % (args.output, len(lats), len(lons), packed_bytes, raw_bytes))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
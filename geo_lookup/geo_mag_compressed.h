@@ -0,0 +1,78 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2014 MAV GEO Library (MAVGEO). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name MAVGEO nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+* @file geo_mag_compressed.h
+*
+* Delta compressed storage for the magnetic field lookup tables.
+*
+* A naive finer sampling grid multiplies the flash cost of the int8 tables in
+* geo_mag_declination.cpp by the resolution factor squared. The field is
+* smooth, so adjacent samples differ by only a few counts: each table row is
+* stored as an int16 base value followed by nibble packed signed deltas along
+* longitude. A delta of -8 escapes to a full signed 8 bit delta in the next
+* two nibbles; the generator rejects data that does not fit. Per row byte
+* offsets allow any row to be decoded without touching the rows before it.
+*
+* Tables in this format are produced from an IGRF calculator grid export with
+* geo_lookup/compress_mag_tables.py. The decoder in geo_mag_declination.cpp
+* decompresses the active grid cell into a small RAM cache on demand, so
+* repeated lookups at a quasi stationary position do not decompress at all.
+*
+* Enabled with the GEO_MAG_COMPRESSED_TABLES build option.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+struct mag_compressed_table_s {
+	float sampling_res;		///< grid spacing in degrees
+	float min_lat;			///< latitude of the first row in degrees
+	float max_lat;			///< latitude of the last row in degrees
+	float min_lon;			///< longitude of the first column in degrees
+	float max_lon;			///< longitude of the last column in degrees
+	uint16_t num_lat;		///< number of rows
+	uint16_t num_lon;		///< number of columns
+	float scale;			///< value units per stored count
+	const int16_t *row_base;	///< first value of each row, in counts
+	const uint16_t *row_offset;	///< byte offset of each row in the delta stream
+	const uint8_t *deltas;		///< nibble packed delta stream
+};
+
+#ifdef GEO_MAG_COMPRESSED_TABLES
+extern const mag_compressed_table_s mag_declination_compressed;
+extern const mag_compressed_table_s mag_inclination_compressed;
+extern const mag_compressed_table_s mag_strength_compressed;
+#endif
@@ -44,12 +44,18 @@
 
 #include "geo_mag_declination.h"
 
+#ifdef GEO_MAG_COMPRESSED_TABLES
+#include "geo_mag_compressed.h"
+#endif
+
 #include <mathlib/mathlib.h>
 
 #include <stdint.h>
 
 using math::constrain;
 
+#ifndef GEO_MAG_COMPRESSED_TABLES
+
 /** set this always to the sampling in degrees for the table below */
 static constexpr float SAMPLING_RES = 10.0f;
 static constexpr float SAMPLING_MIN_LAT	= -60.0f;
@@ -161,17 +167,238 @@ get_table_data(float lat, float lon, const int8_t table[13][37])
 	return lat_scale * (data_max - data_min) + data_min;
 }
 
+#else
+
+/* the four corners of the active grid cell of one compressed table (sw, se,
+ * nw, ne) - decoding walks the delta stream of the two rows, so the result is
+ * cached until the position crosses a grid line
+ */
+struct mag_compressed_cell_s {
+	unsigned min_lat_index;
+	unsigned min_lon_index;
+	float corner[4];	///< sw, se, nw, ne corner values
+	bool valid;
+};
+
+/* one cell cache per table: declination, inclination, strength */
+static struct mag_compressed_cell_s compressed_cells[3] = {};
+
+static unsigned
+get_compressed_table_index(float *val, float min, float max, float res)
+{
+	/* same bounds enforcement as get_lookup_table_index(), with the
+	 * sampling resolution taken from the table header
+	 */
+	*val = constrain(*val, min, max - res);
+
+	return static_cast<unsigned>((-(min) + *val) / res);
+}
+
+static int
+decode_next_delta(const uint8_t *stream, unsigned *nibble_index)
+{
+	const uint8_t byte = stream[*nibble_index / 2];
+	const int nibble = (*nibble_index % 2) ? (byte & 0xf) : (byte >> 4);
+	(*nibble_index)++;
+
+	int delta = (nibble < 8) ? nibble : (nibble - 16);
+
+	if (delta == -8) {
+		/* escape: full signed 8 bit delta in the next two nibbles, high first */
+		const uint8_t hi_byte = stream[*nibble_index / 2];
+		const int hi = (*nibble_index % 2) ? (hi_byte & 0xf) : (hi_byte >> 4);
+		(*nibble_index)++;
+
+		const uint8_t lo_byte = stream[*nibble_index / 2];
+		const int lo = (*nibble_index % 2) ? (lo_byte & 0xf) : (lo_byte >> 4);
+		(*nibble_index)++;
+
+		delta = static_cast<int8_t>((hi << 4) | lo);
+	}
+
+	return delta;
+}
+
+static void
+decode_row_pair(const mag_compressed_table_s &table, unsigned row, unsigned col,
+		float *val_low, float *val_high)
+{
+	const uint8_t *stream = table.deltas + table.row_offset[row];
+	unsigned nibble_index = 0;
+	int value = table.row_base[row];
+
+	for (unsigned c = 0; c < col; c++) {
+		value += decode_next_delta(stream, &nibble_index);
+	}
+
+	*val_low = value * table.scale;
+	*val_high = (value + decode_next_delta(stream, &nibble_index)) * table.scale;
+}
+
+static float
+get_compressed_table_data(float lat, float lon, const mag_compressed_table_s &table,
+			  struct mag_compressed_cell_s *cell)
+{
+	/*
+	 * If the values exceed valid ranges, return zero as default
+	 * as we have no way of knowing what the closest real value
+	 * would be.
+	 */
+	if (lat < -90.0f || lat > 90.0f ||
+	    lon < -180.0f || lon > 180.0f) {
+		return 0.0f;
+	}
+
+	const float res = table.sampling_res;
+
+	/* round down to nearest sampling resolution */
+	float min_lat = int(lat / res) * res;
+	float min_lon = int(lon / res) * res;
+
+	/* find index of nearest low sampling point */
+	const unsigned min_lat_index = get_compressed_table_index(&min_lat, table.min_lat, table.max_lat, res);
+	const unsigned min_lon_index = get_compressed_table_index(&min_lon, table.min_lon, table.max_lon, res);
+
+	if (!cell->valid
+	    || (cell->min_lat_index != min_lat_index)
+	    || (cell->min_lon_index != min_lon_index)) {
+		/* decompress the active cell into the RAM cache */
+		decode_row_pair(table, min_lat_index, min_lon_index, &cell->corner[0], &cell->corner[1]);
+		decode_row_pair(table, min_lat_index + 1, min_lon_index, &cell->corner[2], &cell->corner[3]);
+
+		cell->min_lat_index = min_lat_index;
+		cell->min_lon_index = min_lon_index;
+		cell->valid = true;
+	}
+
+	/* perform bilinear interpolation on the four grid corners - same
+	 * evaluation order as get_table_data() so a losslessly re-encoded
+	 * table returns identical results
+	 */
+	const float lat_scale = constrain((lat - min_lat) / res, 0.0f, 1.0f);
+	const float lon_scale = constrain((lon - min_lon) / res, 0.0f, 1.0f);
+
+	const float data_min = lon_scale * (cell->corner[1] - cell->corner[0]) + cell->corner[0];
+	const float data_max = lon_scale * (cell->corner[3] - cell->corner[2]) + cell->corner[2];
+
+	return lat_scale * (data_max - data_min) + data_min;
+}
+
+#endif // GEO_MAG_COMPRESSED_TABLES
+
 float get_mag_declination(float lat, float lon)
 {
+#ifdef GEO_MAG_COMPRESSED_TABLES
+	return get_compressed_table_data(lat, lon, mag_declination_compressed, &compressed_cells[0]);
+
+#else
 	return get_table_data(lat, lon, declination_table);
+#endif
+}
+
+#ifndef GEO_MAG_COMPRESSED_TABLES
+
+/* the four corners of the last 10 degree grid cell looked up by get_mag_field() -
+ * the flight code queries the field at the (essentially stationary) vehicle
+ * position, so the cell only changes when crossing a grid line
+ */
+struct mag_field_cell_s {
+	unsigned min_lat_index;
+	unsigned min_lon_index;
+	float declination[4];	///< sw, se, nw, ne corner values
+	float inclination[4];
+	float strength[4];
+	bool valid;
+};
+
+static struct mag_field_cell_s mag_field_cell = {};
+
+void get_mag_field(float lat, float lon, float *declination, float *inclination, float *strength)
+{
+	/* returns zero outside the table range, matching the per component functions */
+	if (lat < -90.0f || lat > 90.0f ||
+	    lon < -180.0f || lon > 180.0f) {
+		*declination = 0.0f;
+		*inclination = 0.0f;
+		*strength = 0.0f;
+		return;
+	}
+
+	/* round down to nearest sampling resolution */
+	float min_lat = int(lat / SAMPLING_RES) * SAMPLING_RES;
+	float min_lon = int(lon / SAMPLING_RES) * SAMPLING_RES;
+
+	/* find index of nearest low sampling point */
+	const unsigned min_lat_index = get_lookup_table_index(&min_lat, SAMPLING_MIN_LAT, SAMPLING_MAX_LAT);
+	const unsigned min_lon_index = get_lookup_table_index(&min_lon, SAMPLING_MIN_LON, SAMPLING_MAX_LON);
+
+	if (!mag_field_cell.valid
+	    || (mag_field_cell.min_lat_index != min_lat_index)
+	    || (mag_field_cell.min_lon_index != min_lon_index)) {
+		/* gather the cell corners of all three tables once */
+		const int8_t (*tables[3])[13][37] = {&declination_table, &inclination_table, &strength_table};
+		float *corners[3] = {mag_field_cell.declination, mag_field_cell.inclination, mag_field_cell.strength};
+
+		for (unsigned i = 0; i < 3; i++) {
+			corners[i][0] = (*tables[i])[min_lat_index][min_lon_index];
+			corners[i][1] = (*tables[i])[min_lat_index][min_lon_index + 1];
+			corners[i][2] = (*tables[i])[min_lat_index + 1][min_lon_index];
+			corners[i][3] = (*tables[i])[min_lat_index + 1][min_lon_index + 1];
+		}
+
+		mag_field_cell.min_lat_index = min_lat_index;
+		mag_field_cell.min_lon_index = min_lon_index;
+		mag_field_cell.valid = true;
+	}
+
+	/* perform bilinear interpolation on the cached grid corners - same evaluation
+	 * order as get_table_data() so the results are identical
+	 */
+	const float lat_scale = constrain((lat - min_lat) / SAMPLING_RES, 0.0f, 1.0f);
+	const float lon_scale = constrain((lon - min_lon) / SAMPLING_RES, 0.0f, 1.0f);
+
+	float *out[3] = {declination, inclination, strength};
+
+	for (unsigned i = 0; i < 3; i++) {
+		const float *data = (i == 0) ? mag_field_cell.declination : ((i == 1) ? mag_field_cell.inclination : mag_field_cell.strength);
+
+		const float data_min = lon_scale * (data[1] - data[0]) + data[0];
+		const float data_max = lon_scale * (data[3] - data[2]) + data[2];
+
+		*out[i] = lat_scale * (data_max - data_min) + data_min;
+	}
 }
 
+#else
+
+void get_mag_field(float lat, float lon, float *declination, float *inclination, float *strength)
+{
+	/* the per table cell caches make the three lookups cheap once the cell
+	 * has been decompressed
+	 */
+	*declination = get_compressed_table_data(lat, lon, mag_declination_compressed, &compressed_cells[0]);
+	*inclination = get_compressed_table_data(lat, lon, mag_inclination_compressed, &compressed_cells[1]);
+	*strength = get_compressed_table_data(lat, lon, mag_strength_compressed, &compressed_cells[2]);
+}
+
+#endif // GEO_MAG_COMPRESSED_TABLES
+
 float get_mag_inclination(float lat, float lon)
 {
+#ifdef GEO_MAG_COMPRESSED_TABLES
+	return get_compressed_table_data(lat, lon, mag_inclination_compressed, &compressed_cells[1]);
+
+#else
 	return get_table_data(lat, lon, inclination_table);
+#endif
 }
 
 float get_mag_strength(float lat, float lon)
 {
+#ifdef GEO_MAG_COMPRESSED_TABLES
+	return get_compressed_table_data(lat, lon, mag_strength_compressed, &compressed_cells[2]);
+
+#else
 	return get_table_data(lat, lon, strength_table);
+#endif
 }
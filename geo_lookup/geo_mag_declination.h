@@ -49,3 +49,10 @@ float get_mag_inclination(float lat, float lon);
 
 // return magnetic field strength in mTesla
 float get_mag_strength(float lat, float lon);
+
+// Return declination (degrees), inclination (degrees) and strength (mTesla) from
+// a single index computation. The four corners of the 10 degree grid cell are
+// cached between calls, so repeated lookups from an essentially stationary
+// position only pay for the three bilinear blends. Returns the same values as
+// the three functions above.
+void get_mag_field(float lat, float lon, float *declination, float *inclination, float *strength);
@@ -0,0 +1,106 @@
+/* generated by compress_mag_tables.py - do not edit by hand */
+
+#include "geo_mag_compressed.h"
+
+#ifdef GEO_MAG_COMPRESSED_TABLES
+
+static constexpr int16_t mag_declination_compressed_base[13] = {
+	47,31,22,17,13,11,10,9,8,7,5,3,3,
+};
+
+static constexpr uint16_t mag_declination_compressed_offset[13] = {
+	0,23,48,73,94,114,133,151,169,187,205,223,243,
+};
+
+static constexpr uint8_t mag_declination_compressed_deltas[266] = {
+	255,239,254,236,202,154,171,188,187,153,143,137,154,187,239,40,12,130,120,48,129,5,31,0,
+	240,0,254,218,152,248,155,206,221,170,153,188,241,72,8,128,232,16,129,8,12,128,133,49,
+	16,15,0,31,218,143,136,247,143,139,222,15,235,171,207,37,128,136,10,128,168,8,118,84,
+	33,0,31,0,15,219,143,120,247,143,140,223,19,47,204,209,53,119,99,67,67,33,1,0,
+	240,255,234,143,136,247,172,241,52,83,237,223,36,69,49,35,35,17,0,0,240,15,218,143,
+	137,174,19,69,83,14,222,17,51,32,18,50,17,240,0,0,255,202,154,192,36,84,51,30,
+	238,1,18,0,18,34,33,0,0,0,254,187,155,225,52,83,34,31,239,240,17,240,2,35,
+	33,16,16,0,237,186,173,241,68,51,34,31,255,240,15,255,242,35,50,33,17,0,220,170,
+	174,2,52,51,33,16,15,255,255,238,240,51,67,51,33,31,218,153,174,19,52,51,49,17,
+	0,255,237,205,240,51,68,83,66,15,201,143,120,248,175,18,68,68,50,34,16,254,219,188,
+	224,52,68,84,67,30,184,247,143,72,246,175,35,69,85,68,67,33,13,168,248,143,139,225,
+	52,85,
+};
+
+const mag_compressed_table_s mag_declination_compressed = {
+	10.0f,	// sampling_res
+	-60.0f, 60.0f,	// min_lat, max_lat
+	-180.0f, 180.0f,	// min_lon, max_lon
+	13, 37,	// num_lat, num_lon
+	1.0f,	// scale
+	mag_declination_compressed_base,
+	mag_declination_compressed_offset,
+	mag_declination_compressed_deltas,
+};
+
+static constexpr int16_t mag_inclination_compressed_base[13] = {
+	-78,-72,-64,-55,-42,-25,-5,15,31,43,53,62,71,
+};
+
+static constexpr uint16_t mag_inclination_compressed_offset[13] = {
+	0,18,36,54,72,93,114,135,156,174,192,210,228,
+};
+
+static constexpr uint8_t mag_inclination_compressed_deltas[246] = {
+	34,34,35,35,50,16,255,255,240,0,255,237,220,221,205,241,34,34,34,34,34,51,50,31,
+	236,222,240,1,15,237,221,206,239,17,33,34,34,18,34,51,51,14,202,188,223,18,17,238,
+	221,239,1,17,18,34,34,35,34,35,67,12,153,155,190,242,50,15,239,240,17,17,18,34,
+	35,34,50,51,67,250,143,120,247,143,137,205,242,51,32,255,1,18,1,18,35,50,50,50,
+	52,66,249,143,88,245,143,105,206,2,67,48,15,1,17,16,19,51,51,34,50,51,65,233,
+	143,104,244,143,105,208,18,68,32,15,1,16,0,19,52,51,18,35,35,33,218,143,136,246,
+	143,139,224,18,67,33,240,241,0,255,18,52,50,33,34,50,16,220,169,188,241,18,35,32,
+	15,0,15,254,1,35,34,34,34,33,16,221,204,222,0,18,18,16,0,0,15,238,255,33,
+	18,18,35,33,31,237,237,224,241,17,17,1,0,0,15,238,239,1,17,18,34,34,15,253,
+	239,255,0,16,17,1,16,16,255,238,239,0,1,18,33,33,15,254,254,240,0,0,16,17,
+	17,0,15,238,255,0,
+};
+
+const mag_compressed_table_s mag_inclination_compressed = {
+	10.0f,	// sampling_res
+	-60.0f, 60.0f,	// min_lat, max_lat
+	-180.0f, 180.0f,	// min_lon, max_lon
+	13, 37,	// num_lat, num_lon
+	1.0f,	// scale
+	mag_inclination_compressed_base,
+	mag_inclination_compressed_offset,
+	mag_inclination_compressed_deltas,
+};
+
+static constexpr int16_t mag_strength_compressed_base[13] = {
+	62,59,54,49,43,38,34,33,34,37,42,48,54,
+};
+
+static constexpr uint16_t mag_strength_compressed_offset[13] = {
+	0,18,36,54,72,90,108,126,144,162,180,198,216,
+};
+
+static constexpr uint8_t mag_strength_compressed_deltas[234] = {
+	238,238,237,221,237,238,239,15,0,18,35,68,84,67,34,16,255,254,222,238,221,221,221,223,
+	255,0,240,18,36,85,85,67,49,31,255,238,237,238,222,221,205,239,0,0,0,1,52,85,
+	100,67,33,0,239,222,237,238,222,237,237,239,16,17,1,0,35,85,85,50,16,15,254,238,
+	238,238,239,238,239,224,1,17,33,0,18,68,68,49,15,15,254,238,239,239,255,255,255,255,
+	1,18,33,16,1,35,66,33,255,15,254,254,255,15,0,240,15,255,0,17,33,16,1,18,
+	34,17,255,255,254,255,15,1,1,1,15,255,255,1,17,17,1,17,33,16,255,254,254,240,
+	0,17,18,17,15,254,224,241,1,17,17,17,17,16,14,238,238,240,1,18,18,33,15,254,
+	239,240,17,1,18,17,17,16,14,237,238,255,1,18,34,33,15,254,238,15,1,16,17,33,
+	33,17,255,237,222,255,1,18,18,17,15,254,239,255,0,16,17,34,18,17,14,238,238,255,
+	0,17,17,1,240,255,239,255,0,1,17,18,18,17,240,239,239,240,
+};
+
+const mag_compressed_table_s mag_strength_compressed = {
+	10.0f,	// sampling_res
+	-60.0f, 60.0f,	// min_lat, max_lat
+	-180.0f, 180.0f,	// min_lon, max_lon
+	13, 37,	// num_lat, num_lon
+	1.0f,	// scale
+	mag_strength_compressed_base,
+	mag_strength_compressed_offset,
+	mag_strength_compressed_deltas,
+};
+
+#endif // GEO_MAG_COMPRESSED_TABLES
@@ -42,14 +42,20 @@
 
 #include "ecl_l1_pos_controller.h"
 
+#include <mathlib/fastmath.h>
+
 using matrix::Vector2f;
 using matrix::wrap_pi;
 
+namespace fm = ecl::fastmath;
+
 
 void ECL_L1_Pos_Controller::update_roll_setpoint()
 {
-	float roll_new = atanf(_lateral_accel * 1.0f / CONSTANTS_ONE_G);
-	roll_new = math::constrain(roll_new, -_roll_lim_rad, _roll_lim_rad);
+	/* apply the roll limit as the equivalent lateral acceleration limit cached by
+	 * set_l1_roll_limit(); atan is monotonic so the resulting angle respects _roll_lim_rad */
+	float lateral_accel = math::constrain(_lateral_accel, -_lateral_accel_lim, _lateral_accel_lim);
+	float roll_new = fm::atan(lateral_accel * 1.0f / CONSTANTS_ONE_G);
 
 	// no slew rate limiting active
 	if (_dt <= 0.0f || _roll_slew_rate <= 0.0f) {
@@ -70,6 +76,29 @@ float ECL_L1_Pos_Controller::switch_distance(float wp_radius)
 	return math::min(wp_radius, _L1_distance);
 }
 
+void ECL_L1_Pos_Controller::set_waypoints(const Vector2f &vector_A, const Vector2f &vector_B)
+{
+	_wp_segment.wp_A = vector_A;
+	_wp_segment.wp_B = vector_B;
+
+	/* latitude scale factors used by the planar approximation, fixed per segment */
+	_wp_segment.cos_lat_A = fm::cos(math::radians(vector_A(0)));
+	_wp_segment.cos_lat_B = fm::cos(math::radians(vector_B(0)));
+
+	/* calculate vector from A to B */
+	Vector2f vector_AB = get_local_planar_vector(vector_A, _wp_segment.cos_lat_A, vector_B);
+
+	/* check if waypoints are on top of each other */
+	_wp_segment.ab_valid = !(vector_AB.length() < 1.0e-6f);
+
+	if (_wp_segment.ab_valid) {
+		vector_AB.normalize();
+	}
+
+	_wp_segment.vector_AB_unit = vector_AB;
+	_wp_segment.valid = true;
+}
+
 void
 ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector2f &vector_B,
 		const Vector2f &vector_curr_position, const Vector2f &ground_speed_vector)
@@ -79,6 +108,14 @@ ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector
 	float xtrack_vel = 0.0f;
 	float ltrack_vel = 0.0f;
 
+	/* refresh the cached segment geometry if the waypoints differ from the cached ones,
+	 * callers using set_waypoints() at mission item transitions skip this entirely */
+	if (!_wp_segment.valid
+	    || (vector_A(0) != _wp_segment.wp_A(0)) || (vector_A(1) != _wp_segment.wp_A(1))
+	    || (vector_B(0) != _wp_segment.wp_B(0)) || (vector_B(1) != _wp_segment.wp_B(1))) {
+		set_waypoints(vector_A, vector_B);
+	}
+
 	/* get the direction between the last (visited) and next waypoint */
 	_target_bearing = get_bearing_to_next_waypoint((double)vector_curr_position(0), (double)vector_curr_position(1), (double)vector_B(0), (double)vector_B(1));
 
@@ -88,21 +125,20 @@ ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector
 	/* calculate the L1 length required for the desired period */
 	_L1_distance = _L1_ratio * ground_speed;
 
-	/* calculate vector from A to B */
-	Vector2f vector_AB = get_local_planar_vector(vector_A, vector_B);
+	/* unit vector from A to B, precomputed per segment */
+	Vector2f vector_AB = _wp_segment.vector_AB_unit;
 
 	/*
 	 * check if waypoints are on top of each other. If yes,
 	 * skip A and directly continue to B
 	 */
-	if (vector_AB.length() < 1.0e-6f) {
+	if (!_wp_segment.ab_valid) {
 		vector_AB = get_local_planar_vector(vector_curr_position, vector_B);
+		vector_AB.normalize();
 	}
 
-	vector_AB.normalize();
-
 	/* calculate the vector from waypoint A to the aircraft */
-	Vector2f vector_A_to_airplane = get_local_planar_vector(vector_A, vector_curr_position);
+	Vector2f vector_A_to_airplane = get_local_planar_vector(vector_A, _wp_segment.cos_lat_A, vector_curr_position);
 
 	/* calculate crosstrack error (output only) */
 	_crosstrack_error = vector_AB % vector_A_to_airplane;
@@ -116,12 +152,12 @@ ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector
 	float alongTrackDist = vector_A_to_airplane * vector_AB;
 
 	/* estimate airplane position WRT to B */
-	Vector2f vector_B_to_P_unit = get_local_planar_vector(vector_B, vector_curr_position).normalized();
+	Vector2f vector_B_to_P_unit = get_local_planar_vector(vector_B, _wp_segment.cos_lat_B, vector_curr_position).normalized();
 
 	/* calculate angle of airplane position vector relative to line) */
 
 	// XXX this could probably also be based solely on the dot product
-	float AB_to_BP_bearing = atan2f(vector_B_to_P_unit % vector_AB, vector_B_to_P_unit * vector_AB);
+	float AB_to_BP_bearing = fm::atan2(vector_B_to_P_unit % vector_AB, vector_B_to_P_unit * vector_AB);
 
 	/* extension from [2], fly directly to A */
 	if (distance_A_to_airplane > _L1_distance && alongTrackDist / math::max(distance_A_to_airplane, 1.0f) < -0.7071f) {
@@ -134,9 +170,9 @@ ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector
 		xtrack_vel = ground_speed_vector % (-vector_A_to_airplane_unit);
 		/* velocity along line */
 		ltrack_vel = ground_speed_vector * (-vector_A_to_airplane_unit);
-		eta = atan2f(xtrack_vel, ltrack_vel);
+		eta = fm::atan2(xtrack_vel, ltrack_vel);
 		/* bearing from current position to L1 point */
-		_nav_bearing = atan2f(-vector_A_to_airplane_unit(1), -vector_A_to_airplane_unit(0));
+		_nav_bearing = fm::atan2(-vector_A_to_airplane_unit(1), -vector_A_to_airplane_unit(0));
 
 		/*
 		 * If the AB vector and the vector from B to airplane point in the same
@@ -159,9 +195,9 @@ ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector
 		xtrack_vel = ground_speed_vector % (-vector_B_to_P_unit);
 		/* velocity along line */
 		ltrack_vel = ground_speed_vector * (-vector_B_to_P_unit);
-		eta = atan2f(xtrack_vel, ltrack_vel);
+		eta = fm::atan2(xtrack_vel, ltrack_vel);
 		/* bearing from current position to L1 point */
-		_nav_bearing = atan2f(-vector_B_to_P_unit(1), -vector_B_to_P_unit(0));
+		_nav_bearing = fm::atan2(-vector_B_to_P_unit(1), -vector_B_to_P_unit(0));
 
 	} else {
 
@@ -172,22 +208,25 @@ ECL_L1_Pos_Controller::navigate_waypoints(const Vector2f &vector_A, const Vector
 		/* velocity along line */
 		ltrack_vel = ground_speed_vector * vector_AB;
 		/* calculate eta2 (angle of velocity vector relative to line) */
-		float eta2 = atan2f(xtrack_vel, ltrack_vel);
+		float eta2 = fm::atan2(xtrack_vel, ltrack_vel);
 		/* calculate eta1 (angle to L1 point) */
 		float xtrackErr = vector_A_to_airplane % vector_AB;
 		float sine_eta1 = xtrackErr / math::max(_L1_distance, 0.1f);
 		/* limit output to 45 degrees */
 		sine_eta1 = math::constrain(sine_eta1, -0.7071f, 0.7071f); //sin(pi/4) = 0.7071
-		float eta1 = asinf(sine_eta1);
+		float eta1 = fm::asin(sine_eta1);
 		eta = eta1 + eta2;
 		/* bearing from current position to L1 point */
-		_nav_bearing = atan2f(vector_AB(1), vector_AB(0)) + eta1;
+		_nav_bearing = fm::atan2(vector_AB(1), vector_AB(0)) + eta1;
 
 	}
 
 	/* limit angle to +-90 degrees */
 	eta = math::constrain(eta, (-M_PI_F) / 2.0f, +M_PI_F / 2.0f);
-	_lateral_accel = _K_L1 * ground_speed * ground_speed / _L1_distance * sinf(eta);
+
+	/* K_L1 * ground_speed^2 / L1_distance with the L1 length substituted,
+	 * using the gain cached by update_gain_schedule() */
+	_lateral_accel = _K_eta * ground_speed * fm::sin(eta);
 
 	/* flying to waypoints, not circling them */
 	_circle_mode = false;
@@ -204,10 +243,7 @@ ECL_L1_Pos_Controller::navigate_loiter(const Vector2f &vector_A, const Vector2f
 {
 	/* the complete guidance logic in this section was proposed by [2] */
 
-	/* calculate the gains for the PD loop (circle tracking) */
-	float omega = (2.0f * M_PI_F / _L1_period);
-	float K_crosstrack = omega * omega;
-	float K_velocity = 2.0f * _L1_damping * omega;
+	/* the gains for the PD loop (circle tracking) are cached by update_gain_schedule() */
 
 	/* update bearing to next waypoint */
 	_target_bearing = get_bearing_to_next_waypoint((double)vector_curr_position(0), (double)vector_curr_position(1), (double)vector_A(0), (double)vector_A(1));
@@ -238,12 +274,12 @@ ECL_L1_Pos_Controller::navigate_loiter(const Vector2f &vector_A, const Vector2f
 	float xtrack_vel_center = vector_A_to_airplane_unit % ground_speed_vector;
 	/* velocity along line from waypoint to current position */
 	float ltrack_vel_center = - (ground_speed_vector * vector_A_to_airplane_unit);
-	float eta = atan2f(xtrack_vel_center, ltrack_vel_center);
+	float eta = fm::atan2(xtrack_vel_center, ltrack_vel_center);
 	/* limit eta to 90 degrees */
 	eta = math::constrain(eta, -M_PI_F / 2.0f, +M_PI_F / 2.0f);
 
 	/* calculate the lateral acceleration to capture the center point */
-	float lateral_accel_sp_center = _K_L1 * ground_speed * ground_speed / _L1_distance * sinf(eta);
+	float lateral_accel_sp_center = _K_eta * ground_speed * fm::sin(eta);
 
 	/* for PD control: Calculate radial position and velocity errors */
 
@@ -256,7 +292,7 @@ ECL_L1_Pos_Controller::navigate_loiter(const Vector2f &vector_A, const Vector2f
 	_crosstrack_error = xtrack_err_circle;
 
 	/* calculate PD update to circle waypoint */
-	float lateral_accel_sp_circle_pd = (xtrack_err_circle * K_crosstrack + xtrack_vel_circle * K_velocity);
+	float lateral_accel_sp_circle_pd = (xtrack_err_circle * _K_crosstrack + xtrack_vel_circle * _K_velocity);
 
 	/* calculate velocity on circle / along tangent */
 	float tangent_vel = xtrack_vel_center * loiter_direction;
@@ -286,14 +322,14 @@ ECL_L1_Pos_Controller::navigate_loiter(const Vector2f &vector_A, const Vector2f
 		/* angle between requested and current velocity vector */
 		_bearing_error = eta;
 		/* bearing from current position to L1 point */
-		_nav_bearing = atan2f(-vector_A_to_airplane_unit(1), -vector_A_to_airplane_unit(0));
+		_nav_bearing = fm::atan2(-vector_A_to_airplane_unit(1), -vector_A_to_airplane_unit(0));
 
 	} else {
 		_lateral_accel = lateral_accel_sp_circle;
 		_circle_mode = true;
 		_bearing_error = 0.0f;
 		/* bearing from current position to L1 point */
-		_nav_bearing = atan2f(-vector_A_to_airplane_unit(1), -vector_A_to_airplane_unit(0));
+		_nav_bearing = fm::atan2(-vector_A_to_airplane_unit(1), -vector_A_to_airplane_unit(0));
 	}
 
 	update_roll_setpoint();
@@ -331,7 +367,7 @@ void ECL_L1_Pos_Controller::navigate_heading(float navigation_heading, float cur
 
 	/* limit eta to 90 degrees */
 	eta = math::constrain(eta, (-M_PI_F) / 2.0f, +M_PI_F / 2.0f);
-	_lateral_accel = 2.0f * sinf(eta) * omega_vel;
+	_lateral_accel = 2.0f * fm::sin(eta) * omega_vel;
 
 	update_roll_setpoint();
 }
@@ -354,10 +390,16 @@ void ECL_L1_Pos_Controller::navigate_level_flight(float current_heading)
 }
 
 Vector2f ECL_L1_Pos_Controller::get_local_planar_vector(const Vector2f &origin, const Vector2f &target) const
+{
+	return get_local_planar_vector(origin, fm::cos(math::radians(origin(0))), target);
+}
+
+Vector2f ECL_L1_Pos_Controller::get_local_planar_vector(const Vector2f &origin, float cos_lat_origin,
+		const Vector2f &target) const
 {
 	/* this is an approximation for small angles, proposed by [2] */
 	Vector2f out(math::radians((target(0) - origin(0))),
-		     math::radians((target(1) - origin(1))*cosf(math::radians(origin(0)))));
+		     math::radians((target(1) - origin(1))*cos_lat_origin));
 
 	return out * static_cast<float>(CONSTANTS_RADIUS_OF_EARTH);
 }
@@ -366,20 +408,33 @@ void ECL_L1_Pos_Controller::set_l1_period(float period)
 {
 	_L1_period = period;
 
-	/* calculate the ratio introduced in [2] */
-	_L1_ratio = 1.0f / M_PI_F * _L1_damping * _L1_period;
-
-	/* calculate normalized frequency for heading tracking */
-	_heading_omega = sqrtf(2.0f) * M_PI_F / _L1_period;
+	update_gain_schedule();
 }
 
 void ECL_L1_Pos_Controller::set_l1_damping(float damping)
 {
 	_L1_damping = damping;
 
+	update_gain_schedule();
+}
+
+void ECL_L1_Pos_Controller::update_gain_schedule()
+{
 	/* calculate the ratio introduced in [2] */
 	_L1_ratio = 1.0f / M_PI_F * _L1_damping * _L1_period;
 
+	/* calculate normalized frequency for heading tracking */
+	_heading_omega = sqrtf(2.0f) * M_PI_F / _L1_period;
+
 	/* calculate the L1 gain (following [2]) */
 	_K_L1 = 4.0f * _L1_damping * _L1_damping;
+
+	/* gains for the loiter PD loop (circle tracking) */
+	float omega = (2.0f * M_PI_F / _L1_period);
+	_K_crosstrack = omega * omega;
+	_K_velocity = 2.0f * _L1_damping * omega;
+
+	/* lateral acceleration gain per unit ground speed:
+	 * K_L1 * v^2 / L1_distance with L1_distance = L1_ratio * v reduces to (K_L1 / L1_ratio) * v */
+	_K_eta = _K_L1 / math::max(_L1_ratio, 1.0e-4f);
 }
@@ -135,6 +135,18 @@ public:
 	 */
 	float switch_distance(float waypoint_switch_radius);
 
+	/**
+	 * Set the current waypoint segment
+	 *
+	 * Precomputes the segment geometry (latitude scale factors of both
+	 * waypoints and the unit vector along the segment) which stays fixed
+	 * until the next mission item transition, so navigate_waypoints()
+	 * reduces to cheap float vector math per cycle. Call once per segment;
+	 * navigate_waypoints() refreshes the cache itself when it is handed
+	 * waypoints that differ from the cached ones.
+	 */
+	void set_waypoints(const matrix::Vector2f &vector_A, const matrix::Vector2f &vector_B);
+
 	/**
 	 * Navigate between two waypoints
 	 *
@@ -193,7 +205,14 @@ public:
 	/**
 	 * Set the maximum roll angle output in radians
 	 */
-	void set_l1_roll_limit(float roll_lim_rad) { _roll_lim_rad = roll_lim_rad; }
+	void set_l1_roll_limit(float roll_lim_rad)
+	{
+		_roll_lim_rad = roll_lim_rad;
+
+		/* cache the equivalent lateral acceleration limit of a coordinated turn,
+		 * which is independent of ground speed */
+		_lateral_accel_lim = CONSTANTS_ONE_G * tanf(roll_lim_rad);
+	}
 
 	/**
 	 * Set roll angle slew rate. Set to zero to deactivate.
@@ -221,11 +240,32 @@ private:
 	float _K_L1{2.0f};			///< L1 control gain for _L1_damping
 	float _heading_omega{1.0f};		///< Normalized frequency
 
+	/* gains derived from period and damping, cached by update_gain_schedule()
+	 * so the 50Hz navigation path carries no setter-dependent divisions */
+	float _K_crosstrack{0.0632f};	///< loiter PD crosstrack gain, omega^2
+	float _K_velocity{0.377f};		///< loiter PD velocity gain, 2 * damping * omega
+	float _K_eta{0.4f};			///< L1 acceleration gain per unit ground speed, _K_L1 / _L1_ratio
+
 	float _roll_lim_rad{math::radians(30.0f)};  ///<maximum roll angle in radians
+	float _lateral_accel_lim{5.66f};	///< roll limit as a lateral acceleration, g * tan(_roll_lim_rad)
 	float _roll_setpoint{0.0f};	///< current roll angle setpoint in radians
 	float _roll_slew_rate{0.0f};	///< roll angle setpoint slew rate limit in rad/s
 	float _dt{0};				///< control loop time in seconds
 
+	/**
+	 * Geometry of the current waypoint segment, precomputed once per
+	 * segment by set_waypoints() instead of once per control cycle
+	 */
+	struct {
+		matrix::Vector2f wp_A;			///< start waypoint in WGS84 coordinates
+		matrix::Vector2f wp_B;			///< end waypoint in WGS84 coordinates
+		matrix::Vector2f vector_AB_unit;	///< unit vector along the segment in planar coordinates
+		float cos_lat_A{1.0f};			///< latitude scale factor of waypoint A
+		float cos_lat_B{1.0f};			///< latitude scale factor of waypoint B
+		bool ab_valid{false};			///< the waypoints are far enough apart to define a direction
+		bool valid{false};			///< the cache holds a segment
+	} _wp_segment;
+
 	/**
 	 * Convert a 2D vector from WGS84 to planar coordinates.
 	 *
@@ -239,12 +279,28 @@ private:
 	 */
 	matrix::Vector2f get_local_planar_vector(const matrix::Vector2f &origin, const matrix::Vector2f &target) const;
 
+	/**
+	 * Variant of get_local_planar_vector() taking the precomputed latitude
+	 * scale factor of the origin, avoiding the per-call trigonometry when
+	 * the origin is one of the cached waypoints
+	 */
+	matrix::Vector2f get_local_planar_vector(const matrix::Vector2f &origin, float cos_lat_origin,
+			const matrix::Vector2f &target) const;
+
 	/**
 	 * Update roll angle setpoint. This will also apply slew rate limits if set.
 	 *
 	 */
 	void update_roll_setpoint();
 
+	/**
+	 * Recompute the gains derived from the L1 period and damping.
+	 *
+	 * Called by set_l1_period() and set_l1_damping() so the navigation
+	 * functions use cached values instead of re-deriving them each cycle.
+	 */
+	void update_gain_schedule();
+
 };
 
 
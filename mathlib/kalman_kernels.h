@@ -0,0 +1,232 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 ECL Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file kalman_kernels.h
+ *
+ * Fused small-matrix kernels for the scalar-measurement Kalman filter
+ * patterns used by the airdata estimators and the 24-state EKF fusion
+ * paths. The generic matrix expressions
+ * (K = P * H' / S, P -= K * H * P, P = L * diag(d) * L') materialise
+ * intermediate matrix temporaries on the stack and copy the results back;
+ * for the small fixed sizes used here each pattern reduces to a single
+ * pass over the covariance with no intermediates. All kernels are
+ * header-only templates so they inline into the callers.
+ *
+ * The covariance update kernels assume P is symmetric, which the callers
+ * maintain by construction or by explicit symmetrisation after each fusion.
+ */
+
+#ifndef ECL_KALMAN_KERNELS_H
+#define ECL_KALMAN_KERNELS_H
+
+#include <inttypes.h>
+
+namespace ecl
+{
+namespace kalman
+{
+
+// Fused gain and innovation variance for a scalar measurement update.
+// Computes P * H', S = H * P * H' + R and K = P * H' / S in one pass.
+// P * H' is also returned so the matching covariance update can reuse it.
+// Returns S, which is always >= R for a valid covariance.
+template<typename MatrixT, typename T, unsigned N>
+inline T scalarMeasurementGain(const MatrixT &P, const T (&H)[N], const T R, T (&K)[N], T (&PH)[N])
+{
+	T S = R;
+
+	for (unsigned i = 0; i < N; i++) {
+		PH[i] = T(0);
+
+		for (unsigned j = 0; j < N; j++) {
+			PH[i] += P(i, j) * H[j];
+		}
+
+		S += H[i] * PH[i];
+	}
+
+	const T S_inv = T(1) / S;
+
+	for (unsigned i = 0; i < N; i++) {
+		K[i] = PH[i] * S_inv;
+	}
+
+	return S;
+}
+
+// In-place covariance update P -= K * H * P for a scalar measurement,
+// reusing the P * H' product from the gain kernel: for symmetric P the
+// row vector H * P is the transpose of P * H', so no further products
+// with P are required.
+template<typename MatrixT, typename T, unsigned N>
+inline void scalarMeasurementCovarianceUpdate(MatrixT &P, const T (&K)[N], const T (&PH)[N])
+{
+	for (unsigned i = 0; i < N; i++) {
+		for (unsigned j = 0; j < N; j++) {
+			P(i, j) -= K[i] * PH[j];
+		}
+	}
+}
+
+// P = L * diag(d) * L' computed directly into P without forming the
+// intermediate products. The result is symmetric so only the upper
+// triangle is computed and then mirrored.
+template<typename MatrixT, typename T, unsigned N>
+inline void diagonalSandwich(const MatrixT &L, const T (&d)[N], MatrixT &P)
+{
+	for (unsigned i = 0; i < N; i++) {
+		for (unsigned j = i; j < N; j++) {
+			T sum = T(0);
+
+			for (unsigned k = 0; k < N; k++) {
+				sum += L(i, k) * d[k] * L(j, k);
+			}
+
+			P(i, j) = sum;
+			P(j, i) = sum;
+		}
+	}
+}
+
+// --- kernels for the raw square-array covariance of the 24 state EKF ---
+//
+// The arrays carry the compile time maximum dimension N while the active state
+// count n may be smaller when state groups are compiled out, so the loops run
+// to n. A 24x24 float covariance is 2.3 kB and resident in L1 cache, so these
+// kernels optimise for operation count and working set rather than explicit
+// cache tiling: for symmetric P the covariance correction K * H * P of a
+// measurement update is the outer product of the gain and the H * P row, so
+// the NxN correction matrix is never formed and the multiply count of a scalar
+// update drops from O(nnz * n^2) to O(nnz * n + n^2 / 2).
+
+// row vector HP = H * P for an observation jacobian with nnz non zero entries
+// given as index/value pairs; for symmetric P this is also the transpose of
+// the P * H' product used by the gain calculation
+template<typename T, unsigned N>
+inline void sparseRowProduct(const T (&P)[N][N], const T *h_val, const uint8_t *h_idx,
+			     unsigned nnz, T (&HP)[N], unsigned n = N)
+{
+	for (unsigned col = 0; col < n; col++) {
+		HP[col] = T(0);
+	}
+
+	// accumulate one jacobian entry at a time so the accesses stream along the rows of P
+	for (unsigned k = 0; k < nnz; k++) {
+		const T h = h_val[k];
+		const T *P_row = P[h_idx[k]];
+
+		for (unsigned col = 0; col < n; col++) {
+			HP[col] += h * P_row[col];
+		}
+	}
+}
+
+// true when the rank-1 downdate P -= K * HP' leaves every variance non
+// negative; the diagonal of the correction is K[i] * HP[i] so the correction
+// matrix does not have to be formed to run the check
+template<typename T, unsigned N>
+inline bool rankOneDowndateHealthy(const T (&P)[N][N], const T (&K)[N], const T (&HP)[N], unsigned n = N)
+{
+	for (unsigned i = 0; i < n; i++) {
+		if (P[i][i] < K[i] * HP[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// symmetric rank-1 downdate P -= K * HP' for a scalar measurement, computed on
+// the upper triangle and mirrored so the covariance stays exactly symmetric
+template<typename T, unsigned N>
+inline void rankOneDowndate(T (&P)[N][N], const T (&K)[N], const T (&HP)[N], unsigned n = N)
+{
+	for (unsigned row = 0; row < n; row++) {
+		P[row][row] -= K[row] * HP[row];
+
+		for (unsigned col = row + 1; col < n; col++) {
+			const T tmp = P[row][col] - K[row] * HP[col];
+			P[row][col] = tmp;
+			P[col][row] = tmp;
+		}
+	}
+}
+
+// rank-k variants for a block of m <= M scalar observations fused together,
+// with the H * P row of observation i stored as column i of PHt
+
+template<typename T, unsigned N, unsigned M>
+inline bool rankKDowndateHealthy(const T (&P)[N][N], const T (&K)[N][M], const T (&PHt)[N][M],
+				 unsigned m, unsigned n = N)
+{
+	for (unsigned i = 0; i < n; i++) {
+		T diag = T(0);
+
+		for (unsigned k = 0; k < m; k++) {
+			diag += K[i][k] * PHt[i][k];
+		}
+
+		if (P[i][i] < diag) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// symmetric rank-k downdate P -= K * PHt', computed on the upper triangle and
+// mirrored so the covariance stays exactly symmetric
+template<typename T, unsigned N, unsigned M>
+inline void rankKDowndate(T (&P)[N][N], const T (&K)[N][M], const T (&PHt)[N][M],
+			  unsigned m, unsigned n = N)
+{
+	for (unsigned row = 0; row < n; row++) {
+		for (unsigned col = row; col < n; col++) {
+			T tmp = T(0);
+
+			for (unsigned k = 0; k < m; k++) {
+				tmp += K[row][k] * PHt[col][k];
+			}
+
+			P[row][col] -= tmp;
+			P[col][row] = P[row][col];
+		}
+	}
+}
+
+} // namespace kalman
+} // namespace ecl
+
+#endif // ECL_KALMAN_KERNELS_H
@@ -62,6 +62,22 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 	uint64_t now = ecl_absolute_time();
 	float dt = constrain((now - _state_update_timestamp) * 1.0e-6f, DT_MIN, DT_MAX);
 
+	tecs_update_input input;
+	input.altitude = altitude;
+	input.vz = vz;
+	input.az = az;
+	input.altitude_lock = altitude_lock;
+	input.vz_valid = vz_valid;
+	input.in_air = in_air;
+	input.indicated_airspeed = airspeed;
+
+	// Assuming the vehicle is flying X axis forward, use the X axis measured acceleration
+	// compensated for gravity to estimate the rate of change of speed
+	_update_state_estimates(now, dt, input, rotMat(2, 0) * CONSTANTS_ONE_G + accel_body(0));
+}
+
+void TECS::_update_state_estimates(uint64_t now, float dt, const tecs_update_input &input, float speed_deriv_raw)
+{
 	bool reset_altitude = false;
 
 	if (_state_update_timestamp == 0 || dt > DT_MAX) {
@@ -69,15 +85,15 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 		reset_altitude = true;
 	}
 
-	if (!altitude_lock || !in_air) {
+	if (!input.altitude_lock || !input.in_air) {
 		reset_altitude = true;
 	}
 
 	if (reset_altitude) {
-		_vert_pos_state = altitude;
+		_vert_pos_state = input.altitude;
 
-		if (vz_valid) {
-			_vert_vel_state = -vz;
+		if (input.vz_valid) {
+			_vert_vel_state = -input.vz;
 
 		} else {
 			_vert_vel_state = 0.0f;
@@ -88,19 +104,19 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 	}
 
 	_state_update_timestamp = now;
-	_EAS = airspeed;
+	_EAS = input.indicated_airspeed;
 
-	_in_air = in_air;
+	_in_air = input.in_air;
 
 	// Generate the height and climb rate state estimates
-	if (vz_valid) {
+	if (input.vz_valid) {
 		// Set the velocity and position state to the the INS data
-		_vert_vel_state = -vz;
-		_vert_pos_state = altitude;
+		_vert_vel_state = -input.vz;
+		_vert_pos_state = input.altitude;
 
 	} else {
 		// Get height acceleration
-		float hgt_ddot_mea = -az;
+		float hgt_ddot_mea = -input.az;
 
 		// If we have no vertical INS data, estimate the vertical velocity using a complementary filter
 		// Perform filter calculation using backwards Euler integration
@@ -108,7 +124,7 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 		// Reference Paper: Optimising the Gains of the Baro-Inertial Vertical Channel
 		// Widnall W.S, Sinha P.K, AIAA Journal of Guidance and Control, 78-1307R
 		float omega2 = _hgt_estimate_freq * _hgt_estimate_freq;
-		float hgt_err = altitude - _vert_pos_state;
+		float hgt_err = input.altitude - _vert_pos_state;
 		float vert_accel_input = hgt_err * omega2 * _hgt_estimate_freq;
 		_vert_accel_state = _vert_accel_state + vert_accel_input * dt;
 		float vert_vel_input = _vert_accel_state + hgt_ddot_mea + hgt_err * omega2 * 3.0f;
@@ -118,7 +134,7 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 		// If more than 1 second has elapsed since last update then reset the position state
 		// to the measured height
 		if (reset_altitude) {
-			_vert_pos_state = altitude;
+			_vert_pos_state = input.altitude;
 
 		} else {
 			_vert_pos_state = _vert_pos_state + vert_pos_input * dt;
@@ -128,11 +144,7 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 	}
 
 	// Update and average speed rate of change if airspeed is being measured
-	if (ISFINITE(airspeed) && airspeed_sensor_enabled()) {
-		// Assuming the vehicle is flying X axis forward, use the X axis measured acceleration
-		// compensated for gravity to estimate the rate of change of speed
-		float speed_deriv_raw = rotMat(2, 0) * CONSTANTS_ONE_G + accel_body(0);
-
+	if (ISFINITE(input.indicated_airspeed) && airspeed_sensor_enabled()) {
 		// Apply some noise filtering
 		_speed_derivative = 0.95f * _speed_derivative + 0.05f * speed_deriv_raw;
 
@@ -146,12 +158,9 @@ void TECS::update_vehicle_state_estimates(float airspeed, const matrix::Dcmf &ro
 
 }
 
-void TECS::_update_speed_states(float airspeed_setpoint, float indicated_airspeed, float EAS2TAS)
+void TECS::_update_speed_states(uint64_t now, float dt, float airspeed_setpoint, float indicated_airspeed,
+				float EAS2TAS)
 {
-	// Calculate the time in seconds since the last update and use the default time step value if out of bounds
-	uint64_t now = ecl_absolute_time();
-	const float dt = constrain((now - _speed_update_timestamp) * 1.0e-6f, DT_MIN, DT_MAX);
-
 	// Convert equivalent airspeed quantities to true airspeed
 	_EAS_setpoint = airspeed_setpoint;
 	_TAS_setpoint  = _EAS_setpoint * EAS2TAS;
@@ -301,7 +310,7 @@ void TECS::_update_energy_estimates()
 	_SKE_rate = _tas_state * _speed_derivative;// kinetic energy rate of change
 }
 
-void TECS::_update_throttle_setpoint(const float throttle_cruise, const matrix::Dcmf &rotMat)
+void TECS::_update_throttle_setpoint(const float throttle_cruise, const float cos_phi)
 {
 	// Calculate total energy error
 	_STE_error = _SPE_setpoint - _SPE_estimate + _SKE_setpoint - _SKE_estimate;
@@ -322,8 +331,7 @@ void TECS::_update_throttle_setpoint(const float throttle_cruise, const matrix::
 		// Adjust the demanded total energy rate to compensate for induced drag rise in turns.
 		// Assume induced drag scales linearly with normal load factor.
 		// The additional normal load factor is given by (1/cos(bank angle) - 1)
-		float cosPhi = sqrtf((rotMat(0, 1) * rotMat(0, 1)) + (rotMat(1, 1) * rotMat(1, 1)));
-		STE_rate_setpoint = STE_rate_setpoint + _load_factor_correction * (1.0f / constrain(cosPhi, 0.1f, 1.0f) - 1.0f);
+		STE_rate_setpoint = STE_rate_setpoint + _load_factor_correction * (1.0f / constrain(cos_phi, 0.1f, 1.0f) - 1.0f);
 
 		// Calculate a predicted throttle from the demanded rate of change of energy, using the cruise throttle
 		// as the starting point. Assume:
@@ -585,17 +593,43 @@ void TECS::update_pitch_throttle(const matrix::Dcmf &rotMat, float pitch, float
 {
 	// Calculate the time since last update (seconds)
 	uint64_t now = ecl_absolute_time();
-	_dt = constrain((now - _pitch_update_timestamp) * 1e-6f, DT_MIN, DT_MAX);
+	float dt = constrain((now - _pitch_update_timestamp) * 1e-6f, DT_MIN, DT_MAX);
+
+	tecs_update_input input;
+	input.pitch = pitch;
+	input.baro_altitude = baro_altitude;
+	input.hgt_setpoint = hgt_setpoint;
+	input.EAS_setpoint = EAS_setpoint;
+	input.indicated_airspeed = indicated_airspeed;
+	input.eas_to_tas = eas_to_tas;
+	input.climb_out_setpoint = climb_out_setpoint;
+	input.pitch_min_climbout = pitch_min_climbout;
+	input.throttle_min = throttle_min;
+	input.throttle_max = throttle_max;
+	input.throttle_cruise = throttle_cruise;
+	input.pitch_limit_min = pitch_limit_min;
+	input.pitch_limit_max = pitch_limit_max;
+
+	// cosine of the bank angle from the rotation matrix
+	float cos_phi = sqrtf((rotMat(0, 1) * rotMat(0, 1)) + (rotMat(1, 1) * rotMat(1, 1)));
+
+	_update_control(now, dt, input, cos_phi);
+}
+
+void TECS::_update_control(uint64_t now, float dt, const tecs_update_input &input, float cos_phi)
+{
+	_dt = dt;
 
 	// Set class variables from inputs
-	_throttle_setpoint_max = throttle_max;
-	_throttle_setpoint_min = throttle_min;
-	_pitch_setpoint_max = pitch_limit_max;
-	_pitch_setpoint_min = pitch_limit_min;
-	_climbout_mode_active = climb_out_setpoint;
+	_throttle_setpoint_max = input.throttle_max;
+	_throttle_setpoint_min = input.throttle_min;
+	_pitch_setpoint_max = input.pitch_limit_max;
+	_pitch_setpoint_min = input.pitch_limit_min;
+	_climbout_mode_active = input.climb_out_setpoint;
 
 	// Initialize selected states and variables as required
-	_initialize_states(pitch, throttle_cruise, baro_altitude, pitch_min_climbout, eas_to_tas);
+	_initialize_states(input.pitch, input.throttle_cruise, input.baro_altitude, input.pitch_min_climbout,
+			   input.eas_to_tas);
 
 	// Don't run TECS control algorithms when not in flight
 	if (!_in_air) {
@@ -603,7 +637,7 @@ void TECS::update_pitch_throttle(const matrix::Dcmf &rotMat, float pitch, float
 	}
 
 	// Update the true airspeed state estimate
-	_update_speed_states(EAS_setpoint, indicated_airspeed, eas_to_tas);
+	_update_speed_states(now, _dt, input.EAS_setpoint, input.indicated_airspeed, input.eas_to_tas);
 
 	// Calculate rate limits for specific total energy
 	_update_STE_rate_lim();
@@ -618,13 +652,13 @@ void TECS::update_pitch_throttle(const matrix::Dcmf &rotMat, float pitch, float
 	_update_speed_setpoint();
 
 	// Calculate the demanded height
-	_update_height_setpoint(hgt_setpoint, baro_altitude);
+	_update_height_setpoint(input.hgt_setpoint, input.baro_altitude);
 
 	// Calculate the specific energy values required by the control loop
 	_update_energy_estimates();
 
 	// Calculate the throttle demand
-	_update_throttle_setpoint(throttle_cruise, rotMat);
+	_update_throttle_setpoint(input.throttle_cruise, cos_phi);
 
 	// Calculate the pitch demand
 	_update_pitch_setpoint();
@@ -648,3 +682,24 @@ void TECS::update_pitch_throttle(const matrix::Dcmf &rotMat, float pitch, float
 	}
 
 }
+
+void TECS::update(const matrix::Dcmf &rotMat, const matrix::Vector3f &accel_body, const tecs_update_input &input)
+{
+	// one timestamp and one time step shared by every filter stage
+	uint64_t now = ecl_absolute_time();
+	float dt = constrain((now - _state_update_timestamp) * 1.0e-6f, DT_MIN, DT_MAX);
+
+	// read the rotation matrix elements used by TECS once per cycle
+	const float rot_20 = rotMat(2, 0);
+	const float rot_01 = rotMat(0, 1);
+	const float rot_11 = rotMat(1, 1);
+
+	// rate of change of speed along the X axis, compensated for gravity
+	float speed_deriv_raw = rot_20 * CONSTANTS_ONE_G + accel_body(0);
+
+	// cosine of the bank angle
+	float cos_phi = sqrtf((rot_01 * rot_01) + (rot_11 * rot_11));
+
+	_update_state_estimates(now, dt, input, speed_deriv_raw);
+	_update_control(now, dt, input, cos_phi);
+}
@@ -42,6 +42,37 @@
 #include <mathlib/mathlib.h>
 #include <matrix/math.hpp>
 
+/**
+ * Packed per-cycle inputs for the fused TECS::update() call.
+ * Collecting the inputs in one struct lets all filter stages run as a
+ * single pass with one time step instead of separate calls each doing
+ * their own dt bookkeeping.
+ */
+struct tecs_update_input {
+	// vehicle state estimation
+	float altitude{0.0f};		///< altitude used by the height rate complementary filter (m)
+	float vz{0.0f};			///< down velocity from the INS (m/sec), used when vz_valid is true
+	float az{0.0f};			///< down acceleration (m/sec**2)
+	bool altitude_lock{false};	///< true when the altitude source is valid
+	bool vz_valid{false};		///< true when the INS vertical velocity is valid
+	bool in_air{false};		///< true when the vehicle is flying
+
+	// control loop setpoints and limits
+	float pitch{0.0f};		///< current pitch angle (rad)
+	float baro_altitude{0.0f};	///< altitude used by the control loops (m)
+	float hgt_setpoint{0.0f};	///< demanded height (m)
+	float EAS_setpoint{0.0f};	///< demanded equivalent airspeed (m/sec)
+	float indicated_airspeed{0.0f};	///< measured indicated airspeed (m/sec)
+	float eas_to_tas{1.0f};		///< equivalent to true airspeed conversion factor
+	bool climb_out_setpoint{false};	///< true when climbout mode is demanded
+	float pitch_min_climbout{0.0f};	///< minimum pitch angle during climbout (rad)
+	float throttle_min{0.0f};	///< normalised throttle lower limit
+	float throttle_max{0.0f};	///< normalised throttle upper limit
+	float throttle_cruise{0.0f};	///< normalised cruise throttle
+	float pitch_limit_min{0.0f};	///< pitch demand lower limit (rad)
+	float pitch_limit_max{0.0f};	///< pitch demand upper limit (rad)
+};
+
 class TECS
 {
 public:
@@ -85,6 +116,18 @@ public:
 				   float throttle_min, float throttle_setpoint_max, float throttle_cruise,
 				   float pitch_limit_min, float pitch_limit_max);
 
+	/**
+	 * Fused single-pass update
+	 *
+	 * Runs the vehicle state estimation and the pitch/throttle control loops
+	 * in one pass over the packed input struct, with one timestamp, one time
+	 * step and a single read of the rotation matrix elements used by TECS.
+	 * Equivalent to calling update_vehicle_state_estimates() followed by
+	 * update_pitch_throttle() back to back, which remain available for
+	 * callers that run the state estimation at a higher rate.
+	 */
+	void update(const matrix::Dcmf &rotMat, const matrix::Vector3f &accel_body, const tecs_update_input &input);
+
 	float get_throttle_setpoint(void) { return _throttle_setpoint; }
 	float get_pitch_setpoint() { return _pitch_setpoint; }
 	float get_speed_weight() { return _pitch_speed_weight; }
@@ -277,10 +320,21 @@ private:
 	bool _states_initalized{false};					///< true when TECS states have been iniitalized
 	bool _in_air{false};						///< true when the vehicle is flying
 
+	/**
+	 * Update the vehicle kinematic state estimates with an externally computed time step
+	 */
+	void _update_state_estimates(uint64_t now, float dt, const tecs_update_input &input, float speed_deriv_raw);
+
+	/**
+	 * Run the control loop calculations with an externally computed time step
+	 */
+	void _update_control(uint64_t now, float dt, const tecs_update_input &input, float cos_phi);
+
 	/**
 	 * Update the airspeed internal state using a second order complementary filter
 	 */
-	void _update_speed_states(float airspeed_setpoint, float indicated_airspeed, float eas_to_tas);
+	void _update_speed_states(uint64_t now, float dt, float airspeed_setpoint, float indicated_airspeed,
+				  float eas_to_tas);
 
 	/**
 	 * Update the desired airspeed
@@ -303,9 +357,9 @@ private:
 	void _update_energy_estimates();
 
 	/**
-	 * Update throttle setpoint
+	 * Update throttle setpoint, cos_phi is the cosine of the bank angle
 	 */
-	void _update_throttle_setpoint(float throttle_cruise, const matrix::Dcmf &rotMat);
+	void _update_throttle_setpoint(float throttle_cruise, float cos_phi);
 
 	/**
 	 * Detect an uncommanded descent
@@ -0,0 +1,602 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file tecs_batch.cpp
+ *
+ * Structure-of-arrays batch TECS engine, see tecs_batch.h.
+ * The stage kernels mirror the scalar TECS implementation in tecs.cpp;
+ * when changing the control law keep both in step.
+ *
+ * @author Paul Riseborough
+ */
+
+#include "tecs_batch.h"
+
+#include <ecl.h>
+#include <geo/geo.h>
+#include <mathlib/mathlib.h>
+#include <string.h>
+
+using math::constrain;
+using math::max;
+using math::min;
+
+static constexpr float DT_MIN = 0.001f;	///< minimum allowed simulation time step (sec)
+static constexpr float DT_MAX = 1.0f;	///< maximum allowed simulation time step (sec)
+
+namespace
+{
+// number of float and flag lanes carved from the two contiguous allocations
+constexpr unsigned NUM_FLOAT_LANES = 31;
+constexpr unsigned NUM_FLAG_LANES = 3;
+}
+
+TECSBatch::~TECSBatch()
+{
+	delete[] _lanes;
+	delete[] _flag_lanes;
+}
+
+bool TECSBatch::allocate(unsigned num_vehicles)
+{
+	delete[] _lanes;
+	delete[] _flag_lanes;
+	_lanes = nullptr;
+	_flag_lanes = nullptr;
+	_n = 0;
+
+	if (num_vehicles == 0) {
+		return false;
+	}
+
+	_lanes = new float[NUM_FLOAT_LANES * num_vehicles];
+	_flag_lanes = new uint8_t[NUM_FLAG_LANES * num_vehicles];
+
+	if (_lanes == nullptr || _flag_lanes == nullptr) {
+		delete[] _lanes;
+		delete[] _flag_lanes;
+		_lanes = nullptr;
+		_flag_lanes = nullptr;
+		return false;
+	}
+
+	_n = num_vehicles;
+	memset(_lanes, 0, sizeof(float) * NUM_FLOAT_LANES * _n);
+	memset(_flag_lanes, 0, sizeof(uint8_t) * NUM_FLAG_LANES * _n);
+
+	// carve the lanes out of the contiguous blocks
+	float *p = _lanes;
+	_vert_accel_state = p;		p += _n;
+	_vert_vel_state = p;		p += _n;
+	_vert_pos_state = p;		p += _n;
+	_tas_rate_state = p;		p += _n;
+	_tas_state = p;			p += _n;
+	_speed_derivative = p;		p += _n;
+	_EAS = p;			p += _n;
+	_TAS_setpoint_adj = p;		p += _n;
+	_TAS_rate_setpoint = p;		p += _n;
+	_hgt_setpoint_in_prev = p;	p += _n;
+	_hgt_setpoint_prev = p;		p += _n;
+	_hgt_setpoint_adj = p;		p += _n;
+	_hgt_setpoint_adj_prev = p;	p += _n;
+	_hgt_rate_setpoint = p;		p += _n;
+	_SPE_setpoint = p;		p += _n;
+	_SKE_setpoint = p;		p += _n;
+	_SPE_rate_setpoint = p;		p += _n;
+	_SKE_rate_setpoint = p;		p += _n;
+	_SPE_estimate = p;		p += _n;
+	_SKE_estimate = p;		p += _n;
+	_SPE_rate = p;			p += _n;
+	_SKE_rate = p;			p += _n;
+	_STE_error = p;			p += _n;
+	_STE_rate_error = p;		p += _n;
+	_throttle_integ_state = p;	p += _n;
+	_pitch_integ_state = p;		p += _n;
+	_last_throttle_setpoint = p;	p += _n;
+	_last_pitch_setpoint = p;	p += _n;
+	_pitch_setpoint_unc = p;	p += _n;
+	_throttle_setpoint = p;		p += _n;
+	_pitch_setpoint = p;
+
+	uint8_t *f = _flag_lanes;
+	_underspeed_detected = f;		f += _n;
+	_uncommanded_descent_recovery = f;	f += _n;
+	_states_initalized = f;
+
+	return true;
+}
+
+void TECSBatch::update(float dt, const tecs_batch_input &input)
+{
+	if (_n == 0) {
+		return;
+	}
+
+	dt = constrain(dt, DT_MIN, DT_MAX);
+
+	// fleet-wide specific total energy rate limits
+	_STE_rate_max = _max_climb_rate * CONSTANTS_ONE_G;
+	_STE_rate_min = -_min_sink_rate * CONSTANTS_ONE_G;
+
+	// same stage order as the scalar TECS::update()
+	_stage_state_estimates(dt, input);
+	_stage_initialize(input);
+	_stage_speed_states(dt, input);
+	_stage_detect(input);
+	_stage_speed_setpoint(input);
+	_stage_height_setpoint(dt, input);
+	_stage_energy_estimates();
+	_stage_throttle_setpoint(dt, input);
+	_stage_pitch_setpoint(dt, input);
+}
+
+void TECSBatch::_stage_state_estimates(float dt, const tecs_batch_input &in)
+{
+	const float omega = _hgt_estimate_freq;
+	const float omega2 = omega * omega;
+
+	for (unsigned i = 0; i < _n; i++) {
+		// the simulation supplies a bounded dt, so only input validity forces a reset
+		bool reset_altitude = !in.altitude_lock[i] || !in.in_air[i];
+
+		if (reset_altitude) {
+			_vert_pos_state[i] = in.altitude[i];
+			_vert_vel_state[i] = in.vz_valid[i] ? -in.vz[i] : 0.0f;
+			_vert_accel_state[i] = 0.0f;
+			_states_initalized[i] = 0;
+		}
+
+		_EAS[i] = in.indicated_airspeed[i];
+
+		// Generate the height and climb rate state estimates
+		if (in.vz_valid[i]) {
+			// Set the velocity and position state to the the INS data
+			_vert_vel_state[i] = -in.vz[i];
+			_vert_pos_state[i] = in.altitude[i];
+
+		} else {
+			// Estimate the vertical velocity using the baro-inertial complementary filter,
+			// see TECS::_update_state_estimates() for the references
+			float hgt_ddot_mea = -in.az[i];
+			float hgt_err = in.altitude[i] - _vert_pos_state[i];
+			float vert_accel_input = hgt_err * omega2 * omega;
+			_vert_accel_state[i] = _vert_accel_state[i] + vert_accel_input * dt;
+			float vert_vel_input = _vert_accel_state[i] + hgt_ddot_mea + hgt_err * omega2 * 3.0f;
+			_vert_vel_state[i] = _vert_vel_state[i] + vert_vel_input * dt;
+			float vert_pos_input = _vert_vel_state[i] + hgt_err * omega * 3.0f;
+
+			if (!reset_altitude) {
+				_vert_pos_state[i] = _vert_pos_state[i] + vert_pos_input * dt;
+			}
+		}
+
+		// Update and average speed rate of change if airspeed is being measured
+		if (ISFINITE(in.indicated_airspeed[i]) && _airspeed_enabled) {
+			_speed_derivative[i] = 0.95f * _speed_derivative[i] + 0.05f * in.speed_deriv_raw[i];
+
+		} else {
+			_speed_derivative[i] = 0.0f;
+		}
+
+		if (!in.in_air[i]) {
+			_states_initalized[i] = 0;
+		}
+	}
+}
+
+void TECSBatch::_stage_initialize(const tecs_batch_input &in)
+{
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i] || !_states_initalized[i]) {
+			// reset so the filters get a clean start, as in TECS::_initialize_states()
+			_vert_accel_state[i] = 0.0f;
+			_vert_vel_state[i] = 0.0f;
+			_vert_pos_state[i] = in.altitude[i];
+			_tas_rate_state[i] = 0.0f;
+			_tas_state[i] = _EAS[i] * in.eas_to_tas;
+			_throttle_integ_state[i] = 0.0f;
+			_pitch_integ_state[i] = 0.0f;
+			_last_throttle_setpoint[i] = in.in_air[i] ? in.throttle_cruise : 0.0f;
+			_last_pitch_setpoint[i] = constrain(in.pitch[i], in.pitch_limit_min, in.pitch_limit_max);
+			_pitch_setpoint_unc[i] = _last_pitch_setpoint[i];
+			_hgt_setpoint_adj_prev[i] = in.altitude[i];
+			_hgt_setpoint_adj[i] = _hgt_setpoint_adj_prev[i];
+			_hgt_setpoint_prev[i] = _hgt_setpoint_adj_prev[i];
+			_hgt_setpoint_in_prev[i] = _hgt_setpoint_adj_prev[i];
+			_TAS_setpoint_adj[i] = _EAS[i] * in.eas_to_tas;
+			_underspeed_detected[i] = 0;
+			_uncommanded_descent_recovery[i] = 0;
+			_STE_rate_error[i] = 0.0f;
+			_states_initalized[i] = 1;
+
+		} else if (in.climb_out[i]) {
+			// during climbout track the measured height and airspeed
+			_hgt_setpoint_adj_prev[i] = in.altitude[i];
+			_hgt_setpoint_adj[i] = _hgt_setpoint_adj_prev[i];
+			_hgt_setpoint_prev[i] = _hgt_setpoint_adj_prev[i];
+			_TAS_setpoint_adj[i] = _EAS[i] * in.eas_to_tas;
+			_underspeed_detected[i] = 0;
+			_uncommanded_descent_recovery[i] = 0;
+		}
+	}
+}
+
+void TECSBatch::_stage_speed_states(float dt, const tecs_batch_input &in)
+{
+	const float EAS_default = 0.5f * (_indicated_airspeed_min + _indicated_airspeed_max);
+	const float freq = _tas_estimate_freq;
+
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i]) {
+			continue;
+		}
+
+		// If airspeed measurements are not being used, fix the airspeed estimate to
+		// halfway between min and max limits
+		if (!ISFINITE(in.indicated_airspeed[i]) || !_airspeed_enabled) {
+			_EAS[i] = EAS_default;
+
+		} else {
+			_EAS[i] = in.indicated_airspeed[i];
+		}
+
+		// Obtain a smoothed airspeed estimate using a second order complementary filter
+		float tas_error = (_EAS[i] * in.eas_to_tas) - _tas_state[i];
+		float tas_rate_state_input = tas_error * freq * freq;
+
+		// limit integrator input to prevent windup
+		if (_tas_state[i] < 3.1f) {
+			tas_rate_state_input = max(tas_rate_state_input, 0.0f);
+		}
+
+		_tas_rate_state[i] = _tas_rate_state[i] + tas_rate_state_input * dt;
+		float tas_state_input = _tas_rate_state[i] + _speed_derivative[i] + tas_error * freq * 1.4142f;
+		_tas_state[i] = _tas_state[i] + tas_state_input * dt;
+
+		// Limit the airspeed state to a minimum of 3 m/s
+		_tas_state[i] = max(_tas_state[i], 3.0f);
+	}
+}
+
+void TECSBatch::_stage_detect(const tecs_batch_input &in)
+{
+	const float TAS_min = _indicated_airspeed_min * in.eas_to_tas;
+
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i]) {
+			continue;
+		}
+
+		// underspeed detection, as in TECS::_detect_underspeed()
+		if (!_detect_underspeed_enabled) {
+			_underspeed_detected[i] = 0;
+
+		} else if (((_tas_state[i] < TAS_min * 0.9f) && (_throttle_setpoint[i] >= in.throttle_max * 0.95f))
+			   || ((_vert_pos_state[i] < _hgt_setpoint_adj[i]) && _underspeed_detected[i])) {
+			_underspeed_detected[i] = 1;
+
+		} else {
+			_underspeed_detected[i] = 0;
+		}
+
+		// uncommanded descent detection, as in TECS::_detect_uncommanded_descent()
+		float STE_rate = _SPE_rate[i] + _SKE_rate[i];
+
+		bool enter_mode = !_uncommanded_descent_recovery[i] && !_underspeed_detected[i]
+				  && (_STE_error[i] > 200.0f) && (STE_rate < 0.0f)
+				  && (_throttle_setpoint[i] >= in.throttle_max * 0.9f);
+
+		bool exit_mode = _uncommanded_descent_recovery[i]
+				 && (_underspeed_detected[i] || (_STE_error[i] < 0.0f));
+
+		if (enter_mode) {
+			_uncommanded_descent_recovery[i] = 1;
+
+		} else if (exit_mode) {
+			_uncommanded_descent_recovery[i] = 0;
+		}
+	}
+}
+
+void TECSBatch::_stage_speed_setpoint(const tecs_batch_input &in)
+{
+	const float TAS_min = _indicated_airspeed_min * in.eas_to_tas;
+	const float TAS_max = _indicated_airspeed_max * in.eas_to_tas;
+
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i]) {
+			continue;
+		}
+
+		float TAS_setpoint = in.EAS_setpoint[i] * in.eas_to_tas;
+
+		// demand minimum airspeed in an underspeed or uncontrolled descent condition
+		if (_uncommanded_descent_recovery[i] || _underspeed_detected[i]) {
+			TAS_setpoint = TAS_min;
+		}
+
+		TAS_setpoint = constrain(TAS_setpoint, TAS_min, TAS_max);
+
+		// speed rate demand limits from the physical performance limits with a 50% margin
+		float velRateMax = 0.5f * _STE_rate_max / _tas_state[i];
+		float velRateMin = 0.5f * _STE_rate_min / _tas_state[i];
+
+		_TAS_setpoint_adj[i] = constrain(TAS_setpoint, TAS_min, TAS_max);
+
+		_TAS_rate_setpoint[i] = constrain((_TAS_setpoint_adj[i] - _tas_state[i]) * _speed_error_gain,
+						  velRateMin, velRateMax);
+	}
+}
+
+void TECSBatch::_stage_height_setpoint(float dt, const tecs_batch_input &in)
+{
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i]) {
+			continue;
+		}
+
+		float desired = in.hgt_setpoint[i];
+
+		// Detect first time through and initialize previous value to demand
+		if (ISFINITE(desired) && fabsf(_hgt_setpoint_in_prev[i]) < 0.1f) {
+			_hgt_setpoint_in_prev[i] = desired;
+		}
+
+		// Apply a 2 point moving average to demanded height
+		float hgt_setpoint;
+
+		if (ISFINITE(desired)) {
+			hgt_setpoint = 0.5f * (desired + _hgt_setpoint_in_prev[i]);
+
+		} else {
+			hgt_setpoint = _hgt_setpoint_in_prev[i];
+		}
+
+		_hgt_setpoint_in_prev[i] = hgt_setpoint;
+
+		// Apply a rate limit to respect vehicle performance limitations
+		if ((hgt_setpoint - _hgt_setpoint_prev[i]) > (_max_climb_rate * dt)) {
+			hgt_setpoint = _hgt_setpoint_prev[i] + _max_climb_rate * dt;
+
+		} else if ((hgt_setpoint - _hgt_setpoint_prev[i]) < (-_max_sink_rate * dt)) {
+			hgt_setpoint = _hgt_setpoint_prev[i] - _max_sink_rate * dt;
+		}
+
+		_hgt_setpoint_prev[i] = hgt_setpoint;
+
+		// Apply a first order noise filter
+		_hgt_setpoint_adj[i] = 0.1f * hgt_setpoint + 0.9f * _hgt_setpoint_adj_prev[i];
+
+		// demanded climb rate from height error plus demand derivative feedforward
+		_hgt_rate_setpoint[i] = (_hgt_setpoint_adj[i] - in.altitude[i]) * _height_error_gain
+					+ _height_setpoint_gain_ff * (_hgt_setpoint_adj[i] - _hgt_setpoint_adj_prev[i]) / dt;
+		_hgt_setpoint_adj_prev[i] = _hgt_setpoint_adj[i];
+
+		// respect vehicle performance limits
+		if (_hgt_rate_setpoint[i] > _max_climb_rate) {
+			_hgt_rate_setpoint[i] = _max_climb_rate;
+
+		} else if (_hgt_rate_setpoint[i] < -_max_sink_rate) {
+			_hgt_rate_setpoint[i] = -_max_sink_rate;
+		}
+	}
+}
+
+void TECSBatch::_stage_energy_estimates()
+{
+	for (unsigned i = 0; i < _n; i++) {
+		// specific energy demands (m**2/sec**2) and rate demands (m**2/sec**3)
+		_SPE_setpoint[i] = _hgt_setpoint_adj[i] * CONSTANTS_ONE_G;
+		_SKE_setpoint[i] = 0.5f * _TAS_setpoint_adj[i] * _TAS_setpoint_adj[i];
+		_SPE_rate_setpoint[i] = _hgt_rate_setpoint[i] * CONSTANTS_ONE_G;
+		_SKE_rate_setpoint[i] = _tas_state[i] * _TAS_rate_setpoint[i];
+
+		// specific energy estimates and rates
+		_SPE_estimate[i] = _vert_pos_state[i] * CONSTANTS_ONE_G;
+		_SKE_estimate[i] = 0.5f * _tas_state[i] * _tas_state[i];
+		_SPE_rate[i] = _vert_vel_state[i] * CONSTANTS_ONE_G;
+		_SKE_rate[i] = _tas_state[i] * _speed_derivative[i];
+	}
+}
+
+void TECSBatch::_stage_throttle_setpoint(float dt, const tecs_batch_input &in)
+{
+	const float STE_to_throttle = 1.0f / (_throttle_time_constant * (_STE_rate_max - _STE_rate_min));
+
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i]) {
+			continue;
+		}
+
+		// during climbout the throttle lower limit prevents throttle reduction
+		const float throttle_min = in.climb_out[i] ? (in.throttle_max - 0.01f) : in.throttle_min;
+
+		// total energy error
+		_STE_error[i] = _SPE_setpoint[i] - _SPE_estimate[i] + _SKE_setpoint[i] - _SKE_estimate[i];
+
+		// demanded rate of change of total energy, respecting vehicle limits
+		float STE_rate_setpoint = constrain((_SPE_rate_setpoint[i] + _SKE_rate_setpoint[i]),
+						    _STE_rate_min, _STE_rate_max);
+
+		// total energy rate error with a first order IIR filter to reduce accelerometer noise
+		_STE_rate_error[i] = 0.2f * (STE_rate_setpoint - _SPE_rate[i] - _SKE_rate[i]) + 0.8f * _STE_rate_error[i];
+
+		if (_underspeed_detected[i]) {
+			// always use full throttle to recover from an underspeed condition
+			_throttle_setpoint[i] = 1.0f;
+			continue;
+		}
+
+		// compensate for induced drag rise in turns, see TECS::_update_throttle_setpoint()
+		STE_rate_setpoint = STE_rate_setpoint
+				    + _load_factor_correction * (1.0f / constrain(in.cos_phi[i], 0.1f, 1.0f) - 1.0f);
+
+		// predicted throttle from the demanded rate of change of energy
+		float throttle_predicted;
+
+		if (STE_rate_setpoint >= 0) {
+			throttle_predicted = in.throttle_cruise
+					     + STE_rate_setpoint / _STE_rate_max * (in.throttle_max - in.throttle_cruise);
+
+		} else {
+			throttle_predicted = in.throttle_cruise
+					     + STE_rate_setpoint / _STE_rate_min * (throttle_min - in.throttle_cruise);
+		}
+
+		// proportional and derivative feedback on the predicted throttle
+		float throttle_setpoint = (_STE_error[i] + _STE_rate_error[i] * _throttle_damping_gain) * STE_to_throttle
+					  + throttle_predicted;
+		throttle_setpoint = constrain(throttle_setpoint, throttle_min, in.throttle_max);
+
+		// Rate limit the throttle demand
+		if (fabsf(_throttle_slewrate) > 0.01f) {
+			float throttle_increment_limit = dt * (in.throttle_max - throttle_min) * _throttle_slewrate;
+			throttle_setpoint = constrain(throttle_setpoint,
+						      _last_throttle_setpoint[i] - throttle_increment_limit,
+						      _last_throttle_setpoint[i] + throttle_increment_limit);
+		}
+
+		_last_throttle_setpoint[i] = throttle_setpoint;
+
+		if (_integrator_gain > 0.0f) {
+			// integrator limits with 10% saturation allowance
+			float integ_state_max = in.throttle_max - throttle_setpoint + 0.1f;
+			float integ_state_min = throttle_min - throttle_setpoint - 0.1f;
+
+			_throttle_integ_state[i] = _throttle_integ_state[i]
+						   + (_STE_error[i] * _integrator_gain) * dt * STE_to_throttle;
+
+			if (in.climb_out[i]) {
+				_throttle_integ_state[i] = integ_state_max;
+
+			} else {
+				_throttle_integ_state[i] = constrain(_throttle_integ_state[i], integ_state_min, integ_state_max);
+			}
+
+		} else {
+			_throttle_integ_state[i] = 0.0f;
+		}
+
+		if (_airspeed_enabled) {
+			throttle_setpoint = throttle_setpoint + _throttle_integ_state[i];
+
+		} else {
+			throttle_setpoint = throttle_predicted;
+		}
+
+		_throttle_setpoint[i] = constrain(throttle_setpoint, throttle_min, in.throttle_max);
+	}
+}
+
+void TECSBatch::_stage_pitch_setpoint(float dt, const tecs_batch_input &in)
+{
+	for (unsigned i = 0; i < _n; i++) {
+		if (!in.in_air[i]) {
+			continue;
+		}
+
+		// during climbout the lower pitch limit comes from the mission plan
+		const float pitch_min = in.climb_out[i] ? in.pitch_min_climbout : in.pitch_limit_min;
+
+		// speed / height priority weighting, see TECS::_update_pitch_setpoint()
+		float SKE_weighting = constrain(_pitch_speed_weight, 0.0f, 2.0f);
+
+		if ((_underspeed_detected[i] || in.climb_out[i]) && _airspeed_enabled) {
+			SKE_weighting = 2.0f;
+
+		} else if (!_airspeed_enabled) {
+			SKE_weighting = 0.0f;
+		}
+
+		float SPE_weighting = 2.0f - SKE_weighting;
+
+		// specific energy balance demand and rate demand
+		float SEB_setpoint = _SPE_setpoint[i] * SPE_weighting - _SKE_setpoint[i] * SKE_weighting;
+		float SEB_rate_setpoint = _SPE_rate_setpoint[i] * SPE_weighting - _SKE_rate_setpoint[i] * SKE_weighting;
+
+		// specific energy balance and balance rate error
+		float SEB_error = SEB_setpoint - (_SPE_estimate[i] * SPE_weighting - _SKE_estimate[i] * SKE_weighting);
+		float SEB_rate_error = SEB_rate_setpoint - (_SPE_rate[i] * SPE_weighting - _SKE_rate[i] * SKE_weighting);
+
+		// derivative from change in climb angle to rate of change of specific energy balance
+		float climb_angle_to_SEB_rate = _tas_state[i] * _pitch_time_constant * CONSTANTS_ONE_G;
+
+		if (_integrator_gain > 0.0f) {
+			float pitch_integ_input = SEB_error * _integrator_gain;
+
+			// anti-windup on the pitch demand saturation
+			if (_pitch_setpoint_unc[i] > in.pitch_limit_max) {
+				pitch_integ_input = min(pitch_integ_input,
+							min((in.pitch_limit_max - _pitch_setpoint_unc[i]) * climb_angle_to_SEB_rate /
+							    _pitch_time_constant, 0.0f));
+
+			} else if (_pitch_setpoint_unc[i] < pitch_min) {
+				pitch_integ_input = max(pitch_integ_input,
+							max((pitch_min - _pitch_setpoint_unc[i]) * climb_angle_to_SEB_rate /
+							    _pitch_time_constant, 0.0f));
+			}
+
+			_pitch_integ_state[i] = _pitch_integ_state[i] + pitch_integ_input * dt;
+
+		} else {
+			_pitch_integ_state[i] = 0.0f;
+		}
+
+		// specific energy correction excluding the integrator contribution
+		float SEB_correction = SEB_error + SEB_rate_error * _pitch_damping_gain
+				       + SEB_rate_setpoint * _pitch_time_constant;
+
+		// during climbout bias the demanded pitch angle to the minimum pitch angle
+		if (in.climb_out[i]) {
+			SEB_correction += pitch_min * climb_angle_to_SEB_rate;
+		}
+
+		// convert to a pitch angle demand
+		_pitch_setpoint_unc[i] = (SEB_correction + _pitch_integ_state[i]) / climb_angle_to_SEB_rate;
+		float pitch_setpoint = constrain(_pitch_setpoint_unc[i], pitch_min, in.pitch_limit_max);
+
+		// comply with the vertical acceleration limit by applying a pitch rate limit
+		float ptchRateIncr = dt * _vert_accel_limit / _tas_state[i];
+
+		if ((pitch_setpoint - _last_pitch_setpoint[i]) > ptchRateIncr) {
+			pitch_setpoint = _last_pitch_setpoint[i] + ptchRateIncr;
+
+		} else if ((pitch_setpoint - _last_pitch_setpoint[i]) < -ptchRateIncr) {
+			pitch_setpoint = _last_pitch_setpoint[i] - ptchRateIncr;
+		}
+
+		_last_pitch_setpoint[i] = pitch_setpoint;
+		_pitch_setpoint[i] = pitch_setpoint;
+	}
+}
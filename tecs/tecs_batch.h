@@ -0,0 +1,230 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2018 Estimation and Control Library (ECL). All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name ECL nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file tecs_batch.h
+ *
+ * Structure-of-arrays batch TECS engine for multi-vehicle simulation.
+ *
+ * Advances N TECS instances per update() call. Every filter and controller
+ * state is stored as a contiguous lane of N values and each control stage is
+ * one loop over the lanes, so the compiler can vectorize the arithmetic and
+ * fleet simulation cost scales with SIMD width instead of vehicle count.
+ *
+ * The controller mathematics mirror the scalar TECS class stage by stage.
+ * Differences imposed by the batch form:
+ *  - the time step is supplied by the simulation instead of being measured,
+ *  - the tuning parameters, airspeed limits and throttle/pitch envelope are
+ *    fleet-wide (one homogeneous vehicle model per engine),
+ *  - the caller precomputes the two rotation matrix derived inputs
+ *    (speed_deriv_raw and cos_phi) per vehicle, since the engine does not
+ *    store attitude.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Per-cycle inputs for TECSBatch::update(). The pointers address per-vehicle
+ * lanes of num_vehicles() entries; the scalars apply to the whole fleet.
+ */
+struct tecs_batch_input {
+	// per-vehicle input lanes
+	const float *altitude{nullptr};		///< altitude (m)
+	const float *vz{nullptr};		///< down velocity from the INS (m/sec), used when vz_valid
+	const float *az{nullptr};		///< down acceleration (m/sec**2)
+	const float *speed_deriv_raw{nullptr};	///< rotMat(2,0) * g + body X acceleration (m/sec**2)
+	const float *cos_phi{nullptr};		///< cosine of the bank angle
+	const float *pitch{nullptr};		///< pitch angle (rad)
+	const float *hgt_setpoint{nullptr};	///< demanded height (m)
+	const float *EAS_setpoint{nullptr};	///< demanded equivalent airspeed (m/sec)
+	const float *indicated_airspeed{nullptr}; ///< measured indicated airspeed (m/sec)
+	const uint8_t *altitude_lock{nullptr};	///< non-zero when the altitude source is valid
+	const uint8_t *vz_valid{nullptr};	///< non-zero when the INS vertical velocity is valid
+	const uint8_t *in_air{nullptr};		///< non-zero when the vehicle is flying
+	const uint8_t *climb_out{nullptr};	///< non-zero when climbout mode is demanded
+
+	// fleet-wide scalars
+	float eas_to_tas{1.0f};			///< equivalent to true airspeed conversion factor
+	float pitch_min_climbout{0.0f};		///< minimum pitch angle during climbout (rad)
+	float throttle_min{0.0f};		///< normalised throttle lower limit
+	float throttle_max{0.0f};		///< normalised throttle upper limit
+	float throttle_cruise{0.0f};		///< normalised cruise throttle
+	float pitch_limit_min{0.0f};		///< pitch demand lower limit (rad)
+	float pitch_limit_max{0.0f};		///< pitch demand upper limit (rad)
+};
+
+class TECSBatch
+{
+public:
+	TECSBatch() = default;
+	~TECSBatch();
+
+	// no copy, assignment, move, move assignment
+	TECSBatch(const TECSBatch &) = delete;
+	TECSBatch &operator=(const TECSBatch &) = delete;
+	TECSBatch(TECSBatch &&) = delete;
+	TECSBatch &operator=(TECSBatch &&) = delete;
+
+	/**
+	 * Allocate the state lanes for a fleet of num_vehicles instances.
+	 * Existing lanes are released first. Returns false on allocation failure.
+	 */
+	bool allocate(unsigned num_vehicles);
+
+	/**
+	 * Advance all instances by one time step of dt seconds.
+	 */
+	void update(float dt, const tecs_batch_input &input);
+
+	unsigned num_vehicles() const { return _n; }
+
+	// per-vehicle output lanes, valid after update()
+	const float *throttle_setpoint() const { return _throttle_setpoint; }
+	const float *pitch_setpoint() const { return _pitch_setpoint; }
+	const float *tas_state() const { return _tas_state; }
+	const float *vert_pos_state() const { return _vert_pos_state; }
+	const float *vert_vel_state() const { return _vert_vel_state; }
+
+	// fleet-wide configuration, same meaning as the scalar TECS setters
+	void enable_airspeed(bool enabled) { _airspeed_enabled = enabled; }
+	void set_detect_underspeed_enabled(bool enabled) { _detect_underspeed_enabled = enabled; }
+	void set_time_const(float time_const) { _pitch_time_constant = time_const; }
+	void set_integrator_gain(float gain) { _integrator_gain = gain; }
+	void set_min_sink_rate(float rate) { _min_sink_rate = rate; }
+	void set_max_sink_rate(float sink_rate) { _max_sink_rate = sink_rate; }
+	void set_max_climb_rate(float climb_rate) { _max_climb_rate = climb_rate; }
+	void set_height_comp_filter_omega(float omega) { _hgt_estimate_freq = omega; }
+	void set_heightrate_ff(float heightrate_ff) { _height_setpoint_gain_ff = heightrate_ff; }
+	void set_heightrate_p(float heightrate_p) { _height_error_gain = heightrate_p; }
+	void set_indicated_airspeed_max(float airspeed) { _indicated_airspeed_max = airspeed; }
+	void set_indicated_airspeed_min(float airspeed) { _indicated_airspeed_min = airspeed; }
+	void set_pitch_damping(float damping) { _pitch_damping_gain = damping; }
+	void set_vertical_accel_limit(float limit) { _vert_accel_limit = limit; }
+	void set_speed_comp_filter_omega(float omega) { _tas_estimate_freq = omega; }
+	void set_speed_weight(float weight) { _pitch_speed_weight = weight; }
+	void set_speedrate_p(float speedrate_p) { _speed_error_gain = speedrate_p; }
+	void set_time_const_throt(float time_const_throt) { _throttle_time_constant = time_const_throt; }
+	void set_throttle_damp(float throttle_damp) { _throttle_damping_gain = throttle_damp; }
+	void set_throttle_slewrate(float slewrate) { _throttle_slewrate = slewrate; }
+	void set_roll_throttle_compensation(float compensation) { _load_factor_correction = compensation; }
+
+private:
+	// per-stage kernels, each one loop over the lanes
+	void _stage_initialize(const tecs_batch_input &input);
+	void _stage_state_estimates(float dt, const tecs_batch_input &input);
+	void _stage_speed_states(float dt, const tecs_batch_input &input);
+	void _stage_detect(const tecs_batch_input &input);
+	void _stage_speed_setpoint(const tecs_batch_input &input);
+	void _stage_height_setpoint(float dt, const tecs_batch_input &input);
+	void _stage_energy_estimates();
+	void _stage_throttle_setpoint(float dt, const tecs_batch_input &input);
+	void _stage_pitch_setpoint(float dt, const tecs_batch_input &input);
+
+	unsigned _n{0};			///< number of instances
+	float *_lanes{nullptr};		///< single contiguous allocation carved into the float lanes below
+	uint8_t *_flag_lanes{nullptr};	///< single contiguous allocation carved into the flag lanes below
+
+	// complementary filter state lanes
+	float *_vert_accel_state{nullptr};
+	float *_vert_vel_state{nullptr};
+	float *_vert_pos_state{nullptr};
+	float *_tas_rate_state{nullptr};
+	float *_tas_state{nullptr};
+	float *_speed_derivative{nullptr};
+	float *_EAS{nullptr};
+
+	// setpoint tracking lanes
+	float *_TAS_setpoint_adj{nullptr};
+	float *_TAS_rate_setpoint{nullptr};
+	float *_hgt_setpoint_in_prev{nullptr};
+	float *_hgt_setpoint_prev{nullptr};
+	float *_hgt_setpoint_adj{nullptr};
+	float *_hgt_setpoint_adj_prev{nullptr};
+	float *_hgt_rate_setpoint{nullptr};
+
+	// specific energy lanes
+	float *_SPE_setpoint{nullptr};
+	float *_SKE_setpoint{nullptr};
+	float *_SPE_rate_setpoint{nullptr};
+	float *_SKE_rate_setpoint{nullptr};
+	float *_SPE_estimate{nullptr};
+	float *_SKE_estimate{nullptr};
+	float *_SPE_rate{nullptr};
+	float *_SKE_rate{nullptr};
+	float *_STE_error{nullptr};
+	float *_STE_rate_error{nullptr};
+
+	// controller state and output lanes
+	float *_throttle_integ_state{nullptr};
+	float *_pitch_integ_state{nullptr};
+	float *_last_throttle_setpoint{nullptr};
+	float *_last_pitch_setpoint{nullptr};
+	float *_pitch_setpoint_unc{nullptr};
+	float *_throttle_setpoint{nullptr};
+	float *_pitch_setpoint{nullptr};
+
+	// controller mode flag lanes
+	uint8_t *_underspeed_detected{nullptr};
+	uint8_t *_uncommanded_descent_recovery{nullptr};
+	uint8_t *_states_initalized{nullptr};
+
+	// fleet-wide energy rate limits, refreshed each update
+	float _STE_rate_max{0.0f};
+	float _STE_rate_min{0.0f};
+
+	// fleet-wide controller parameters, defaults as in the scalar TECS
+	float _hgt_estimate_freq{0.0f};
+	float _tas_estimate_freq{0.0f};
+	float _max_climb_rate{2.0f};
+	float _min_sink_rate{1.0f};
+	float _max_sink_rate{2.0f};
+	float _pitch_time_constant{5.0f};
+	float _throttle_time_constant{8.0f};
+	float _pitch_damping_gain{0.0f};
+	float _throttle_damping_gain{0.0f};
+	float _integrator_gain{0.0f};
+	float _vert_accel_limit{0.0f};
+	float _load_factor_correction{0.0f};
+	float _pitch_speed_weight{1.0f};
+	float _height_error_gain{0.0f};
+	float _height_setpoint_gain_ff{0.0f};
+	float _speed_error_gain{0.0f};
+	float _indicated_airspeed_min{3.0f};
+	float _indicated_airspeed_max{30.0f};
+	float _throttle_slewrate{0.0f};
+
+	bool _airspeed_enabled{false};
+	bool _detect_underspeed_enabled{true};
+};
@@ -78,7 +78,6 @@ DataValidator::put(uint64_t timestamp, const float val[dimensions], uint64_t err
 			float delta_val = lp_val - _mean[i];
 			_mean[i] += delta_val / _event_count;
 			_M2[i] += delta_val * (lp_val - _mean[i]);
-			_rms[i] = sqrtf(_M2[i] / (_event_count - 1));
 
 			if (fabsf(_value[i] - val[i]) < 0.000001f) {
 				_value_equal_count++;
@@ -97,11 +96,21 @@ DataValidator::put(uint64_t timestamp, const float val[dimensions], uint64_t err
 	}
 
 	_time_last = timestamp;
+
+	/* the derived values need re-evaluation on the next query */
+	_rms_dirty = true;
+	_confidence_cached = false;
 }
 
 float
 DataValidator::confidence(uint64_t timestamp)
 {
+	/* the confidence only changes when new data is put or when the stream times
+	 * out, so repeated queries within one cycle return the cached value */
+	if (_confidence_cached && (timestamp - _time_last <= _timeout_interval)) {
+		return _confidence;
+	}
+
 	float ret = 1.0f;
 
 	/* check if we have any data */
@@ -141,6 +150,12 @@ DataValidator::confidence(uint64_t timestamp)
 		}
 	}
 
+	/* only cache results which do not depend on the query time (no data / timeout) */
+	if ((_time_last != 0) && (timestamp - _time_last <= _timeout_interval)) {
+		_confidence = ret;
+		_confidence_cached = true;
+	}
+
 	return ret;
 }
 
@@ -155,6 +170,6 @@ DataValidator::print()
 	for (unsigned i = 0; i < dimensions; i++) {
 		ECL_INFO("\tval: %8.4f, lp: %8.4f mean dev: %8.4f RMS: %8.4f conf: %8.4f",
 			 (double) _value[i], (double)_lp[i], (double)_mean[i],
-			 (double)_rms[i], (double)confidence(ecl_absolute_time()));
+			 (double)rms()[i], (double)confidence(ecl_absolute_time()));
 	}
 }
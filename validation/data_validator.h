@@ -66,19 +66,6 @@ public:
 	 */
 	void			put(uint64_t timestamp, const float val[dimensions], uint64_t error_count, int priority);
 
-	/**
-	 * Get the next sibling in the group
-	 *
-	 * @return		the next sibling
-	 */
-	DataValidator		*sibling() { return _sibling; }
-
-	/**
-	 * Set the sibling to the next node in the group
-	 *
-	 */
-	void			setSibling(DataValidator *new_sibling) { _sibling = new_sibling; }
-
 	/**
 	 * Get the confidence of this validator
 	 * @return		the confidence between 0 and 1
@@ -122,9 +109,24 @@ public:
 
 	/**
 	 * Get the RMS values of this validator
+	 *
+	 * The square roots are only evaluated here when data was put since the
+	 * last query, put() itself just maintains the running sums.
+	 *
 	 * @return		the stored RMS
 	 */
-	float			*rms() { return _rms; }
+	float			*rms()
+	{
+		if (_rms_dirty) {
+			for (unsigned i = 0; i < dimensions; i++) {
+				_rms[i] = (_event_count > 1) ? sqrtf(_M2[i] / (_event_count - 1)) : 0.0f;
+			}
+
+			_rms_dirty = false;
+		}
+
+		return _rms;
+	}
 
 	/**
 	 * Get the vibration offset
@@ -189,11 +191,13 @@ private:
 	float _value[dimensions] {};			/**< last value */
 	float _vibe[dimensions] {};			/**< vibration level, in sensor unit */
 
+	float _confidence{0.0f};			/**< cached result of the last confidence evaluation */
+	bool _confidence_cached{false};			/**< the cached confidence is current */
+	bool _rms_dirty{false};				/**< data was put since the RMS was last evaluated */
+
 	unsigned _value_equal_count{0};			/**< equal values in a row */
 	unsigned _value_equal_count_threshold{VALUE_EQUAL_COUNT_DEFAULT};	/**< when to consider an equal count as a problem */
 
-	DataValidator *_sibling{nullptr};		/**< sibling in the group */
-
 	static const constexpr unsigned NORETURN_ERRCOUNT = 10000;	/**< if the error count reaches this value, return sensor as invalid */
 	static const constexpr float ERROR_DENSITY_WINDOW = 100.0f; 	/**< window in measurement counts for errors */
 	static const constexpr unsigned VALUE_EQUAL_COUNT_DEFAULT = 100;	/**< if the sensor value is the same (accumulated also between axes) this many times, flag it */
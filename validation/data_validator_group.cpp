@@ -45,60 +45,56 @@
 
 DataValidatorGroup::DataValidatorGroup(unsigned siblings)
 {
-	DataValidator *next = nullptr;
-	DataValidator *prev = nullptr;
-
-	for (unsigned i = 0; i < siblings; i++) {
-		next = new DataValidator();
-
-		if (i == 0) {
-			_first = next;
-
-		} else {
-			prev->setSibling(next);
-		}
-
-		prev = next;
+	// the validators live in one contiguous array so the per-poll confidence scan
+	// walks adjacent memory instead of chasing list nodes. A few spare slots are
+	// allocated up front so that late detected sensors can be added in place.
+	_capacity = siblings + GROUP_RESERVE;
+
+	_validators = new DataValidator[_capacity];
+	_confidences = new float[_capacity];
+
+	if ((_validators == nullptr) || (_confidences == nullptr)) {
+		delete[] _validators;
+		delete[] _confidences;
+		_validators = nullptr;
+		_confidences = nullptr;
+		_capacity = 0;
+		return;
 	}
 
-	_last = next;
+	_num = siblings;
 
-	if (_first) {
-		_timeout_interval_us = _first->get_timeout();
+	if (_num > 0) {
+		_timeout_interval_us = _validators[0].get_timeout();
 	}
 }
 
 DataValidatorGroup::~DataValidatorGroup()
 {
-	while (_first) {
-		DataValidator *next = _first->sibling();
-		delete (_first);
-		_first = next;
-	}
+	delete[] _validators;
+	delete[] _confidences;
 }
 
 DataValidator *DataValidatorGroup::add_new_validator()
 {
-	DataValidator *validator = new DataValidator();
-
-	if (!validator) {
+	if (_num >= _capacity) {
+		// all slots are in use, the array cannot be moved because the
+		// validators carry their accumulated statistics
 		return nullptr;
 	}
 
-	_last->setSibling(validator);
-	_last = validator;
-	_last->set_timeout(_timeout_interval_us);
-	return _last;
+	DataValidator *validator = &_validators[_num];
+	validator->set_timeout(_timeout_interval_us);
+	_num++;
+
+	return validator;
 }
 
 void
 DataValidatorGroup::set_timeout(uint32_t timeout_interval_us)
 {
-	DataValidator *next = _first;
-
-	while (next != nullptr) {
-		next->set_timeout(timeout_interval_us);
-		next = next->sibling();
+	for (unsigned i = 0; i < _num; i++) {
+		_validators[i].set_timeout(timeout_interval_us);
 	}
 
 	_timeout_interval_us = timeout_interval_us;
@@ -107,11 +103,8 @@ DataValidatorGroup::set_timeout(uint32_t timeout_interval_us)
 void
 DataValidatorGroup::set_equal_value_threshold(uint32_t threshold)
 {
-	DataValidator *next = _first;
-
-	while (next != nullptr) {
-		next->set_equal_value_threshold(threshold);
-		next = next->sibling();
+	for (unsigned i = 0; i < _num; i++) {
+		_validators[i].set_equal_value_threshold(threshold);
 	}
 }
 
@@ -119,25 +112,14 @@ DataValidatorGroup::set_equal_value_threshold(uint32_t threshold)
 void
 DataValidatorGroup::put(unsigned index, uint64_t timestamp, const float val[3], uint64_t error_count, int priority)
 {
-	DataValidator *next = _first;
-	unsigned i = 0;
-
-	while (next != nullptr) {
-		if (i == index) {
-			next->put(timestamp, val, error_count, priority);
-			break;
-		}
-
-		next = next->sibling();
-		i++;
+	if (index < _num) {
+		_validators[index].put(timestamp, val, error_count, priority);
 	}
 }
 
 float *
 DataValidatorGroup::get_best(uint64_t timestamp, int *index)
 {
-	DataValidator *next = _first;
-
 	// XXX This should eventually also include voting
 	int pre_check_best = _curr_best;
 	float pre_check_confidence = 1.0f;
@@ -147,13 +129,17 @@ DataValidatorGroup::get_best(uint64_t timestamp, int *index)
 	int max_index = -1;
 	DataValidator *best = nullptr;
 
-	int i = 0;
+	/* first pass: batch evaluate all confidences over the contiguous array */
+	for (unsigned i = 0; i < _num; i++) {
+		_confidences[i] = _validators[i].confidence(timestamp);
+	}
 
-	while (next != nullptr) {
-		float confidence = next->confidence(timestamp);
+	/* second pass: select the best sensor from the evaluated confidences */
+	for (unsigned i = 0; i < _num; i++) {
+		const float confidence = _confidences[i];
 
-		if (i == pre_check_best) {
-			pre_check_prio = next->priority();
+		if ((int)i == pre_check_best) {
+			pre_check_prio = _validators[i].priority();
 			pre_check_confidence = confidence;
 		}
 
@@ -163,18 +149,15 @@ DataValidatorGroup::get_best(uint64_t timestamp, int *index)
 		 * 2) the confidence is no less than 1% different and the priority is higher
 		 */
 		if ((((max_confidence < MIN_REGULAR_CONFIDENCE) && (confidence >= MIN_REGULAR_CONFIDENCE)) ||
-		     (confidence > max_confidence && (next->priority() >= max_priority)) ||
-		     (fabsf(confidence - max_confidence) < 0.01f && (next->priority() > max_priority))
+		     (confidence > max_confidence && (_validators[i].priority() >= max_priority)) ||
+		     (fabsf(confidence - max_confidence) < 0.01f && (_validators[i].priority() > max_priority))
 		    ) && (confidence > 0.0f)) {
 
 			max_index = i;
 			max_confidence = confidence;
-			max_priority = next->priority();
-			best = next;
+			max_priority = _validators[i].priority();
+			best = &_validators[i];
 		}
-
-		next = next->sibling();
-		i++;
 	}
 
 	/* the current best sensor is not matching the previous best sensor,
@@ -225,15 +208,13 @@ DataValidatorGroup::get_best(uint64_t timestamp, int *index)
 float
 DataValidatorGroup::get_vibration_factor(uint64_t timestamp)
 {
-	DataValidator *next = _first;
-
 	float vibe = 0.0f;
 
 	/* find the best RMS value of a non-timed out sensor */
-	while (next != nullptr) {
+	for (unsigned i = 0; i < _num; i++) {
 
-		if (next->confidence(timestamp) > 0.5f) {
-			float *rms = next->rms();
+		if (_validators[i].confidence(timestamp) > 0.5f) {
+			float *rms = _validators[i].rms();
 
 			for (unsigned j = 0; j < 3; j++) {
 				if (rms[j] > vibe) {
@@ -241,8 +222,6 @@ DataValidatorGroup::get_vibration_factor(uint64_t timestamp)
 				}
 			}
 		}
-
-		next = next->sibling();
 	}
 
 	return vibe;
@@ -251,22 +230,18 @@ DataValidatorGroup::get_vibration_factor(uint64_t timestamp)
 float
 DataValidatorGroup::get_vibration_offset(uint64_t timestamp, int axis)
 {
-	DataValidator *next = _first;
-
 	float vibe = -1.0f;
 
 	/* find the best vibration value of a non-timed out sensor */
-	while (next != nullptr) {
+	for (unsigned i = 0; i < _num; i++) {
 
-		if (next->confidence(timestamp) > 0.5f) {
-			float *vibration_offset = next->vibration_offset();
+		if (_validators[i].confidence(timestamp) > 0.5f) {
+			float *vibration_offset = _validators[i].vibration_offset();
 
 			if (vibe < 0.0f || vibration_offset[axis] < vibe) {
 				vibe = vibration_offset[axis];
 			}
 		}
-
-		next = next->sibling();
 	}
 
 	return vibe;
@@ -280,14 +255,11 @@ DataValidatorGroup::print()
 		 _curr_best, _prev_best, (_toggle_count > 0) ? "YES" : "NO",
 		 _toggle_count);
 
-	DataValidator *next = _first;
-	unsigned i = 0;
+	for (unsigned i = 0; i < _num; i++) {
+		if (_validators[i].used()) {
+			uint32_t flags = _validators[i].state();
 
-	while (next != nullptr) {
-		if (next->used()) {
-			uint32_t flags = next->state();
-
-			ECL_INFO("sensor #%u, prio: %d, state:%s%s%s%s%s%s", i, next->priority(),
+			ECL_INFO("sensor #%u, prio: %d, state:%s%s%s%s%s%s", i, _validators[i].priority(),
 				 ((flags & DataValidator::ERROR_FLAG_NO_DATA) ? " OFF" : ""),
 				 ((flags & DataValidator::ERROR_FLAG_STALE_DATA) ? " STALE" : ""),
 				 ((flags & DataValidator::ERROR_FLAG_TIMEOUT) ? " TOUT" : ""),
@@ -295,27 +267,19 @@ DataValidatorGroup::print()
 				 ((flags & DataValidator::ERROR_FLAG_HIGH_ERRDENSITY) ? " EDNST" : ""),
 				 ((flags == DataValidator::ERROR_FLAG_NO_ERROR) ? " OK" : ""));
 
-			next->print();
+			_validators[i].print();
 		}
-
-		next = next->sibling();
-		i++;
 	}
 }
 
 int
 DataValidatorGroup::failover_index()
 {
-	DataValidator *next = _first;
-	unsigned i = 0;
-
-	while (next != nullptr) {
-		if (next->used() && (next->state() != DataValidator::ERROR_FLAG_NO_ERROR) && (i == (unsigned)_prev_best)) {
+	for (unsigned i = 0; i < _num; i++) {
+		if (_validators[i].used() && (_validators[i].state() != DataValidator::ERROR_FLAG_NO_ERROR)
+		    && (i == (unsigned)_prev_best)) {
 			return i;
 		}
-
-		next = next->sibling();
-		i++;
 	}
 
 	return -1;
@@ -324,16 +288,11 @@ DataValidatorGroup::failover_index()
 uint32_t
 DataValidatorGroup::failover_state()
 {
-	DataValidator *next = _first;
-	unsigned i = 0;
-
-	while (next != nullptr) {
-		if (next->used() && (next->state() != DataValidator::ERROR_FLAG_NO_ERROR) && (i == (unsigned)_prev_best)) {
-			return next->state();
+	for (unsigned i = 0; i < _num; i++) {
+		if (_validators[i].used() && (_validators[i].state() != DataValidator::ERROR_FLAG_NO_ERROR)
+		    && (i == (unsigned)_prev_best)) {
+			return _validators[i].state();
 		}
-
-		next = next->sibling();
-		i++;
 	}
 
 	return DataValidator::ERROR_FLAG_NO_ERROR;
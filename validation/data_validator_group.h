@@ -54,7 +54,7 @@ public:
 
 	/**
 	 * Create a new Validator (with index equal to the number of currently existing validators)
-	 * @return the newly created DataValidator or nullptr on error
+	 * @return the newly created DataValidator or nullptr when all slots are in use
 	 */
 	DataValidator *add_new_validator();
 
@@ -133,8 +133,11 @@ public:
 
 
 private:
-	DataValidator *_first{nullptr};		/**< first node in the group */
-	DataValidator *_last{nullptr};		/**< last node in the group */
+	DataValidator *_validators{nullptr};	/**< contiguous array of validators */
+	float *_confidences{nullptr};		/**< per validator confidence of the last get_best() scan */
+
+	unsigned _num{0};			/**< number of validators in use */
+	unsigned _capacity{0};			/**< number of validator slots allocated */
 
 	uint32_t _timeout_interval_us{0}; /**< currently set timeout */
 
@@ -147,6 +150,10 @@ private:
 
 	static constexpr float MIN_REGULAR_CONFIDENCE = 0.9f;
 
+	/** spare validator slots allocated beyond the initial count so that sensors
+	 *  detected after startup can be added without moving the array */
+	static constexpr unsigned GROUP_RESERVE = 4;
+
 	/* we don't want this class to be copied */
 	DataValidatorGroup(const DataValidatorGroup &);
 	DataValidatorGroup operator=(const DataValidatorGroup &);